@@ -28,18 +28,25 @@
 #include "debug.h"
 #include "fat32.h"
 
+extern sdio_t sdio;
+
 static void fat32Task(void *pvParameters);
 
+static blockdev_t sd_dev;
+
 int main(void)
 {
     // Initialize the platform
     platform_init();
 
+    // Use the micro SD card as block device
+    blockdev_sdio_config(&sd_dev, sdio);
+
     // Create the logging task
     xTaskCreate(fat32Task, (signed char *)"FAT32", configMINIMAL_STACK_SIZE, NULL, 3, NULL);
 
     // Initialize FAT32 FS library
-    if (fat32_init() != FAT32_OK)
+    if (fat32_init(&sd_dev) != FAT32_OK)
     {
         log_error("Error initializing FAT32");
         HALT();
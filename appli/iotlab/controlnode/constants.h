@@ -41,11 +41,15 @@ enum {
 
     SET_TIME = 0x52,
 
+    CONFIG_SERIAL = 0x54,
+    SET_BAUDRATE = 0x55,
+
     RADIO_OFF = 0x60,
     RADIO_SNIFFER = 0x61,
     RADIO_POLLING = 0x62,
     RADIO_INJECTION = 0x63,
     RADIO_JAMMING = 0x64,
+    RADIO_MONITOR = 0x65,
 };
 
 // Notification Frames
@@ -53,8 +57,16 @@ enum
 {
     RADIO_NOTIF_SNIFFED= 0xA1,
     RADIO_NOTIF_POLLING = 0xA2,
+    RADIO_NOTIF_SWEEP = 0xA3,
 
     POWERPOLL_NOTIF = 0xB1,
+    POWERPOLL_CALIBRATION_NOTIF = 0xB2,
+
+    SERIAL_SUPERFRAME = 0xC0,
+    SERIAL_STATS_NOTIF = 0xC1,
+
+    MONITOR_NOTIF = 0xD1,
+    MONITOR_STATS_NOTIF = 0xD2,
 };
 
 
@@ -31,6 +31,7 @@
 #include "iotlab-polling.h"
 #include "iotlab-radio.h"
 #include "iotlab-serial.h"
+#include "iotlab-sched.h"
 
 #include "softtimer/soft_timer_.h"
 
@@ -52,6 +53,9 @@ int main()
     // Start the serial lib
     iotlab_serial_start(500000);
 
+    // Start the sampling scheduler, shared by the monitors
+    iotlab_sched_start();
+
     // Start the application libs
     iotlab_control_start();
     iotlab_polling_start();
@@ -43,10 +43,30 @@ static iotlab_serial_handler_t handler_set_time;
 static int32_t start_stop(uint8_t cmd_type, packet_t *pkt);
 static int32_t battery(uint8_t cmd_type, packet_t *pkt);
 static int32_t set_time(uint8_t cmd_type, packet_t *pkt);
+static void set_time_64(uint64_t local, uint64_t time_us);
+
+/** Limit of the estimated clock skew, in ppb */
+#define SKEW_MAX_PPB 500000
+/** Minimum interval between two SET_TIME to update the skew, in ticks */
+#define SKEW_MIN_INTERVAL soft_timer_s_to_ticks(1)
 
 static struct
 {
     int32_t time_offset;
+
+    /** 64bit time, enabled by the first 64bit SET_TIME */
+    struct
+    {
+        uint32_t enabled;
+
+        /** Local time and experiment time of the last SET_TIME */
+        uint64_t ref_local;
+        uint64_t ref_us;
+
+        /** Estimated skew of the local clock, in ppb */
+        int32_t skew_ppb;
+        uint32_t skew_valid;
+    } time64;
 } ctrl;
 
 void iotlab_control_start()
@@ -54,14 +74,17 @@ void iotlab_control_start()
     // Configure and register all handlers
     handler_start.cmd_type = OPENNODE_START;
     handler_start.handler = start_stop;
+    handler_start.flags = IOTLAB_SERIAL_HANDLER_FAST;
     iotlab_serial_register_handler(&handler_start);
 
     handler_start_battery.cmd_type = OPENNODE_STARTBATTERY;
     handler_start_battery.handler = start_stop;
+    handler_start_battery.flags = IOTLAB_SERIAL_HANDLER_FAST;
     iotlab_serial_register_handler(&handler_start_battery);
 
     handler_stop.cmd_type = OPENNODE_STOP;
     handler_stop.handler = start_stop;
+    handler_stop.flags = IOTLAB_SERIAL_HANDLER_FAST;
     iotlab_serial_register_handler(&handler_stop);
 
     handler_battery_charge.cmd_type = BATTERY_CHARGE;
@@ -74,10 +97,14 @@ void iotlab_control_start()
 
     handler_set_time.cmd_type = SET_TIME;
     handler_set_time.handler = set_time;
+    handler_set_time.flags = IOTLAB_SERIAL_HANDLER_FAST;
     iotlab_serial_register_handler(&handler_set_time);
 
     // Initilize the time
     ctrl.time_offset = 0;
+    ctrl.time64.enabled = 0;
+    ctrl.time64.skew_ppb = 0;
+    ctrl.time64.skew_valid = 0;
 }
 
 static int32_t start_stop(uint8_t cmd_type, packet_t *pkt)
@@ -140,8 +167,23 @@ static int32_t set_time(uint8_t cmd_type, packet_t *pkt)
 {
     /*
      * Expected packet is:
-     *      * time to set [4B]
+     *      * time to set, in ticks [4B]
+     * or, for the 64bit time:
+     *      * time to set, in microseconds [8B]
      */
+    if (pkt->length == 8)
+    {
+        uint64_t local = soft_timer_time_64();
+        uint32_t high, low;
+        packer_uint32_unpack(pkt->data, &high);
+        packer_uint32_unpack(pkt->data + 4, &low);
+        set_time_64(local, ((uint64_t) high << 32) | low);
+
+        // OK, no payload
+        pkt->length = 0;
+        return 1;
+    }
+
     if (pkt->length != 4)
     {
         log_warning("Bad packet length: %u", pkt->length);
@@ -160,7 +202,90 @@ static int32_t set_time(uint8_t cmd_type, packet_t *pkt)
     return 1;
 }
 
+static void set_time_64(uint64_t local, uint64_t time_us)
+{
+    int32_t skew_ppb = ctrl.time64.skew_ppb;
+    uint32_t skew_valid = ctrl.time64.skew_valid;
+
+    if (ctrl.time64.enabled
+            && (local - ctrl.time64.ref_local) >= SKEW_MIN_INTERVAL)
+    {
+        // Compare the elapsed times since the previous SET_TIME
+        int64_t local_us = ((local - ctrl.time64.ref_local) * 1000000)
+                / SOFT_TIMER_FREQUENCY;
+        int64_t exp_us = time_us - ctrl.time64.ref_us;
+        int64_t skew = ((exp_us - local_us) * 1000000000) / local_us;
+
+        if (skew > SKEW_MAX_PPB || skew < -SKEW_MAX_PPB)
+        {
+            log_warning("Ignoring clock skew %d ppb", (int32_t) skew);
+        }
+        else if (!skew_valid)
+        {
+            skew_ppb = skew;
+            skew_valid = 1;
+        }
+        else
+        {
+            // Low pass filter, to smooth the host timing jitter
+            skew_ppb += (skew - skew_ppb) / 4;
+        }
+    }
+
+    // Restart from the new reference, times are converted from other tasks
+    platform_enter_critical();
+    ctrl.time64.ref_local = local;
+    ctrl.time64.ref_us = time_us;
+    ctrl.time64.skew_ppb = skew_ppb;
+    ctrl.time64.skew_valid = skew_valid;
+    ctrl.time64.enabled = 1;
+    platform_exit_critical();
+}
+
 uint32_t iotlab_control_convert_time(uint32_t timestamp)
 {
     return timestamp + ctrl.time_offset;
 }
+
+uint64_t iotlab_control_convert_time_us(uint32_t timestamp)
+{
+    uint64_t ref_local, ref_us;
+    int32_t skew_ppb;
+
+    platform_enter_critical();
+    ref_local = ctrl.time64.ref_local;
+    ref_us = ctrl.time64.ref_us;
+    skew_ppb = ctrl.time64.skew_ppb;
+    platform_exit_critical();
+
+    // Signed, the timestamp may be older than the reference
+    int64_t ticks = soft_timer_convert_time_64(timestamp) - ref_local;
+    int64_t local_us = (ticks * 1000000) / SOFT_TIMER_FREQUENCY;
+
+    return ref_us + local_us + (local_us * skew_ppb) / 1000000000;
+}
+
+uint8_t *iotlab_control_pack_time(uint8_t *data, uint32_t timestamp)
+{
+    if (!ctrl.time64.enabled)
+    {
+        return packer_uint32_pack(data, iotlab_control_convert_time(timestamp));
+    }
+
+    uint64_t t = iotlab_control_convert_time_us(timestamp);
+    data = packer_uint32_pack(data, t >> 32);
+    return packer_uint32_pack(data, t);
+}
+
+uint8_t *iotlab_control_pack_time_le(uint8_t *data, uint32_t timestamp)
+{
+    if (!ctrl.time64.enabled)
+    {
+        return packer_uint32_pack(data,
+                packer_uint32_hton(iotlab_control_convert_time(timestamp)));
+    }
+
+    uint64_t t = iotlab_control_convert_time_us(timestamp);
+    data = packer_uint32_pack(data, packer_uint32_hton(t));
+    return packer_uint32_pack(data, packer_uint32_hton(t >> 32));
+}
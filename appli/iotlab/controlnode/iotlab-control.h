@@ -26,6 +26,8 @@
 #ifndef IOTLAB_CONTROL_H_
 #define IOTLAB_CONTROL_H_
 
+#include <stdint.h>
+
 /** Start the control library */
 void iotlab_control_start();
 
@@ -37,4 +39,37 @@ void iotlab_control_start();
  */
 uint32_t iotlab_control_convert_time(uint32_t timestamp);
 
+/**
+ * Convert a local time to a 64bit experiment time, in microseconds.
+ *
+ * The conversion uses the reference and the clock skew estimated from the
+ * 64bit SET_TIME commands.
+ *
+ * \param timestamp the local time to convert, obtained from soft_timer_time()
+ * \return the experiment time corresponding, in microseconds
+ */
+uint64_t iotlab_control_convert_time_us(uint32_t timestamp);
+
+/**
+ * Pack a local time in a notification frame.
+ *
+ * Once a 64bit SET_TIME has been received, this packs the 64bit experiment
+ * time in microseconds [8B], otherwise the legacy 32bit experiment time in
+ * ticks [4B].
+ *
+ * \param data where to pack the time
+ * \param timestamp the local time, obtained from soft_timer_time()
+ * \return the pointer after the packed time
+ */
+uint8_t *iotlab_control_pack_time(uint8_t *data, uint32_t timestamp);
+
+/**
+ * Same as \ref iotlab_control_pack_time, with the 32bit or 64bit time in
+ * little endian order, as used by the radio notifications.
+ */
+uint8_t *iotlab_control_pack_time_le(uint8_t *data, uint32_t timestamp);
+
+/** Maximum size of a time packed by \ref iotlab_control_pack_time */
+#define IOTLAB_CONTROL_TIME_MAX_SIZE 8
+
 #endif /* IOTLAB_CONTROL_H_ */
@@ -28,10 +28,12 @@
 #include "debug.h"
 #include "packer.h"
 #include "soft_timer.h"
+#include "event.h"
 
 #include "iotlab-polling.h"
 #include "iotlab-control.h"
 #include "iotlab-serial.h"
+#include "iotlab-sched.h"
 #include "constants.h"
 
 #include "fiteco_lib_gwt.h"
@@ -40,6 +42,64 @@ static iotlab_serial_handler_t handler_config_powerpoll;
 static int32_t config_powerpoll(uint8_t cmd_type, packet_t *pkt);
 static void polling_sample(handler_arg_t arg, float voltage, float current,
         float power, float shunt_voltage, uint32_t timestamp);
+static void polling_batch_sample(handler_arg_t arg, float voltage,
+        float current, float power, float shunt_voltage, uint32_t timestamp);
+static void polling_raw_sample(handler_arg_t arg, const uint16_t *values,
+        uint32_t timestamp);
+static uint8_t *batch_prepare(uint32_t timestamp);
+static void batch_commit(uint8_t *data, uint32_t timestamp);
+static void send_calibration();
+static void batch_flush_time(handler_arg_t arg);
+static void batch_flush_check(handler_arg_t arg);
+static void batch_send();
+
+/** Selection bits of the quantities sent in batched frames */
+enum
+{
+    POWERPOLL_VOLTAGE = 0x01,
+    POWERPOLL_CURRENT = 0x02,
+    POWERPOLL_POWER = 0x04,
+    POWERPOLL_ALL = 0x07,
+    /** Send the samples as records of the shared MONITOR_NOTIF frames */
+    POWERPOLL_MONITOR = 0x40,
+    /** Send the raw 16-bit INA226 registers instead of floats */
+    POWERPOLL_RAW = 0x80,
+};
+
+enum
+{
+    /** Size of the batched frame header: selection, count, base timestamp */
+    BATCH_HEADER_SIZE = 2 + IOTLAB_CONTROL_TIME_MAX_SIZE,
+    /** Size of a sample time delta */
+    BATCH_DELTA_SIZE = 2,
+    /** Maximum time a sample waits in a batch before the frame is sent */
+    BATCH_FLUSH_MS = 50,
+};
+
+static struct
+{
+    /** Selected quantities, POWERPOLL_* bits */
+    uint8_t selection;
+    /** Number of samples sent per frame */
+    uint8_t samples_per_pkt;
+
+    /** Set while the samples are sent to the sampling scheduler */
+    uint8_t monitor;
+    /** Record of the sample being prepared, in monitor mode */
+    uint8_t record[12];
+
+    /** Frame being filled, NULL if none */
+    packet_t *serial_pkt;
+    /** Number of samples in serial_pkt */
+    uint8_t current_sample_in_pkt;
+    /** Time of the first and last samples of serial_pkt */
+    uint32_t first_timestamp, last_timestamp;
+
+    /** Raw samples lost by the sampling, already counted as drops */
+    uint32_t raw_dropped;
+
+    soft_timer_t flush_tim;
+} batch;
 
 void iotlab_polling_start()
 {
@@ -50,21 +110,42 @@ void iotlab_polling_start()
     handler_config_powerpoll.cmd_type = CONFIG_POWERPOLL;
     handler_config_powerpoll.handler = config_powerpoll;
     iotlab_serial_register_handler(&handler_config_powerpoll);
+    iotlab_serial_set_frame_class(POWERPOLL_NOTIF, IOTLAB_SERIAL_CLASS_BULK);
+
+    soft_timer_set_handler(&batch.flush_tim, batch_flush_time, NULL);
 }
 
 static int32_t config_powerpoll(uint8_t cmd_type, packet_t *pkt)
 {
-    // Stop sampling
+    // Stop sampling, and send the samples of the previous configuration
     fiteco_lib_gwt_current_monitor_stop();
+    soft_timer_stop(&batch.flush_tim);
+    batch_send();
+
+    if (batch.monitor)
+    {
+        iotlab_sched_release();
+        batch.monitor = 0;
+    }
 
     /*
      * Expected packet is:
      *      * monitor input [1B]
      *      * sampling period [1B]
      *      * average mode [1B]
+     *
+     * Optionally followed by, to enable batched notifications:
+     *      * selected quantities, POWERPOLL_* bits [1B]
+     *      * samples per frame, 0 for as many as fit in a frame [1B]
+     *
+     * In raw mode, a POWERPOLL_CALIBRATION_NOTIF frame is sent first with
+     * the LSB values to convert the registers.
+     *
+     * With POWERPOLL_MONITOR, each sample is a POWERPOLL_NOTIF record of the
+     * MONITOR_NOTIF frames, with the selected values only.
      */
 
-    if (pkt->length != 3)
+    if (pkt->length != 3 && pkt->length != 5)
     {
         log_warning("Bad packet length: %u", pkt->length);
         pkt->length = 0;
@@ -96,11 +177,75 @@ static int32_t config_powerpoll(uint8_t cmd_type, packet_t *pkt)
         return 0;
     }
 
-    if (input != FITECO_GWT_CURRENT_MONITOR__OFF)
+    fiteco_lib_gwt_current_monitor_handler_t handler = polling_sample;
+
+    if (pkt->length == 5)
+    {
+        uint8_t selection = pkt->data[3];
+        uint8_t samples = pkt->data[4];
+
+        if ((selection & POWERPOLL_ALL) == 0
+                || (selection
+                        & ~(POWERPOLL_ALL | POWERPOLL_MONITOR | POWERPOLL_RAW)))
+        {
+            log_warning("Invalid quantity selection %x", selection);
+            pkt->length = 0;
+            return 0;
+        }
+
+        // Limit the number of samples to what fits in a frame
+        uint32_t value_size = (selection & POWERPOLL_RAW) ? 2 : 4;
+        uint32_t sample_size = BATCH_DELTA_SIZE
+                + value_size * __builtin_popcount(selection & POWERPOLL_ALL);
+        uint32_t max_samples = (PACKET_MAX_SIZE - IOTLAB_SERIAL_PACKET_OFFSET
+                - BATCH_HEADER_SIZE) / sample_size;
+
+        if (samples == 0 || samples > max_samples)
+        {
+            samples = max_samples;
+        }
+
+        batch.selection = selection;
+        batch.samples_per_pkt = samples;
+        handler = polling_batch_sample;
+
+        if (input != FITECO_GWT_CURRENT_MONITOR__OFF
+                && (selection & POWERPOLL_MONITOR))
+        {
+            iotlab_sched_acquire();
+            batch.monitor = 1;
+        }
+    }
+
+    if (input != FITECO_GWT_CURRENT_MONITOR__OFF && pkt->length == 5
+            && (batch.selection & POWERPOLL_RAW))
+    {
+        // Read the registers from interrupt, without conversion
+        uint8_t registers = 0;
+        if (batch.selection & POWERPOLL_VOLTAGE)
+        {
+            registers |= INA226_RAW_BUS_VOLTAGE;
+        }
+        if (batch.selection & POWERPOLL_CURRENT)
+        {
+            registers |= INA226_RAW_CURRENT;
+        }
+        if (batch.selection & POWERPOLL_POWER)
+        {
+            registers |= INA226_RAW_POWER;
+        }
+
+        fiteco_lib_gwt_current_monitor_configure(period, average);
+        batch.raw_dropped = 0;
+        fiteco_lib_gwt_current_monitor_select_raw(input, registers,
+                polling_raw_sample, NULL);
+        send_calibration();
+    }
+    else if (input != FITECO_GWT_CURRENT_MONITOR__OFF)
     {
         // Set parameters and start sampling
         fiteco_lib_gwt_current_monitor_configure(period, average);
-        fiteco_lib_gwt_current_monitor_select(input, polling_sample, NULL);
+        fiteco_lib_gwt_current_monitor_select(input, handler, NULL);
     }
     // OK
     pkt->length = 0;
@@ -113,28 +258,237 @@ static void polling_sample(handler_arg_t arg, float voltage, float current,
     packet_t *pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
     if (pkt == NULL)
     {
-        log_error("Failed to allocate packet for polling data");
+        iotlab_serial_count_drop(POWERPOLL_NOTIF);
         return;
     }
 
     /**
      * Prepare packet as follows:
-     *      * timestamp [4B]
+     *      * timestamp [4B, 8B with the 64bit time]
      *      * voltage [4B]
      *      * current [4B]
      *      * power [4B]
      */
     uint8_t *data = pkt->data;
-    data = packer_uint32_pack(data, iotlab_control_convert_time(timestamp));
+    data = iotlab_control_pack_time(data, timestamp);
     data = packer_float_pack(data, voltage);
     data = packer_float_pack(data, current);
     data = packer_float_pack(data, power);
 
     pkt->length = data - pkt->data;
     if (!iotlab_serial_send_frame(POWERPOLL_NOTIF, pkt))
+    {
+        // Counted as dropped by the serial library
+        packet_free(pkt);
+    }
+}
+
+static void polling_batch_sample(handler_arg_t arg, float voltage,
+        float current, float power, float shunt_voltage, uint32_t timestamp)
+{
+    uint8_t *data = batch_prepare(timestamp);
+    if (data == NULL)
+    {
+        return;
+    }
+
+    if (batch.selection & POWERPOLL_VOLTAGE)
+    {
+        data = packer_float_pack(data, voltage);
+    }
+    if (batch.selection & POWERPOLL_CURRENT)
+    {
+        data = packer_float_pack(data, current);
+    }
+    if (batch.selection & POWERPOLL_POWER)
+    {
+        data = packer_float_pack(data, power);
+    }
+
+    batch_commit(data, timestamp);
+}
+
+static void polling_raw_sample(handler_arg_t arg, const uint16_t *values,
+        uint32_t timestamp)
+{
+    // Report the samples lost before reaching here with the frame drops
+    uint32_t dropped = fiteco_lib_gwt_current_monitor_raw_dropped();
+    while (batch.raw_dropped != dropped)
+    {
+        batch.raw_dropped++;
+        iotlab_serial_count_drop(POWERPOLL_NOTIF);
+    }
+
+    uint8_t *data = batch_prepare(timestamp);
+    if (data == NULL)
+    {
+        return;
+    }
+
+    // Values are in register order: bus voltage, power, current
+    uint16_t voltage = 0, current = 0, power = 0;
+    if (batch.selection & POWERPOLL_VOLTAGE)
+    {
+        voltage = *values++;
+    }
+    if (batch.selection & POWERPOLL_POWER)
+    {
+        power = *values++;
+    }
+    if (batch.selection & POWERPOLL_CURRENT)
+    {
+        current = *values++;
+    }
+
+    // Sent in the same order as floats
+    if (batch.selection & POWERPOLL_VOLTAGE)
+    {
+        data = packer_uint16_pack(data, voltage);
+    }
+    if (batch.selection & POWERPOLL_CURRENT)
+    {
+        data = packer_uint16_pack(data, current);
+    }
+    if (batch.selection & POWERPOLL_POWER)
+    {
+        data = packer_uint16_pack(data, power);
+    }
+
+    batch_commit(data, timestamp);
+}
+
+static uint8_t *batch_prepare(uint32_t timestamp)
+{
+    // The sample is a record, the scheduler has the timestamp
+    if (batch.monitor)
+    {
+        return batch.record;
+    }
+
+    // Deltas are 16 bits, start a new frame if the previous sample is too old
+    if (batch.serial_pkt
+            && (timestamp - batch.last_timestamp) > 0xFFFF)
+    {
+        batch_send();
+    }
+
+    // Get packet if required
+    if (batch.serial_pkt == NULL)
+    {
+        batch.serial_pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+        if (batch.serial_pkt == NULL)
+        {
+            iotlab_serial_count_drop(POWERPOLL_NOTIF);
+            return NULL;
+        }
+
+        /**
+         * Prepare packet as follows:
+         *      * selected quantities [1B]
+         *      * number of samples [1B], set when sent
+         *      * base timestamp [4B, 8B with the 64bit time]
+         * then for each sample:
+         *      * ticks since the previous sample (0 for the first) [2B]
+         *      * voltage, current, power if selected [4B each, 2B if raw]
+         */
+        uint8_t *data = batch.serial_pkt->data;
+        *data++ = batch.selection;
+        *data++ = 0;
+        data = iotlab_control_pack_time(data, timestamp);
+        batch.serial_pkt->length = data - batch.serial_pkt->data;
+
+        batch.current_sample_in_pkt = 0;
+        batch.first_timestamp = timestamp;
+        batch.last_timestamp = timestamp;
+
+        // Make sure the samples don't wait too long if the rate is low
+        soft_timer_start(&batch.flush_tim,
+                soft_timer_ms_to_ticks(BATCH_FLUSH_MS), 0);
+    }
+
+    // Append sample delta, the values follow
+    uint8_t *data = batch.serial_pkt->data + batch.serial_pkt->length;
+    return packer_uint16_pack(data, timestamp - batch.last_timestamp);
+}
+
+static void batch_commit(uint8_t *data, uint32_t timestamp)
+{
+    if (batch.monitor)
+    {
+        iotlab_sched_record(POWERPOLL_NOTIF, timestamp, batch.record,
+                data - batch.record);
+        return;
+    }
+
+    batch.serial_pkt->length = data - batch.serial_pkt->data;
+    batch.last_timestamp = timestamp;
+
+    // Send if full
+    batch.current_sample_in_pkt++;
+    if (batch.current_sample_in_pkt >= batch.samples_per_pkt)
+    {
+        batch_send();
+    }
+}
+
+static void send_calibration()
+{
+    packet_t *pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+    if (pkt == NULL)
+    {
+        log_error("Failed to allocate packet for calibration");
+        return;
+    }
+
+    /**
+     * Prepare packet as follows:
+     *      * voltage LSB, in V [4B]
+     *      * current LSB, in A [4B]
+     *      * power LSB, in W [4B]
+     */
+    float current_lsb = ina226_get_current_lsb();
+    uint8_t *data = pkt->data;
+    data = packer_float_pack(data, INA226_BUS_VOLTAGE_LSB);
+    data = packer_float_pack(data, current_lsb);
+    data = packer_float_pack(data, INA226_POWER_LSB_RATIO * current_lsb);
+
+    pkt->length = data - pkt->data;
+    if (!iotlab_serial_send_frame(POWERPOLL_CALIBRATION_NOTIF, pkt))
     {
         log_error("Failed to send to serial");
         packet_free(pkt);
     }
+}
 
+static void batch_flush_time(handler_arg_t arg)
+{
+    // Soft timer handlers may not run in the sampling task
+    event_post(EVENT_QUEUE_APPLI, batch_flush_check, NULL);
+}
+
+static void batch_flush_check(handler_arg_t arg)
+{
+    // The frame may have been sent and a new one started since the timeout
+    if (batch.serial_pkt && (soft_timer_time() - batch.first_timestamp)
+            >= soft_timer_ms_to_ticks(BATCH_FLUSH_MS))
+    {
+        batch_send();
+    }
+}
+
+static void batch_send()
+{
+    if (batch.serial_pkt == NULL)
+    {
+        return;
+    }
+
+    batch.serial_pkt->data[1] = batch.current_sample_in_pkt;
+
+    if (!iotlab_serial_send_frame(POWERPOLL_NOTIF, batch.serial_pkt))
+    {
+        // Counted as dropped by the serial library
+        packet_free(batch.serial_pkt);
+    }
+    batch.serial_pkt = NULL;
 }
@@ -30,24 +30,28 @@
 #include "iotlab-radio.h"
 #include "iotlab-serial.h"
 #include "iotlab-control.h"
+#include "iotlab-sched.h"
 
 #include "constants.h"
 
 #include "phy.h"
 #include "packer.h"
 #include "soft_timer.h"
+#include "event.h"
 
 static iotlab_serial_handler_t handler_off;
 static iotlab_serial_handler_t handler_sniffer;
 static iotlab_serial_handler_t handler_polling;
 static iotlab_serial_handler_t handler_injection;
 static iotlab_serial_handler_t handler_jamming;
+static iotlab_serial_handler_t handler_monitor;
 
 static int32_t radio_off(uint8_t cmd_type, packet_t *pkt);
 static int32_t radio_sniffer(uint8_t cmd_type, packet_t *pkt);
 static int32_t radio_polling(uint8_t cmd_type, packet_t *pkt);
 static int32_t radio_injection(uint8_t cmd_type, packet_t *pkt);
 static int32_t radio_jamming(uint8_t cmd_type, packet_t *pkt);
+static int32_t radio_monitor(uint8_t cmd_type, packet_t *pkt);
 
 static struct
 {
@@ -66,6 +70,14 @@ static struct
         packet_t *serial_pkt;
         uint32_t max_poll_per_pkt;
         uint32_t current_poll_in_pkt;
+
+        /** Channels of the sweep mode */
+        uint32_t sweep_channels;
+        /** Incremented to stop back to back sweeps */
+        uint32_t sweep_id;
+        /** Period and next start of the periodic sweeps, in ticks */
+        uint32_t sweep_period;
+        uint32_t sweep_alarm;
     } poll;
 
     struct
@@ -74,6 +86,16 @@ static struct
         uint32_t current_pkts_on_channel;
 
         phy_packet_t pkt;
+
+        /** Hardware timed mode, TX period in ticks, 0 for back to back */
+        uint32_t timed;
+        uint32_t period;
+        /** Time of the next timed TX */
+        uint32_t next_time;
+
+        /** Place a sequence number and a timestamp in the payload */
+        uint32_t stamp;
+        uint32_t seq;
     } injection;
 
     struct
@@ -81,6 +103,19 @@ static struct
         phy_power_t tx_power;
     } jam;
 
+    struct
+    {
+        /** Set while on the sampling timeline */
+        uint32_t active;
+        /** Sniffed channel, 0 if not sniffing */
+        uint32_t sniff_channel;
+        /** Channels measured in turn in the ED slots, and the last one */
+        uint32_t ed_channels;
+        uint32_t ed_channel;
+
+        iotlab_sched_activity_t ed;
+    } monitor;
+
 } radio;
 
 void iotlab_radio_start()
@@ -105,6 +140,18 @@ void iotlab_radio_start()
     handler_jamming.cmd_type = RADIO_JAMMING;
     handler_jamming.handler = radio_jamming;
     iotlab_serial_register_handler(&handler_jamming);
+
+    handler_monitor.cmd_type = RADIO_MONITOR;
+    handler_monitor.handler = radio_monitor;
+    iotlab_serial_register_handler(&handler_monitor);
+
+    // Sniffed frames and polling are bulk notifications
+    iotlab_serial_set_frame_class(RADIO_NOTIF_SNIFFED,
+            IOTLAB_SERIAL_CLASS_BULK);
+    iotlab_serial_set_frame_class(RADIO_NOTIF_POLLING,
+            IOTLAB_SERIAL_CLASS_BULK);
+    iotlab_serial_set_frame_class(RADIO_NOTIF_SWEEP,
+            IOTLAB_SERIAL_CLASS_BULK);
 }
 
 static void proper_stop()
@@ -112,9 +159,22 @@ static void proper_stop()
     // Stop timer
     soft_timer_stop(&radio.period_tim);
 
-    // Set PHY idle
+    // Leave the sampling timeline, before it takes the radio again
+    if (radio.monitor.active)
+    {
+        iotlab_sched_set_background(NULL, NULL);
+        iotlab_sched_remove(&radio.monitor.ed);
+        iotlab_sched_release();
+        radio.monitor.active = 0;
+    }
+
+    // Stop timed injection, then set PHY idle
+    radio.injection.timed = 0;
     phy_idle(platform_phy);
 
+    // Stop back to back sweeps
+    radio.poll.sweep_id++;
+
     // Free polling packet
     if (radio.poll.serial_pkt)
     {
@@ -236,25 +296,37 @@ static void sniff_rx(phy_status_t status)
         packet_t *serial_pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
         if (serial_pkt == NULL)
         {
-            log_error("Failed to get a packet for sniffed RX");
+            iotlab_serial_count_drop(RADIO_NOTIF_SNIFFED);
             return;
         }
 
         uint8_t *data = serial_pkt->data;
 
         // Place timestamp, channel, RSSI, LQI, captured length, as header
-        data = packer_uint32_pack(data,
-                packer_uint32_hton(
-                        iotlab_control_convert_time(rx_packet->timestamp)));
+        data = iotlab_control_pack_time_le(data, rx_packet->timestamp);
         *data++ = radio.current_channel;
         *data++ = rx_packet->rssi;
         *data++ = rx_packet->lqi;
-        *data++ = rx_packet->length;
-        memcpy(data, rx_packet->data, rx_packet->length);
-        data += rx_packet->length;
+
+        // Capture what fits in the serial frame
+        uint32_t length = rx_packet->length;
+        uint32_t room = PACKET_MAX_SIZE - IOTLAB_SERIAL_PACKET_OFFSET
+                - (data + 1 - serial_pkt->data);
+        if (length > room)
+        {
+            length = room;
+        }
+        *data++ = length;
+        memcpy(data, rx_packet->data, length);
+        data += length;
         serial_pkt->length = data - serial_pkt->data;
 
-        event_post(EVENT_QUEUE_APPLI, sniff_send_to_serial, serial_pkt);
+        if (event_post(EVENT_QUEUE_APPLI, sniff_send_to_serial, serial_pkt)
+                != EVENT_OK)
+        {
+            iotlab_serial_count_drop(RADIO_NOTIF_SNIFFED);
+            packet_free(serial_pkt);
+        }
     }
 }
 
@@ -263,7 +335,7 @@ static void sniff_send_to_serial(handler_arg_t arg)
     packet_t *pkt = arg;
     if (!iotlab_serial_send_frame(RADIO_NOTIF_SNIFFED, pkt))
     {
-        log_error("Failed to send captured frame");
+        // Counted as dropped by the serial library
         packet_free(pkt);
     }
 }
@@ -297,6 +369,10 @@ static void sniff_switch_channel(handler_arg_t arg)
 }
 /* ********************** POLLING **************************** */
 static void poll_time(handler_arg_t arg);
+static int32_t radio_sweep(packet_t *pkt);
+static void sweep_time(handler_arg_t arg);
+static void sweep_periodic(handler_arg_t arg);
+static void sweep_next(handler_arg_t arg);
 
 static int32_t radio_polling(uint8_t cmd_type, packet_t *pkt)
 {
@@ -307,8 +383,17 @@ static int32_t radio_polling(uint8_t cmd_type, packet_t *pkt)
      * Expected packet format is (length:3B):
      *      * channel                   [1B]
      *      * Sample period (1/1000s)   [2B]
+     *
+     * or for the sweep mode (length:6B):
+     *      * channels bitmap           [4B]
+     *      * Sweep period (1/1000s)    [2B]
      */
 
+    if (pkt->length == 6)
+    {
+        return radio_sweep(pkt);
+    }
+
     if (pkt->length != 3)
     {
         log_warning("Bad Packet length: %u", pkt->length);
@@ -360,7 +445,7 @@ static int32_t radio_polling(uint8_t cmd_type, packet_t *pkt)
 static void poll_time(handler_arg_t arg)
 {
     int32_t ed = 0;
-    uint32_t timestamp = iotlab_control_convert_time(soft_timer_time());
+    uint32_t timestamp = soft_timer_time();
     phy_ed(platform_phy, &ed);
 
     // Get packet if required
@@ -369,11 +454,12 @@ static void poll_time(handler_arg_t arg)
         radio.poll.serial_pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
         if (radio.poll.serial_pkt == NULL)
         {
-            log_error("Failed to get Packet");
+            iotlab_serial_count_drop(RADIO_NOTIF_POLLING);
             return;
         }
-        memcpy(radio.poll.serial_pkt->data, &timestamp, 4);
-        radio.poll.serial_pkt->length = 4;
+        radio.poll.serial_pkt->length = iotlab_control_pack_time_le(
+                radio.poll.serial_pkt->data, timestamp)
+                - radio.poll.serial_pkt->data;
     }
 
     // Append measurement
@@ -390,16 +476,148 @@ static void poll_time(handler_arg_t arg)
         if (iotlab_serial_send_frame(RADIO_NOTIF_POLLING, radio.poll.serial_pkt)
                 != 1)
         {
-            log_error("Failed to send serial log");
             packet_free(radio.poll.serial_pkt);
         }
         radio.poll.serial_pkt = NULL;
     }
 }
 
+static int32_t radio_sweep(packet_t *pkt)
+{
+    uint32_t channels;
+    uint16_t sweep_period;
+    memcpy(&channels, pkt->data, 4);
+    memcpy(&sweep_period, pkt->data + 4, 2);
+
+    // Keep only valid channels
+    channels &= ((1 << (PHY_2400_MAX_CHANNEL + 1)) - 1)
+            & ~((1 << PHY_2400_MIN_CHANNEL) - 1);
+
+    if (channels == 0)
+    {
+        log_warning("Invalid channels: %x", channels);
+        pkt->length = 0;
+        return 0;
+    }
+
+    log_info("Radio Sweep on channels %x, period %u", channels, sweep_period);
+
+    radio.poll.sweep_channels = channels;
+    radio.poll.sweep_id++;
+
+    if (sweep_period == 0)
+    {
+        // Back to back sweeps, giving way to the other events in between
+        event_post(EVENT_QUEUE_APPLI, sweep_next,
+                (handler_arg_t) (uintptr_t) radio.poll.sweep_id);
+    }
+    else
+    {
+        // Re-armed by each sweep, so that a slow sweep never piles events up
+        radio.poll.sweep_period = soft_timer_ms_to_ticks(sweep_period);
+        radio.poll.sweep_alarm = soft_timer_time() + radio.poll.sweep_period;
+        soft_timer_set_handler(&radio.period_tim, sweep_periodic,
+                (handler_arg_t) (uintptr_t) radio.poll.sweep_id);
+        soft_timer_start_at(&radio.period_tim, radio.poll.sweep_alarm);
+    }
+
+    pkt->length = 0;
+    return 1;
+}
+
+static void sweep_time(handler_arg_t arg)
+{
+    packet_t *pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+    if (pkt == NULL)
+    {
+        iotlab_serial_count_drop(RADIO_NOTIF_SWEEP);
+        return;
+    }
+
+    /**
+     * Prepare packet as follows:
+     *      * timestamp of the sweep start [4B, 8B with the 64bit time]
+     *      * sweep duration, in 1/32768s [2B]
+     *      * ED for each channel of the bitmap, in dBm [1B each]
+     */
+    int8_t ed[PHY_2400_MAX_CHANNEL - PHY_2400_MIN_CHANNEL + 1];
+    uint32_t nchannels = __builtin_popcount(radio.poll.sweep_channels);
+
+    uint32_t start = soft_timer_time();
+    if (phy_ed_sweep(platform_phy, radio.poll.sweep_channels, ed)
+            != PHY_SUCCESS)
+    {
+        log_error("ED sweep failed");
+        packet_free(pkt);
+        return;
+    }
+    uint32_t duration = soft_timer_time() - start;
+
+    uint8_t *data = iotlab_control_pack_time_le(pkt->data, start);
+    data = packer_uint16_pack(data, duration > 0xFFFF ? 0xFFFF : duration);
+    memcpy(data, ed, nchannels);
+    data += nchannels;
+
+    pkt->length = data - pkt->data;
+    if (!iotlab_serial_send_frame(RADIO_NOTIF_SWEEP, pkt))
+    {
+        packet_free(pkt);
+    }
+}
+
+static void sweep_periodic(handler_arg_t arg)
+{
+    // Stopped or restarted since posted
+    if ((uint32_t) (uintptr_t) arg != radio.poll.sweep_id)
+    {
+        return;
+    }
+
+    sweep_time(NULL);
+
+    // Next period in the future, the skipped ones are counted as drops
+    radio.poll.sweep_alarm += radio.poll.sweep_period;
+    while ((int32_t) (radio.poll.sweep_alarm - soft_timer_time()) <= 0)
+    {
+        radio.poll.sweep_alarm += radio.poll.sweep_period;
+        iotlab_serial_count_drop(RADIO_NOTIF_SWEEP);
+    }
+    soft_timer_start_at(&radio.period_tim, radio.poll.sweep_alarm);
+}
+
+static void sweep_next(handler_arg_t arg)
+{
+    // Stopped or restarted since posted
+    if ((uint32_t) (uintptr_t) arg != radio.poll.sweep_id)
+    {
+        return;
+    }
+
+    sweep_time(NULL);
+
+    if (event_post(EVENT_QUEUE_APPLI, sweep_next, arg) != EVENT_OK)
+    {
+        log_error("Failed to post next sweep");
+    }
+}
+
 /* ********************** INJECTION **************************** */
 static void injection_time(handler_arg_t arg);
+static void injection_skip(handler_arg_t arg);
 static void injection_tx_done(phy_status_t status);
+static void injection_send(uint32_t tx_time);
+
+/** Flags of the extended injection command */
+enum
+{
+    /** The TX period is in 1/32768s and frames are sent at hardware times */
+    INJECTION_FLAG_TIMED = 0x01,
+    /** Sequence number and timestamp at the start of the payload */
+    INJECTION_FLAG_STAMP = 0x02,
+};
+
+/** Minimum time to prepare a timed TX, else it is sent right away */
+#define INJECTION_MIN_LEAD soft_timer_us_to_ticks(500)
 
 static int32_t radio_injection(uint8_t cmd_type, packet_t *pkt)
 {
@@ -413,9 +631,17 @@ static int32_t radio_injection(uint8_t cmd_type, packet_t *pkt)
      *      * num packets per channel   [2B]
      *      * TX power                  [4B]
      *      * packet size               [1B]
+     *
+     * optionally followed by (length:14B):
+     *      * INJECTION_FLAG_* flags    [1B]
+     *
+     * With INJECTION_FLAG_TIMED, the TX period is in 1/32768s, 0 for back to
+     * back frames. With INJECTION_FLAG_STAMP, the payload starts with a
+     * sequence number [4B] and the experiment time of the TX [4B, 8B with
+     * the 64bit time].
      */
 
-    if (pkt->length != 13)
+    if (pkt->length != 13 && pkt->length != 14)
     {
         log_warning("Bad Packet length: %u", pkt->length);
         pkt->length = 0;
@@ -434,6 +660,7 @@ static int32_t radio_injection(uint8_t cmd_type, packet_t *pkt)
     memcpy(&tx_power, data, 4);
     data += 4;
     uint32_t pkt_size = *data++;
+    uint8_t flags = (pkt->length == 14) ? *data++ : 0;
 
     if ((radio.channels & PHY_MAP_CHANNEL_2400_ALL) == 0)
     {
@@ -450,17 +677,25 @@ static int32_t radio_injection(uint8_t cmd_type, packet_t *pkt)
         return 0;
     }
 
-    if (tx_period == 0)
+    if (tx_period == 0 && !(flags & INJECTION_FLAG_TIMED))
     {
         log_warning("Invalid injection TX period: %u", tx_period);
         pkt->length = 0;
         return 0;
     }
 
+    if ((flags & INJECTION_FLAG_STAMP)
+            && pkt_size < 4 + IOTLAB_CONTROL_TIME_MAX_SIZE)
+    {
+        log_warning("Injection length too small for stamps: %u", pkt_size);
+        pkt->length = 0;
+        return 0;
+    }
+
     log_info(
-            "Radio Injection on channels %08x, period %u, %u pkt/ch, %fdBm, %ubytes",
+            "Radio Injection on channels %08x, period %u, %u pkt/ch, %d(0.1dBm), %ubytes",
             radio.channels, tx_period, radio.injection.num_pkts_per_channel,
-            tx_power, pkt_size);
+            (int32_t) (tx_power * 10), pkt_size);
 
     // Prepare packet
     phy_prepare_packet(&radio.injection.pkt);
@@ -481,15 +716,28 @@ static int32_t radio_injection(uint8_t cmd_type, packet_t *pkt)
 
     // Clear TX count
     radio.injection.current_pkts_on_channel = 0;
+    radio.injection.stamp = (flags & INJECTION_FLAG_STAMP) != 0;
+    radio.injection.seq = 0;
 
     // Wake PHY and configure
     phy_set_channel(platform_phy, radio.current_channel);
     phy_set_power(platform_phy, phy_convert_power(tx_power));
 
-    // Start sending timer
-    soft_timer_set_handler(&radio.period_tim, injection_time, NULL);
-    soft_timer_start(&radio.period_tim, soft_timer_ms_to_ticks(5 * tx_period),
-            1);
+    if (flags & INJECTION_FLAG_TIMED)
+    {
+        // Each frame is scheduled at the end of the previous one
+        radio.injection.timed = 1;
+        radio.injection.period = tx_period;
+        radio.injection.next_time = soft_timer_time();
+        injection_send(0);
+    }
+    else
+    {
+        // Start sending timer
+        soft_timer_set_handler(&radio.period_tim, injection_time, NULL);
+        soft_timer_start(&radio.period_tim,
+                soft_timer_ms_to_ticks(5 * tx_period), 1);
+    }
 
     // OK
     pkt->length = 0;
@@ -498,11 +746,39 @@ static int32_t radio_injection(uint8_t cmd_type, packet_t *pkt)
 
 static void injection_time(handler_arg_t arg)
 {
-    if (phy_tx_now(platform_phy, &radio.injection.pkt, injection_tx_done) != PHY_SUCCESS)
+    injection_send(0);
+}
+
+static void injection_send(uint32_t tx_time)
+{
+    if (radio.injection.stamp)
+    {
+        // The timestamp is the requested TX time, or now
+        uint8_t *data = radio.injection.pkt.data;
+        data = packer_uint32_pack(data, radio.injection.seq++);
+        iotlab_control_pack_time(data, tx_time ? tx_time : soft_timer_time());
+    }
+
+    if (phy_tx(platform_phy, tx_time, &radio.injection.pkt, injection_tx_done)
+            != PHY_SUCCESS)
     {
         log_error("Failed to send injection packet");
+
+        if (radio.injection.timed)
+        {
+            // Skip this slot, the chain goes on with the next one
+            soft_timer_set_handler(&radio.period_tim, injection_skip, NULL);
+            soft_timer_start(&radio.period_tim,
+                    radio.injection.period ?
+                            radio.injection.period : INJECTION_MIN_LEAD, 0);
+        }
     }
 }
+
+static void injection_skip(handler_arg_t arg)
+{
+    injection_tx_done(PHY_ERR_INTERNAL);
+}
 static void injection_tx_done(phy_status_t status)
 {
     // Increment packet count and check
@@ -528,6 +804,31 @@ static void injection_tx_done(phy_status_t status)
         log_info("Injecting %u packets on channel %u",
                 radio.injection.num_pkts_per_channel, radio.current_channel);
     }
+
+    if (!radio.injection.timed)
+    {
+        return;
+    }
+
+    // Schedule the next frame, send it right away if there is no time left
+    if (radio.injection.period == 0)
+    {
+        injection_send(0);
+        return;
+    }
+
+    radio.injection.next_time += radio.injection.period;
+
+    if ((int32_t) (radio.injection.next_time - soft_timer_time())
+            < (int32_t) INJECTION_MIN_LEAD)
+    {
+        radio.injection.next_time = soft_timer_time();
+        injection_send(0);
+    }
+    else
+    {
+        injection_send(radio.injection.next_time);
+    }
 }
 
 /* ********************** JAMMING **************************** */
@@ -569,8 +870,8 @@ static int32_t radio_jamming(uint8_t cmd_type, packet_t *pkt)
     }
     radio.channels &= PHY_MAP_CHANNEL_2400_ALL;
 
-    log_info("Radio Jamming on channels %08x, change period %u, power %f",
-            radio.channels, channel_period, tx_power);
+    log_info("Radio Jamming on channels %08x, change period %u, power %d(0.1dBm)",
+            radio.channels, channel_period, (int32_t) (tx_power * 10));
 
     // Select first channel
     for (radio.current_channel = 0;
@@ -614,3 +915,154 @@ static void jam_change_channel_time(handler_arg_t arg)
 
     log_info("Jamming on channel %u", radio.current_channel);
 }
+
+/* ********************** MONITOR **************************** */
+static void monitor_suspend(handler_arg_t arg);
+static void monitor_resume(handler_arg_t arg);
+static void monitor_ed(uint32_t slot_time);
+
+static int32_t radio_monitor(uint8_t cmd_type, packet_t *pkt)
+{
+    // Stop all
+    proper_stop();
+
+    /*
+     * Expected packet format is (length:8B):
+     *      * slot duration (1/32768s)          [2B]
+     *      * sniffed channel, 0 for none       [1B]
+     *      * ED channels bitmap, 0 for none    [4B]
+     *      * ED period, in slots               [1B]
+     *
+     * The sniffer listens between the ED slots, each ED slot measures the
+     * next channel of the bitmap. Sniffed frames are sent in
+     * RADIO_NOTIF_SNIFFED frames, the ED measures as RADIO_NOTIF_POLLING
+     * records in MONITOR_NOTIF frames:
+     *      * channel [1B]
+     *      * ED, in dBm [1B]
+     */
+
+    if (pkt->length != 8)
+    {
+        log_warning("Bad Packet length: %u", pkt->length);
+        pkt->length = 0;
+        return 0;
+    }
+
+    const uint8_t *data = pkt->data;
+    uint16_t slot;
+    memcpy(&slot, data, 2);
+    data += 2;
+    uint8_t sniff_channel = *data++;
+    uint32_t ed_channels;
+    memcpy(&ed_channels, data, 4);
+    data += 4;
+    uint8_t ed_period = *data++;
+
+    ed_channels &= PHY_MAP_CHANNEL_2400_ALL;
+
+    if (sniff_channel != 0 && (sniff_channel < PHY_2400_MIN_CHANNEL
+            || sniff_channel > PHY_2400_MAX_CHANNEL))
+    {
+        log_warning("Invalid channel: %u", sniff_channel);
+        pkt->length = 0;
+        return 0;
+    }
+
+    if (ed_channels != 0 && (slot == 0 || ed_period == 0))
+    {
+        log_warning("Invalid ED slot %u, period %u", slot, ed_period);
+        pkt->length = 0;
+        return 0;
+    }
+
+    if (sniff_channel == 0 && ed_channels == 0)
+    {
+        log_warning("Nothing to monitor");
+        pkt->length = 0;
+        return 0;
+    }
+
+    log_info("Radio Monitor sniffing channel %u, ED on %08x every %u x %u",
+            sniff_channel, ed_channels, ed_period, slot);
+
+    radio.monitor.active = 1;
+    radio.monitor.sniff_channel = sniff_channel;
+    radio.monitor.ed_channels = ed_channels;
+    radio.monitor.ed_channel = PHY_2400_MAX_CHANNEL;
+
+    // The combined statistics are reported until stopped
+    iotlab_sched_acquire();
+
+    if (sniff_channel)
+    {
+        // Listen, the ED slots suspend the RX
+        radio.current_channel = sniff_channel;
+        radio.sniff.pkt_index = 0;
+        phy_prepare_packet(radio.sniff.pkt_buf + radio.sniff.pkt_index);
+        monitor_resume(NULL);
+
+        iotlab_sched_set_background(monitor_suspend, monitor_resume);
+    }
+
+    if (ed_channels)
+    {
+        radio.monitor.ed.run = monitor_ed;
+        radio.monitor.ed.period = ed_period;
+        radio.monitor.ed.phase = 0;
+        radio.monitor.ed.radio = 1;
+        radio.monitor.ed.type = RADIO_NOTIF_POLLING;
+
+        iotlab_sched_set_slot(slot);
+        iotlab_sched_add(&radio.monitor.ed);
+    }
+
+    // OK
+    pkt->length = 0;
+    return 1;
+}
+
+static void monitor_suspend(handler_arg_t arg)
+{
+    // A frame being received is lost
+    phy_idle(platform_phy);
+}
+
+static void monitor_resume(handler_arg_t arg)
+{
+    phy_set_channel(platform_phy, radio.monitor.sniff_channel);
+    phy_status_t ret = phy_rx(platform_phy, 0,
+            soft_timer_time() + soft_timer_ms_to_ticks(500),
+            radio.sniff.pkt_buf + radio.sniff.pkt_index, sniff_rx);
+    if (ret != PHY_SUCCESS)
+    {
+        log_error("PHY RX Failed");
+    }
+}
+
+static void monitor_ed(uint32_t slot_time)
+{
+    // Select next channel
+    do
+    {
+        radio.monitor.ed_channel++;
+        if (radio.monitor.ed_channel > PHY_2400_MAX_CHANNEL)
+        {
+            radio.monitor.ed_channel = PHY_2400_MIN_CHANNEL;
+        }
+    } while ((radio.monitor.ed_channels & (1 << radio.monitor.ed_channel))
+            == 0);
+
+    int32_t ed = 0;
+    uint32_t timestamp = soft_timer_time();
+
+    phy_set_channel(platform_phy, radio.monitor.ed_channel);
+    if (phy_ed(platform_phy, &ed) != PHY_SUCCESS)
+    {
+        log_error("ED failed");
+        return;
+    }
+
+    uint8_t record[2] =
+    { radio.monitor.ed_channel, ed };
+    iotlab_sched_record(RADIO_NOTIF_POLLING, timestamp, record, 2);
+}
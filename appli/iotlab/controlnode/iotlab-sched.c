@@ -0,0 +1,451 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2013 HiKoB.
+ */
+
+/*
+ * iotlab-sched.c
+ *
+ * The timeline runs in the network event queue, with the radio handlers.
+ * The aggregated frame is shared with the application event queue, it is
+ * only modified with the interrupts masked.
+ */
+
+#include <string.h>
+
+#include "platform.h"
+#include "debug.h"
+#include "packer.h"
+#include "soft_timer.h"
+#include "event.h"
+
+#include "iotlab-sched.h"
+#include "iotlab-serial.h"
+#include "iotlab-control.h"
+#include "constants.h"
+
+static void slot_time(handler_arg_t arg);
+static void flush_time(handler_arg_t arg);
+static void send_stats(handler_arg_t arg);
+static void update_state();
+
+enum
+{
+    /** Size of the aggregated frame header: count, base timestamp */
+    AGG_HEADER_SIZE = 1 + IOTLAB_CONTROL_TIME_MAX_SIZE,
+    /** Size of a record header: type, time offset, length */
+    AGG_RECORD_HEADER_SIZE = 4,
+    /** Room for the records in a frame */
+    AGG_MAX_SIZE = PACKET_MAX_SIZE - IOTLAB_SERIAL_PACKET_OFFSET,
+};
+
+static struct
+{
+    /** Timeline */
+    soft_timer_t slot_tim;
+    uint32_t slot_ticks;
+    uint32_t slot;
+    uint32_t slot_time;
+    uint32_t running;
+
+    iotlab_sched_activity_t *activities[IOTLAB_SCHED_MAX_ACTIVITIES];
+    uint32_t num_activities;
+
+    /** Background radio user */
+    handler_t suspend, resume;
+
+    /** Users of the aggregator, and statistics reported */
+    uint32_t users;
+    uint32_t active;
+
+    struct
+    {
+        /** Frame being filled, NULL if none */
+        packet_t *pkt;
+        /** Time of the first record, the offsets are relative to it */
+        uint32_t base;
+
+        /** Frames and records sent since the previous report */
+        uint16_t frames, records;
+
+        soft_timer_t flush_tim;
+    } agg;
+} sched;
+
+static inline void count(uint16_t *counter)
+{
+    if (*counter != 0xFFFF)
+    {
+        (*counter)++;
+    }
+}
+
+void iotlab_sched_start()
+{
+    sched.num_activities = 0;
+    sched.running = 0;
+    sched.users = 0;
+    sched.active = 0;
+    sched.agg.pkt = NULL;
+
+    soft_timer_set_handler(&sched.slot_tim, slot_time, NULL);
+    soft_timer_set_event_priority(&sched.slot_tim, EVENT_QUEUE_NETWORK);
+    soft_timer_set_handler(&sched.agg.flush_tim, flush_time, NULL);
+
+    iotlab_serial_set_frame_class(MONITOR_NOTIF, IOTLAB_SERIAL_CLASS_BULK);
+}
+
+/* ********************** TIMELINE **************************** */
+
+void iotlab_sched_set_slot(uint32_t slot_ticks)
+{
+    sched.slot_ticks = slot_ticks;
+
+    // Restart from slot 0, on the new period
+    soft_timer_stop(&sched.slot_tim);
+    sched.running = 0;
+    update_state();
+}
+
+int32_t iotlab_sched_add(iotlab_sched_activity_t *activity)
+{
+    if (sched.num_activities >= IOTLAB_SCHED_MAX_ACTIVITIES)
+    {
+        log_warning("Sampling timeline is full");
+        return 0;
+    }
+
+    activity->runs = 0;
+    activity->late = 0;
+
+    platform_enter_critical();
+    sched.activities[sched.num_activities++] = activity;
+    platform_exit_critical();
+
+    update_state();
+    return 1;
+}
+
+void iotlab_sched_remove(iotlab_sched_activity_t *activity)
+{
+    uint32_t i;
+
+    platform_enter_critical();
+    for (i = 0; i < sched.num_activities; i++)
+    {
+        if (sched.activities[i] == activity)
+        {
+            // Keep the registration order of the others
+            for (; i + 1 < sched.num_activities; i++)
+            {
+                sched.activities[i] = sched.activities[i + 1];
+            }
+            sched.num_activities--;
+            break;
+        }
+    }
+    platform_exit_critical();
+
+    update_state();
+}
+
+void iotlab_sched_set_background(handler_t suspend, handler_t resume)
+{
+    platform_enter_critical();
+    sched.suspend = suspend;
+    sched.resume = resume;
+    platform_exit_critical();
+}
+
+static void slot_time(handler_arg_t arg)
+{
+    uint32_t i, suspended = 0;
+
+    // The periodic timer does not drift, the slot time is the theoretical one
+    sched.slot++;
+    sched.slot_time += sched.slot_ticks;
+    uint32_t late = (soft_timer_time() - sched.slot_time) >= sched.slot_ticks;
+
+    for (i = 0; i < sched.num_activities; i++)
+    {
+        iotlab_sched_activity_t *activity = sched.activities[i];
+
+        if (activity->period == 0
+                || (sched.slot % activity->period) != activity->phase)
+        {
+            continue;
+        }
+
+        // Take the radio from the background user for the slot
+        if (activity->radio && !suspended && sched.suspend)
+        {
+            sched.suspend(NULL);
+            suspended = 1;
+        }
+
+        activity->run(sched.slot_time);
+
+        count(&activity->runs);
+        if (late)
+        {
+            count(&activity->late);
+        }
+    }
+
+    if (suspended && sched.resume)
+    {
+        sched.resume(NULL);
+    }
+}
+
+/* ********************** AGGREGATOR **************************** */
+
+void iotlab_sched_acquire()
+{
+    sched.users++;
+    update_state();
+}
+
+void iotlab_sched_release()
+{
+    if (sched.users)
+    {
+        sched.users--;
+    }
+    update_state();
+}
+
+static void agg_send(packet_t *pkt)
+{
+    if (!iotlab_serial_send_frame(MONITOR_NOTIF, pkt))
+    {
+        // Counted as dropped by the serial library
+        packet_free(pkt);
+    }
+}
+
+static int record_fits(packet_t *pkt, uint32_t timestamp, uint8_t length)
+{
+    int32_t offset = timestamp - sched.agg.base;
+
+    return offset >= -0x8000 && offset <= 0x7FFF
+            && pkt->length + AGG_RECORD_HEADER_SIZE + length <= AGG_MAX_SIZE;
+}
+
+int32_t iotlab_sched_record(uint8_t type, uint32_t timestamp,
+        const uint8_t *data, uint8_t length)
+{
+    packet_t *spare = NULL, *full = NULL;
+    int32_t added = 0;
+
+    if (AGG_HEADER_SIZE + AGG_RECORD_HEADER_SIZE + length > AGG_MAX_SIZE)
+    {
+        log_error("Record too long: %u", length);
+        return 0;
+    }
+
+    while (!added)
+    {
+        platform_enter_critical();
+        packet_t *pkt = sched.agg.pkt;
+
+        if (pkt && !record_fits(pkt, timestamp, length))
+        {
+            full = pkt;
+            pkt = sched.agg.pkt = NULL;
+        }
+
+        if (pkt == NULL && spare)
+        {
+            /**
+             * Prepare packet as follows:
+             *      * number of records [1B]
+             *      * base timestamp [4B, 8B with the 64bit time]
+             * then for each record:
+             *      * record type [1B]
+             *      * ticks since the base timestamp, signed [2B]
+             *      * record length [1B]
+             *      * record, as in the notification of the same type
+             */
+            pkt = sched.agg.pkt = spare;
+            spare = NULL;
+            pkt->data[0] = 0;
+            pkt->length = iotlab_control_pack_time(pkt->data + 1, timestamp)
+                    - pkt->data;
+            sched.agg.base = timestamp;
+        }
+
+        if (pkt)
+        {
+            uint8_t *p = pkt->data + pkt->length;
+            *p++ = type;
+            p = packer_uint16_pack(p, timestamp - sched.agg.base);
+            *p++ = length;
+            memcpy(p, data, length);
+            pkt->length = p + length - pkt->data;
+            pkt->data[0]++;
+
+            count(&sched.agg.records);
+            added = 1;
+        }
+        platform_exit_critical();
+
+        if (full)
+        {
+            count(&sched.agg.frames);
+            agg_send(full);
+            full = NULL;
+        }
+
+        // Packets are allocated outside the critical section
+        if (!added)
+        {
+            spare = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+            if (spare == NULL)
+            {
+                iotlab_serial_count_drop(MONITOR_NOTIF);
+                return 0;
+            }
+        }
+    }
+
+    // Another frame was started while allocating
+    if (spare)
+    {
+        packet_free(spare);
+    }
+
+    return 1;
+}
+
+void iotlab_sched_flush()
+{
+    platform_enter_critical();
+    packet_t *pkt = sched.agg.pkt;
+    sched.agg.pkt = NULL;
+    platform_exit_critical();
+
+    if (pkt)
+    {
+        count(&sched.agg.frames);
+        agg_send(pkt);
+    }
+}
+
+static void flush_time(handler_arg_t arg)
+{
+    // Checked every half period, send the frames old enough
+    if (sched.agg.pkt && (soft_timer_time() - sched.agg.base)
+            >= soft_timer_ms_to_ticks(IOTLAB_SCHED_FLUSH_MS))
+    {
+        iotlab_sched_flush();
+    }
+}
+
+/* ********************** STATISTICS **************************** */
+
+static void update_state()
+{
+    // Run the timeline while it has activities
+    if (sched.num_activities && sched.slot_ticks && !sched.running)
+    {
+        sched.slot = 0;
+        sched.slot_time = soft_timer_time();
+        soft_timer_start(&sched.slot_tim, sched.slot_ticks, 1);
+        sched.running = 1;
+    }
+    else if (sched.num_activities == 0 && sched.running)
+    {
+        soft_timer_stop(&sched.slot_tim);
+        sched.running = 0;
+    }
+
+    // Aggregate and report while used
+    uint32_t active = sched.num_activities || sched.users;
+
+    if (active && !sched.active)
+    {
+        sched.agg.frames = 0;
+        sched.agg.records = 0;
+        soft_timer_start(&sched.agg.flush_tim,
+                soft_timer_ms_to_ticks(IOTLAB_SCHED_FLUSH_MS / 2), 1);
+        iotlab_serial_set_stats_handler(send_stats, NULL);
+    }
+    else if (!active && sched.active)
+    {
+        soft_timer_stop(&sched.agg.flush_tim);
+        iotlab_sched_flush();
+
+        // Last report, then back to the serial statistics
+        iotlab_serial_set_stats_handler(NULL, NULL);
+        event_post(EVENT_QUEUE_APPLI, send_stats, NULL);
+    }
+
+    sched.active = active;
+}
+
+static void send_stats(handler_arg_t arg)
+{
+    uint32_t i;
+    packet_t *pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+    if (pkt == NULL)
+    {
+        // Counters are kept for the next report
+        return;
+    }
+
+    /**
+     * Prepare packet as follows:
+     *      * time of the report [4B, 8B with the 64bit time]
+     *      * number of activities [1B]
+     * then for each activity, since the previous report:
+     *      * record type [1B]
+     *      * runs, runs started more than a slot late [2B each]
+     * then
+     *      * aggregated frames, records sent since the previous report [2B each]
+     * then as in SERIAL_STATS_NOTIF, for each frame type with drops:
+     *      * frame type [1B]
+     *      * number of dropped frames, saturated [2B]
+     */
+    uint8_t *data = iotlab_control_pack_time(pkt->data, soft_timer_time());
+
+    platform_enter_critical();
+    *data++ = sched.num_activities;
+    for (i = 0; i < sched.num_activities; i++)
+    {
+        iotlab_sched_activity_t *activity = sched.activities[i];
+
+        *data++ = activity->type;
+        data = packer_uint16_pack(data, activity->runs);
+        data = packer_uint16_pack(data, activity->late);
+        activity->runs = 0;
+        activity->late = 0;
+    }
+    data = packer_uint16_pack(data, sched.agg.frames);
+    data = packer_uint16_pack(data, sched.agg.records);
+    sched.agg.frames = 0;
+    sched.agg.records = 0;
+    platform_exit_critical();
+
+    data = iotlab_serial_pack_drops(data, pkt->raw_data + PACKET_MAX_SIZE);
+
+    pkt->length = data - pkt->data;
+    if (!iotlab_serial_send_frame(MONITOR_STATS_NOTIF, pkt))
+    {
+        packet_free(pkt);
+    }
+}
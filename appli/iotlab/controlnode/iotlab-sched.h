@@ -0,0 +1,129 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2013 HiKoB.
+ */
+
+/*
+ * iotlab-sched.h
+ *
+ * Sampling scheduler, running the monitors of the control node together.
+ *
+ * Periodic activities are run on a common timeline of fixed slots, in
+ * registration order, so that their interleaving is deterministic. The
+ * activities using the radio suspend the background radio user (the
+ * sniffer) for the duration of their slot, the RX windows are the time
+ * between these slots.
+ *
+ * The records produced by the monitors are aggregated in shared
+ * MONITOR_NOTIF frames, and while the scheduler is in use the serial
+ * statistics are replaced by a single MONITOR_STATS_NOTIF report.
+ */
+
+#ifndef IOTLAB_SCHED_H_
+#define IOTLAB_SCHED_H_
+
+#include <stdint.h>
+#include "handler.h"
+
+#ifndef IOTLAB_SCHED_MAX_ACTIVITIES
+/** Maximum number of activities on the timeline */
+#define IOTLAB_SCHED_MAX_ACTIVITIES 4
+#endif
+
+/** Maximum time a record waits in an aggregated frame, in ms */
+#define IOTLAB_SCHED_FLUSH_MS 50
+
+typedef struct
+{
+    /**
+     * Called from the network event queue in each slot where
+     * (slot % period) == phase, with the time of the slot.
+     */
+    void (*run)(uint32_t slot_time);
+
+    /** Period and phase on the timeline, in slots */
+    uint16_t period, phase;
+    /** Set if the activity uses the radio */
+    uint8_t radio;
+    /** Type of the records produced, reported in the statistics */
+    uint8_t type;
+
+    /** Number of runs, and of runs started more than a slot late */
+    uint16_t runs, late;
+} iotlab_sched_activity_t;
+
+/** Start the scheduler library */
+void iotlab_sched_start();
+
+/**
+ * Start the timeline, or change its slot duration.
+ *
+ * \param slot_ticks the slot duration, in soft timer ticks
+ */
+void iotlab_sched_set_slot(uint32_t slot_ticks);
+
+/**
+ * Add an activity on the timeline.
+ *
+ * The activity must be persistent until removed. Its statistics are
+ * cleared.
+ *
+ * \return 1 if added, 0 if the timeline is full
+ */
+int32_t iotlab_sched_add(iotlab_sched_activity_t *activity);
+
+/** Remove an activity from the timeline, the timeline stops when empty */
+void iotlab_sched_remove(iotlab_sched_activity_t *activity);
+
+/**
+ * Set the background radio user.
+ *
+ * \a suspend is called before the radio activities of a slot, and \a resume
+ * after them. Both are called from the network event queue.
+ *
+ * \param suspend the function releasing the radio, NULL to clear
+ * \param resume the function taking the radio again
+ */
+void iotlab_sched_set_background(handler_t suspend, handler_t resume);
+
+/**
+ * Use the aggregator without timeline activity.
+ *
+ * The scheduler statistics are reported while it has activities or users.
+ */
+void iotlab_sched_acquire();
+void iotlab_sched_release();
+
+/**
+ * Append a record to the shared notification frame.
+ *
+ * This may be called from both event queues. The frame is sent when full,
+ * or when its first record is \ref IOTLAB_SCHED_FLUSH_MS old.
+ *
+ * \param type the record type, the type of the notification it replaces
+ * \param timestamp the local time of the record, from soft_timer_time()
+ * \param data the record payload
+ * \param length the payload length
+ * \return 1 if the record was added, 0 if it was dropped
+ */
+int32_t iotlab_sched_record(uint8_t type, uint32_t timestamp,
+        const uint8_t *data, uint8_t length);
+
+/** Send the shared notification frame now */
+void iotlab_sched_flush();
+
+#endif /* IOTLAB_SCHED_H_ */
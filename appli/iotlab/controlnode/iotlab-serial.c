@@ -25,9 +25,14 @@
  */
 #include "platform.h"
 #include "iotlab-serial.h"
+#include "constants.h"
+
+#include <string.h>
 
 #include "debug.h"
 #include "event.h"
+#include "packer.h"
+#include "soft_timer.h"
 
 #if defined(RELEASE) && RELEASE
 #define ASYNCHRONOUS 1
@@ -39,7 +44,16 @@ enum
     SYNC_BYTE = 0x80,
 
     ACK = 0x0A,
-    NACK = 0x02
+    NACK = 0x02,
+
+    /** Flow control characters, only valid between frames */
+    XON = 0x11,
+    XOFF = 0x13,
+
+    /** Lowest baudrate accepted by SET_BAUDRATE */
+    MIN_BAUDRATE = 9600,
+    /** Longest superframe, as its length byte counts the type */
+    SUPERFRAME_MAX_SIZE = 2 + 255,
 };
 
 /** Handler for IDLE check */
@@ -49,23 +63,55 @@ static void char_rx(handler_arg_t arg, uint8_t c);
 
 static void allocate_packet(handler_arg_t arg);
 static void packet_received(handler_arg_t arg);
+static void tx_enqueue(iotlab_serial_class_t cls, packet_t *pkt);
 static void send_now(handler_arg_t arg);
-#if ASYNCHRONOUS
+static iotlab_serial_class_t tx_class_end();
+static void superframe_merge(iotlab_serial_class_t cls);
+static int32_t config_serial(uint8_t cmd_type, packet_t *pkt);
+static int32_t set_baudrate(uint8_t cmd_type, packet_t *pkt);
+static void baudrate_switch();
+static void baudrate_confirm();
+static void baudrate_timeout(handler_arg_t arg);
+static void baudrate_revert(handler_arg_t arg);
+static void stats_time(handler_arg_t arg);
+static void send_stats(handler_arg_t arg);
 /** Function called at the end of a UART TX transfer */
 static void tx_done_isr(handler_arg_t arg);
-#endif // ASYNCHRONOUS
 /** */
 static void handle_packet_sent(handler_arg_t arg);
 
 static struct
 {
-    iotlab_serial_handler_t *first_handler;
+    /** Dispatch table, indexed by command type */
+    iotlab_serial_handler_t *handlers[256];
 
     /** Structure holding the TX information */
     struct
     {
-        /** The FIFO of packets to send */
-        packet_t *fifo;
+        /** The FIFOs of packets to send, one per class */
+        packet_t *fifo[IOTLAB_SERIAL_CLASS_NUMBER];
+
+        /** Number of packets in each FIFO */
+        uint8_t count[IOTLAB_SERIAL_CLASS_NUMBER];
+
+        /** Class of each frame type */
+        uint8_t type_class[256];
+
+        /** Number of frames dropped per type since last statistics */
+        uint16_t dropped[256];
+
+        /** Flag indicating some frames were dropped */
+        uint32_t has_dropped;
+
+        /** Flow control enabled, and bulk frames paused by the host */
+        uint32_t flow_control;
+        volatile uint32_t paused;
+
+        /** Queued notifications are merged in superframes */
+        uint32_t superframes;
+
+        /** Transfers are asynchronous, not blocking */
+        uint32_t async;
 
         /** The packet in TX */
         packet_t *pkt;
@@ -86,6 +132,33 @@ static struct
         /** The complete received packet */
         packet_t * volatile ready_pkt;
     } rx;
+
+    /** Structure holding the baudrate negotiation */
+    struct
+    {
+        /** Baudrate in use */
+        uint32_t current;
+
+        /** Baudrate to use at the end of the current transfer, 0 if none */
+        uint32_t next;
+
+        /** Previous baudrate, until the new one is confirmed, 0 if none */
+        uint32_t fallback;
+
+        /** Reply to send at the previous baudrate before switching */
+        packet_t *reply;
+
+        soft_timer_t confirm_tim;
+        iotlab_serial_handler_t handler;
+    } baud;
+
+    /** Statistics timer and serial configuration handler */
+    soft_timer_t stats_tim;
+    iotlab_serial_handler_t config_handler;
+
+    /** Replacement of the statistics frame, if any */
+    handler_t stats_handler;
+    handler_arg_t stats_handler_arg;
 } ser;
 
 static inline int is_idle()
@@ -103,14 +176,40 @@ void iotlab_serial_start(uint32_t baudrate)
     packet_init();
     uart_enable(uart_external, baudrate);
 
-    // Clear the first handler
-    ser.first_handler = NULL;
+    // Clear the dispatch table
+    uint32_t i;
+    for (i = 0; i < 256; i++)
+    {
+        ser.handlers[i] = NULL;
+    }
 
-    // Clear RX/TX structures
-    ser.tx.fifo = NULL;
+    // Clear RX/TX structures, all frame types are control by default
+    for (i = 0; i < IOTLAB_SERIAL_CLASS_NUMBER; i++)
+    {
+        ser.tx.fifo[i] = NULL;
+        ser.tx.count[i] = 0;
+    }
+    for (i = 0; i < 256; i++)
+    {
+        ser.tx.type_class[i] = IOTLAB_SERIAL_CLASS_CONTROL;
+        ser.tx.dropped[i] = 0;
+    }
+    ser.tx.has_dropped = 0;
+    ser.stats_handler = NULL;
+    ser.tx.flow_control = 0;
+    ser.tx.paused = 0;
+    ser.tx.superframes = 0;
     ser.tx.pkt = NULL;
     ser.tx.busy = 0;
 
+    // Debug output shares the UART in debug builds, frames must not be cut
+    ser.tx.async = ASYNCHRONOUS || (uart_external != uart_print);
+
+    ser.baud.current = baudrate;
+    ser.baud.next = 0;
+    ser.baud.fallback = 0;
+    ser.baud.reply = NULL;
+
     ser.rx.tmp_pkt = NULL;
     ser.rx.ready_pkt = NULL;
 
@@ -125,33 +224,77 @@ void iotlab_serial_start(uint32_t baudrate)
 
     // allocate first packet
     allocate_packet(NULL );
+
+    // Register the serial configuration command, and report drops
+    ser.config_handler.cmd_type = CONFIG_SERIAL;
+    ser.config_handler.handler = config_serial;
+    iotlab_serial_register_handler(&ser.config_handler);
+
+    ser.baud.handler.cmd_type = SET_BAUDRATE;
+    ser.baud.handler.handler = set_baudrate;
+    iotlab_serial_register_handler(&ser.baud.handler);
+    soft_timer_set_handler(&ser.baud.confirm_tim, baudrate_timeout, NULL);
+
+    soft_timer_set_handler(&ser.stats_tim, stats_time, NULL);
+    soft_timer_start(&ser.stats_tim,
+            soft_timer_ms_to_ticks(IOTLAB_SERIAL_STATS_PERIOD_MS), 1);
 }
 
 void iotlab_serial_register_handler(iotlab_serial_handler_t *handler)
 {
-    // Insert last
-    handler->next = NULL;
-
-    if (ser.first_handler == NULL )
+    if (ser.handlers[handler->cmd_type] != NULL)
     {
-        ser.first_handler = handler;
+        log_warning("Replacing handler for command %x", handler->cmd_type);
     }
-    else
+
+    ser.handlers[handler->cmd_type] = handler;
+}
+
+void iotlab_serial_set_frame_class(uint8_t type, iotlab_serial_class_t cls)
+{
+    ser.tx.type_class[type] = cls;
+}
+
+void iotlab_serial_count_drop(uint8_t type)
+{
+    platform_enter_critical();
+    if (ser.tx.dropped[type] != 0xFFFF)
     {
-        iotlab_serial_handler_t *h;
-        for (h = ser.first_handler; h->next != NULL ; h = h->next)
-        {
-        }
-        h->next = handler;
+        ser.tx.dropped[type]++;
     }
+    ser.tx.has_dropped = 1;
+    platform_exit_critical();
 }
 
 int32_t iotlab_serial_send_frame(uint8_t type, packet_t *pkt)
 {
+    iotlab_serial_class_t cls = ser.tx.type_class[type];
+    uint8_t limit = (cls == IOTLAB_SERIAL_CLASS_BULK) ?
+            IOTLAB_SERIAL_TX_LIMIT_BULK : IOTLAB_SERIAL_TX_LIMIT_CONTROL;
+    int32_t full;
+
+    // Reserve a place in the class FIFO
+    platform_enter_critical();
+    full = (ser.tx.count[cls] >= limit);
+    if (!full)
+    {
+        ser.tx.count[cls]++;
+    }
+    platform_exit_critical();
+
+    if (full)
+    {
+        iotlab_serial_count_drop(type);
+        return 0;
+    }
+
     // Check length:
     if (pkt->length > PACKET_MAX_SIZE - IOTLAB_SERIAL_PACKET_OFFSET)
     {
         log_error("Serial Packet TX length too big: %u", pkt->length);
+        platform_enter_critical();
+        ser.tx.count[cls]--;
+        platform_exit_critical();
         return 0;
     }
 
@@ -164,6 +307,9 @@ int32_t iotlab_serial_send_frame(uint8_t type, packet_t *pkt)
                 != PACKET_SUCCESS)
         {
             log_error("Serial packet too big to add header");
+            platform_enter_critical();
+            ser.tx.count[cls]--;
+            platform_exit_critical();
             return 0;
         }
     }
@@ -177,8 +323,8 @@ int32_t iotlab_serial_send_frame(uint8_t type, packet_t *pkt)
     pkt->data[2] = type;
     pkt->length += 3;
 
-    // Append to FIFO
-    packet_fifo_append(&ser.tx.fifo, pkt);
+    // Append to FIFO, the place is already reserved
+    packet_fifo_append(&ser.tx.fifo[cls], pkt);
 
     // Send if idle
     if (is_idle())
@@ -191,6 +337,15 @@ int32_t iotlab_serial_send_frame(uint8_t type, packet_t *pkt)
     return 1;
 }
 
+static void tx_enqueue(iotlab_serial_class_t cls, packet_t *pkt)
+{
+    platform_enter_critical();
+    ser.tx.count[cls]++;
+    platform_exit_critical();
+
+    packet_fifo_append(&ser.tx.fifo[cls], pkt);
+}
+
 static void char_rx(handler_arg_t arg, uint8_t c)
 {
     /*
@@ -201,14 +356,6 @@ static void char_rx(handler_arg_t arg, uint8_t c)
     static uint16_t rx_index = 0;
     static uint32_t last_start_time = 0;
 
-    // Check for ready buffer
-    if (ser.rx.tmp_pkt == NULL )
-    {
-        // Request allocation
-        rx_index = 0;
-        return;
-    }
-
     // Check if packet started too long ago
     if (last_start_time
             && (soft_timer_time() - last_start_time
@@ -219,6 +366,22 @@ static void char_rx(handler_arg_t arg, uint8_t c)
         last_start_time = 0;
     }
 
+    // Between frames, handle flow control from the host, even without buffer
+    if (rx_index == 0 && ser.tx.flow_control && (c == XON || c == XOFF))
+    {
+        ser.tx.paused = (c == XOFF);
+        return;
+    }
+
+    // Check for ready buffer
+    if (ser.rx.tmp_pkt == NULL )
+    {
+        // Request allocation
+        rx_index = 0;
+        last_start_time = 0;
+        return;
+    }
+
     // A char is received, switch index
     switch (rx_index)
     {
@@ -266,9 +429,15 @@ static void char_rx(handler_arg_t arg, uint8_t c)
 }
 static int32_t check_uart(handler_arg_t arg)
 {
-    if (ser.rx.ready_pkt)
+    packet_t *ready_pkt = ser.rx.ready_pkt;
+    if (ready_pkt)
     {
-        event_post(EVENT_QUEUE_APPLI, packet_received, NULL );
+        // Process in the queue requested by the command handler
+        iotlab_serial_handler_t *handler = ser.handlers[ready_pkt->data[2]];
+        event_post(
+                (handler && (handler->flags & IOTLAB_SERIAL_HANDLER_FAST)) ?
+                        EVENT_QUEUE_NETWORK : EVENT_QUEUE_APPLI,
+                packet_received, NULL );
         return 1;
     }
     else if (ser.rx.tmp_pkt == NULL )
@@ -281,35 +450,73 @@ static int32_t check_uart(handler_arg_t arg)
         event_post(EVENT_QUEUE_APPLI, handle_packet_sent, NULL );
         return 1;
     }
+    if (is_idle()
+            && (ser.tx.count[IOTLAB_SERIAL_CLASS_REPLY]
+                    || ser.tx.count[IOTLAB_SERIAL_CLASS_CONTROL]
+                    || (!ser.tx.paused
+                            && ser.tx.count[IOTLAB_SERIAL_CLASS_BULK])))
+    {
+        // Resume after XON
+        event_post(EVENT_QUEUE_APPLI, send_now, NULL );
+        return 1;
+    }
 
     return 0;
 }
 static void allocate_packet(handler_arg_t arg)
 {
+    if (ser.rx.tmp_pkt != NULL )
+    {
+        return;
+    }
+
+    // Allocate a new packet for RX
+    packet_t *pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+    if (pkt == NULL)
+    {
+        return;
+    }
+
+    // Both event queues may allocate, keep only one packet
+    platform_enter_critical();
     if (ser.rx.tmp_pkt == NULL )
     {
-        // Allocate a new packet for RX
-        ser.rx.tmp_pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+        ser.rx.tmp_pkt = pkt;
+        pkt = NULL;
+    }
+    platform_exit_critical();
+
+    if (pkt)
+    {
+        packet_free(pkt);
     }
 }
 static void packet_received(handler_arg_t arg)
 {
     packet_t *rx_pkt;
 
+    // Get the ready packet, it may have been processed by another event
+    platform_enter_critical();
+    rx_pkt = ser.rx.ready_pkt;
+    ser.rx.ready_pkt = NULL;
+    platform_exit_critical();
+
+    if (rx_pkt == NULL)
+    {
+        return;
+    }
+
     // Allocate a new packet for RX
     allocate_packet(NULL );
 
-    // Get the ready packet
-    rx_pkt = ser.rx.ready_pkt;
-
-    // Prepare packets for next RX
-    ser.rx.ready_pkt = NULL;
+    // A frame was received, the baudrate works
+    baudrate_confirm();
 
     // Get the command type header
     uint8_t cmd_type = rx_pkt->data[2];
 
-    // Loop over the registered handlers to find a match
-    iotlab_serial_handler_t *handler = ser.first_handler;
+    // Get the registered handler
+    iotlab_serial_handler_t *handler = ser.handlers[cmd_type];
 
     int32_t result = 0;
 
@@ -317,21 +524,11 @@ static void packet_received(handler_arg_t arg)
     rx_pkt->data += 3;
     rx_pkt->length -= 3;
 
-    int found = 0;
-    while (handler != NULL )
+    if (handler)
     {
-        if (handler->cmd_type == cmd_type)
-        {
-            // Found! process
-            found = 1;
-            result = handler->handler(cmd_type, rx_pkt);
-            break;
-        }
-
-        // Increment
-        handler = handler->next;
+        result = handler->handler(cmd_type, rx_pkt);
     }
-    if (!found)
+    else
     {
         log_warning("No Handler found for command %x", cmd_type);
     }
@@ -349,8 +546,8 @@ static void packet_received(handler_arg_t arg)
     rx_pkt->data[3] = result ? ACK : NACK;
     rx_pkt->length += 4;
 
-    // Append to FIFO
-    packet_fifo_append(&ser.tx.fifo, rx_pkt);
+    // Append to FIFO, replies are sent first
+    tx_enqueue(IOTLAB_SERIAL_CLASS_REPLY, rx_pkt);
 
     // Send if idle
     if (is_idle())
@@ -362,12 +559,15 @@ static void packet_received(handler_arg_t arg)
 
 static void send_now(handler_arg_t arg)
 {
-    // Check if busy
+    // Check if busy, and set busy, frames may be sent from both event queues
+    platform_enter_critical();
     if (is_sending())
     {
-        log_error("Serial can't send because already Sending");
+        platform_exit_critical();
         return;
     }
+    ser.tx.busy = 1;
+    platform_exit_critical();
 
     if (ser.tx.pkt != NULL )
     {
@@ -376,11 +576,17 @@ static void send_now(handler_arg_t arg)
         ser.tx.pkt = NULL;
     }
 
-    // Set busy
-    ser.tx.busy = 1;
+    // Try to get a frame from the FIFOs, by priority, no bulk one if paused
+    iotlab_serial_class_t cls;
+    for (cls = IOTLAB_SERIAL_CLASS_REPLY; cls < tx_class_end(); cls++)
+    {
+        ser.tx.pkt = packet_fifo_get(&ser.tx.fifo[cls]);
+        if (ser.tx.pkt != NULL)
+        {
+            break;
+        }
+    }
 
-    // Try to get a frame from the FIFO
-    ser.tx.pkt = packet_fifo_get(&ser.tx.fifo);
     if (ser.tx.pkt == NULL )
     {
         // Nothing to send, set IDLE
@@ -388,24 +594,102 @@ static void send_now(handler_arg_t arg)
         return;
     }
 
+    platform_enter_critical();
+    ser.tx.count[cls]--;
+    platform_exit_critical();
+
+    // Replies are sent alone, the host waits for them
+    if (ser.tx.superframes && cls != IOTLAB_SERIAL_CLASS_REPLY)
+    {
+        superframe_merge(cls);
+    }
+
     ser.tx.irq_triggered = 0;
 
     // Start sending the packet
-#if ASYNCHRONOUS
-    uart_transfer_async(uart_external, ser.tx.pkt->data, ser.tx.pkt->length,
-            tx_done_isr, NULL );
-#else // ASYNCHRONOUS
-    uart_transfer(uart_external, ser.tx.pkt->data, ser.tx.pkt->length);
-    event_post(EVENT_QUEUE_APPLI, handle_packet_sent, NULL );
-#endif // ASYNCHRONOUS
+    if (ser.tx.async)
+    {
+        uart_transfer_async(uart_external, ser.tx.pkt->data,
+                ser.tx.pkt->length, tx_done_isr, NULL );
+    }
+    else
+    {
+        uart_transfer(uart_external, ser.tx.pkt->data, ser.tx.pkt->length);
+        event_post(EVENT_QUEUE_APPLI, handle_packet_sent, NULL );
+    }
+}
+
+/** The classes that may be sent, bulk frames are held while paused */
+static iotlab_serial_class_t tx_class_end()
+{
+    return ser.tx.paused ?
+            IOTLAB_SERIAL_CLASS_BULK : IOTLAB_SERIAL_CLASS_NUMBER;
+}
+
+static void superframe_merge(iotlab_serial_class_t cls)
+{
+    packet_t *pkt = ser.tx.pkt, *next;
+    uint32_t merged = 0;
+
+    /**
+     * Superframe is as follows:
+     *      * SYNC_BYTE, length, SERIAL_SUPERFRAME
+     * then for each frame, in the queue order:
+     *      * the frame without its SYNC_BYTE: length, type, payload
+     *
+     * The first frame is already in place, 2 bytes after the start.
+     */
+    uint8_t *start = pkt->data - 2;
+    uint16_t length = pkt->length + 2;
+    uint16_t room = pkt->raw_data + PACKET_MAX_SIZE - start;
+    if (room > SUPERFRAME_MAX_SIZE)
+    {
+        room = SUPERFRAME_MAX_SIZE;
+    }
+
+    // Only this function removes packets from the FIFOs, the heads are stable
+    for (; cls < tx_class_end(); cls++)
+    {
+        while ((next = ser.tx.fifo[cls]) != NULL
+                && length + next->length - 1 <= room)
+        {
+            packet_fifo_get(&ser.tx.fifo[cls]);
+
+            platform_enter_critical();
+            ser.tx.count[cls]--;
+            platform_exit_critical();
+
+            memcpy(start + length, next->data + 1, next->length - 1);
+            length += next->length - 1;
+            packet_free(next);
+            merged++;
+        }
+
+        // Do not send lower priority frames before this one
+        if (next)
+        {
+            break;
+        }
+    }
+
+    // A single frame is sent as is
+    if (merged == 0)
+    {
+        return;
+    }
+
+    start[0] = SYNC_BYTE;
+    start[1] = length - 2;
+    start[2] = SERIAL_SUPERFRAME;
+    pkt->data = start;
+    pkt->length = length;
 }
 
-#if ASYNCHRONOUS
 static void tx_done_isr(handler_arg_t arg)
 {
     ser.tx.irq_triggered = 1;
 }
-#endif // ASYNCHRONOUS
+
 static void handle_packet_sent(handler_arg_t arg)
 {
     // Check there is a packet being sent
@@ -415,6 +699,20 @@ static void handle_packet_sent(handler_arg_t arg)
         return;
     }
 
+    // Change the baudrate while the TX is still held
+    if (ser.baud.next
+            && (ser.baud.reply == NULL || ser.baud.reply == ser.tx.pkt))
+    {
+        if (ser.baud.reply)
+        {
+            ser.baud.reply = NULL;
+            soft_timer_start(&ser.baud.confirm_tim,
+                    soft_timer_ms_to_ticks(IOTLAB_SERIAL_BAUDRATE_CONFIRM_MS),
+                    0);
+        }
+        baudrate_switch();
+    }
+
     // Free the packet
     packet_free(ser.tx.pkt);
     ser.tx.pkt = NULL;
@@ -424,8 +722,225 @@ static void handle_packet_sent(handler_arg_t arg)
     ser.tx.irq_triggered = 0;
 
     // Test if there is a packet to send
-    if (ser.tx.fifo != NULL )
+    if (ser.tx.count[IOTLAB_SERIAL_CLASS_REPLY]
+            || ser.tx.count[IOTLAB_SERIAL_CLASS_CONTROL]
+            || ser.tx.count[IOTLAB_SERIAL_CLASS_BULK])
     {
         event_post(EVENT_QUEUE_APPLI, send_now, NULL );
     }
 }
+
+static int32_t config_serial(uint8_t cmd_type, packet_t *pkt)
+{
+    /*
+     * Expected packet is:
+     *      * XON/XOFF flow control enable [1B]
+     *      * superframes enable [1B], optional, legacy framing if absent
+     */
+    if (pkt->length != 1 && pkt->length != 2)
+    {
+        log_warning("Bad packet length: %u", pkt->length);
+        pkt->length = 0;
+        return 0;
+    }
+
+    ser.tx.flow_control = (pkt->data[0] != 0);
+    ser.tx.paused = 0;
+    ser.tx.superframes = (pkt->length == 2) && (pkt->data[1] != 0);
+
+    // OK, no payload
+    pkt->length = 0;
+    return 1;
+}
+
+static int32_t set_baudrate(uint8_t cmd_type, packet_t *pkt)
+{
+    uint32_t baudrate, max = uart_get_max_baudrate(uart_external);
+
+    /*
+     * Expected packet is:
+     *      * new baudrate, 0 to only get the current one [4B]
+     */
+    if (pkt->length != 4)
+    {
+        log_warning("Bad packet length: %u", pkt->length);
+        pkt->length = 0;
+        return 0;
+    }
+
+    memcpy(&baudrate, pkt->data, 4);
+
+    if (baudrate && (baudrate < MIN_BAUDRATE || baudrate > max))
+    {
+        log_warning("Baudrate %u out of range, max %u", baudrate, max);
+        pkt->length = 0;
+        return 0;
+    }
+
+    /*
+     * Reply is, before changing:
+     *      * current baudrate [4B]
+     *      * maximum baudrate [4B]
+     */
+    memcpy(pkt->data, &ser.baud.current, 4);
+    memcpy(pkt->data + 4, &max, 4);
+    pkt->length = 8;
+
+    // Change once this packet, the reply, is sent
+    if (baudrate && baudrate != ser.baud.current)
+    {
+        ser.baud.fallback = ser.baud.current;
+        ser.baud.next = baudrate;
+        ser.baud.reply = pkt;
+    }
+
+    return 1;
+}
+
+/** Switch to the next baudrate, the TX must be held with the busy flag */
+static void baudrate_switch()
+{
+    uart_enable(uart_external, ser.baud.next);
+
+    // The RX interrupt is cleared by the UART configuration
+    uart_set_rx_handler(uart_external, char_rx, NULL );
+
+    ser.baud.current = ser.baud.next;
+    ser.baud.next = 0;
+}
+
+static void baudrate_confirm()
+{
+    uint32_t confirmed = 0;
+
+    // Only the frames received after the switch confirm the new baudrate
+    platform_enter_critical();
+    if (ser.baud.fallback && ser.baud.next == 0)
+    {
+        ser.baud.fallback = 0;
+        confirmed = 1;
+    }
+    platform_exit_critical();
+
+    if (confirmed)
+    {
+        soft_timer_stop(&ser.baud.confirm_tim);
+    }
+}
+
+static void baudrate_timeout(handler_arg_t arg)
+{
+    // Change in the same queue as the transfers
+    event_post(EVENT_QUEUE_APPLI, baudrate_revert, NULL);
+}
+
+static void baudrate_revert(handler_arg_t arg)
+{
+    uint32_t idle;
+
+    platform_enter_critical();
+    if (ser.baud.fallback == 0)
+    {
+        // Confirmed meanwhile
+        platform_exit_critical();
+        return;
+    }
+
+    ser.baud.next = ser.baud.fallback;
+    ser.baud.fallback = 0;
+
+    // Hold the TX if idle, else switch at the end of the transfer
+    idle = !is_sending();
+    if (idle)
+    {
+        ser.tx.busy = 1;
+    }
+    platform_exit_critical();
+
+    // The host may not know the new framing either
+    ser.tx.superframes = 0;
+    log_warning("Baudrate not confirmed, back to %u", ser.baud.next);
+
+    if (idle)
+    {
+        baudrate_switch();
+        ser.tx.busy = 0;
+        send_now(NULL);
+    }
+}
+
+void iotlab_serial_set_stats_handler(handler_t handler, handler_arg_t arg)
+{
+    platform_enter_critical();
+    ser.stats_handler = handler;
+    ser.stats_handler_arg = arg;
+    platform_exit_critical();
+}
+
+static void stats_time(handler_arg_t arg)
+{
+    // Build the frame in the same queue as the other notifications
+    if (ser.stats_handler)
+    {
+        event_post(EVENT_QUEUE_APPLI, ser.stats_handler,
+                ser.stats_handler_arg);
+    }
+    else if (ser.tx.has_dropped)
+    {
+        event_post(EVENT_QUEUE_APPLI, send_stats, NULL);
+    }
+}
+
+uint8_t *iotlab_serial_pack_drops(uint8_t *data, const uint8_t *end)
+{
+    uint32_t type;
+
+    platform_enter_critical();
+    ser.tx.has_dropped = 0;
+    for (type = 0; type < 256; type++)
+    {
+        if (ser.tx.dropped[type] == 0)
+        {
+            continue;
+        }
+
+        if (data + 3 > end)
+        {
+            // Remaining types in the next frame
+            ser.tx.has_dropped = 1;
+            break;
+        }
+
+        *data++ = type;
+        data = packer_uint16_pack(data, ser.tx.dropped[type]);
+        ser.tx.dropped[type] = 0;
+    }
+    platform_exit_critical();
+
+    return data;
+}
+
+static void send_stats(handler_arg_t arg)
+{
+    packet_t *pkt = packet_alloc(IOTLAB_SERIAL_PACKET_OFFSET);
+    if (pkt == NULL)
+    {
+        // Try again next period
+        return;
+    }
+
+    /**
+     * Prepare packet as follows, for each frame type with drops since the
+     * previous statistics frame:
+     *      * frame type [1B]
+     *      * number of dropped frames, saturated [2B]
+     */
+    uint8_t *data = iotlab_serial_pack_drops(pkt->data,
+            pkt->raw_data + PACKET_MAX_SIZE);
+
+    pkt->length = data - pkt->data;
+    if (!iotlab_serial_send_frame(SERIAL_STATS_NOTIF, pkt))
+    {
+        packet_free(pkt);
+    }
+}
@@ -29,6 +29,7 @@
 
 #include <stdint.h>
 #include "packet.h"
+#include "handler.h"
 
 enum
 {
@@ -36,9 +37,29 @@ enum
     IOTLAB_SERIAL_PACKET_OFFSET = 5
 };
 
-/** Start the serial library, at the specified baudrate */
+/**
+ * Start the serial library, at the specified baudrate.
+ *
+ * The host may then change the baudrate with the SET_BAUDRATE command, up to
+ * the maximum of the UART. The new baudrate is used after the reply, and
+ * must be confirmed by a frame from the host within
+ * \ref IOTLAB_SERIAL_BAUDRATE_CONFIRM_MS, otherwise the library falls back
+ * to the previous baudrate and to the legacy framing.
+ */
 void iotlab_serial_start(uint32_t baudrate);
 
+/** Handler flags */
+enum
+{
+    /**
+     * The handler is called from the high priority event queue, instead of
+     * the application one, so that its command is not queued behind the
+     * processing of bulk notifications. It must be short, and only use
+     * functions safe to call from the network event queue.
+     */
+    IOTLAB_SERIAL_HANDLER_FAST = 0x01,
+};
+
 typedef struct
 {
     /** The command type for which the handler should be called */
@@ -54,28 +75,116 @@ typedef struct
      */
     int32_t (*handler)(uint8_t cmd_type, packet_t *pkt);
 
-    /** Next pointer to chain list */
-    void* next;
+    /** IOTLAB_SERIAL_HANDLER_* flags */
+    uint32_t flags;
 } iotlab_serial_handler_t;
 
 /**
  * Register a serial handler.
- * This method registers a handler for a command type based on the structure.
+ * This method registers a handler for a command type based on the structure,
+ * replacing any handler previously registered for the same type.
  *
- * The provided structure will be chained internally, and data must be persistent
- * at all time.
+ * The provided structure is referenced by a dispatch table, and data must be
+ * persistent at all time.
  *
  * \param handler a pointer to the structure containing the information.
  */
 void iotlab_serial_register_handler(iotlab_serial_handler_t *handler);
 
+/**
+ * TX priority classes.
+ *
+ * Queued frames of a class are all sent before the frames of the next one.
+ */
+typedef enum
+{
+    /** Command replies, never dropped */
+    IOTLAB_SERIAL_CLASS_REPLY = 0,
+    /** Control notifications, the default class of a frame type */
+    IOTLAB_SERIAL_CLASS_CONTROL = 1,
+    /** Bulk data notifications */
+    IOTLAB_SERIAL_CLASS_BULK = 2,
+
+    IOTLAB_SERIAL_CLASS_NUMBER = 3,
+} iotlab_serial_class_t;
+
+#ifndef IOTLAB_SERIAL_TX_LIMIT_CONTROL
+/** Maximum number of queued control notifications */
+#define IOTLAB_SERIAL_TX_LIMIT_CONTROL  2
+#endif
+#ifndef IOTLAB_SERIAL_TX_LIMIT_BULK
+/** Maximum number of queued bulk notifications, keep packets for commands */
+#define IOTLAB_SERIAL_TX_LIMIT_BULK     3
+#endif
+#ifndef IOTLAB_SERIAL_BAUDRATE_CONFIRM_MS
+/** Time for the host to confirm a new baudrate */
+#define IOTLAB_SERIAL_BAUDRATE_CONFIRM_MS   1000
+#endif
+#ifndef IOTLAB_SERIAL_STATS_PERIOD_MS
+/** Period of the statistics frames, only sent if frames were dropped */
+#define IOTLAB_SERIAL_STATS_PERIOD_MS   1000
+#endif
+
+/**
+ * Set the TX class of a frame type.
+ *
+ * \param type the frame type
+ * \param cls the class of the frames of this type
+ */
+void iotlab_serial_set_frame_class(uint8_t type, iotlab_serial_class_t cls);
+
 /**
  * Send an asynchronous frame.
  *
+ * The frame is dropped if the queue of its class is full, the drop is then
+ * counted and reported in the next statistics frame.
+ *
+ * When the host enabled superframes with CONFIG_SERIAL, the notifications
+ * queued together are sent in a single SERIAL_SUPERFRAME frame, each one
+ * without its sync byte.
+ *
  * \param type the frame type
  * \param pkt a pointer to the packet to send. It will be freed if sent successfully.
  * \return 1 if packet sent OK, 0 if an error occurred.
  */
 int32_t iotlab_serial_send_frame(uint8_t type, packet_t *pkt);
 
+/**
+ * Count a frame lost before it was given to the serial library.
+ *
+ * This is to be called when a frame could not be built, for instance because
+ * no packet could be allocated, so that the host knows data is missing.
+ *
+ * \param type the type of the lost frame
+ */
+void iotlab_serial_count_drop(uint8_t type);
+
+/**
+ * Pack the frames dropped since the previous statistics, and clear them.
+ *
+ * For each frame type with drops, this packs:
+ *      * frame type [1B]
+ *      * number of dropped frames, saturated [2B]
+ *
+ * Types which do not fit are kept for the next call.
+ *
+ * \param data where to pack the counts
+ * \param end the end of the room available
+ * \return the pointer after the packed counts
+ */
+uint8_t *iotlab_serial_pack_drops(uint8_t *data, const uint8_t *end);
+
+/**
+ * Replace the statistics frame.
+ *
+ * While set, the handler is called from the application event queue every
+ * statistics period, instead of sending the SERIAL_STATS_NOTIF frame. It
+ * should report the drops with \ref iotlab_serial_pack_drops in its own
+ * frame.
+ *
+ * \param handler the handler, or NULL to restore the statistics frame
+ * \param arg the handler argument
+ */
+void iotlab_serial_set_stats_handler(handler_t handler, handler_arg_t arg);
+
 #endif /* IOTLAB_SERIAL_H_ */
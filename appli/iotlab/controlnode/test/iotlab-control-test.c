@@ -0,0 +1,139 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2013 HiKoB.
+ */
+
+/*
+ * iotlab-control-test.c
+ *
+ * Check the packing of the 64bit experiment time: a 64bit SET_TIME is given
+ * to the control library handler, then the time is packed in both orders.
+ * The serial library is replaced by a stub keeping the handlers.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "platform.h"
+#include "debug.h"
+#include "packer.h"
+
+#include "soft_timer.h"
+#include "iotlab-serial.h"
+#include "iotlab-control.h"
+#include "constants.h"
+
+/** Time set by the test, in microseconds */
+#define TEST_TIME_US 0x0123456789ABCDEFull
+
+static iotlab_serial_handler_t *set_time_handler;
+
+static void app_task(void *);
+
+void iotlab_serial_register_handler(iotlab_serial_handler_t *handler)
+{
+    if (handler->cmd_type == SET_TIME)
+    {
+        set_time_handler = handler;
+    }
+}
+
+int main()
+{
+    // Initialize the platform
+    platform_init();
+
+    // Start the soft timer
+    soft_timer_init();
+
+    // Create a task for the application
+    xTaskCreate(app_task, (const signed char * const) "app",
+                configMINIMAL_STACK_SIZE, NULL, 1, NULL);
+
+    // Run
+    platform_run();
+    return 0;
+}
+
+static void check(bool ok, const char *msg)
+{
+    if (!ok)
+    {
+        log_error("%s", msg);
+
+        while (1)
+        {
+            ;
+        }
+    }
+}
+
+static void app_task(void *param)
+{
+    static packet_t pkt;
+    uint8_t be[IOTLAB_CONTROL_TIME_MAX_SIZE], le[IOTLAB_CONTROL_TIME_MAX_SIZE];
+    uint32_t timestamp, high, low, i;
+    uint64_t t;
+
+    log_printf("# Testing the 64bit experiment time packing\n");
+
+    iotlab_control_start();
+    check(set_time_handler != NULL, "SET_TIME handler not registered");
+
+    // 64bit SET_TIME, big endian
+    pkt.data = pkt.raw_data;
+    packer_uint32_pack(pkt.data, TEST_TIME_US >> 32);
+    packer_uint32_pack(pkt.data + 4, (uint32_t) TEST_TIME_US);
+    pkt.length = 8;
+    check(set_time_handler->handler(SET_TIME, &pkt) == 1,
+          "SET_TIME rejected");
+
+    // Same local time packed in both orders
+    vTaskDelay(configTICK_RATE_HZ / 10);
+    timestamp = soft_timer_time();
+
+    check(iotlab_control_pack_time(be, timestamp) - be == 8,
+          "Big endian time not 8 bytes");
+    check(iotlab_control_pack_time_le(le, timestamp) - le == 8,
+          "Little endian time not 8 bytes");
+
+    for (i = 0; i < 8; i++)
+    {
+        check(le[i] == be[7 - i], "Little endian time not reversed");
+    }
+
+    // The time elapsed since the SET_TIME, about 100ms
+    packer_uint32_unpack(be, &high);
+    packer_uint32_unpack(be + 4, &low);
+    t = ((uint64_t) high << 32) | low;
+    check(t == iotlab_control_convert_time_us(timestamp),
+          "Packed time is not the converted time");
+    check(t > TEST_TIME_US && t - TEST_TIME_US < 1000000,
+          "Packed time out of range");
+
+    log_printf("# %02x%02x%02x%02x%02x%02x%02x%02x packed little endian as"
+               " %02x%02x%02x%02x%02x%02x%02x%02x\n",
+               be[0], be[1], be[2], be[3], be[4], be[5], be[6], be[7],
+               le[0], le[1], le[2], le[3], le[4], le[5], le[6], le[7]);
+
+    log_printf("Test successfull\n");
+
+    while (1)
+    {
+        ;
+    }
+}
@@ -0,0 +1,408 @@
+#!/usr/bin/env python
+
+#
+# Copyright 2013 HiKoB, all rights reserved
+#
+
+"""Load generator for the control node serial protocol
+
+Measures the command latency and the notification throughput of a control
+node, either on the real serial link or on the pty of the native platform:
+
+    NATIVE_UART_EXTERNAL=/tmp/cn.pty bin/iotlab_controlnode.elf &
+    iotlab-load.py /tmp/cn.pty --powerpoll 1,0,0,7,0 --radio poll
+"""
+
+from __future__ import print_function
+
+import os
+import sys
+import time
+import struct
+import argparse
+import threading
+
+try:
+    import serial
+except ImportError:
+    serial = None
+
+SYNC = 0x80
+ACK = 0x0A
+NACK = 0x02
+
+CONFIG_POWERPOLL = 0x42
+SET_TIME = 0x52
+CONFIG_SERIAL = 0x54
+SET_BAUDRATE = 0x55
+RADIO_OFF = 0x60
+RADIO_SNIFFER = 0x61
+RADIO_POLLING = 0x62
+RADIO_INJECTION = 0x63
+RADIO_MONITOR = 0x65
+
+SERIAL_SUPERFRAME = 0xC0
+SERIAL_STATS_NOTIF = 0xC1
+MONITOR_NOTIF = 0xD1
+MONITOR_STATS_NOTIF = 0xD2
+
+NOTIF_NAMES = {
+    0xA1: "sniffed",
+    0xA2: "radio poll",
+    0xA3: "ed sweep",
+    0xB1: "power poll",
+    0xB2: "calibration",
+    SERIAL_SUPERFRAME: "superframe",
+    SERIAL_STATS_NOTIF: "serial stats",
+    MONITOR_NOTIF: "monitor",
+    MONITOR_STATS_NOTIF: "monitor stats",
+}
+
+# Default radio configurations: sniffer hopping every second on all channels,
+# ED sweep on all channels every 2ms, injection of 10 frames per channel
+RADIO_COMMANDS = {
+    "sniffer": (RADIO_SNIFFER, [0x00, 0xF8, 0xFF, 0x07, 100, 0]),
+    "poll": (RADIO_POLLING, [0x00, 0xF8, 0xFF, 0x07, 0x02, 0x00]),
+    "inject": (RADIO_INJECTION, [0x00, 0xF8, 0xFF, 0x07, 10, 0, 10, 0,
+                                 0, 0, 0, 0, 20]),
+}
+
+
+class PosixPort(object):
+    """Minimal raw serial port, when pyserial is not installed"""
+
+    def __init__(self, path):
+        import termios
+        import tty
+
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attr = termios.tcgetattr(self.fd)
+        attr[6][termios.VMIN] = 0
+        attr[6][termios.VTIME] = 5
+        termios.tcsetattr(self.fd, termios.TCSANOW, attr)
+
+    def read(self, size=1):
+        return os.read(self.fd, size)
+
+    def set_baudrate(self, baudrate):
+        # Only the real serial links have a baudrate, see pyserial
+        pass
+
+    def write(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def close(self):
+        os.close(self.fd)
+
+
+class Link(threading.Thread):
+    """Frame reader, with a single outstanding command"""
+
+    def __init__(self, port, baudrate):
+        threading.Thread.__init__(self)
+        self.daemon = True
+
+        if serial is not None:
+            self.port = serial.Serial(port, baudrate, timeout=0.5)
+        else:
+            self.port = PosixPort(port)
+
+        self.running = True
+        self.cond = threading.Condition()
+        self.pending = None
+        self.response = None
+
+        # Statistics
+        self.start_time = time.time()
+        self.rx_bytes = 0
+        self.frames = {}
+        self.frame_bytes = {}
+        self.samples = 0
+        self.records = {}
+        self.late = {}
+        self.drops = {}
+
+        # Power poll notifications carry several samples
+        self.batched = False
+        # Timestamps are 64bit once a 64bit SET_TIME is acknowledged
+        self.time_size = 4
+
+    def close(self):
+        self.running = False
+        self.join(1)
+        self.port.close()
+
+    def set_baudrate(self, baudrate):
+        if serial is not None:
+            self.port.baudrate = baudrate
+        else:
+            self.port.set_baudrate(baudrate)
+
+    def reset_stats(self):
+        with self.cond:
+            self.start_time = time.time()
+            self.rx_bytes = 0
+            self.frames = {}
+            self.frame_bytes = {}
+            self.samples = 0
+            self.records = {}
+            self.late = {}
+
+    def command(self, cmd, data=(), timeout=1.0):
+        """Send a command and return (ack, payload, latency), None on timeout"""
+        frame = bytearray([SYNC, len(data) + 1, cmd]) + bytearray(data)
+
+        with self.cond:
+            self.pending = cmd
+            self.response = None
+            start = time.time()
+            self.port.write(bytes(frame))
+
+            while self.response is None and time.time() - start < timeout:
+                self.cond.wait(timeout)
+
+            latency = time.time() - start
+            response = self.response
+            self.pending = None
+
+        if response is None:
+            return None
+        return (response[0] == ACK, response[1:], latency)
+
+    def run(self):
+        buf = bytearray()
+
+        while self.running:
+            try:
+                data = self.port.read(256)
+            except (OSError, IOError) as err:
+                print("Closing: %s" % err, file=sys.stderr)
+                return
+
+            if not data:
+                continue
+
+            buf += bytearray(data)
+            self.rx_bytes += len(data)
+
+            while len(buf) >= 2:
+                if buf[0] != SYNC:
+                    # Debug output, skip until next sync
+                    del buf[0]
+                    continue
+
+                length = buf[1]
+                if len(buf) < 2 + length:
+                    break
+
+                self._process(buf[2:2 + length])
+                del buf[:2 + length]
+
+    def _process(self, frame):
+        if not frame:
+            return
+
+        ftype = frame[0]
+        payload = frame[1:]
+
+        with self.cond:
+            if ftype == self.pending and payload and payload[0] in (ACK, NACK):
+                self.response = payload
+                self.cond.notify()
+                return
+
+            self.frames[ftype] = self.frames.get(ftype, 0) + 1
+            self.frame_bytes[ftype] = self.frame_bytes.get(ftype, 0) \
+                + len(frame) + 2
+
+            if ftype == SERIAL_SUPERFRAME:
+                # Frames without their sync byte: length, type, payload
+                i = 0
+                while i < len(payload):
+                    self._process(payload[i + 1:i + 1 + payload[i]])
+                    i += 1 + payload[i]
+            elif ftype == SERIAL_STATS_NOTIF:
+                self._drops(payload)
+            elif ftype == MONITOR_NOTIF:
+                self._records(payload)
+            elif ftype == MONITOR_STATS_NOTIF:
+                # Time, activities (type, runs, late), frames, records, drops
+                i = self.time_size
+                count = payload[i]
+                i += 1
+                for _ in range(count):
+                    rtype, _runs, late = struct.unpack(
+                        ">BHH", bytes(payload[i:i + 5]))
+                    self.late[rtype] = self.late.get(rtype, 0) + late
+                    i += 5
+                self._drops(payload[i + 4:])
+            elif ftype == 0xB1:
+                # Batched frames have the sample count in the second byte
+                if self.batched and len(payload) >= 2:
+                    self.samples += payload[1]
+                else:
+                    self.samples += 1
+
+
+    def _drops(self, payload):
+        for i in range(0, len(payload) - 2, 3):
+            dtype, count = struct.unpack(">BH", bytes(payload[i:i + 3]))
+            self.drops[dtype] = self.drops.get(dtype, 0) + count
+
+    def _records(self, payload):
+        # Count, base time, then (type, offset, length, record)
+        i = 1 + self.time_size
+        for _ in range(payload[0]):
+            if i + 4 > len(payload):
+                break
+            rtype, length = payload[i], payload[i + 3]
+            self.records[rtype] = self.records.get(rtype, 0) + 1
+            if rtype == 0xB1:
+                self.samples += 1
+            i += 4 + length
+
+
+def percentile(values, pct):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100.0))]
+
+
+def ping(link, count):
+    latencies = []
+    lost = 0
+
+    for _ in range(count):
+        now = struct.pack(">Q", int(time.time() * 1e6))
+        ret = link.command(SET_TIME, bytearray(now))
+        if ret is None or not ret[0]:
+            lost += 1
+        else:
+            latencies.append(ret[2] * 1000.0)
+            link.time_size = 8
+
+    if latencies:
+        print("# SET_TIME %u: min %.2f avg %.2f max %.2f p99 %.2f ms, %u lost"
+              % (len(latencies), min(latencies),
+                 sum(latencies) / len(latencies), max(latencies),
+                 percentile(latencies, 99), lost))
+    else:
+        print("# SET_TIME: no response")
+
+
+def check(ret, what):
+    if ret is None:
+        print("%s: timeout" % what)
+    elif not ret[0]:
+        print("%s: NACK" % what)
+    else:
+        return True
+    return False
+
+
+def report(link, baudrate):
+    elapsed = time.time() - link.start_time
+    total = 0
+
+    print("# %.1f s, %u bytes received, %.0f B/s, %.1f%% of the link"
+          % (elapsed, link.rx_bytes, link.rx_bytes / elapsed,
+             100.0 * link.rx_bytes * 10 / (baudrate * elapsed)))
+
+    for ftype in sorted(link.frames):
+        total += link.frames[ftype]
+        print("#   0x%02X %-12s %7u frames %9u bytes %8.1f frames/s"
+              % (ftype, NOTIF_NAMES.get(ftype, "?"), link.frames[ftype],
+                 link.frame_bytes[ftype], link.frames[ftype] / elapsed))
+
+    if link.samples:
+        print("#   %u power samples, %.1f samples/s"
+              % (link.samples, link.samples / elapsed))
+
+    for rtype in sorted(link.records):
+        print("#   0x%02X %-12s %7u records %9u late"
+              % (rtype, NOTIF_NAMES.get(rtype, "?"), link.records[rtype],
+                 link.late.get(rtype, 0)))
+
+    for dtype in sorted(link.drops):
+        print("#   0x%02X %-12s %7u dropped"
+              % (dtype, NOTIF_NAMES.get(dtype, "?"), link.drops[dtype]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("-b", "--baudrate", type=int, default=500000)
+    parser.add_argument("-d", "--duration", type=float, default=10,
+                        help="measure duration in seconds")
+    parser.add_argument("-p", "--pings", type=int, default=100,
+                        help="SET_TIME commands before and during the load")
+    parser.add_argument("--powerpoll", default=None,
+                        help="input,period,average[,selection,samples]")
+    parser.add_argument("--radio", choices=sorted(RADIO_COMMANDS),
+                        default=None)
+    parser.add_argument("--monitor", default=None,
+                        help="slot,sniff_channel,ed_channels,ed_period")
+    parser.add_argument("--switch-baudrate", type=int, default=None,
+                        help="baudrate to negotiate before the load")
+    parser.add_argument("--superframes", action="store_true",
+                        help="merge the queued notifications")
+    args = parser.parse_args()
+
+    link = Link(args.port, args.baudrate)
+    link.start()
+
+    try:
+        check(link.command(RADIO_OFF), "Radio off")
+
+        if args.switch_baudrate:
+            ret = link.command(SET_BAUDRATE,
+                               bytearray(struct.pack("<I",
+                                                     args.switch_baudrate)))
+            if check(ret, "Baudrate %u" % args.switch_baudrate):
+                current, maximum = struct.unpack("<II", bytes(ret[1]))
+                print("# Baudrate %u -> %u, max %u"
+                      % (current, args.switch_baudrate, maximum))
+                # The reply is the last frame at the previous baudrate
+                link.set_baudrate(args.switch_baudrate)
+                args.baudrate = args.switch_baudrate
+
+        if args.superframes:
+            check(link.command(CONFIG_SERIAL, [0, 1]), "Superframes")
+
+        print("# Idle link")
+        ping(link, args.pings)
+
+        if args.powerpoll:
+            config = [int(v, 0) for v in args.powerpoll.split(",")]
+            link.batched = len(config) == 5
+            check(link.command(CONFIG_POWERPOLL, config), "Power poll")
+
+        if args.radio:
+            cmd, config = RADIO_COMMANDS[args.radio]
+            check(link.command(cmd, config), "Radio %s" % args.radio)
+
+        if args.monitor:
+            slot, channel, channels, period = [
+                int(v, 0) for v in args.monitor.split(",")]
+            config = struct.pack("<HBIB", slot, channel, channels, period)
+            check(link.command(RADIO_MONITOR, bytearray(config)), "Monitor")
+
+        link.reset_stats()
+        end = time.time() + args.duration
+
+        print("# Loaded link")
+        ping(link, args.pings)
+
+        while time.time() < end:
+            time.sleep(0.1)
+
+        report(link, args.baudrate)
+    finally:
+        link.command(RADIO_OFF)
+        link.command(CONFIG_POWERPOLL, [0, 0, 0])
+        link.close()
+
+
+if __name__ == "__main__":
+    main()
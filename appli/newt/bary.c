@@ -28,6 +28,7 @@
 #include "math.h"
 #include "platform.h"
 #include "printf.h"
+#include "debug.h"
 
 #include "soft_timer.h"
 
@@ -37,11 +38,22 @@
 #include "pca9685.h"
 
 extern adg759_t pga308_mux;
+extern openlab_timer_t pga308_timer;
 
 static void app_task(void *);
 
-static void adc_sample_done(handler_arg_t arg, uint16_t value);
-static volatile int32_t adc_value;
+/*
+ * The PGA output is sampled continuously at ADC_FREQUENCY, each half of the
+ * buffer is averaged by the driver into a single value.
+ */
+#define ADC_FREQUENCY 2000
+#define ADC_OVERSAMPLING 16
+static uint16_t adc_buffer[2 * ADC_OVERSAMPLING];
+
+static void adc_scan_done(handler_arg_t arg, const uint16_t *scans,
+                          uint16_t num_scans);
+static volatile uint16_t adc_value;
+static volatile uint32_t adc_count;
 
 static void gauges_read();
 static void gauges_compute();
@@ -116,11 +128,22 @@ static void app_task(void *param)
     // Enable the ADC
     adc_enable(pga308_get_adc());
 
-    // Set ADC handler
-    adc_set_handler(pga308_get_adc(), adc_sample_done, NULL);
+    // Sample the PGA output continuously, averaged by the driver
+    uint8_t channel = pga308_get_adc_channel();
+    if (!adc_config_scan(pga308_get_adc(), &channel, 1, pga308_timer,
+                         TIMER_CHANNEL_4))
+    {
+        log_error("Unable to configure the ADC scan");
+        HALT();
+    }
 
-    // Prepare the ADC
-    adc_prepare_single(pga308_get_adc(), pga308_get_adc_channel());
+    if (!adc_start_scan(pga308_get_adc(), ADC_FREQUENCY, adc_buffer,
+                        2 * ADC_OVERSAMPLING, ADC_OVERSAMPLING, adc_scan_done,
+                        NULL))
+    {
+        log_error("Unable to start the ADC scan");
+        HALT();
+    }
 
     // Read a few times for setup
     gauges_read();
@@ -165,10 +188,12 @@ static void app_task(void *param)
     }
 }
 
-static void adc_sample_done(handler_arg_t arg, uint16_t value)
+static void adc_scan_done(handler_arg_t arg, const uint16_t *scans,
+                          uint16_t num_scans)
 {
-    // Store the value
-    adc_value = value;
+    // Store the averaged value
+    adc_value = scans[0];
+    adc_count++;
 }
 
 static void gauges_read()
@@ -185,14 +210,12 @@ static void gauges_read()
 
         soft_timer_delay_ms(10);
 
-        // Start new sample
-        adc_value = -1;
-        adc_sample_single(pga308_get_adc());
+        // Wait for a value averaged entirely after the settling time
+        uint32_t count = adc_count;
 
-        // Wait until value updated
-        while (adc_value == -1)
+        while (adc_count - count < 2)
         {
-            asm volatile("nop");
+            soft_timer_delay_ms(1);
         }
 
         // Average if not null
@@ -36,7 +36,17 @@
 #define MAX_WRITE 6000
 #define BUF_SIZE 10
 
+#if defined(NATIVE)
+// Disk image used on the native platform, create it with
+// mkfs.vfat -F 32 -C fat32.img <size in KB>
+#define DISK_IMAGE "fat32.img"
+static blockdev_file_t image;
+#else
+extern sdio_t sdio;
+#endif
+
 xTaskHandle vLEDTaskHandle, vBenchTaskHandle;
+blockdev_t dev;
 file_t f;
 uint8_t fb[512];
 uint8_t *filename = (uint8_t *)"LOG.TXT";
@@ -94,8 +104,14 @@ int main()
             printf("-> LED task created successfully\r\n");
     }
 
+#if defined(NATIVE)
+    blockdev_file_config(&dev, &image, DISK_IMAGE);
+#else
+    blockdev_sdio_config(&dev, sdio);
+#endif
+
     // If an error occured suspend this task and make the LED blink
-    if (fat32_init() != FAT32_OK)
+    if (fat32_init(&dev) != FAT32_OK)
     {
         error = 1;
         printf("/!\\ Error initializing FAT32\r\n");
@@ -0,0 +1,161 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * test_flashlog.c
+ *
+ * Flash log test on a RAM simulated NOR flash: records are appended at a
+ * fixed rate while the log is drained, then the log is remounted to check
+ * that the state is recovered from the flash content.
+ */
+
+#include <stdint.h>
+#include "platform.h"
+#include "printf.h"
+#include "debug.h"
+#include "flashlog.h"
+
+#define NUM_BLOCKS  4
+#define NUM_RECORDS 5000
+#define RECORD_LEN  16
+
+static uint8_t flash_mem[NUM_BLOCKS * FLASHLOG_BLOCK_SIZE];
+static flashlog_nor_sim_t sim;
+static flashlog_nor_t nor;
+static flashlog_t flog;
+
+static void app_task(void *);
+
+static uint32_t clock_us()
+{
+    return xTaskGetTickCount() * portTICK_RATE_MS * 1000;
+}
+
+int main()
+{
+    // Initialize the platform
+    platform_init();
+
+    // Create a task for the application
+    xTaskCreate(app_task, (const signed char * const) "app",
+                configMINIMAL_STACK_SIZE, NULL, 1, NULL);
+
+    // Run
+    platform_run();
+    return 0;
+}
+
+static void check(bool ok, const char *msg)
+{
+    if (!ok)
+    {
+        log_error("%s", msg);
+
+        while (1)
+        {
+            ;
+        }
+    }
+}
+
+static void app_task(void *param)
+{
+    static uint32_t record[RECORD_LEN / 4], buf[FLASHLOG_MAX_RECORD / 4];
+    static uint32_t i, next, count, start, reread;
+    uint16_t len;
+
+    log_printf("# Testing flash log on simulated NOR\n");
+
+    flashlog_nor_sim_config(&nor, &sim, flash_mem, sizeof(flash_mem), clock_us);
+    flashlog_config(&flog, &nor, 0, sizeof(flash_mem));
+    flashlog_mount(&flog);
+
+    /** Append while draining, one record read every two written */
+    start = xTaskGetTickCount();
+    next = 0;
+
+    for (i = 0; i < NUM_RECORDS; i++)
+    {
+        record[0] = i;
+        flashlog_append(&flog, (uint8_t *)record, RECORD_LEN);
+
+        if ((i & 1) && (len = flashlog_read(&flog, (uint8_t *)buf, sizeof(buf))))
+        {
+            // Records may be lost when the log is full, never reordered
+            check(buf[0] >= next, "Record read out of order");
+            next = buf[0] + 1;
+        }
+
+        vTaskDelay(1);
+    }
+
+    flashlog_sync(&flog);
+
+    log_printf("# %u records in %u ms, %u dropped, %u pages overwritten\n",
+               flashlog_get_stats(&flog)->records_written,
+               (uint32_t) ((xTaskGetTickCount() - start) * portTICK_RATE_MS),
+               flashlog_get_stats(&flog)->records_dropped,
+               flashlog_get_stats(&flog)->pages_overwritten);
+    log_printf("# %u programs, %u erases, max erase count %u\n",
+               sim.programs, sim.erases,
+               flashlog_get_stats(&flog)->max_erase_count);
+
+    /** Remount and drain */
+    count = flashlog_pending_pages(&flog);
+    flashlog_mount(&flog);
+    check(flashlog_pending_pages(&flog) == count, "Pending pages lost on mount");
+
+    count = 0;
+    reread = 0;
+
+    while ((len = flashlog_read(&flog, (uint8_t *)buf, sizeof(buf))))
+    {
+        check(len == RECORD_LEN, "Wrong record length");
+
+        if (count == 0 && buf[0] < next)
+        {
+            // The partly read tail page is read again from its start
+            reread = next - buf[0];
+            check(reread < FLASHLOG_PAGE_SIZE / RECORD_LEN,
+                  "Records read again beyond the tail page");
+        }
+        else
+        {
+            check(buf[0] >= next, "Record read out of order");
+        }
+
+        next = buf[0] + 1;
+        count++;
+    }
+
+    check(next == NUM_RECORDS, "Last record missing");
+    log_printf("# Drained %u records after remount, %u read again\n",
+               count, reread);
+
+    /** Once drained, nothing is left after another mount */
+    flashlog_mount(&flog);
+    check(flashlog_pending_pages(&flog) == 0, "Consumed pages read again");
+
+    log_printf("Test successfull\n");
+
+    while (1)
+    {
+        ;
+    }
+}
@@ -29,6 +29,7 @@
 #include "soft_timer.h"
 
 #include "hkb-lwip.h"
+#include "ethmac.h"
 #include "debug.h"
 
 #include "lwip/opt.h"
@@ -37,8 +38,12 @@
 #include "ipv4/lwip/ip_addr.h"
 
 #define WEB_THREAD_PORT         80
+#define ECHO_THREAD_PORT        7
+#define DISCARD_THREAD_PORT     9
 
 static void web_task(void*);
+static void echo_task(void*);
+static void discard_task(void*);
 
 int main()
 {
@@ -53,6 +58,14 @@ int main()
     xTaskCreate(web_task, (const signed char*) "web", configMINIMAL_STACK_SIZE,
             NULL, 1, NULL);
 
+    // Create the tasks for the measures: latency with the echo server (e.g.
+    // 'tcpping' or a ping-pong script), throughput with the discard server
+    // (e.g. 'dd if=/dev/zero bs=1k count=10k | nc <address> 9')
+    xTaskCreate(echo_task, (const signed char*) "echo", configMINIMAL_STACK_SIZE,
+            NULL, 1, NULL);
+    xTaskCreate(discard_task, (const signed char*) "discard",
+            configMINIMAL_STACK_SIZE, NULL, 1, NULL);
+
     platform_run();
     return 0;
 }
@@ -138,3 +151,90 @@ static void web_task(void* p)
         netconn_delete(newconn);
     }
 }
+
+static struct netconn *listen_on(uint16_t port)
+{
+    struct netconn *conn;
+
+    /* Create a new TCP connection handle */
+    conn = netconn_new(NETCONN_TCP);
+    LWIP_ERROR("listen_on: invalid conn", (conn != NULL),
+            while (1){vTaskDelay(configTICK_RATE_HZ);});
+
+    /* Bind to the port with default IP address, and listen */
+    netconn_bind(conn, NULL, port);
+    netconn_listen(conn);
+
+    return conn;
+}
+
+static void echo_task(void* p)
+{
+    struct netconn *conn, *newconn;
+    struct netbuf *inbuf;
+    void *data;
+    u16_t len;
+
+    conn = listen_on(ECHO_THREAD_PORT);
+
+    while (1)
+    {
+        if (netconn_accept(conn, &newconn) != ERR_OK)
+            continue;
+
+        /* Send back each segment as soon as received */
+        while (netconn_recv(newconn, &inbuf) == ERR_OK)
+        {
+            do
+            {
+                netbuf_data(inbuf, &data, &len);
+                netconn_write(newconn, data, len, NETCONN_COPY);
+            } while (netbuf_next(inbuf) >= 0);
+
+            netbuf_delete(inbuf);
+        }
+
+        netconn_close(newconn);
+        netconn_delete(newconn);
+    }
+}
+
+static void discard_task(void* p)
+{
+    struct netconn *conn, *newconn;
+    struct netbuf *inbuf;
+    uint32_t start, bytes, ms;
+    ethmac_stats_t stats;
+
+    conn = listen_on(DISCARD_THREAD_PORT);
+
+    while (1)
+    {
+        if (netconn_accept(conn, &newconn) != ERR_OK)
+            continue;
+
+        start = soft_timer_time();
+        bytes = 0;
+        ethmac_reset_stats();
+
+        while (netconn_recv(newconn, &inbuf) == ERR_OK)
+        {
+            bytes += netbuf_len(inbuf);
+            netbuf_delete(inbuf);
+        }
+
+        ms = soft_timer_ticks_to_ms(soft_timer_time() - start);
+        log_info("Discarded %u bytes in %u ms, %u kB/s", bytes, ms,
+                ms ? bytes / ms : 0);
+
+        // Frames per interrupt show the moderation and the batching
+        ethmac_get_stats(&stats);
+        log_info("RX %u frames (%u errors, %u missed), TX %u frames "
+                "(%u errors), %u interrupts", stats.rx_frames,
+                stats.rx_errors, stats.rx_missed, stats.tx_frames,
+                stats.tx_errors, stats.interrupts);
+
+        netconn_close(newconn);
+        netconn_delete(newconn);
+    }
+}
@@ -30,6 +30,9 @@
 #include "debug.h"
 #include "n25xxx.h"
 #include "random.h"
+#include "soft_timer.h"
+
+#define ASYNC_PAGES 64
 
 static void app_task(void *);
 
@@ -47,11 +50,18 @@ int main()
     return 0;
 }
 
+static void async_done(handler_arg_t arg, unsigned result)
+{
+    (*(volatile uint32_t *) arg)++;
+}
+
 static void app_task(void *param)
 {
     static uint8_t buf[256];
     static uint16_t i;
     static uint32_t page;
+    static uint32_t start;
+    static volatile uint32_t done;
 
     log_printf("# Testing N25XXX\n");
 
@@ -113,6 +123,70 @@ static void app_task(void *param)
         }
     }
 
+    /** Asynchronous write and read back of consecutive pages */
+    page &= ~(ASYNC_PAGES - 1);
+    log_printf("# Asynchronous write of %d pages from page %d\n", ASYNC_PAGES, page);
+
+    done = 0;
+
+    for (i = 0; i < ASYNC_PAGES; i += 16)
+    {
+        n25xxx_erase_subsector_async((page + i) << 8, async_done,
+                                     (handler_arg_t) &done);
+    }
+
+    while (done != ASYNC_PAGES / 16)
+    {
+        vTaskDelay(1);
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        buf[i] = 7 * i;
+    }
+
+    done = 0;
+    start = soft_timer_time();
+
+    for (i = 0; i < ASYNC_PAGES; i++)
+    {
+        // Same buffer for every page, queue as soon as there is room
+        while (!n25xxx_write_page_async((page + i) << 8, buf, async_done,
+                                        (handler_arg_t) &done))
+        {
+            vTaskDelay(1);
+        }
+    }
+
+    while (done != ASYNC_PAGES)
+    {
+        vTaskDelay(1);
+    }
+
+    log_printf("# Written in %d us\n",
+               soft_timer_ticks_to_us(soft_timer_time() - start));
+
+    for (i = 0; i < ASYNC_PAGES; i++)
+    {
+        done = 0;
+        n25xxx_read_async((page + i) << 8, buf, 256, async_done,
+                          (handler_arg_t) &done);
+
+        while (!done)
+        {
+            vTaskDelay(1);
+        }
+
+        for (start = 0; start < 256; start++)
+        {
+            if (buf[start] != (uint8_t)(7 * start))
+            {
+                log_error("Page %d has not the right content...", page + i);
+                while(1);
+            }
+        }
+    }
+
     log_printf("Test successfull\n");
 
     while (1)
@@ -36,13 +36,14 @@
  * \defgroup ADC ADC driver
  *
  * This driver provides all functions required to perform ADC conversions on
- * a selected channel.
+ * a selected channel, or continuously on a group of channels.
  *
  *@{
  */
 
 #include <stdint.h>
 #include "handler.h"
+#include "timer.h"
 
 /** Abstract pointer representing an ADC */
 typedef const void *adc_t;
@@ -56,6 +57,24 @@ typedef const void *adc_t;
  */
 typedef void (*adc_handler_t)(handler_arg_t arg, uint16_t value);
 
+/**
+ * ADC handler function used to get the conversions of a scan group.
+ *
+ * It is called from the DMA interrupt each time half of the buffer is
+ * filled, with the scans of this half, averaged if oversampling. They
+ * are overwritten when the DMA comes back to this half.
+ *
+ * \param arg the argument provided when starting the scan
+ * \param scans the 12bit conversion results, one per channel of the group
+ *      for each scan, in the group order
+ * \param num_scans the number of scans
+ */
+typedef void (*adc_scan_handler_t)(handler_arg_t arg, const uint16_t *scans,
+                                   uint16_t num_scans);
+
+/** Maximum number of channels in a scan group */
+#define ADC_SCAN_MAX_CHANNELS 16
+
 enum
 {
     ADC_CHANNEL_TEMPERATURE = 16,
@@ -138,6 +157,53 @@ void adc_prepare_single(adc_t adc, uint8_t channel);
  */
 void adc_sample_single(adc_t adc);
 
+/**
+ * Configure a scan group.
+ *
+ * The channels are converted in sequence at each compare event of a timer
+ * channel, the results are transferred by DMA. The timer must be enabled
+ * and its clock selected, the ADC DMA channel set by the platform.
+ *
+ * \param adc the ADC to configure
+ * \param channels the channels to convert at each scan, in order
+ * \param num_channels the number of channels, up to ADC_SCAN_MAX_CHANNELS
+ * \param timer the timer triggering the scans
+ * \param timer_channel the channel of the timer triggering the scans
+ * \return 1 if configured, 0 if this timer channel cannot trigger the ADC or
+ *      if there are too many channels
+ */
+int32_t adc_config_scan(adc_t adc, const uint8_t *channels,
+                        uint8_t num_channels, openlab_timer_t timer,
+                        timer_channel_t timer_channel);
+
+/**
+ * Start the continuous conversion of the configured scan group.
+ *
+ * The buffer is used circularly, the handler is called with each half.
+ * With oversampling, consecutive scans of a half are averaged in place
+ * before calling the handler.
+ *
+ * \param adc the ADC to sample
+ * \param frequency the scan frequency, in Hz
+ * \param buffer the buffer, of num_scans * num_channels samples
+ * \param num_scans the number of scans in the buffer, each half must be a
+ *      multiple of the oversampling
+ * \param oversampling the number of scans averaged per result, 1 for none
+ * \param handler the handler called with the results of each half
+ * \param arg the argument to provide to the handler
+ * \return 1 if started, 0 on invalid parameters
+ */
+int32_t adc_start_scan(adc_t adc, uint32_t frequency, uint16_t *buffer,
+                       uint16_t num_scans, uint8_t oversampling,
+                       adc_scan_handler_t handler, handler_arg_t arg);
+
+/**
+ * Stop the conversion of a scan group.
+ *
+ * \param adc the ADC to stop
+ */
+void adc_stop_scan(adc_t adc);
+
 /**
  * Enable VrefINT for sampling it and computing Vcc
  */
@@ -34,6 +34,13 @@
 static handler_t tick_handler;
 static handler_arg_t tick_handler_arg;
 
+/** SysTick counts of one period, and number of periods of a stretched one */
+static uint32_t tick_reload;
+static uint32_t tick_stretched;
+
+/** Maximum reload value of the 24bit SysTick counter */
+#define SYSTICK_MAX_RELOAD 0xFFFFFF
+
 void nvic_enable_interrupt_line(nvic_irq_line_t line)
 {
     uint8_t word, bit;
@@ -91,6 +98,7 @@ void nvic_enable_systick(uint32_t freq, handler_t handler, handler_arg_t arg)
                    / freq;
 
     // Set the SysTick reload value
+    tick_reload = reload_value;
     *cm3_nvic_get_SYSTICK_RELOAD_VALUE() = reload_value - 1;
 
     // Clear the current value
@@ -107,6 +115,68 @@ void nvic_disable_systick()
     *cm3_nvic_get_SYSTICK_CTRL() = 0;
 }
 
+uint32_t nvic_stretch_systick(uint32_t periods)
+{
+    uint32_t current;
+
+    // Limit to the counter range
+    if (periods > (SYSTICK_MAX_RELOAD + 1) / tick_reload)
+    {
+        periods = (SYSTICK_MAX_RELOAD + 1) / tick_reload;
+    }
+
+    // Stop counting, a period ending now leaves its interrupt pending
+    *cm3_nvic_get_SYSTICK_CTRL() &= ~SYSTICK_CTRL__ENABLE;
+    current = *cm3_nvic_get_SYSTICK_CURRENT_VALUE();
+    if (current == 0)
+    {
+        current = 1;
+    }
+
+    // Keep the phase of the current period, and add the next ones
+    tick_stretched = periods;
+    *cm3_nvic_get_SYSTICK_RELOAD_VALUE() = current + (periods - 1)
+            * tick_reload;
+    *cm3_nvic_get_SYSTICK_CURRENT_VALUE() = 0;
+    *cm3_nvic_get_SYSTICK_CTRL() |= SYSTICK_CTRL__ENABLE;
+
+    return periods;
+}
+
+uint32_t nvic_restore_systick()
+{
+    uint32_t ctrl, current, elapsed;
+
+    // Stop counting, reading the control clears the count flag
+    ctrl = *cm3_nvic_get_SYSTICK_CTRL();
+    *cm3_nvic_get_SYSTICK_CTRL() = ctrl & ~SYSTICK_CTRL__ENABLE;
+
+    // Catch the end of the period if it happened while stopping
+    ctrl |= *cm3_nvic_get_SYSTICK_CTRL();
+
+    if (ctrl & SYSTICK_CTRL__COUNTFLAG)
+    {
+        // The stretched period ended, its interrupt accounts for the last one
+        elapsed = tick_stretched - 1;
+        current = tick_reload;
+    }
+    else
+    {
+        // Interrupted earlier, count the periods ended and finish the current
+        current = *cm3_nvic_get_SYSTICK_CURRENT_VALUE();
+        elapsed = tick_stretched - (current + tick_reload - 1) / tick_reload;
+        current = ((current + tick_reload - 1) % tick_reload) + 1;
+    }
+
+    // Restart from the remainder of the current period, then periodic again
+    *cm3_nvic_get_SYSTICK_RELOAD_VALUE() = current - 1;
+    *cm3_nvic_get_SYSTICK_CURRENT_VALUE() = 0;
+    *cm3_nvic_get_SYSTICK_CTRL() = ctrl | SYSTICK_CTRL__ENABLE;
+    *cm3_nvic_get_SYSTICK_RELOAD_VALUE() = tick_reload - 1;
+
+    return elapsed;
+}
+
 void systick_handler()
 {
     if (tick_handler)
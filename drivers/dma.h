@@ -141,6 +141,50 @@ void dma_start(dma_t dma, handler_t done_handler, handler_arg_t handler_arg);
  */
 int32_t dma_cancel(dma_t dma);
 
+/**
+ * Start a circular DMA transfer, which must have been configured.
+ *
+ * The channel runs over the configured buffer continuously, wrapping to its
+ * beginning at the end, until canceled with \ref dma_cancel. The handlers
+ * are called from the interrupt when each half of the buffer is done, the
+ * consumer processes one half while the other is being transferred.
+ *
+ * \param dma the DMA to start;
+ * \param half_handler the function called when the first half is done,
+ *      NULL if not required;
+ * \param full_handler the function called when the second half is done,
+ *      NULL if not required;
+ * \param handler_arg optional argument for the handlers;
+ */
+void dma_start_circular(dma_t dma, handler_t half_handler,
+                        handler_t full_handler, handler_arg_t handler_arg);
+
+/**
+ * Get the number of transfers remaining before the end of the buffer.
+ *
+ * For a circular transfer, the position of the DMA in the buffer is the
+ * transfer number minus this count, for a ring consumer to know how far it
+ * may read.
+ *
+ * \param dma the DMA to query;
+ * \return the number of transfers remaining.
+ */
+uint16_t dma_get_remaining(dma_t dma);
+
+/**
+ * Chain a transfer after the current one.
+ *
+ * When the current one-shot transfer completes, the DMA is restarted from
+ * the interrupt on the new memory buffer, with the same configuration,
+ * before the done handler of the completed transfer is called. This is
+ * typically called from the done handler, to double-buffer a stream.
+ *
+ * \param dma the running DMA;
+ * \param memory_address the memory address of the next transfer;
+ * \param transfer_number the number of transfers to operate;
+ */
+void dma_chain(dma_t dma, uint32_t memory_address, uint16_t transfer_number);
+
 /**
  * @}
  * @}
@@ -29,12 +29,39 @@
 
 #include <stdint.h>
 
+/** Size of the frame buffers, multiple of 4 */
+#define ETHMAC_BUFFER_SIZE 1524
+
 typedef struct
 {
     uint32_t offset, size;
     void* real_des;
 } ethmac_tx_t;
 
+/** A part of a frame to send in place, see \ref ethmac_tx_send_buffers */
+typedef struct
+{
+    const uint8_t *data;
+    uint16_t length;
+} ethmac_tx_buffer_t;
+
+/** Statistics counters of the driver */
+typedef struct
+{
+    /** Valid frames received */
+    uint32_t rx_frames;
+    /** Received frames dropped for errors */
+    uint32_t rx_errors;
+    /** Frames missed by the DMA, no free descriptor or FIFO overflow */
+    uint32_t rx_missed;
+    /** Frames sent */
+    uint32_t tx_frames;
+    /** Frames whose transmission failed */
+    uint32_t tx_errors;
+    /** Interrupts handled */
+    uint32_t interrupts;
+} ethmac_stats_t;
+
 typedef struct
 {
     uint32_t offset, size;
@@ -58,6 +85,35 @@ void ethmac_disable();
  */
 void ethmac_start(const uint8_t* address);
 
+/**
+ * Set the interrupt moderation.
+ *
+ * The receive interrupt is raised for every rx_frames frames, or when
+ * rx_timeout_us has elapsed after a frame without interrupt, the timeout
+ * being 1 to 255 periods of 256 HCLK cycles (about 390us at 168MHz). The
+ * transmit interrupt is raised for every tx_frames frames, none if 0.
+ *
+ * The default is an interrupt per frame. This must be called after
+ * \ref ethmac_start.
+ *
+ * \param rx_frames frames per receive interrupt, up to the number of
+ * descriptors
+ * \param rx_timeout_us maximum delay of a receive interrupt if rx_frames > 1
+ * \param tx_frames frames per transmit interrupt
+ */
+void ethmac_set_coalescing(uint32_t rx_frames, uint32_t rx_timeout_us,
+        uint32_t tx_frames);
+
+/**
+ * Get the statistics counters, since the start or the last reset.
+ *
+ * \param stats a pointer to the structure to fill
+ */
+void ethmac_get_stats(ethmac_stats_t *stats);
+
+/** Reset the statistics counters */
+void ethmac_reset_stats();
+
 /**
  * Get the link status
  * \return 1 if link up, 0 if down
@@ -86,6 +142,36 @@ void ethmac_tx_write(ethmac_tx_t *tx, const uint8_t* buffer, uint32_t len);
  */
 void ethmac_tx_send(ethmac_tx_t *tx);
 
+/**
+ * Send a frame from a list of buffers, without copy.
+ *
+ * Each buffer takes a transmit descriptor, the DMA reads it in place: the
+ * buffers must remain valid until the frame is returned by
+ * \ref ethmac_tx_reclaim. This must not be mixed with the copying
+ * ethmac_tx_init/write/send functions.
+ *
+ * \param buffers the parts of the frame, in order
+ * \param count the number of parts
+ * \param arg non NULL, identifies the frame for \ref ethmac_tx_reclaim
+ * \return 1 if queued, 0 if not enough descriptors are free
+ */
+int32_t ethmac_tx_send_buffers(const ethmac_tx_buffer_t *buffers,
+        uint32_t count, void *arg);
+
+/**
+ * Get the number of free transmit descriptors, for
+ * \ref ethmac_tx_send_buffers.
+ */
+uint32_t ethmac_tx_get_free();
+
+/**
+ * Get the next frame sent by \ref ethmac_tx_send_buffers, whose buffers
+ * are no longer used. The frames are returned in the order they were sent.
+ *
+ * \return the arg of the frame, NULL if none
+ */
+void *ethmac_tx_reclaim();
+
 /**
  * Initialize the next receive descriptor
  *
@@ -93,6 +179,13 @@ void ethmac_tx_send(ethmac_tx_t *tx);
  */
 int32_t ethmac_rx_init(ethmac_rx_t *rx);
 
+/**
+ * Check if a received frame is waiting, without taking it.
+ *
+ * \return 1 if \ref ethmac_rx_init has a descriptor to process, 0 otherwise
+ */
+int32_t ethmac_rx_pending();
+
 /**
  * Get the length of the received data in the current descriptor.
  *
@@ -115,6 +208,23 @@ void ethmac_rx_read(ethmac_rx_t *rx,uint8_t *buffer, uint32_t len);
  */
 void ethmac_rx_release(ethmac_rx_t *rx);
 
+/**
+ * Get the DMA buffer of the received frame, to use it in place.
+ */
+uint8_t *ethmac_rx_get_buffer(ethmac_rx_t *rx);
+
+/**
+ * Release the current received descriptor with a new buffer.
+ *
+ * The following frames are received in the given buffer, of
+ * \ref ETHMAC_BUFFER_SIZE bytes and word aligned. The current buffer is
+ * left to the caller, that may give it back with a later release.
+ *
+ * \param rx the received descriptor
+ * \param buffer the new buffer of the descriptor
+ */
+void ethmac_rx_release_buffer(ethmac_rx_t *rx, uint8_t *buffer);
+
 /**
  *  Function called when a received frame interrupt happened
  *
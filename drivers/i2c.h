@@ -57,6 +57,48 @@ typedef enum
     I2C_CLOCK_MODE_FAST,
 } i2c_clock_mode_t;
 
+/**
+ * Priorities of the I2C transactions, see \ref i2c_transaction_t.
+ */
+enum
+{
+    I2C_PRIORITY_LOW = 0,
+    I2C_PRIORITY_NORMAL = 1,
+    I2C_PRIORITY_HIGH = 2,
+};
+
+/**
+ * Descriptor of an I2C transaction, a send then receive with a slave.
+ *
+ * The descriptor and the buffers must remain valid until the end of the
+ * transaction.
+ */
+typedef struct i2c_transaction
+{
+    /** The I2C slave address */
+    uint8_t addr;
+    /** Priority, the pending transactions are started highest first */
+    uint8_t priority;
+
+    /** The bytes to send, if any */
+    const uint8_t *tx_buffer;
+    uint16_t tx_length;
+    /** The buffer to store the received bytes, if any */
+    uint8_t *rx_buffer;
+    uint16_t rx_length;
+
+    /** The handler called when the transaction completes, may be NULL */
+    result_handler_t handler;
+    handler_arg_t arg;
+
+    /** Set while queued or in progress, private to the driver */
+    volatile uint8_t pending;
+    /** The result, 0 if the transaction succeeded, >0 otherwise */
+    unsigned result;
+    /** Next pending transaction, private to the driver */
+    struct i2c_transaction *next;
+} i2c_transaction_t;
+
 /**
  * Enable a I2C driver
  *
@@ -79,11 +121,39 @@ void i2c_enable(i2c_t i2c, i2c_clock_mode_t mode);
  */
 void i2c_disable(i2c_t i2c);
 
+/**
+ * Submit a transaction to the queue of an I2C driver.
+ *
+ * The transaction starts immediately if the bus is free, otherwise it is
+ * started from the interrupt ending the previous one, by priority then in
+ * submission order. This may be called from interrupt context.
+ *
+ * Note: the handler of the transaction is called from interrupt context, it
+ * may submit the descriptor again.
+ *
+ * \param i2c the I2C driver to use;
+ * \param transaction the transaction to submit.
+ * \return >0 if the descriptor is already pending.
+ */
+unsigned i2c_submit(i2c_t i2c, i2c_transaction_t *transaction);
+
+/**
+ * Wait for the end of a submitted transaction.
+ * Blocking call.
+ *
+ * \param transaction the submitted transaction.
+ * \return 0 if the transaction succeeded, >0 if an error occurred.
+ */
+unsigned i2c_wait(i2c_transaction_t *transaction);
+
 /**
  * Send then receive a given amount of bytes with an I2C driver.
  * Non-blocking call if the given handler is non-NULL.
  * It is then called when the transfer is completed.
  *
+ * The transfer is queued with a normal priority if the bus is busy, the
+ * buffers must remain valid until the handler is called.
+ *
  * Note: the handler is called from interrupt context.
  *
  * \param i2c the I2C driver to use;
@@ -24,67 +24,349 @@
  *      Author: Antoine Fraboulet <antoine.fraboulet.at.hikob.com>
  */
 
+#include <pthread.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+
 #include "timer.h"
 #include "timer_.h"
 #include "printf.h"
 
-void timer_enable(timer_t timer)
+static void *timer_thread(void *arg);
+
+/** Timers and interrupt thread state, protected by the mutex */
+static pthread_mutex_t timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_cond;
+static pthread_t timer_thread_id;
+static int timer_thread_started = 0;
+
+/** Timers which may generate interrupts */
+static _timer_data_t *timers[16];
+static uint32_t timers_count = 0;
+
+static _timer_data_t *timer_data(openlab_timer_t timer)
 {
+    return ((const _openlab_timer_t *) timer)->data;
 }
 
-void timer_disable(timer_t timer)
+static uint64_t host_ns()
 {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
 }
 
-void timer_select_internal_clock(timer_t timer, uint16_t prescaler)
+/** Number of ticks elapsed since the timer start */
+static uint64_t timer_ticks(_timer_data_t *_timer, uint64_t now_ns)
 {
+    return ((unsigned __int128) (now_ns - _timer->start_ns)
+            * _timer->frequency) / 1000000000ull;
 }
 
-void timer_select_external_clock(timer_t timer, uint16_t prescaler)
+/** Host time of a given tick, rounded up */
+static uint64_t timer_tick_ns(_timer_data_t *_timer, uint64_t tick)
 {
+    return _timer->start_ns + ((unsigned __int128) tick * 1000000000ull
+            + _timer->frequency - 1) / _timer->frequency;
+}
+
+/** Compute the first match of a channel after a given tick */
+static void channel_arm(_timer_data_t *_timer,
+                        _openlab_timer_channel_t *channel, uint64_t after)
+{
+    channel->next = after - (after % _timer->period) + channel->value;
+
+    if (channel->next <= after)
+    {
+        channel->next += _timer->period;
+    }
 }
 
-void timer_start(timer_t timer, uint16_t update_value,
+static void timer_register(_timer_data_t *_timer)
+{
+    uint32_t i;
+    pthread_condattr_t attr;
+
+    if (!timer_thread_started)
+    {
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&timer_cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        pthread_create(&timer_thread_id, NULL, timer_thread, NULL);
+        timer_thread_started = 1;
+    }
+
+    for (i = 0; i < timers_count; i++)
+    {
+        if (timers[i] == _timer)
+        {
+            return;
+        }
+    }
+
+    if (timers_count < sizeof(timers) / sizeof(timers[0]))
+    {
+        timers[timers_count++] = _timer;
+    }
+}
+
+void timer_enable(openlab_timer_t timer)
+{
+    _timer_data_t *_timer = timer_data(timer);
+
+    pthread_mutex_lock(&timer_mutex);
+    _timer->started = 0;
+    _timer->frequency = NATIVE_TIMER_INTERNAL_CLOCK;
+    _timer->period = 0x10000;
+    _timer->update_handler = NULL;
+    timer_register(_timer);
+    pthread_mutex_unlock(&timer_mutex);
+}
+
+void timer_disable(openlab_timer_t timer)
+{
+    timer_stop(timer);
+}
+
+void timer_select_internal_clock(openlab_timer_t timer, uint16_t prescaler)
+{
+    timer_data(timer)->frequency = NATIVE_TIMER_INTERNAL_CLOCK
+            / (prescaler + 1);
+}
+
+void timer_select_external_clock(openlab_timer_t timer, uint16_t prescaler)
+{
+    timer_data(timer)->frequency = NATIVE_TIMER_EXTERNAL_CLOCK
+            / (prescaler + 1);
+}
+
+void timer_start(openlab_timer_t timer, uint16_t update_value,
                  timer_handler_t update_handler, handler_arg_t update_arg)
 {
+    _timer_data_t *_timer = timer_data(timer);
+    uint32_t i;
+
+    pthread_mutex_lock(&timer_mutex);
+    timer_register(_timer);
+
+    _timer->period = (uint32_t) update_value + 1;
+    _timer->start_ns = host_ns();
+    _timer->updates = 0;
+    _timer->update_handler = update_handler;
+    _timer->update_handler_arg = update_arg;
+
+    for (i = 0; i < NATIVE_TIMER_CHANNELS; i++)
+    {
+        channel_arm(_timer, &_timer->channels[i], 0);
+    }
+
+    _timer->started = 1;
+    pthread_cond_signal(&timer_cond);
+    pthread_mutex_unlock(&timer_mutex);
+}
+
+void timer_stop(openlab_timer_t timer)
+{
+    pthread_mutex_lock(&timer_mutex);
+    timer_data(timer)->started = 0;
+    pthread_mutex_unlock(&timer_mutex);
 }
 
-void timer_stop(timer_t timer)
+uint16_t timer_time(openlab_timer_t timer)
 {
+    _timer_data_t *_timer = timer_data(timer);
+
+    if (!_timer->started)
+    {
+        return 0;
+    }
+
+    return timer_ticks(_timer, host_ns()) % _timer->period;
 }
 
-uint16_t timer_time(timer_t timer)
+void timer_tick_update(openlab_timer_t timer, int16_t dt)
 {
-    return 0;
+    _timer_data_t *_timer = timer_data(timer);
+
+    // Move the counter start, the pending matches follow
+    pthread_mutex_lock(&timer_mutex);
+    _timer->start_ns -= (int64_t) dt * 1000000000ll / _timer->frequency;
+    pthread_cond_signal(&timer_cond);
+    pthread_mutex_unlock(&timer_mutex);
 }
 
-uint32_t timer_get_frequency(timer_t timer)
+uint32_t timer_get_frequency(openlab_timer_t timer)
 {
-    return 0;
+    return timer_data(timer)->frequency;
 }
 
-uint16_t timer_get_number_of_channels(timer_t timer)
+uint16_t timer_get_number_of_channels(openlab_timer_t timer)
 {
-    return 0;
+    return NATIVE_TIMER_CHANNELS;
 }
 
-void timer_set_channel_compare(timer_t timer, timer_channel_t channel,
+void timer_set_channel_compare(openlab_timer_t timer, timer_channel_t channel,
                                uint16_t compare_value, timer_handler_t handler, handler_arg_t arg)
 {
+    _timer_data_t *_timer = timer_data(timer);
+    _openlab_timer_channel_t *ch = &_timer->channels[channel];
+
+    pthread_mutex_lock(&timer_mutex);
+    ch->handler = handler;
+    ch->handler_arg = arg;
+    pthread_mutex_unlock(&timer_mutex);
+
+    timer_update_channel_compare(timer, channel, compare_value);
 }
 
-void timer_update_channel_compare(timer_t timer, timer_channel_t channel,
+void timer_update_channel_compare(openlab_timer_t timer, timer_channel_t channel,
                                   uint16_t value)
 {
+    _timer_data_t *_timer = timer_data(timer);
+    _openlab_timer_channel_t *ch = &_timer->channels[channel];
+
+    // Matches when the counter reaches the value, from now on
+    pthread_mutex_lock(&timer_mutex);
+    ch->value = value;
+
+    if (_timer->started)
+    {
+        channel_arm(_timer, ch, timer_ticks(_timer, host_ns()));
+        pthread_cond_signal(&timer_cond);
+    }
+
+    pthread_mutex_unlock(&timer_mutex);
 }
 
-void timer_set_channel_capture(timer_t timer, timer_channel_t channel,
+void timer_set_channel_capture(openlab_timer_t timer, timer_channel_t channel,
                                timer_capture_edge_t signal_edge, timer_handler_t handler,
                                handler_arg_t arg)
 {
 }
 
-void timer_handle_interrupt(_timer_t *_timer)
+uint32_t timer_get_update_flag(openlab_timer_t timer)
 {
+    _timer_data_t *_timer = timer_data(timer);
+
+    // Set if the counter overflowed and the interrupt was not generated yet
+    return _timer->started && (timer_ticks(_timer, host_ns()) / _timer->period
+                               > _timer->updates);
 }
 
+typedef struct
+{
+    /** The timer for an update, NULL for a compare match */
+    _timer_data_t *update;
+    timer_handler_t handler;
+    handler_arg_t arg;
+    uint16_t value;
+} timer_event_t;
+
+static void timer_interrupt(void *arg)
+{
+    timer_event_t *event = arg;
+
+    // The update flag is cleared by the interrupt
+    if (event->update)
+    {
+        pthread_mutex_lock(&timer_mutex);
+        event->update->updates++;
+        pthread_mutex_unlock(&timer_mutex);
+    }
+
+    if (event->handler)
+    {
+        event->handler(event->arg, event->value);
+    }
+}
+
+static void *timer_thread(void *arg)
+{
+    pthread_mutex_lock(&timer_mutex);
+
+    while (1)
+    {
+        _timer_data_t *next_timer = NULL;
+        _openlab_timer_channel_t *next_channel = NULL;
+        uint64_t next_ns = UINT64_MAX;
+        uint32_t i, c;
+
+        // Find the next update or compare match
+        for (i = 0; i < timers_count; i++)
+        {
+            _timer_data_t *_timer = timers[i];
+            uint64_t t;
+
+            if (!_timer->started)
+            {
+                continue;
+            }
+
+            t = timer_tick_ns(_timer, (_timer->updates + 1) * _timer->period);
+            if (t < next_ns)
+            {
+                next_ns = t;
+                next_timer = _timer;
+                next_channel = NULL;
+            }
+
+            for (c = 0; c < NATIVE_TIMER_CHANNELS; c++)
+            {
+                if (_timer->channels[c].handler == NULL)
+                {
+                    continue;
+                }
+
+                t = timer_tick_ns(_timer, _timer->channels[c].next);
+                if (t < next_ns)
+                {
+                    next_ns = t;
+                    next_timer = _timer;
+                    next_channel = &_timer->channels[c];
+                }
+            }
+        }
+
+        if (next_timer == NULL)
+        {
+            pthread_cond_wait(&timer_cond, &timer_mutex);
+            continue;
+        }
+
+        if (host_ns() < next_ns)
+        {
+            struct timespec ts =
+            { next_ns / 1000000000ull, next_ns % 1000000000ull };
+            pthread_cond_timedwait(&timer_cond, &timer_mutex, &ts);
+            continue;
+        }
+
+        // Generate the interrupt, without holding the mutex
+        timer_event_t event;
+
+        if (next_channel)
+        {
+            next_channel->next += next_timer->period;
+            event.update = NULL;
+            event.handler = next_channel->handler;
+            event.arg = next_channel->handler_arg;
+            event.value = next_channel->value;
+        }
+        else
+        {
+            event.update = next_timer;
+            event.handler = next_timer->update_handler;
+            event.arg = next_timer->update_handler_arg;
+            event.value = 0;
+        }
+
+        pthread_mutex_unlock(&timer_mutex);
+        vPortNativeInterrupt(timer_interrupt, &event);
+        pthread_mutex_lock(&timer_mutex);
+    }
+
+    return NULL;
+}
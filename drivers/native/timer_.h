@@ -32,63 +32,53 @@
 
 #include "timer.h"
 
+/** Number of compare channels of the native timers */
+#define NATIVE_TIMER_CHANNELS 4
+/** Frequency of the internal clock, before the prescaler */
+#define NATIVE_TIMER_INTERNAL_CLOCK 72000000
+/** Frequency of the external clock, before the prescaler */
+#define NATIVE_TIMER_EXTERNAL_CLOCK 32768
+
 typedef struct
 {
-#if 0
-    // Base Address of the timer
-    uint32_t base_address;
-    // APB bus number
-    rcc_apb_bus_t apb_bus;
-    // APB bit
-    rcc_apb_bit_t apb_bit;
-    // IRQ line in the NVIC
-    nvic_irq_line_t irq_line;
+    /** Compare value, and absolute tick of the next match */
+    uint16_t value;
+    uint64_t next;
 
-    // The estimated frequency
-    uint32_t frequency;
+    timer_handler_t handler;
+    handler_arg_t handler_arg;
+} _openlab_timer_channel_t;
 
-    uint8_t number_of_channels;
+/**
+ * The native timers count host time, the counter value is derived from the
+ * monotonic clock, and a single host thread generates their interrupts.
+ */
+typedef struct
+{
+    uint32_t frequency;
+    /** Running, and counter period (update value + 1) */
+    uint32_t started;
+    uint32_t period;
+    /** Host time of the counter start, in ns */
+    uint64_t start_ns;
+    /** Number of update interrupts generated */
+    uint64_t updates;
 
     timer_handler_t update_handler;
     handler_arg_t update_handler_arg;
 
-    timer_handler_t *channel_handlers;
-    handler_arg_t *channel_handler_args;
-#endif
-} _timer_t;
-
-#if 0
-static inline void timer_init(_timer_t *timer, uint32_t base_address, rcc_apb_bus_t apb_bus, rcc_apb_bit_t apb_bit, nvic_irq_line_t irq_line, uint8_t number_of_channels, timer_handler_t *channel_handlers, handler_arg_t *channel_handler_args)
-{
-    timer->base_address = base_address;
-
-    timer->apb_bus = apb_bus;
-    timer->apb_bit = apb_bit;
-    timer->irq_line = irq_line;
-
-    timer->number_of_channels = number_of_channels;
-
-    timer->channel_handlers = channel_handlers;
-    timer->channel_handler_args = channel_handler_args;
-}
-#endif
+    _openlab_timer_channel_t channels[NATIVE_TIMER_CHANNELS];
+} _timer_data_t;
 
-#if 0
-static inline void timer_init_basic(_timer_t *timer, uint32_t base_address, rcc_apb_bus_t apb_bus, rcc_apb_bit_t apb_bit, nvic_irq_line_t irq_line)
+typedef struct
 {
-    // Initialize the timer with zero channel
-    timer_init(timer, base_address, apb_bus, apb_bit, irq_line, 0, NULL, NULL);
-}
-#endif
+    _timer_data_t *data;
+} _openlab_timer_t;
 
-#if 0
-static inline void timer_init_general(_timer_t *timer, uint32_t base_address, rcc_apb_bus_t apb_bus, rcc_apb_bit_t apb_bit, nvic_irq_line_t irq_line, timer_handler_t *channel_handlers, handler_arg_t *channel_handler_args)
-{
-    // Initialize the timer with four channels
-    timer_init(timer, base_address, apb_bus, apb_bit, irq_line, 4, channel_handlers, channel_handler_args);
+#define TIMER_INIT(name) \
+    static _timer_data_t name##_data; \
+    const _openlab_timer_t name = { \
+    .data = &name##_data \
 }
-#endif
-
-void timer_handle_interrupt(_timer_t *timer);
 
 #endif /* TIMER__H_ */
@@ -0,0 +1,333 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * uart.c
+ *
+ * The received bytes are read by a host thread and given to the RX handler
+ * from a native interrupt. Asynchronous transfers are written by another
+ * thread, which waits for the time the bytes take on the line before calling
+ * the TX handler, so that a pseudo-terminal has the throughput of a real
+ * UART at the same baudrate (10 bits per byte).
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+
+#include "uart.h"
+#include "uart_.h"
+#include "debug.h"
+
+static void *rx_thread(void *arg);
+static void *tx_thread(void *arg);
+
+static uint64_t host_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void write_all(int fd, const uint8_t *buffer, uint16_t length)
+{
+    while (length)
+    {
+        ssize_t n = write(fd, buffer, length);
+
+        if (n <= 0)
+        {
+            return;
+        }
+
+        buffer += n;
+        length -= n;
+    }
+}
+
+/** Wait until the bytes written from start_ns are out on the line */
+static void line_delay(_uart_data_t *data, uint64_t start_ns, uint16_t length)
+{
+    if (data->mode != UART_NATIVE_PTY || data->baudrate == 0)
+    {
+        return;
+    }
+
+    uint64_t end_ns = start_ns
+                      + (uint64_t) length * 10 * 1000000000ull / data->baudrate;
+    struct timespec ts =
+    { end_ns / 1000000000ull, end_ns % 1000000000ull };
+
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static int open_pty(const _uart_t *_uart)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    int slave;
+    struct termios tio;
+
+    if (fd < 0 || grantpt(fd) || unlockpt(fd))
+    {
+        log_error("Failed to open a pseudo-terminal");
+        return -1;
+    }
+
+    /*
+     * Set the raw mode, and keep the slave side open so that the master
+     * does not see a hang-up when the client closes it.
+     */
+    slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+    if (slave >= 0 && tcgetattr(slave, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+    }
+
+    const char *link = _uart->link_env ? getenv(_uart->link_env) : NULL;
+    if (link)
+    {
+        unlink(link);
+        if (symlink(ptsname(fd), link))
+        {
+            log_error("Failed to link %s to %s", link, ptsname(fd));
+        }
+    }
+
+    log_printf("UART on %s%s%s\n", ptsname(fd), link ? " linked as " : "",
+               link ? link : "");
+    return fd;
+}
+
+void uart_enable(uart_t uart, uint32_t baudrate)
+{
+    const _uart_t *_uart = uart;
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    _uart->data->baudrate = baudrate;
+    _uart->data->mode = _uart->mode;
+
+    // Keep the same terminal when enabled again
+    if (_uart->data->fd_in >= 0)
+    {
+        return;
+    }
+
+    if (_uart->mode == UART_NATIVE_PTY)
+    {
+        _uart->data->fd_in = _uart->data->fd_out = open_pty(_uart);
+
+        if (_uart->data->fd_in < 0)
+        {
+            return;
+        }
+    }
+    else
+    {
+        _uart->data->fd_in = STDIN_FILENO;
+        _uart->data->fd_out = STDOUT_FILENO;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_create(&thread, &attr, rx_thread, _uart->data);
+    pthread_create(&thread, &attr, tx_thread, _uart->data);
+    pthread_attr_destroy(&attr);
+}
+
+uint32_t uart_get_max_baudrate(uart_t uart)
+{
+    // As a UART on the 72MHz APB2 bus of the STM32F1
+    return 4500000;
+}
+
+void uart_disable(uart_t uart)
+{
+}
+
+void uart_set_rx_handler(uart_t uart, uart_handler_t handler, handler_arg_t arg)
+{
+    const _uart_t *_uart = uart;
+
+    _uart->data->rx_handler = handler;
+    _uart->data->rx_handler_arg = arg;
+}
+
+void uart_set_irq_priority(uart_t uart, uint8_t priority)
+{
+}
+
+void uart_transfer(uart_t uart, const uint8_t *tx_buffer, uint16_t length)
+{
+    const _uart_t *_uart = uart;
+    uint64_t start_ns = host_ns();
+
+    if (_uart->data->fd_out < 0)
+    {
+        return;
+    }
+
+    write_all(_uart->data->fd_out, tx_buffer, length);
+    line_delay(_uart->data, start_ns, length);
+}
+
+void uart_transfer_async(uart_t uart, const uint8_t *tx_buffer, uint16_t length,
+                         handler_t handler, handler_arg_t handler_arg)
+{
+    const _uart_t *_uart = uart;
+
+    pthread_mutex_lock(&_uart->data->tx_mutex);
+    _uart->data->tx_length = length;
+    _uart->data->tx_handler = handler;
+    _uart->data->tx_handler_arg = handler_arg;
+    _uart->data->tx_buffer = tx_buffer;
+    pthread_cond_broadcast(&_uart->data->tx_cond);
+    pthread_mutex_unlock(&_uart->data->tx_mutex);
+}
+
+void uart_transfer_async_finish(uart_t uart)
+{
+    const _uart_t *_uart = uart;
+
+    // Wait for the TX thread to write the transfer, without its handler
+    pthread_mutex_lock(&_uart->data->tx_mutex);
+    _uart->data->tx_handler = NULL;
+
+    while (_uart->data->tx_buffer != NULL)
+    {
+        pthread_cond_wait(&_uart->data->tx_cond, &_uart->data->tx_mutex);
+    }
+
+    pthread_mutex_unlock(&_uart->data->tx_mutex);
+}
+
+typedef struct
+{
+    _uart_data_t *data;
+    uint8_t buffer[64];
+    uint16_t length;
+} rx_chunk_t;
+
+static void rx_interrupt(void *arg)
+{
+    rx_chunk_t *chunk = arg;
+    _uart_data_t *data = chunk->data;
+    uint16_t i;
+
+    for (i = 0; i < chunk->length; i++)
+    {
+        if (data->rx_handler)
+        {
+            data->rx_handler(data->rx_handler_arg, chunk->buffer[i]);
+        }
+    }
+}
+
+static void *rx_thread(void *arg)
+{
+    rx_chunk_t chunk =
+    { .data = arg };
+
+    while (1)
+    {
+        ssize_t n = read(chunk.data->fd_in, chunk.buffer,
+                         sizeof(chunk.buffer));
+
+        if (n == 0 && chunk.data->mode == UART_NATIVE_STDIO)
+        {
+            // End of the standard input
+            return NULL;
+        }
+
+        if (n <= 0)
+        {
+            struct timespec ts =
+            { 0, 10000000 };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        chunk.length = n;
+        vPortNativeInterrupt(rx_interrupt, &chunk);
+    }
+
+    return NULL;
+}
+
+typedef struct
+{
+    handler_t handler;
+    handler_arg_t arg;
+} tx_done_t;
+
+static void tx_interrupt(void *arg)
+{
+    tx_done_t *done = arg;
+
+    if (done->handler)
+    {
+        done->handler(done->arg);
+    }
+}
+
+static void *tx_thread(void *arg)
+{
+    _uart_data_t *data = arg;
+
+    pthread_mutex_lock(&data->tx_mutex);
+
+    while (1)
+    {
+        while (data->tx_buffer == NULL)
+        {
+            pthread_cond_wait(&data->tx_cond, &data->tx_mutex);
+        }
+
+        const uint8_t *buffer = data->tx_buffer;
+        uint16_t length = data->tx_length;
+        tx_done_t done;
+        pthread_mutex_unlock(&data->tx_mutex);
+
+        uint64_t start_ns = host_ns();
+        write_all(data->fd_out, buffer, length);
+        line_delay(data, start_ns, length);
+
+        // Ready for the next transfer, which may be started by the handler
+        // The handler is read now, uart_transfer_async_finish may clear it
+        pthread_mutex_lock(&data->tx_mutex);
+        done.handler = data->tx_handler;
+        done.arg = data->tx_handler_arg;
+        data->tx_buffer = NULL;
+        pthread_cond_broadcast(&data->tx_cond);
+        pthread_mutex_unlock(&data->tx_mutex);
+
+        vPortNativeInterrupt(tx_interrupt, &done);
+
+        pthread_mutex_lock(&data->tx_mutex);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * uart_.h
+ *
+ * Native UART, on the standard input/output or on a pseudo-terminal.
+ */
+
+#ifndef UART__H_
+#define UART__H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "uart.h"
+#include "handler.h"
+
+typedef enum
+{
+    /** Standard input and output, no baudrate emulation */
+    UART_NATIVE_STDIO = 0,
+    /** Pseudo-terminal, the baudrate limits the TX throughput */
+    UART_NATIVE_PTY = 1,
+} uart_native_mode_t;
+
+typedef struct
+{
+    /** File descriptors, -1 until enabled */
+    int fd_in, fd_out;
+    uart_native_mode_t mode;
+    uint32_t baudrate;
+
+    uart_handler_t rx_handler;
+    handler_arg_t rx_handler_arg;
+
+    /** Asynchronous transfer, handed over to the TX thread */
+    pthread_mutex_t tx_mutex;
+    pthread_cond_t tx_cond;
+    const uint8_t *tx_buffer;
+    uint16_t tx_length;
+    handler_t tx_handler;
+    handler_arg_t tx_handler_arg;
+} _uart_data_t;
+
+typedef struct
+{
+    uart_native_mode_t mode;
+    /** Environment variable naming a symbolic link to the pseudo-terminal */
+    const char *link_env;
+
+    _uart_data_t *data;
+} _uart_t;
+
+#define UART_INIT(name, mode_, env) \
+    static _uart_data_t name##_data = { \
+    .fd_in = -1, .fd_out = -1, \
+    .tx_mutex = PTHREAD_MUTEX_INITIALIZER, \
+    .tx_cond = PTHREAD_COND_INITIALIZER \
+    }; \
+    const _uart_t name = { \
+    .mode = mode_, \
+    .link_env = env, \
+    .data = &name##_data \
+}
+
+#endif /* UART__H_ */
@@ -110,6 +110,28 @@ void nvic_enable_systick(uint32_t frequency, handler_t handler,
  */
 void nvic_disable_systick();
 
+/**
+ * Stretch the period of the Cortex-M3 SysTick timer, for tickless idle.
+ *
+ * The current period is kept and the next interrupt is delayed by a number
+ * of periods, limited by the 24bit counter. The interrupts should be masked
+ * until the call to \ref nvic_restore_systick.
+ *
+ * \param periods the number of periods until the next interrupt
+ * \return the number of periods actually delayed
+ */
+uint32_t nvic_stretch_systick(uint32_t periods);
+
+/**
+ * Restore the periodic SysTick interrupt after \ref nvic_stretch_systick.
+ *
+ * The phase of the periods is kept.
+ *
+ * \return the number of periods ended during the stretched one, the one
+ * ending with a pending interrupt excluded
+ */
+uint32_t nvic_restore_systick();
+
 /**
  * @}
  */
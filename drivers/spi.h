@@ -41,6 +41,7 @@
  */
 
 #include "handler.h"
+#include "gpio.h"
 
 /**
  * Abstract representation of a SPI driver.
@@ -132,6 +133,101 @@ void spi_transfer_async(spi_t spi, const uint8_t *tx_buffer,
  */
 void spi_async_cancel(spi_t spi);
 
+/**
+ * Priorities of the SPI devices, see \ref spi_device_t.
+ */
+enum
+{
+    SPI_PRIORITY_LOW = 0,
+    SPI_PRIORITY_NORMAL = 1,
+    SPI_PRIORITY_HIGH = 2,
+};
+
+/**
+ * A slave device on a SPI bus, for the SPI transactions.
+ *
+ * The driver selects the device during its transactions, and sets the
+ * clock of the bus as the device requires.
+ */
+typedef struct
+{
+    /** The SPI driver of the bus */
+    spi_t spi;
+    /** The chip select pin, active low */
+    gpio_t cs_gpio;
+    gpio_pin_t cs_pin;
+    /** The clock mode of the device */
+    spi_clock_mode_t clock_mode;
+    /** The baudrate of the device, 0 to keep the setting of spi_enable */
+    uint32_t baudrate;
+    /** Priority, the pending transactions are started highest first */
+    uint8_t priority;
+} spi_device_t;
+
+/**
+ * Descriptor of a SPI transaction with a device.
+ *
+ * The device is selected for the command then the data phase, at least
+ * one of them must not be empty. The descriptor and the buffers must
+ * remain valid until the end of the transaction.
+ */
+typedef struct spi_transaction
+{
+    /** The device */
+    const spi_device_t *device;
+
+    /** The command bytes, sent first, the bytes received are discarded */
+    const uint8_t *cmd;
+    uint16_t cmd_length;
+
+    /** The data phase, as in \ref spi_transfer_async */
+    const uint8_t *tx_buffer;
+    uint8_t *rx_buffer;
+    uint16_t length;
+
+    /** The handler called when the transaction completes, may be NULL */
+    handler_t handler;
+    handler_arg_t arg;
+
+    /** Set while queued or in progress, private to the driver */
+    volatile uint8_t pending;
+    /** Next pending transaction, private to the driver */
+    struct spi_transaction *next;
+} spi_transaction_t;
+
+/**
+ * Configure the chip select pin of a device, the device being unselected.
+ *
+ * \param device the device
+ */
+void spi_device_init(const spi_device_t *device);
+
+/**
+ * Submit a transaction to the queue of its SPI bus.
+ *
+ * The transaction starts immediately if the bus is free, otherwise it is
+ * started from the interrupt ending the previous one, by device priority
+ * then in submission order. This may be called from interrupt context.
+ *
+ * The devices sharing a bus with transactions must not use the other
+ * transfer functions, whose chip select is not arbitrated.
+ *
+ * Note: the handler is called from interrupt context, it may submit the
+ * descriptor again.
+ *
+ * \param transaction the transaction to submit
+ * \return >0 if the descriptor is already pending
+ */
+unsigned spi_submit(spi_transaction_t *transaction);
+
+/**
+ * Wait for the end of a submitted transaction.
+ * Blocking call.
+ *
+ * \param transaction the submitted transaction
+ */
+void spi_wait(spi_transaction_t *transaction);
+
 /**
  * @}
  * @}
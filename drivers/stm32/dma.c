@@ -64,6 +64,7 @@ void dma_config(dma_t dma, uint32_t peripheral_address,
 
     // Disable the DMA channel and clear all flags
     *dma_get_CCRx(_dma) = 0;
+    _dma->data->next_number = 0;
     *dma_get_IFCR(_dma) = (DMA_IFCR__CGIFx | DMA_IFCR__CTCIFx
                            | DMA_IFCR__CHTIFx | DMA_IFCR__CTEIFx) << (DMA_IFCR__CHANNEL_OFFSET
                                    * _dma->channel);
@@ -91,6 +92,7 @@ void dma_start(dma_t dma, handler_t handler, handler_arg_t handler_arg)
     // Store the handlers
     _dma->data->handler = handler;
     _dma->data->handler_arg = handler_arg;
+    _dma->data->half_handler = NULL;
 
     // Enable the transfer complete interrupt
     *dma_get_CCRx(_dma) |= DMA_CCR__TCIE;
@@ -99,6 +101,52 @@ void dma_start(dma_t dma, handler_t handler, handler_arg_t handler_arg)
     *dma_get_CCRx(_dma) |= DMA_CCR__EN;
 }
 
+void dma_start_circular(dma_t dma, handler_t half_handler,
+                        handler_t full_handler, handler_arg_t handler_arg)
+{
+    const _dma_t *_dma = dma;
+
+    // Store the handlers
+    _dma->data->handler = full_handler;
+    _dma->data->handler_arg = handler_arg;
+    _dma->data->half_handler = half_handler;
+
+    // Enable the circular mode and the interrupts of the handlers set
+    uint32_t ccr = *dma_get_CCRx(_dma) | DMA_CCR__CIRC;
+
+    if (half_handler)
+    {
+        ccr |= DMA_CCR__HTIE;
+    }
+
+    if (full_handler)
+    {
+        ccr |= DMA_CCR__TCIE;
+    }
+
+    *dma_get_CCRx(_dma) = ccr;
+
+    // Set the EN bit to start the channel
+    *dma_get_CCRx(_dma) |= DMA_CCR__EN;
+}
+
+uint16_t dma_get_remaining(dma_t dma)
+{
+    const _dma_t *_dma = dma;
+
+    return *dma_get_CNDTRx(_dma);
+}
+
+void dma_chain(dma_t dma, uint32_t memory_address, uint16_t transfer_number)
+{
+    const _dma_t *_dma = dma;
+
+    platform_enter_critical();
+    _dma->data->next_address = memory_address;
+    _dma->data->next_number = transfer_number;
+    platform_exit_critical();
+}
+
 int32_t dma_cancel(dma_t dma)
 {
     const _dma_t *_dma = dma;
@@ -114,8 +162,9 @@ int32_t dma_cancel(dma_t dma)
         canceled = 1;
     }
 
-    // Clear the CCR to stop the channel
+    // Clear the CCR to stop the channel, and the chained transfer
     *dma_get_CCRx(_dma) = 0;
+    _dma->data->next_number = 0;
     // Clear the interrupt flags
     *dma_get_IFCR(_dma) = (DMA_IFCR__CGIFx | DMA_IFCR__CHTIFx
                            | DMA_IFCR__CTCIFx | DMA_IFCR__CTEIFx) << (_dma->channel
@@ -128,20 +177,60 @@ int32_t dma_cancel(dma_t dma)
 
 void dma_handle_interrupt(const _dma_t *_dma)
 {
-    uint32_t isr;
+    uint32_t isr, ccr;
 
-    isr = *dma_get_ISR(_dma);
+    // Get the flags of this channel, for the enabled interrupts only
+    isr = (*dma_get_ISR(_dma) >> (_dma->channel * DMA_ISR__CHANNEL_OFFSET))
+          & (DMA_ISR__TCIFx | DMA_ISR__HTIFx);
+    ccr = *dma_get_CCRx(_dma);
 
-    // Check if the transfer complete interrupt flag is set for this channel
-    if (isr & (DMA_ISR__TCIFx << (_dma->channel * DMA_ISR__CHANNEL_OFFSET)))
+    if (!(ccr & DMA_CCR__HTIE))
+    {
+        isr &= ~DMA_ISR__HTIFx;
+    }
+
+    if (isr == 0)
+    {
+        return;
+    }
+
+    if (ccr & DMA_CCR__CIRC)
+    {
+        // Clear the flags handled only, the other half may already be done
+        // (CGIF would clear them all)
+        *dma_get_IFCR(_dma) = isr << (_dma->channel * DMA_IFCR__CHANNEL_OFFSET);
+    }
+    else
     {
         // Clear the interrupt flags
         *dma_get_IFCR(_dma) = (DMA_IFCR__CGIFx | DMA_IFCR__CHTIFx
                                | DMA_IFCR__CTCIFx | DMA_IFCR__CTEIFx) << (_dma->channel
                                        * DMA_IFCR__CHANNEL_OFFSET);
+    }
 
-        // Disable the DMA channel
-        *dma_get_CCRx(_dma) &= ~DMA_CCR__EN;
+    // Check if the half transfer interrupt flag is set for this channel
+    if ((isr & DMA_ISR__HTIFx) && _dma->data->half_handler)
+    {
+        _dma->data->half_handler(_dma->data->handler_arg);
+    }
+
+    // Check if the transfer complete interrupt flag is set for this channel
+    if (isr & DMA_ISR__TCIFx)
+    {
+        if (!(ccr & DMA_CCR__CIRC))
+        {
+            // Disable the DMA channel
+            *dma_get_CCRx(_dma) &= ~DMA_CCR__EN;
+
+            // Restart at once on the chained buffer, if any
+            if (_dma->data->next_number)
+            {
+                *dma_get_CMARx(_dma) = _dma->data->next_address;
+                *dma_get_CNDTRx(_dma) = _dma->data->next_number;
+                _dma->data->next_number = 0;
+                *dma_get_CCRx(_dma) |= DMA_CCR__EN;
+            }
+        }
 
         // Call the handler if any
         if (_dma->data->handler)
@@ -67,6 +67,13 @@ typedef struct
     // The handler for transfer done
     handler_t handler;
     handler_arg_t handler_arg;
+
+    // The handler for the half transfer, in circular mode
+    handler_t half_handler;
+
+    // The transfer to start after the current one, if transfer_number is set
+    uint32_t next_address;
+    uint16_t next_number;
 } _dma_data_t;
 
 typedef struct
@@ -25,6 +25,7 @@
  *      Author: Damien Hedde        <damien.hedde.at.hikob.com>
  */
 
+#include "platform.h"
 #include "rcc.h"
 #include "gpio.h"
 #include "i2c.h"
@@ -76,12 +77,17 @@ struct i2c_dbg_struct * volatile i2c_dbg_struct = NULL;
 #define I2C_DEBUG_LOG(a,b,c)
 #endif
 
-static void tx_rx_start(const _i2c_t *_i2c, uint8_t addr, const uint8_t *tx_buffer,
-                   uint16_t tx_length, uint8_t *rx_buffer, uint16_t rx_length,
-                   result_handler_t handler, handler_arg_t arg);
+/** Longest wait for the STOP of the previous transfer, in polling loops */
+#define I2C_STOP_TIMEOUT 1000
+
+static void tx_rx_run(const _i2c_t *_i2c, i2c_transaction_t *transaction);
+static unsigned tx_rx_start(const _i2c_t *_i2c, i2c_transaction_t *transaction);
 static void tx_rx_end(const _i2c_t *_i2c, i2c_state_t state);
-static uint32_t tx_rx_wait(const _i2c_t *_i2c);
+static void tx_rx_complete(const _i2c_t *_i2c, i2c_transaction_t *done,
+                           unsigned result);
 static void test_ready(const _i2c_t *_i2c);
+static void tx_dma_start(const _i2c_t *_i2c);
+static void rx_dma_start(const _i2c_t *_i2c);
 
 void i2c_enable(i2c_t i2c, i2c_clock_mode_t mode)
 {
@@ -163,7 +169,8 @@ void i2c_enable(i2c_t i2c, i2c_clock_mode_t mode)
     _i2c->data->len_recv = 0;
     _i2c->data->cpt_send = 0;
     _i2c->data->cpt_recv = 0;
-    _i2c->data->transfer_handler = NULL;
+    _i2c->data->current = NULL;
+    _i2c->data->queue = NULL;
 
     // Enable I2C EV and ERR interrupt line in the NVIC
     nvic_enable_interrupt_line(_i2c->irq_line_ev);
@@ -184,23 +191,115 @@ void i2c_disable(i2c_t i2c)
     *i2c_get_CR2(_i2c) = 0;
 }
 
+unsigned i2c_submit(i2c_t i2c, i2c_transaction_t *transaction)
+{
+    const _i2c_t *_i2c = i2c;
+    _i2c_data_t *const data = _i2c->data;
+    i2c_transaction_t **next;
+    unsigned start = 0;
+
+    platform_enter_critical();
+
+    if (transaction->pending)
+    {
+        platform_exit_critical();
+        log_error("I2C transaction already pending");
+        return 1;
+    }
+    transaction->pending = 1;
+
+    if (data->current == NULL)
+    {
+        // The bus is free, take it and start now
+        data->current = transaction;
+        start = 1;
+    }
+    else
+    {
+        // Insert after the pending ones of the same or higher priority
+        for (next = &data->queue; *next
+                && (*next)->priority >= transaction->priority;
+                next = &(*next)->next)
+        {
+        }
+
+        transaction->next = *next;
+        *next = transaction;
+    }
+
+    platform_exit_critical();
+
+    if (start)
+    {
+        tx_rx_run(_i2c, transaction);
+    }
+
+    return 0;
+}
+
+unsigned i2c_wait(i2c_transaction_t *transaction)
+{
+    while (transaction->pending)
+    {
+    }
+
+    return transaction->result;
+}
+
 unsigned i2c_tx_rx_async(i2c_t i2c, uint8_t addr, const uint8_t *tx_buffer,
                    uint16_t tx_length, uint8_t *rx_buffer, uint16_t rx_length,
                    result_handler_t handler, handler_arg_t arg)
 {
     const _i2c_t *_i2c = i2c;
-    uint32_t res = 0;
+    i2c_transaction_t sync, *transaction = &sync;
+    uint32_t i;
 
-    // Start the transfer
-    tx_rx_start(_i2c, addr, tx_buffer, tx_length, rx_buffer, rx_length, handler, arg);
+    if (handler)
+    {
+        // Take a free descriptor, the caller does not provide one
+        transaction = NULL;
+
+        platform_enter_critical();
+        for (i = 0; i < I2C_ASYNC_TRANSACTIONS; i++)
+        {
+            if (_i2c->data->async[i].handler == NULL)
+            {
+                transaction = &_i2c->data->async[i];
+                transaction->handler = handler;
+                break;
+            }
+        }
+        platform_exit_critical();
+
+        if (transaction == NULL)
+        {
+            log_error("Too many I2C transfers pending");
+            return 1;
+        }
+    }
+
+    transaction->addr = addr;
+    transaction->priority = I2C_PRIORITY_NORMAL;
+    transaction->tx_buffer = tx_buffer;
+    transaction->tx_length = tx_length;
+    transaction->rx_buffer = rx_buffer;
+    transaction->rx_length = rx_length;
+    transaction->handler = handler;
+    transaction->arg = arg;
+    transaction->pending = 0;
+
+    if (i2c_submit(i2c, transaction))
+    {
+        return 1;
+    }
 
     // Eventually wait for the transfer to be completed
     if (handler == NULL)
     {
-        res = tx_rx_wait(_i2c);
+        return i2c_wait(transaction);
     }
 
-    return res;
+    return 0;
 }
 
 #ifdef I2C__SLAVE_SUPPORT
@@ -262,9 +361,14 @@ void i2c_handle_ev_interrupt(const _i2c_t *_i2c)
             // Send address in order to receive data
             *i2c_get_DR(_i2c) = data->address | 1;
 
-            // In the case of a 2-byte reception we need to set POS bit
-            if (data->len_recv == 2)
+            if (data->dma_recv)
+            {
+                // The DMA reads the bytes once ADDR is cleared
+                rx_dma_start(_i2c);
+            }
+            else if (data->len_recv == 2)
             {
+                // In the case of a 2-byte reception we need to set POS bit
                 *i2c_get_CR1(_i2c) |= I2C_CR1__POS;
             }
         }
@@ -272,6 +376,12 @@ void i2c_handle_ev_interrupt(const _i2c_t *_i2c)
         {
             // Send address in order to send data
             *i2c_get_DR(_i2c) = data->address;
+
+            if (data->dma_send)
+            {
+                // The DMA writes the bytes once ADDR is cleared
+                tx_dma_start(_i2c);
+            }
         }
 
         // Disable Buffer Interrupt
@@ -289,6 +399,17 @@ void i2c_handle_ev_interrupt(const _i2c_t *_i2c)
         // Master mode: Address byte has been sent.
         // The flag is cleared after reading both SR1 and SR2
 
+        if (data->len_send > 0 ? data->dma_send : data->dma_recv)
+        {
+            // Clear the flag by reading SR2, this starts the DMA requests
+            sr2 = *i2c_get_SR2(_i2c);
+
+            // Wait for the end of the DMA transfer
+            data->state = (data->len_send > 0) ? I2C_SENDING_DMA
+                          : I2C_RECEIVING_DMA;
+            return;
+        }
+
         // Send the first byte if any
         if (data->len_send > 0)
         {
@@ -306,12 +427,17 @@ void i2c_handle_ev_interrupt(const _i2c_t *_i2c)
                 // The only byte to send has already been sent so we need to issue
                 // a STOP condition if there is nothing to receive or
                 // a RESTART condition otherwise
+
+                // Indicate that there is nothing else to send
+                data->len_send = 0;
+                data->cpt_send = 0;
+
                 if (data->len_recv == 0)
                 {
                     // There is nothing to receive
                     *i2c_get_CR1(_i2c) |= I2C_CR1__STOP;
 
-                    // The transfer is complete
+                    // The transfer is complete, the next one may start
                     tx_rx_end(_i2c, I2C_IDLE);
                 }
                 else
@@ -322,10 +448,6 @@ void i2c_handle_ev_interrupt(const _i2c_t *_i2c)
                     // Wait for the new start condition to be issued
                     data->state = I2C_SENDING_RESTART;
                 }
-
-                // Indicate that there is nothing else to send
-                data->len_send = 0;
-                data->cpt_send = 0;
             }
             else
             {
@@ -578,12 +700,16 @@ void i2c_handle_ev_interrupt(const _i2c_t *_i2c)
                 // a STOP condition if there is nothing to receive or
                 // a RESTART condition otherwise
 
+                // Indicate that there is nothing else to send
+                data->len_send = 0;
+                data->cpt_send = 0;
+
                 if (data->len_recv == 0)
                 {
                     // There is nothing to receive
                     *i2c_get_CR1(_i2c) |= I2C_CR1__STOP;
 
-                    // The transfer is complete
+                    // The transfer is complete, the next one may start
                     tx_rx_end(_i2c, I2C_IDLE);
                 }
                 else
@@ -593,10 +719,6 @@ void i2c_handle_ev_interrupt(const _i2c_t *_i2c)
 
                     data->state = I2C_SENDING_RESTART;
                 }
-
-                // Indicate that there is nothing else to send
-                data->len_send = 0;
-                data->cpt_send = 0;
             }
             else
             {
@@ -737,32 +859,74 @@ void i2c_handle_er_interrupt(const _i2c_t *_i2c)
 }
 
 /*
- * Start a transfer
+ * Start the transfer owning the bus, failing it and the next ones while the
+ * bus cannot be started. Called with the interrupts enabled.
  */
-static void tx_rx_start(const _i2c_t *_i2c, uint8_t addr, const uint8_t *tx_buffer,
-                   uint16_t tx_length, uint8_t *rx_buffer, uint16_t rx_length,
-                   result_handler_t handler, handler_arg_t arg)
+static void tx_rx_run(const _i2c_t *_i2c, i2c_transaction_t *transaction)
+{
+    _i2c_data_t *const data = _i2c->data;
+    i2c_transaction_t *failed;
+
+    while (transaction && tx_rx_start(_i2c, transaction))
+    {
+        log_error("I2C STOP not cleared, transfer failed");
+
+        // Give the bus to the next pending transfer, before the handler
+        failed = transaction;
+        platform_enter_critical();
+        transaction = data->current = data->queue;
+        if (transaction)
+        {
+            data->queue = transaction->next;
+        }
+        platform_exit_critical();
+
+        tx_rx_complete(_i2c, failed, 1);
+    }
+}
+
+/*
+ * Start a transfer, once the STOP of the previous one is issued.
+ * Returns non zero if it is not within I2C_STOP_TIMEOUT.
+ */
+static unsigned tx_rx_start(const _i2c_t *_i2c, i2c_transaction_t *transaction)
 {
     _i2c_data_t *const data = _i2c->data;
+    uint32_t timeout = I2C_STOP_TIMEOUT;
+
+    // When chained, CR1 must not be written until the STOP of the previous
+    // transfer has been issued, this takes a few bit durations. The wait
+    // is done with the interrupts enabled.
+    while (*i2c_get_CR1(_i2c) & I2C_CR1__STOP)
+    {
+        if (--timeout == 0)
+        {
+            return 1;
+        }
+    }
+
+    platform_enter_critical();
 
     // Do the before-transfer test
     test_ready(_i2c);
 
-    // Save the handler
-    data->transfer_handler = handler;
-    data->transfer_handler_arg = arg;
-
     // Copy the data to send, data to read. Set the current state for the
     // I2C state machine and the issue the start condition.
-    data->address = addr;
+    data->address = transaction->addr;
 
-    data->len_send = tx_length;
+    data->len_send = transaction->tx_length;
     data->cpt_send = 0;
-    data->buf_send = tx_buffer;
+    data->buf_send = transaction->tx_buffer;
 
-    data->len_recv = rx_length;
+    data->len_recv = transaction->rx_length;
     data->cpt_recv = 0;
-    data->buf_recv = rx_buffer;
+    data->buf_recv = transaction->rx_buffer;
+
+    // Long enough phases use the DMA, if any
+    data->dma_send = data->dma_channel_tx
+                     && (data->len_send >= I2C_DMA_MIN_LENGTH);
+    data->dma_recv = data->dma_channel_rx
+                     && (data->len_recv >= I2C_DMA_MIN_LENGTH);
 
     // Ensure POS bit is cleared
     *i2c_get_CR1(_i2c) &= ~I2C_CR1__POS;
@@ -774,52 +938,144 @@ static void tx_rx_start(const _i2c_t *_i2c, uint8_t addr, const uint8_t *tx_buff
 
     // Generate START condition to initiate the transfer
     *i2c_get_CR1(_i2c) |= I2C_CR1__START;
+
+    platform_exit_critical();
+    return 0;
 }
 
 /*
- * Wait for the end of a transfer
+ * Signal the transfer is completed, and start the next pending one
  */
-static uint32_t tx_rx_wait(const _i2c_t *_i2c)
+static void tx_rx_end(const _i2c_t *_i2c, i2c_state_t state)
 {
     _i2c_data_t *const data = _i2c->data;
-    uint32_t result;
+    i2c_transaction_t *done = data->current;
 
-    while ((data->state != I2C_IDLE) && (data->state != I2C_ERROR))
+    // Stop the DMA if the transfer was aborted while using it
+    if (*i2c_get_CR2(_i2c) & I2C_CR2__DMAEN)
     {
+        *i2c_get_CR2(_i2c) &= ~(I2C_CR2__DMAEN | I2C_CR2__LAST);
+        dma_cancel(data->dma_channel_tx);
+        dma_cancel(data->dma_channel_rx);
     }
 
-    // Wait until busy is cleared
-    while (*i2c_get_SR2(_i2c) & I2C_SR2__BUSY)
+    i2c_transaction_t *next;
+
+    data->state = I2C_IDLE;
+
+    // Chain the next transfer before the handler, to keep the bus busy
+    platform_enter_critical();
+    next = data->current = data->queue;
+    if (next)
     {
+        data->queue = next->next;
     }
+    platform_exit_critical();
 
-    // Get result
-    result = (data->state != I2C_IDLE);
+    tx_rx_run(_i2c, next);
 
-    data->state = I2C_IDLE;
-    return result;
+    if (done)
+    {
+        tx_rx_complete(_i2c, done, state != I2C_IDLE);
+    }
 }
 
 /*
- * Signal the transfer is completed
+ * Release a transaction and call its handler
  */
-static void tx_rx_end(const _i2c_t *_i2c, i2c_state_t state)
+static void tx_rx_complete(const _i2c_t *_i2c, i2c_transaction_t *done,
+                           unsigned result)
 {
     _i2c_data_t *const data = _i2c->data;
+    result_handler_t hdl = done->handler;
+    handler_arg_t arg = done->arg;
+
+    // The descriptor may be reused as soon as it is not pending
+    done->result = result;
+    done->pending = 0;
 
-    if (data->transfer_handler)
+    // Release the descriptors of i2c_tx_rx_async
+    if (done >= data->async && done < data->async + I2C_ASYNC_TRANSACTIONS)
     {
-        result_handler_t hdl = data->transfer_handler;
-        data->transfer_handler = NULL;
-        data->state = I2C_IDLE;
-        hdl(data->transfer_handler_arg, (state != I2C_IDLE));
+        done->handler = NULL;
     }
-    else
+
+    if (hdl)
     {
-        data->state = state;
+        hdl(arg, result);
     }
 }
 
+/*
+ * DMA transfer complete of the send phase
+ */
+static void tx_dma_done(handler_arg_t arg)
+{
+    const _i2c_t *_i2c = arg;
+    _i2c_data_t *const data = _i2c->data;
+
+    *i2c_get_CR2(_i2c) &= ~I2C_CR2__DMAEN;
+
+    // All the bytes are written, the last one is being sent:
+    // EV8_2 is handled on BTF, as in the interrupt mode
+    data->cpt_send = data->len_send;
+    data->dma_send = 0;
+    data->state = I2C_SENDING_DATA;
+}
+
+/*
+ * DMA transfer complete of the receive phase
+ */
+static void rx_dma_done(handler_arg_t arg)
+{
+    const _i2c_t *_i2c = arg;
+    _i2c_data_t *const data = _i2c->data;
+
+    // ** EV7_1 with DMA **
+    // The last byte has been NACKed with the LAST bit, program STOP
+    *i2c_get_CR1(_i2c) |= I2C_CR1__STOP;
+    *i2c_get_CR2(_i2c) &= ~(I2C_CR2__DMAEN | I2C_CR2__LAST);
+
+    // Indicate that there is nothing else to receive
+    data->len_recv = 0;
+    data->cpt_recv = 0;
+    data->dma_recv = 0;
+
+    // The transfer is complete
+    tx_rx_end(_i2c, I2C_IDLE);
+}
+
+static void tx_dma_start(const _i2c_t *_i2c)
+{
+    _i2c_data_t *const data = _i2c->data;
+
+    dma_config(data->dma_channel_tx, (uint32_t) i2c_get_DR(_i2c),
+            (uint32_t) data->buf_send, data->len_send, DMA_SIZE_8bit,
+            DMA_DIRECTION_TO_PERIPHERAL, DMA_INCREMENT_ON);
+
+    // HACK for removing const warning
+    dma_start(data->dma_channel_tx, tx_dma_done,
+            (handler_arg_t) (uint32_t) _i2c);
+
+    *i2c_get_CR2(_i2c) |= I2C_CR2__DMAEN;
+}
+
+static void rx_dma_start(const _i2c_t *_i2c)
+{
+    _i2c_data_t *const data = _i2c->data;
+
+    dma_config(data->dma_channel_rx, (uint32_t) i2c_get_DR(_i2c),
+            (uint32_t) data->buf_recv, data->len_recv, DMA_SIZE_8bit,
+            DMA_DIRECTION_FROM_PERIPHERAL, DMA_INCREMENT_ON);
+
+    // HACK for removing const warning
+    dma_start(data->dma_channel_rx, rx_dma_done,
+            (handler_arg_t) (uint32_t) _i2c);
+
+    // NACK the last byte automatically
+    *i2c_get_CR2(_i2c) |= I2C_CR2__DMAEN | I2C_CR2__LAST;
+}
+
 static void test_ready(const _i2c_t *_i2c)
 {
     uint16_t reg;
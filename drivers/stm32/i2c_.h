@@ -33,6 +33,7 @@
 #include "rcc.h"
 #include "nvic.h"
 #include "gpio.h"
+#include "dma.h"
 #include "handler.h"
 
 #ifdef I2C__SLAVE_SUPPORT
@@ -48,12 +49,24 @@ typedef enum
     I2C_RECEIVING_DATA = 4,
     I2C_SENDING_RESTART = 5,
     I2C_ERROR = 6,
+    I2C_SENDING_DMA = 7,
+    I2C_RECEIVING_DMA = 8,
 #ifdef I2C__SLAVE_SUPPORT
     I2C_SL_TX,
     I2C_SL_RX,
 #endif
 } i2c_state_t;
 
+#ifndef I2C_DMA_MIN_LENGTH
+/** Shortest transfer phase done with the DMA, at least 2 (STM32F1 errata) */
+#define I2C_DMA_MIN_LENGTH 4
+#endif
+
+#ifndef I2C_ASYNC_TRANSACTIONS
+/** Number of asynchronous transfers pending at once with i2c_tx_rx_async */
+#define I2C_ASYNC_TRANSACTIONS 4
+#endif
+
 typedef struct
 {
     // State
@@ -68,9 +81,14 @@ typedef struct
     uint32_t len_recv;
     uint32_t cpt_recv;
     uint8_t *buf_recv;
-    // Non-blocking end-transfer handler
-    result_handler_t transfer_handler;
-    handler_arg_t transfer_handler_arg;
+    // DMA channels if any, and the phases of the transfer using them
+    dma_t dma_channel_rx, dma_channel_tx;
+    uint8_t dma_send, dma_recv;
+    // Transaction in progress, and pending ones by priority
+    i2c_transaction_t *current;
+    i2c_transaction_t *queue;
+    // Descriptors of the transfers started with i2c_tx_rx_async
+    i2c_transaction_t async[I2C_ASYNC_TRANSACTIONS];
 #ifdef I2C__SLAVE_SUPPORT
     i2c_slave_handler_t slave_handler;
 #endif
@@ -96,6 +114,23 @@ typedef struct
     .data = &name##_data \
 }
 
+/**
+ * Set the DMA channels of an I2C, for the master transfers.
+ *
+ * The phases of at least I2C_DMA_MIN_LENGTH bytes are then transferred by
+ * the DMA, with a single interrupt at the end. This must be called before
+ * \ref i2c_enable, the DMA channels being enabled.
+ *
+ * \param _i2c the I2C
+ * \param dma_rx the DMA channel of the I2C RX requests
+ * \param dma_tx the DMA channel of the I2C TX requests
+ */
+static inline void i2c_set_dma(const _i2c_t *_i2c, dma_t dma_rx, dma_t dma_tx)
+{
+    _i2c->data->dma_channel_rx = dma_rx;
+    _i2c->data->dma_channel_tx = dma_tx;
+}
+
 void i2c_handle_ev_interrupt(const _i2c_t *_i2c);
 void i2c_handle_er_interrupt(const _i2c_t *_i2c);
 
@@ -41,6 +41,9 @@ static inline void cancel_dma(const _spi_t *_spi);
 static inline void cancel_interrupt(const _spi_t *_spi);
 
 static void transfer_done(const _spi_t *spi);
+static void set_format(const _spi_t *_spi, uint32_t baudrate,
+                       spi_clock_mode_t clock_mode);
+static void transaction_start(const _spi_t *_spi);
 
 void spi_enable(spi_t spi, uint32_t baudrate, spi_clock_mode_t clock_mode)
 {
@@ -58,6 +61,23 @@ void spi_enable(spi_t spi, uint32_t baudrate, spi_clock_mode_t clock_mode)
     // Enable interrupts in NVIC
     nvic_enable_interrupt_line(_spi->irq_line);
 
+    // No transaction
+    _spi->data->current = NULL;
+    _spi->data->queue = NULL;
+
+    set_format(_spi, baudrate, clock_mode);
+}
+
+static void set_format(const _spi_t *_spi, uint32_t baudrate,
+                       spi_clock_mode_t clock_mode)
+{
+    // Record the settings
+    _spi->data->baudrate = baudrate;
+    _spi->data->clock_mode = clock_mode;
+
+    // Disable the SPI prior to configuration
+    *spi_get_CR1(_spi) = 0;
+
     // Compute divider
     uint16_t divider;
     uint32_t pclk;
@@ -188,6 +208,133 @@ void spi_transfer_async(spi_t spi, const uint8_t *tx_buffer,
     }
 }
 
+void spi_device_init(const spi_device_t *device)
+{
+    // Unselect the device
+    gpio_enable(device->cs_gpio);
+    gpio_set_output(device->cs_gpio, device->cs_pin);
+    gpio_pin_set(device->cs_gpio, device->cs_pin);
+}
+
+unsigned spi_submit(spi_transaction_t *transaction)
+{
+    const _spi_t *_spi = transaction->device->spi;
+    _spi_data_t *const data = _spi->data;
+    spi_transaction_t **next;
+
+    platform_enter_critical();
+
+    if (transaction->pending)
+    {
+        platform_exit_critical();
+        return 1;
+    }
+    transaction->pending = 1;
+
+    if (data->current == NULL)
+    {
+        // The bus is free, start now
+        data->current = transaction;
+        transaction_start(_spi);
+    }
+    else
+    {
+        // Insert after the pending ones of the same or higher priority
+        for (next = &data->queue; *next && (*next)->device->priority
+                >= transaction->device->priority; next = &(*next)->next)
+        {
+        }
+
+        transaction->next = *next;
+        *next = transaction;
+    }
+
+    platform_exit_critical();
+    return 0;
+}
+
+void spi_wait(spi_transaction_t *transaction)
+{
+    while (transaction->pending)
+    {
+    }
+}
+
+static void transaction_phase_done(handler_arg_t arg)
+{
+    const _spi_t *_spi = arg;
+    _spi_data_t *const data = _spi->data;
+    spi_transaction_t *done = data->current;
+
+    if (!data->data_phase && done->length)
+    {
+        // The command is sent, transfer the data
+        data->data_phase = 1;
+        spi_transfer_async(_spi, done->tx_buffer, done->rx_buffer,
+                           done->length, transaction_phase_done, arg);
+        return;
+    }
+
+    // Unselect the device, all the bytes are received
+    gpio_pin_set(done->device->cs_gpio, done->device->cs_pin);
+
+    // Start the next transaction before the handler, to keep the bus busy
+    platform_enter_critical();
+    data->current = data->queue;
+    if (data->current)
+    {
+        data->queue = data->current->next;
+        transaction_start(_spi);
+    }
+    platform_exit_critical();
+
+    // The descriptor may be reused as soon as it is not pending
+    handler_t handler = done->handler;
+    handler_arg_t handler_arg = done->arg;
+    done->pending = 0;
+
+    if (handler)
+    {
+        handler(handler_arg);
+    }
+}
+
+/*
+ * Start the current transaction, with the interrupts masked
+ */
+static void transaction_start(const _spi_t *_spi)
+{
+    _spi_data_t *const data = _spi->data;
+    spi_transaction_t *transaction = data->current;
+    const spi_device_t *device = transaction->device;
+
+    // Set the clock of the device, the bus being idle
+    if (device->baudrate && (device->baudrate != data->baudrate
+                             || device->clock_mode != data->clock_mode))
+    {
+        set_format(_spi, device->baudrate, device->clock_mode);
+    }
+
+    // Select the device, and send the command if any
+    gpio_pin_clear(device->cs_gpio, device->cs_pin);
+
+    data->data_phase = (transaction->cmd_length == 0);
+
+    // HACK for removing const warning
+    if (data->data_phase)
+    {
+        spi_transfer_async(_spi, transaction->tx_buffer,
+                           transaction->rx_buffer, transaction->length,
+                           transaction_phase_done, (handler_arg_t) (uint32_t) _spi);
+    }
+    else
+    {
+        spi_transfer_async(_spi, transaction->cmd, NULL,
+                           transaction->cmd_length, transaction_phase_done,
+                           (handler_arg_t) (uint32_t) _spi);
+    }
+}
+
 void spi_async_cancel(spi_t spi)
 {
     const _spi_t *_spi = spi;
@@ -247,7 +394,7 @@ static inline void transfer_dma(const _spi_t *_spi, const uint8_t *tx_buffer,
         // Direction: from peripheral to memory
         tx_buffer ? DMA_INCREMENT_ON : DMA_INCREMENT_OFF);
 
-    // Start the RX DMA, with transfer done handler HACK for removing const warning
+    // Start the RX DMA, with transfer done handler
     dma_start(_spi->data->dma_channel_rx, (handler_t) transfer_done, (handler_arg_t) (uint32_t) _spi);
 
     // Start the TX DMA, with no handler
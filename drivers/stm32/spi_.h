@@ -51,6 +51,15 @@ typedef struct
     handler_t transfer_handler;
     handler_arg_t transfer_handler_arg;
 
+    // Current clock settings
+    uint32_t baudrate;
+    spi_clock_mode_t clock_mode;
+
+    // Transaction in progress and its phase, and pending ones by priority
+    spi_transaction_t *current;
+    uint8_t data_phase;
+    spi_transaction_t *queue;
+
 } _spi_data_t;
 
 typedef struct
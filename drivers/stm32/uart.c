@@ -49,6 +49,14 @@ void uart_enable(uart_t uart, uint32_t baudrate)
     // Enable the Clock for this peripheral
     rcc_apb_enable(_uart->apb_bus, _uart->apb_bit);
 
+    // If already enabled, let the last character be sent before changing
+    if (*uart_get_CR1(_uart) & UART_CR1__UE)
+    {
+        while (!(*uart_get_SR(_uart) & UART_SR__TC))
+        {
+        }
+    }
+
     // Clear all registers
     *uart_get_CR1(_uart) = 0;
     *uart_get_CR2(_uart) = 0;
@@ -98,6 +106,17 @@ void uart_enable(uart_t uart, uint32_t baudrate)
     }
 }
 
+uint32_t uart_get_max_baudrate(uart_t uart)
+{
+    const _uart_t *_uart = uart;
+
+    // The UART clock is sampled 8 or 16 times per bit
+    return rcc_sysclk_get_clock_frequency(
+               _uart->apb_bus == 1 ? RCC_SYSCLK_CLOCK_PCLK1
+               : RCC_SYSCLK_CLOCK_PCLK2)
+           / ((*uart_get_CR1(_uart) & UART_CR1__OVER8) ? 8 : 16);
+}
+
 void uart_disable(uart_t uart)
 {
     const _uart_t *_uart = uart;
@@ -196,6 +215,34 @@ void uart_transfer_async(uart_t uart, const uint8_t *tx_buffer,
 
 }
 
+void uart_transfer_async_finish(uart_t uart)
+{
+    const _uart_t *_uart = uart;
+
+    if (_uart->data->dma_channel_tx)
+    {
+        // The DMA runs without the interrupts, then its flags are cleared
+        while (dma_get_remaining(_uart->data->dma_channel_tx))
+        {
+        }
+        dma_cancel(_uart->data->dma_channel_tx);
+    }
+    else
+    {
+        // Send the remaining bytes instead of the TXE interrupt
+        *uart_get_CR1(_uart) &= ~(UART_CR1__TXEIE);
+        uart_transfer(uart, _uart->data->isr_tx, _uart->data->isr_count);
+        _uart->data->isr_count = 0;
+    }
+
+    // Wait for the last byte to be sent
+    while (!(*uart_get_SR(_uart) & UART_SR__TC))
+    {
+    }
+
+    platform_release_low_power();
+}
+
 static inline void tx_dma(const _uart_t *_uart, const uint8_t *tx_buffer,
                           uint16_t length)
 {
@@ -55,6 +55,7 @@ void dma_config(dma_t dma, uint32_t peripheral_address,
 
     // Disable the DMA channel
     *dma_get_SxCR(_dma) = 0;
+    _dma->data->next_number = 0;
 
     // Compute the IFCR register and bit offset
     volatile uint32_t* ifcr = _dma->stream > 3 ? dma_get_HIFCR(_dma)
@@ -88,6 +89,7 @@ void dma_start(dma_t dma, handler_t handler, handler_arg_t handler_arg)
     // Store the handlers
     _dma->data->handler = handler;
     _dma->data->handler_arg = handler_arg;
+    _dma->data->half_handler = NULL;
 
     // Enable the transfer complete interrupt
     *dma_get_SxCR(_dma) |= DMA_SxCR__TCIE;
@@ -96,6 +98,52 @@ void dma_start(dma_t dma, handler_t handler, handler_arg_t handler_arg)
     *dma_get_SxCR(_dma) |= DMA_SxCR__EN;
 }
 
+void dma_start_circular(dma_t dma, handler_t half_handler,
+        handler_t full_handler, handler_arg_t handler_arg)
+{
+    const _dma_t *_dma = dma;
+
+    // Store the handlers
+    _dma->data->handler = full_handler;
+    _dma->data->handler_arg = handler_arg;
+    _dma->data->half_handler = half_handler;
+
+    // Enable the circular mode and the interrupts of the handlers set
+    uint32_t cr = *dma_get_SxCR(_dma) | DMA_SxCR__CIRC;
+
+    if (half_handler)
+    {
+        cr |= DMA_SxCR__HTIE;
+    }
+
+    if (full_handler)
+    {
+        cr |= DMA_SxCR__TCIE;
+    }
+
+    *dma_get_SxCR(_dma) = cr;
+
+    // Set the EN bit to start channel
+    *dma_get_SxCR(_dma) |= DMA_SxCR__EN;
+}
+
+uint16_t dma_get_remaining(dma_t dma)
+{
+    const _dma_t *_dma = dma;
+
+    return *dma_get_SxNDTR(_dma);
+}
+
+void dma_chain(dma_t dma, uint32_t memory_address, uint16_t transfer_number)
+{
+    const _dma_t *_dma = dma;
+
+    platform_enter_critical();
+    _dma->data->next_address = memory_address;
+    _dma->data->next_number = transfer_number;
+    platform_exit_critical();
+}
+
 int32_t dma_cancel(dma_t dma)
 {
     const _dma_t *_dma = dma;
@@ -111,6 +159,9 @@ int32_t dma_cancel(dma_t dma)
         canceled = 1;
     }
 
+    // Forget the chained transfer
+    _dma->data->next_number = 0;
+
     // Compute the ISR register and bit offset
     uint32_t isr_offset = 6 * ((_dma->stream & 0x1) != 0) + 16 * ((_dma->stream
             & 0x2) != 0);
@@ -140,18 +191,59 @@ void dma_handle_interrupt(dma_t dma)
     uint32_t isr_offset = 6 * ((_dma->stream & 0x1) != 0) + 16 * ((_dma->stream
             & 0x2) != 0);
 
-    // Check if the transfer complete interrupt flag is set for this channel
-    if (*isr & (DMA_LISR__TCIF0 << isr_offset))
+    // Get the flags of this stream, for the enabled interrupts only
+    uint32_t flags = (*isr >> isr_offset) & (DMA_LISR__TCIF0 | DMA_LISR__HTIF0);
+    uint32_t cr = *dma_get_SxCR(_dma);
+
+    if (!(cr & DMA_SxCR__HTIE))
+    {
+        flags &= ~DMA_LISR__HTIF0;
+    }
+
+    if (flags == 0)
+    {
+        return;
+    }
+
+    // Get the IFCR register
+    volatile uint32_t* ifcr = _dma->stream > 3 ? dma_get_HIFCR(_dma)
+            : dma_get_LIFCR(_dma);
+
+    if (cr & DMA_SxCR__CIRC)
+    {
+        // Clear the flags handled only, the other half may already be done
+        *ifcr = flags << isr_offset;
+    }
+    else
     {
-        // Get the IFCR register
-        volatile uint32_t* ifcr = _dma->stream > 3 ? dma_get_HIFCR(_dma)
-                : dma_get_LIFCR(_dma);
         // Clear the interrupt flag
         *ifcr = (DMA_LIFCR__CFEIF0 | DMA_LIFCR__CDMEIF0 | DMA_LIFCR__CTEIF0
                 | DMA_LIFCR__CHTIF0 | DMA_LIFCR__CTCIF0) << isr_offset;
+    }
 
-        // Disable the DMA channel
-        *dma_get_SxCR(_dma) &= ~DMA_SxCR__EN;
+    // Check if the half transfer interrupt flag is set for this stream
+    if ((flags & DMA_LISR__HTIF0) && _dma->data->half_handler)
+    {
+        _dma->data->half_handler(_dma->data->handler_arg);
+    }
+
+    // Check if the transfer complete interrupt flag is set for this channel
+    if (flags & DMA_LISR__TCIF0)
+    {
+        if (!(cr & DMA_SxCR__CIRC))
+        {
+            // Disable the DMA channel
+            *dma_get_SxCR(_dma) &= ~DMA_SxCR__EN;
+
+            // Restart at once on the chained buffer, if any
+            if (_dma->data->next_number)
+            {
+                *dma_get_SxM0AR(_dma) = _dma->data->next_address;
+                *dma_get_SxNDTR(_dma) = _dma->data->next_number;
+                _dma->data->next_number = 0;
+                *dma_get_SxCR(_dma) |= DMA_SxCR__EN;
+            }
+        }
 
         // Call the handler if any
         if (_dma->data->handler)
@@ -71,6 +71,13 @@ typedef struct
     // The handler for transfer done
     handler_t handler;
     handler_arg_t handler_arg;
+
+    // The handler for the half transfer, in circular mode
+    handler_t half_handler;
+
+    // The transfer to start after the current one, if transfer_number is set
+    uint32_t next_address;
+    uint16_t next_number;
 } _dma_data_t;
 
 typedef struct
@@ -102,6 +109,8 @@ typedef struct
         .trigger_channel = 0, \
         .handler = NULL, \
         .handler_arg = NULL, \
+        .half_handler = NULL, \
+        .next_number = 0, \
     }; \
     const _dma_t name = { \
     .base_address = addr, \
@@ -46,6 +46,8 @@ static void mii_find_phy_addr();
 
 /** Set the address in memory */
 static void set_mac_address(const uint8_t *a);
+/** Restart the transmit DMA if suspended */
+static void tx_resume();
 
 static struct
 {
@@ -55,8 +57,22 @@ static struct
     int always_on;
 
     uint8_t mac_address[6];
+
+    /** Descriptors sent in place: oldest one, count, frames by last one */
+    ethmac_tx_descriptor_t *tx_dirty;
+    uint32_t tx_queued;
+    void *tx_args[ETHMAC_TXDES_NUMBER];
+
+    /** Interrupt moderation: watchdog value, TX frames per interrupt */
+    uint32_t rx_watchdog;
+    uint32_t tx_coalesce, tx_count;
+
+    ethmac_stats_t stats;
 } mac;
 
+/** Get the interrupt on completion flag of the next frame to send */
+static uint32_t tx_interrupt_flag();
+
 void ethmac_init(ethmac_mode_t mode, int always_on)
 {
     // Initialize the descriptors
@@ -80,6 +96,11 @@ void ethmac_init(ethmac_mode_t mode, int always_on)
     // Set the always_on value
     mac.always_on = always_on;
 
+    // An interrupt per frame
+    mac.rx_watchdog = 0;
+    mac.tx_coalesce = 1;
+    mac.tx_count = 0;
+
     // Compute MII divider
     switch (rcc_sysclk_get_clock_frequency(RCC_SYSCLK_CLOCK_HCLK))
     {
@@ -146,6 +167,12 @@ void ethmac_start(const uint8_t* address)
 
     // Reset the descriptors
     ethmac_descriptors_reset();
+    mac.tx_dirty = ethmac_current_tx_des;
+    mac.tx_queued = 0;
+    for (i = 0; i < ETHMAC_TXDES_NUMBER; i++)
+    {
+        mac.tx_args[i] = NULL;
+    }
 
     /* ISR vector enabled.*/
     nvic_enable_interrupt_line(NVIC_IRQ_LINE_ETH);
@@ -175,7 +202,11 @@ void ethmac_start(const uint8_t* address)
     /* Enabling required interrupt sources.*/
     *ethmac_get_DMASR() = (uint32_t) (*ethmac_get_DMASR());
     *ethmac_get_DMAIER() = ETHMAC_DMAIER__NISE | ETHMAC_DMAIER__AISE
-            | ETHMAC_DMAIER__RIE | ETHMAC_DMAIER__TIE;
+            | ETHMAC_DMAIER__RIE | ETHMAC_DMAIER__TIE | ETHMAC_DMAIER__RBUIE;
+
+    // Receive watchdog, reset by the DMA reset
+    *ethmac_get_DMARSWTR() = mac.rx_watchdog;
+    ethmac_reset_stats();
 
     /* DMA general settings.*/
     *ethmac_get_DMABMR() = ETHMAC_DMABMR__AAB | ETHMAC_DMABMR__RDP_1Beat
@@ -191,6 +222,71 @@ void ethmac_start(const uint8_t* address)
             | ETHMAC_DMAOMR__TSF | ETHMAC_DMAOMR__ST | ETHMAC_DMAOMR__SR;
 }
 
+void ethmac_set_coalescing(uint32_t rx_frames, uint32_t rx_timeout_us,
+        uint32_t tx_frames)
+{
+    uint32_t i;
+
+    if (rx_frames == 0)
+    {
+        rx_frames = 1;
+    }
+    else if (rx_frames > ETHMAC_RXDES_NUMBER)
+    {
+        rx_frames = ETHMAC_RXDES_NUMBER;
+    }
+
+    // Interrupt on completion of one descriptor every rx_frames
+    for (i = 0; i < ETHMAC_RXDES_NUMBER; i++)
+    {
+        if ((i + 1) % rx_frames)
+        {
+            ethmac_rx_des[i].rdes1 |= ETHMAC_RDES1__DIC;
+        }
+        else
+        {
+            ethmac_rx_des[i].rdes1 &= ~ETHMAC_RDES1__DIC;
+        }
+    }
+
+    // The watchdog raises the interrupt of the frames without one
+    mac.rx_watchdog = 0;
+    if (rx_frames > 1)
+    {
+        mac.rx_watchdog = (rx_timeout_us
+                * (rcc_sysclk_get_clock_frequency(RCC_SYSCLK_CLOCK_HCLK)
+                        / 1000000)) / 256;
+
+        if (mac.rx_watchdog == 0)
+        {
+            mac.rx_watchdog = 1;
+        }
+        else if (mac.rx_watchdog > 255)
+        {
+            mac.rx_watchdog = 255;
+        }
+    }
+    *ethmac_get_DMARSWTR() = mac.rx_watchdog;
+
+    mac.tx_coalesce = tx_frames;
+    mac.tx_count = 0;
+}
+
+void ethmac_get_stats(ethmac_stats_t *stats)
+{
+    // Add the frames missed since the previous read, cleared on read
+    uint32_t missed = *ethmac_get_DMAMFBOCR();
+    mac.stats.rx_missed += (missed & 0xFFFF) + ((missed >> 17) & 0x7FF);
+
+    *stats = mac.stats;
+}
+
+void ethmac_reset_stats()
+{
+    (void) *ethmac_get_DMAMFBOCR();
+    memset(&mac.stats, 0, sizeof(mac.stats));
+}
+
 int ethmac_get_link_status()
 {
     uint32_t maccr, bmsr, bmcr;
@@ -293,6 +389,12 @@ int32_t ethmac_tx_init(ethmac_tx_t *tx)
         return 0;
     }
 
+    // Status of the previous frame sent with this descriptor
+    if (tx_des->tdes0 & ETHMAC_TDES0__ES)
+    {
+        mac.stats.tx_errors++;
+    }
+
     // Increment current descriptor
     ethmac_current_tx_des = (ethmac_tx_descriptor_t*) tx_des->tdes3;
 
@@ -323,10 +425,108 @@ void ethmac_tx_send(ethmac_tx_t *tx)
 {
     /* Unlocks the descriptor and returns it to the DMA engine.*/
     ((ethmac_tx_descriptor_t*) (tx->real_des))->tdes1 = tx->offset;
-    ((ethmac_tx_descriptor_t*) (tx->real_des))->tdes0 = ETHMAC_TDES0__IC
+    ((ethmac_tx_descriptor_t*) (tx->real_des))->tdes0 = tx_interrupt_flag()
             | ETHMAC_TDES0__LS | ETHMAC_TDES0__FS | ETHMAC_TDES0__TCH
             | ETHMAC_TDES0__OWN;
 
+    mac.stats.tx_frames++;
+    tx_resume();
+}
+
+int32_t ethmac_tx_send_buffers(const ethmac_tx_buffer_t *buffers,
+        uint32_t count, void *arg)
+{
+    ethmac_tx_descriptor_t *first = ethmac_current_tx_des;
+    ethmac_tx_descriptor_t *tx_des = first;
+    uint32_t i;
+
+    if (count == 0 || count > ETHMAC_TXDES_NUMBER - mac.tx_queued)
+    {
+        return 0;
+    }
+
+    // One descriptor per buffer, the DMA reads them in place
+    for (i = 0; i < count; i++)
+    {
+        uint32_t tdes0 = ETHMAC_TDES0__TCH;
+
+        if (i == 0)
+        {
+            tdes0 |= ETHMAC_TDES0__FS;
+        }
+        else
+        {
+            // The first one is given last, for the DMA not to start early
+            tdes0 |= ETHMAC_TDES0__OWN;
+        }
+
+        if (i == count - 1)
+        {
+            tdes0 |= ETHMAC_TDES0__LS | tx_interrupt_flag();
+            mac.tx_args[tx_des - ethmac_tx_des] = arg;
+        }
+
+        tx_des->tdes2 = (uint32_t) buffers[i].data;
+        tx_des->tdes1 = buffers[i].length;
+        tx_des->tdes0 = tdes0;
+
+        tx_des = (ethmac_tx_descriptor_t*) tx_des->tdes3;
+    }
+
+    mac.tx_queued += count;
+    mac.stats.tx_frames++;
+    ethmac_current_tx_des = tx_des;
+
+    first->tdes0 |= ETHMAC_TDES0__OWN;
+    tx_resume();
+
+    return 1;
+}
+
+uint32_t ethmac_tx_get_free()
+{
+    return ETHMAC_TXDES_NUMBER - mac.tx_queued;
+}
+
+void *ethmac_tx_reclaim()
+{
+    // Walk the descriptors released by the DMA, up to the end of a frame
+    while (mac.tx_queued && !(mac.tx_dirty->tdes0 & ETHMAC_TDES0__OWN))
+    {
+        uint32_t i = mac.tx_dirty - ethmac_tx_des;
+        void *arg = mac.tx_args[i];
+
+        mac.tx_args[i] = NULL;
+        mac.tx_dirty = (ethmac_tx_descriptor_t*) mac.tx_dirty->tdes3;
+        mac.tx_queued--;
+
+        if (arg)
+        {
+            if (ethmac_tx_des[i].tdes0 & ETHMAC_TDES0__ES)
+            {
+                mac.stats.tx_errors++;
+            }
+
+            return arg;
+        }
+    }
+
+    return NULL;
+}
+
+static uint32_t tx_interrupt_flag()
+{
+    if (mac.tx_coalesce && ++mac.tx_count >= mac.tx_coalesce)
+    {
+        mac.tx_count = 0;
+        return ETHMAC_TDES0__IC;
+    }
+
+    return 0;
+}
+
+static void tx_resume()
+{
     /* If the DMA engine is stalled then a restart request is issued.*/
     if ((*ethmac_get_DMASR() & ETHMAC_DMASR__TPS_MASK)
             == ETHMAC_DMASR__TPS_SUSPENDED)
@@ -350,18 +550,21 @@ int32_t ethmac_rx_init(ethmac_rx_t *rx)
         {
             // Found a valid one
             rx->offset = 0;
-            rx->size = ((ethmac_current_rx_des->rdes0 & ETHMAC_RDES0__FL_MASK)
+            rx->size = ((rx_des->rdes0 & ETHMAC_RDES0__FL_MASK)
                     >> ETHMAC_RDES0__FL_SHIFT) - 4;
             rx->real_des = rx_des;
             ethmac_current_rx_des = (ethmac_rx_descriptor_t *) rx_des->rdes3;
+            mac.stats.rx_frames++;
 
             // Return OK
             return 1;
         }
 
         /* Invalid frame found, purging.*/
+        mac.stats.rx_errors++;
         rx_des->rdes0 = ETHMAC_RDES0__OWN;
-        rx_des = (ethmac_rx_descriptor_t *) ethmac_current_rx_des->rdes3;
+        rx_des = (ethmac_rx_descriptor_t *) rx_des->rdes3;
+        ethmac_current_rx_des = rx_des;
     }
 
     return 0;
@@ -396,6 +599,23 @@ void ethmac_rx_release(ethmac_rx_t *rx)
     }
 }
 
+void ethmac_rx_release_buffer(ethmac_rx_t *rx, uint8_t *buffer)
+{
+    // Swap the buffer, then release as usual
+    ((ethmac_rx_descriptor_t*) (rx->real_des))->rdes2 = (uint32_t) buffer;
+    ethmac_rx_release(rx);
+}
+
+int32_t ethmac_rx_pending()
+{
+    return !(ethmac_current_rx_des->rdes0 & ETHMAC_RDES0__OWN);
+}
+
+uint8_t *ethmac_rx_get_buffer(ethmac_rx_t *rx)
+{
+    return (uint8_t *) (((ethmac_rx_descriptor_t*) (rx->real_des))->rdes2);
+}
+
 uint32_t ethmac_rx_get_len(ethmac_rx_t *rx)
 {
     return rx->size;
@@ -408,9 +628,10 @@ void ethmac_handle_interrupt()
 
     /* Clear status bits.*/
     *ethmac_get_DMASR() = dmasr;
+    mac.stats.interrupts++;
 
-    // Check for read
-    if (dmasr & ETHMAC_DMASR__RS)
+    // Check for read, or for the DMA waiting for descriptors to be released
+    if (dmasr & (ETHMAC_DMASR__RS | ETHMAC_DMASR__RBUS))
     {
         // Data received
         ethmac_frame_received_isr();
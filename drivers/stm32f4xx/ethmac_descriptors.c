@@ -32,8 +32,10 @@ ethmac_tx_descriptor_t ethmac_tx_des[ETHMAC_TXDES_NUMBER];
 ethmac_rx_descriptor_t *ethmac_current_rx_des;
 ethmac_tx_descriptor_t *ethmac_current_tx_des;
 
-static uint8_t rx_buffers[ETHMAC_RXDES_NUMBER][ETHMAC_BUFFER_SIZE];
-static uint8_t tx_buffers[ETHMAC_TXDES_NUMBER][ETHMAC_BUFFER_SIZE];
+static uint8_t rx_buffers[ETHMAC_RXDES_NUMBER][ETHMAC_BUFFER_SIZE]
+        __attribute__((aligned(4)));
+static uint8_t tx_buffers[ETHMAC_TXDES_NUMBER][ETHMAC_BUFFER_SIZE]
+        __attribute__((aligned(4)));
 
 void ethmac_descriptors_init()
 {
@@ -29,6 +29,8 @@
 
 #include <stdint.h>
 
+#include "ethmac.h"
+
 typedef struct
 {
     volatile uint32_t rdes0;
@@ -49,7 +51,6 @@ enum
 {
     ETHMAC_RXDES_NUMBER = 4,
     ETHMAC_TXDES_NUMBER = 4,
-    ETHMAC_BUFFER_SIZE = 1522,
 };
 
 extern ethmac_rx_descriptor_t ethmac_rx_des[ETHMAC_RXDES_NUMBER];
@@ -29,6 +29,8 @@
 #include "adc_registers.h"
 #include "rcc.h"
 #include "nvic_.h"
+#include "timer_.h"
+#include "dma.h"
 
 #include "debug.h"
 
@@ -166,6 +168,202 @@ void adc_sample_single(adc_t adc)
     *adc_get_CR2(_adc) |= ADC_CR2__SWSTART;
 }
 
+static const struct
+{
+    uint32_t timer_address;
+    timer_channel_t channel;
+    uint8_t extsel;
+} scan_triggers[] =
+{
+    // The timer compare events triggering the regular conversions
+    { TIM9_BASE_ADDRESS, TIMER_CHANNEL_2, 0 },
+    { TIM2_BASE_ADDRESS, TIMER_CHANNEL_3, 2 },
+    { TIM2_BASE_ADDRESS, TIMER_CHANNEL_2, 3 },
+    { TIM4_BASE_ADDRESS, TIMER_CHANNEL_4, 5 },
+    { TIM3_BASE_ADDRESS, TIMER_CHANNEL_1, 7 },
+    { TIM3_BASE_ADDRESS, TIMER_CHANNEL_3, 8 },
+};
+
+static void scan_half_done(handler_arg_t arg);
+static void scan_full_done(handler_arg_t arg);
+
+int32_t adc_config_scan(adc_t adc, const uint8_t *channels,
+                        uint8_t num_channels, openlab_timer_t timer,
+                        timer_channel_t timer_channel)
+{
+    const _adc_t *_adc = (const _adc_t *) adc;
+    const _openlab_timer_t *_timer = timer;
+    uint32_t i, extsel = 0xFF;
+
+    for (i = 0; i < sizeof(scan_triggers) / sizeof(scan_triggers[0]); i++)
+    {
+        if (scan_triggers[i].timer_address == _timer->base_address
+                && scan_triggers[i].channel == timer_channel)
+        {
+            extsel = scan_triggers[i].extsel;
+        }
+    }
+
+    if (extsel == 0xFF || num_channels == 0
+            || num_channels > ADC_SCAN_MAX_CHANNELS || _adc->data->dma == NULL)
+    {
+        return 0;
+    }
+
+    _adc->data->num_channels = num_channels;
+    _adc->data->timer = timer;
+    _adc->data->timer_channel = timer_channel;
+
+    // Stop the ADC
+    *adc_get_CR2(_adc) = 0;
+
+    // Scan the sequence, no interrupt, the DMA reads the results
+    *adc_get_CR1(_adc) = ADC_CR1__SCAN;
+
+    // Trigger on the rising edge of the compare event, keep the DMA requests
+    // for the circular transfer (do not set ADON)
+    *adc_get_CR2(_adc) = ADC_CR2__DMA | ADC_CR2__DDS | (1 << 28)
+                         | (extsel << 24);
+
+    // Set the sequence length and the channels, SQ1 in the lowest bits of SQR5
+    *adc_get_SQR1(_adc) = (num_channels - 1) << 20;
+    *adc_get_SQRx(_adc, 3) = 0;
+    *adc_get_SQRx(_adc, 4) = 0;
+    *adc_get_SQRx(_adc, 5) = 0;
+
+    for (i = 0; i < num_channels; i++)
+    {
+        *adc_get_SQRx(_adc, 5 - i / 6) |= (channels[i] & 0x1F) << (5 * (i % 6));
+    }
+
+    return 1;
+}
+
+int32_t adc_start_scan(adc_t adc, uint32_t frequency, uint16_t *buffer,
+                       uint16_t num_scans, uint8_t oversampling,
+                       adc_scan_handler_t handler, handler_arg_t arg)
+{
+    const _adc_t *_adc = (const _adc_t *) adc;
+    _adc_data_t *data = _adc->data;
+
+    if (oversampling == 0 || (num_scans / 2) % oversampling
+            || num_scans < 2 * oversampling || data->num_channels == 0
+            || (uint32_t) num_scans * data->num_channels > 0xFFFF)
+    {
+        return 0;
+    }
+
+    uint32_t period = timer_get_frequency(data->timer) / frequency;
+
+    if (period < 2 || period > 0x10000)
+    {
+        return 0;
+    }
+
+    data->buffer = buffer;
+    data->half_scans = num_scans / 2;
+    data->oversampling = oversampling;
+    data->scan_handler = handler;
+    data->scan_arg = arg;
+
+    // Transfer the conversions circularly in the buffer
+    dma_config(data->dma, (uint32_t) adc_get_DR(_adc), (uint32_t) buffer,
+               num_scans * data->num_channels, DMA_SIZE_16bit,
+               DMA_DIRECTION_FROM_PERIPHERAL, DMA_INCREMENT_ON);
+    dma_start_circular(data->dma, scan_half_done, scan_full_done,
+                       (handler_arg_t) _adc);
+
+    // Prevent HSI disabling while scanning
+    platform_prevent_low_power();
+
+    // Start the ADC
+    *adc_get_CR2(_adc) |= ADC_CR2__ADON;
+
+    // Wait until started
+    while ((*adc_get_SR(_adc) & ADC_SR__ADONS) == 0)
+    {
+    }
+
+    // Start the timer, a compare event in each period triggers a scan
+    timer_start(data->timer, period - 1, NULL, NULL);
+    timer_update_channel_compare(data->timer, data->timer_channel, period / 2);
+    timer_activate_channel_output(data->timer, data->timer_channel,
+                                  TIMER_OUTPUT_MODE_PWM1);
+
+    return 1;
+}
+
+void adc_stop_scan(adc_t adc)
+{
+    const _adc_t *_adc = (const _adc_t *) adc;
+
+    // Stop the triggers, then the DMA
+    timer_activate_channel_output(_adc->data->timer, _adc->data->timer_channel,
+                                  TIMER_OUTPUT_MODE_FROZEN);
+    timer_stop(_adc->data->timer);
+    dma_cancel(_adc->data->dma);
+
+    // Stop the ADC
+    if (*adc_get_CR2(_adc) & ADC_CR2__ADON)
+    {
+        *adc_get_CR2(_adc) = 0;
+
+        // Release HSI disabling prevention
+        platform_release_low_power();
+    }
+
+    *adc_get_CR1(_adc) = 0;
+}
+
+static void scan_done(const _adc_t *_adc, uint16_t *scans)
+{
+    _adc_data_t *data = _adc->data;
+    uint32_t i, j, k, count = data->half_scans;
+
+    if (data->oversampling > 1)
+    {
+        // Average in place, each result is before the scans it comes from
+        count /= data->oversampling;
+
+        for (i = 0; i < count; i++)
+        {
+            for (j = 0; j < data->num_channels; j++)
+            {
+                uint32_t sum = 0;
+                uint16_t *sample = scans
+                                   + i * data->oversampling * data->num_channels + j;
+
+                for (k = 0; k < data->oversampling; k++)
+                {
+                    sum += sample[k * data->num_channels];
+                }
+
+                scans[i * data->num_channels + j] = sum / data->oversampling;
+            }
+        }
+    }
+
+    if (data->scan_handler)
+    {
+        data->scan_handler(data->scan_arg, scans, count);
+    }
+}
+
+static void scan_half_done(handler_arg_t arg)
+{
+    const _adc_t *_adc = arg;
+
+    scan_done(_adc, _adc->data->buffer);
+}
+
+static void scan_full_done(handler_arg_t arg)
+{
+    const _adc_t *_adc = arg;
+
+    scan_done(_adc, _adc->data->buffer
+              + _adc->data->half_scans * _adc->data->num_channels);
+}
+
 void adc_enable_vrefint()
 {
     // Set the TSVREFE bit in CCR
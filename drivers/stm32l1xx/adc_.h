@@ -29,8 +29,10 @@
 
 #include "rcc.h"
 #include "nvic.h"
+#include "dma.h"
 #include "handler.h"
 #include "adc.h"
+#include "timer.h"
 
 typedef struct
 {
@@ -41,6 +43,21 @@ typedef struct
     adc_handler_t handler;
     /** The conversion handler argument. */
     handler_arg_t handler_arg;
+
+    /** The DMA channel of the scan groups */
+    dma_t dma;
+
+    /** The scan group */
+    uint8_t num_channels;
+    uint8_t oversampling;
+    uint16_t *buffer;
+    uint16_t half_scans;
+    openlab_timer_t timer;
+    timer_channel_t timer_channel;
+
+    /** The scan group handler */
+    adc_scan_handler_t scan_handler;
+    handler_arg_t scan_arg;
 } _adc_data_t;
 
 typedef struct
@@ -67,6 +84,12 @@ typedef struct
     .data = &name##_data \
 }
 
+/** Set the DMA channel used by the scan groups */
+static inline void adc_set_dma(const _adc_t *_adc, dma_t dma)
+{
+    _adc->data->dma = dma;
+}
+
 /**
  * Handle an interrupt.
  */
@@ -35,6 +35,8 @@ GPIO_INIT(_gpioD, GPIO_BASE_ADDRESS + GPIOD_OFFSET, RCC_AHB_BIT_GPIOD);
 GPIO_INIT(_gpioH, GPIO_BASE_ADDRESS + GPIOH_OFFSET, RCC_AHB_BIT_GPIOH);
 
 /* Real DMAs */
+DMA_INIT(_dma1_ch1, DMA_BASE_ADDRESS, RCC_AHB_BIT_DMA1, DMA_CHANNEL_1,
+         NVIC_IRQ_LINE_DMA1_Channel1);
 DMA_INIT(_dma1_ch4, DMA_BASE_ADDRESS, RCC_AHB_BIT_DMA1, DMA_CHANNEL_4,
          NVIC_IRQ_LINE_DMA1_Channel4);
 DMA_INIT(_dma1_ch5, DMA_BASE_ADDRESS, RCC_AHB_BIT_DMA1, DMA_CHANNEL_5,
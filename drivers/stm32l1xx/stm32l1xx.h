@@ -42,7 +42,8 @@ extern const _gpio_t _gpioA, _gpioB, _gpioC, _gpioD, _gpioH;
 #define GPIO_D (&_gpioD)
 #define GPIO_H (&_gpioH)
 
-extern const _dma_t _dma1_ch4, _dma1_ch5, _dma1_ch7;
+extern const _dma_t _dma1_ch1, _dma1_ch4, _dma1_ch5, _dma1_ch7;
+#define DMA_1_CH1 (&_dma1_ch1)
 #define DMA_1_CH4 (&_dma1_ch4)
 #define DMA_1_CH5 (&_dma1_ch5)
 #define DMA_1_CH7 (&_dma1_ch7)
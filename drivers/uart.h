@@ -67,6 +67,18 @@ typedef void (*uart_handler_t)(handler_arg_t arg, uint8_t c);
  * \param baudrate the desired baudrate of the UART clock
  */
 void uart_enable(uart_t uart, uint32_t baudrate);
+
+/**
+ * Get the maximum baudrate of a UART driver.
+ *
+ * This depends on the clock of the UART, it may be used to negotiate the
+ * baudrate of a link. The UART driver must be enabled.
+ *
+ * \param uart the UART driver
+ * \return the maximum baudrate supported
+ */
+uint32_t uart_get_max_baudrate(uart_t uart);
+
 /**
  * Disable a UART driver.
  *
@@ -124,6 +136,17 @@ void uart_transfer(uart_t uart, const uint8_t *tx_buffer, uint16_t length);
 void uart_transfer_async(uart_t uart, const uint8_t *tx_buffer, uint16_t length,
                          handler_t handler, handler_arg_t handler_arg);
 
+/**
+ * Complete the asynchronous transfer in progress, by polling.
+ *
+ * This returns once all the bytes of the transfer are sent, its handler is
+ * not called. It may be called with the interrupts masked, before writing
+ * synchronously with \ref uart_transfer.
+ *
+ * \param uart the UART driver, with an asynchronous transfer in progress
+ */
+void uart_transfer_async_finish(uart_t uart);
+
 /**
  * @}
  * @}
@@ -36,8 +36,9 @@
 #define RELEASE 0
 #endif // RELEASE
 
-#if RELEASE > 0
-// Undefine the log level to set it at very high level
+#if RELEASE > 0 && !(defined(LOG_DEFERRED) && LOG_DEFERRED)
+// Undefine the log level to set it at very high level, the deferred logs are
+// cheap enough to be kept
 #ifdef LOG_LEVEL
 #undef LOG_LEVEL
 #endif // LOG_LEVEL
@@ -87,26 +88,34 @@
 #define DEBUG_ENDL()               printf("\n")
 #endif
 
+#if defined(LOG_DEFERRED) && LOG_DEFERRED
+// Store a binary record, formatted on the host
+#include "log_deferred.h"
+#define LOG_RECORD(level, header, ...) LOG_DEFERRED_RECORD(level, __VA_ARGS__)
+#else // LOG_DEFERRED
+#define LOG_RECORD(level, header, ...) do {header(); printf(__VA_ARGS__);DEBUG_ENDL();}while(0)
+#endif // LOG_DEFERRED
+
 #ifndef LOG_LEVEL
 #define LOG_LEVEL LOG_LEVEL_DEBUG
 #endif // LOG_LEVEL
 #if (LOG_LEVEL <= LOG_LEVEL_DEBUG)
-#define log_debug(...) do {DEBUG_HEADER(); printf(__VA_ARGS__);DEBUG_ENDL();}while(0)
+#define log_debug(...) LOG_RECORD(LOG_LEVEL_DEBUG, DEBUG_HEADER, __VA_ARGS__)
 #else // (LOG_LEVEL <= LOG_LEVEL_DEBUG)
 #define log_debug(...)
 #endif // (LOG_LEVEL <= LOG_LEVEL_DEBUG)
 #if (LOG_LEVEL <= LOG_LEVEL_INFO)
-#define log_info(...) do {INFO_HEADER(); printf(__VA_ARGS__);DEBUG_ENDL();}while(0)
+#define log_info(...) LOG_RECORD(LOG_LEVEL_INFO, INFO_HEADER, __VA_ARGS__)
 #else // (LOG_LEVEL <= LOG_LEVEL_INFO)
 #define log_info(...)
 #endif // (LOG_LEVEL <= LOG_LEVEL_INFO)
 #if (LOG_LEVEL <= LOG_LEVEL_WARNING)
-#define log_warning(...) do {WARNING_HEADER(); printf(__VA_ARGS__);DEBUG_ENDL();}while(0)
+#define log_warning(...) LOG_RECORD(LOG_LEVEL_WARNING, WARNING_HEADER, __VA_ARGS__)
 #else // (LOG_LEVEL <= LOG_LEVEL_INFO)
 #define log_warning(...)
 #endif // (LOG_LEVEL <= LOG_LEVEL_INFO)
 #if (LOG_LEVEL <= LOG_LEVEL_ERROR)
-#define log_error(...) do {ERROR_HEADER(); printf(__VA_ARGS__);DEBUG_ENDL();}while(0)
+#define log_error(...) LOG_RECORD(LOG_LEVEL_ERROR, ERROR_HEADER, __VA_ARGS__)
 #define log_not_implemented(...) do {NOT_IMPLEMENTED_HEADER(); printf(__VA_ARGS__);DEBUG_ENDL();}while(0)
 #else // (LOG_LEVEL <= LOG_LEVEL_ERROR)
 #define log_error(...)
@@ -122,6 +131,8 @@
 #if defined(NATIVE)
 inline static void HALT()
 {
+    printf_flush();
+
     while (1)
     {
     }
@@ -130,6 +141,13 @@ inline static void HALT()
 static volatile int block_me;
 static void inline HALT()
 {
+#if defined(LOG_DEFERRED) && LOG_DEFERRED
+    log_deferred_flush();
+#endif // LOG_DEFERRED
+
+    // Let the buffered output out, and print synchronously from now on
+    printf_flush();
+
 #if RELEASE || (defined(AUTO_RESET) && AUTO_RESET)
     // Reset the chip through the NVIC
     NVIC_RESET();
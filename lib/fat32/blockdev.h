@@ -0,0 +1,117 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011,2012 HiKoB.
+ */
+
+/**
+ * \file blockdev.h
+ *
+ * Block device interface used by the FAT32 buffer cache (fs.c).
+ *
+ * A block device is a set of callbacks working on 512-byte blocks addressed
+ * by their index. Implementations are provided for the SDIO micro SD card,
+ * for a RAM disk and, on the native platform, for a file-backed image.
+ */
+
+#ifndef BLOCKDEV_H_
+#define BLOCKDEV_H_
+
+#include <stdint.h>
+
+/** Size of a block, in bytes */
+#define BLOCKDEV_BLOCK_SIZE 512
+
+typedef enum
+{
+    BLOCKDEV_OK = 0,
+    BLOCKDEV_INIT_ERROR,
+    BLOCKDEV_READ_ERROR,
+    BLOCKDEV_WRITE_ERROR,
+    BLOCKDEV_OUT_OF_RANGE
+} blockdev_error_t;
+
+typedef blockdev_error_t (*blockdev_init_t)(void *arg);
+typedef blockdev_error_t (*blockdev_read_t)(void *arg, uint32_t block, uint8_t *buf);
+typedef blockdev_error_t (*blockdev_write_t)(void *arg, uint32_t block, const uint8_t *buf);
+typedef uint32_t (*blockdev_size_t)(void *arg);
+
+typedef struct
+{
+    /** (Re)initialize the medium, called on mount and on error recovery */
+    blockdev_init_t init;
+    /** Read one block, returns when the data is in the buffer */
+    blockdev_read_t read;
+    /** Write one block, returns when the data is on the medium */
+    blockdev_write_t write;
+    /** Get the medium size in blocks */
+    blockdev_size_t size;
+
+    /** Implementation specific argument given to every callback */
+    void *arg;
+} blockdev_t;
+
+/**
+ * RAM disk.
+ *
+ * The memory area must be num_blocks * BLOCKDEV_BLOCK_SIZE bytes long.
+ */
+typedef struct
+{
+    uint8_t *mem;
+    uint32_t num_blocks;
+} blockdev_ram_t;
+
+void blockdev_ram_config(blockdev_t *dev, blockdev_ram_t *ram,
+                         uint8_t *mem, uint32_t num_blocks);
+
+#if defined(NATIVE)
+
+/**
+ * Disk image file, mapped in memory (native platform only).
+ *
+ * The image is opened and mapped on init and must already have the
+ * expected size (i.e. be created with dd or mkfs.vfat -C).
+ */
+typedef struct
+{
+    const char *path;
+    int fd;
+    uint8_t *map;
+    uint32_t num_blocks;
+} blockdev_file_t;
+
+void blockdev_file_config(blockdev_t *dev, blockdev_file_t *file,
+                          const char *path);
+
+/** Flush the mapped image to the file and unmap it */
+void blockdev_file_close(blockdev_file_t *file);
+
+#else
+
+#include "sdio.h"
+
+/**
+ * SDIO micro SD card.
+ *
+ * Only one SDIO block device may be used at a time as the DMA completion
+ * is signaled through a single semaphore.
+ */
+void blockdev_sdio_config(blockdev_t *dev, sdio_t sdio);
+
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011,2012 HiKoB.
+ */
+
+/**
+ * \file blockdev_file.c
+ *
+ * Disk image block device for the native platform. The whole image is
+ * mapped in the process address space so that multi-GB card images are
+ * accessed at memory speed.
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "blockdev.h"
+#include "debug.h"
+
+static blockdev_error_t file_bd_init(void *arg)
+{
+    blockdev_file_t *file = arg;
+    struct stat st;
+    void *map;
+
+    // Already mapped, nothing to do on re-initialization
+    if (file->map != NULL)
+    {
+        return BLOCKDEV_OK;
+    }
+
+    file->fd = open(file->path, O_RDWR);
+
+    if (file->fd < 0)
+    {
+        log_error("Cannot open disk image %s", file->path);
+        return BLOCKDEV_INIT_ERROR;
+    }
+
+    if ((fstat(file->fd, &st) != 0) || (st.st_size < BLOCKDEV_BLOCK_SIZE))
+    {
+        log_error("Invalid disk image %s", file->path);
+        close(file->fd);
+        return BLOCKDEV_INIT_ERROR;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+
+    if (map == MAP_FAILED)
+    {
+        log_error("Cannot map disk image %s", file->path);
+        close(file->fd);
+        return BLOCKDEV_INIT_ERROR;
+    }
+
+    file->map = map;
+    file->num_blocks = st.st_size / BLOCKDEV_BLOCK_SIZE;
+
+    return BLOCKDEV_OK;
+}
+
+static blockdev_error_t file_bd_read(void *arg, uint32_t block, uint8_t *buf)
+{
+    blockdev_file_t *file = arg;
+
+    if (block >= file->num_blocks)
+    {
+        return BLOCKDEV_OUT_OF_RANGE;
+    }
+
+    memcpy(buf, file->map + (size_t)block * BLOCKDEV_BLOCK_SIZE, BLOCKDEV_BLOCK_SIZE);
+
+    return BLOCKDEV_OK;
+}
+
+static blockdev_error_t file_bd_write(void *arg, uint32_t block, const uint8_t *buf)
+{
+    blockdev_file_t *file = arg;
+
+    if (block >= file->num_blocks)
+    {
+        return BLOCKDEV_OUT_OF_RANGE;
+    }
+
+    memcpy(file->map + (size_t)block * BLOCKDEV_BLOCK_SIZE, buf, BLOCKDEV_BLOCK_SIZE);
+
+    return BLOCKDEV_OK;
+}
+
+static uint32_t file_bd_size(void *arg)
+{
+    return ((blockdev_file_t *)arg)->num_blocks;
+}
+
+void blockdev_file_config(blockdev_t *dev, blockdev_file_t *file,
+                          const char *path)
+{
+    file->path = path;
+    file->fd = -1;
+    file->map = NULL;
+    file->num_blocks = 0;
+
+    dev->init = file_bd_init;
+    dev->read = file_bd_read;
+    dev->write = file_bd_write;
+    dev->size = file_bd_size;
+    dev->arg = file;
+}
+
+void blockdev_file_close(blockdev_file_t *file)
+{
+    size_t len = (size_t)file->num_blocks * BLOCKDEV_BLOCK_SIZE;
+
+    if (file->map == NULL)
+    {
+        return;
+    }
+
+    msync(file->map, len, MS_SYNC);
+    munmap(file->map, len);
+    close(file->fd);
+
+    file->map = NULL;
+    file->fd = -1;
+}
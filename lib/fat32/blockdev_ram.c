@@ -0,0 +1,85 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011,2012 HiKoB.
+ */
+
+/**
+ * \file blockdev_ram.c
+ *
+ * RAM disk block device
+ */
+
+#include <string.h>
+#include "blockdev.h"
+
+static blockdev_error_t ram_bd_init(void *arg)
+{
+    blockdev_ram_t *ram = arg;
+
+    if ((ram->mem == NULL) || (ram->num_blocks == 0))
+    {
+        return BLOCKDEV_INIT_ERROR;
+    }
+
+    return BLOCKDEV_OK;
+}
+
+static blockdev_error_t ram_bd_read(void *arg, uint32_t block, uint8_t *buf)
+{
+    blockdev_ram_t *ram = arg;
+
+    if (block >= ram->num_blocks)
+    {
+        return BLOCKDEV_OUT_OF_RANGE;
+    }
+
+    memcpy(buf, ram->mem + block * BLOCKDEV_BLOCK_SIZE, BLOCKDEV_BLOCK_SIZE);
+
+    return BLOCKDEV_OK;
+}
+
+static blockdev_error_t ram_bd_write(void *arg, uint32_t block, const uint8_t *buf)
+{
+    blockdev_ram_t *ram = arg;
+
+    if (block >= ram->num_blocks)
+    {
+        return BLOCKDEV_OUT_OF_RANGE;
+    }
+
+    memcpy(ram->mem + block * BLOCKDEV_BLOCK_SIZE, buf, BLOCKDEV_BLOCK_SIZE);
+
+    return BLOCKDEV_OK;
+}
+
+static uint32_t ram_bd_size(void *arg)
+{
+    return ((blockdev_ram_t *)arg)->num_blocks;
+}
+
+void blockdev_ram_config(blockdev_t *dev, blockdev_ram_t *ram,
+                         uint8_t *mem, uint32_t num_blocks)
+{
+    ram->mem = mem;
+    ram->num_blocks = num_blocks;
+
+    dev->init = ram_bd_init;
+    dev->read = ram_bd_read;
+    dev->write = ram_bd_write;
+    dev->size = ram_bd_size;
+    dev->arg = ram;
+}
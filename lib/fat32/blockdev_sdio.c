@@ -0,0 +1,147 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011,2012 HiKoB.
+ */
+
+/**
+ * \file blockdev_sdio.c
+ *
+ * SDIO micro SD card block device
+ */
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "sdio.h"
+#include "blockdev.h"
+#include "debug.h"
+
+// Semaphore given by the SDIO interrupt at the end of a DMA transfer
+static xSemaphoreHandle sd_transfer_mutex = NULL;
+
+// SD card error reported by the transfer handler
+static sd_error_t transfer_error;
+
+static void transfer_handler(handler_arg_t arg)
+{
+    signed portBASE_TYPE pxHigherPriorityTaskWoken = pdFALSE;
+
+    transfer_error = (sd_error_t)arg;
+
+    xSemaphoreGiveFromISR(sd_transfer_mutex, &pxHigherPriorityTaskWoken);
+
+    if (pxHigherPriorityTaskWoken != pdFALSE)
+    {
+        portYIELD();
+    }
+}
+
+static blockdev_error_t sdio_bd_init(void *arg)
+{
+    sdio_t sdio = (sdio_t)arg;
+
+    if (sd_transfer_mutex == NULL)
+    {
+        sd_transfer_mutex = xSemaphoreCreateCounting(1, 0);
+    }
+
+    if (sd_init(sdio) != SD_NO_ERROR)
+    {
+        return BLOCKDEV_INIT_ERROR;
+    }
+
+    sd_set_transfer_handler(sdio, transfer_handler);
+
+    return BLOCKDEV_OK;
+}
+
+static uint32_t sdio_bd_address(sdio_t sdio, uint32_t block)
+{
+    // SDHC cards are block addressed, others are byte addressed
+    if (sd_get_type(sdio) != SDHC)
+    {
+        return block * BLOCKDEV_BLOCK_SIZE;
+    }
+
+    return block;
+}
+
+static blockdev_error_t sdio_bd_read(void *arg, uint32_t block, uint8_t *buf)
+{
+    sdio_t sdio = (sdio_t)arg;
+    sd_error_t ret;
+
+    ret = sd_read_single_block(sdio, sdio_bd_address(sdio, block), buf);
+
+    if (ret != SD_NO_ERROR)
+    {
+        log_debug("SD read of block %u failed: %d", block, ret);
+        return BLOCKDEV_READ_ERROR;
+    }
+
+    // Wait for DMA transfer to be completed
+    xSemaphoreTake(sd_transfer_mutex, portMAX_DELAY);
+
+    // Check if no error occured during transfer
+    if (transfer_error != SD_NO_ERROR)
+    {
+        log_debug("SD read transfer of block %u failed: %d", block, transfer_error);
+        return BLOCKDEV_READ_ERROR;
+    }
+
+    return BLOCKDEV_OK;
+}
+
+static blockdev_error_t sdio_bd_write(void *arg, uint32_t block, const uint8_t *buf)
+{
+    sdio_t sdio = (sdio_t)arg;
+    sd_error_t ret;
+
+    // The SDIO driver does not modify the buffer, it only lacks the const qualifier
+    ret = sd_write_single_block(sdio, sdio_bd_address(sdio, block), (uint8_t *)buf);
+
+    if (ret != SD_NO_ERROR)
+    {
+        log_debug("SD write of block %u failed: %d", block, ret);
+        return BLOCKDEV_WRITE_ERROR;
+    }
+
+    // Wait for DMA transfer to be completed
+    xSemaphoreTake(sd_transfer_mutex, portMAX_DELAY);
+
+    // Check if no error occured during transfer
+    if (transfer_error != SD_NO_ERROR)
+    {
+        log_debug("SD write transfer of block %u failed: %d", block, transfer_error);
+        return BLOCKDEV_WRITE_ERROR;
+    }
+
+    return BLOCKDEV_OK;
+}
+
+static uint32_t sdio_bd_size(void *arg)
+{
+    return sd_get_size((sdio_t)arg);
+}
+
+void blockdev_sdio_config(blockdev_t *dev, sdio_t sdio)
+{
+    dev->init = sdio_bd_init;
+    dev->read = sdio_bd_read;
+    dev->write = sdio_bd_write;
+    dev->size = sdio_bd_size;
+    dev->arg = sdio;
+}
@@ -36,9 +36,9 @@
 fat32_t fat;
 static uint32_t last_free_cluster = 0;
 
-fat32_error_t fat32_init()
+fat32_error_t fat32_init(const blockdev_t *dev)
 {
-    if (fs_init() != FS_OK)
+    if (fs_init(dev) != FS_OK)
     {
         return FAT32_FS_ERROR;
     }
@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "blockdev.h"
 
 typedef struct
 {
@@ -73,7 +74,11 @@ typedef enum
 
 extern fat32_t fat;
 
-fat32_error_t fat32_init();
+/**
+ * Initialize the FAT32 library on top of a block device.
+ * The block device must remain valid while the file system is in use.
+ */
+fat32_error_t fat32_init(const blockdev_t *dev);
 
 fat32_error_t fat32_mount();
 
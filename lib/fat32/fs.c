@@ -27,7 +27,7 @@
 #include "semphr.h"
 #include "task.h"
 #include "platform.h"
-#include "sdio.h"
+#include "blockdev.h"
 #include "buf_util.h"
 #include "fs.h"
 #include "printf.h"
@@ -39,8 +39,6 @@
  * less used buffer). Maybe it does not matter
  */
 
-extern sdio_t sdio;
-
 #define FS_POOL_SIZE  30
 
 #define MAX_RETRY          3
@@ -54,8 +52,11 @@ static buffer_t pool[FS_POOL_SIZE];
 // Semaphore indicating how much dirty buffers there is
 static xSemaphoreHandle dirty_sem;
 
-// Mutexes for resource management
-static xSemaphoreHandle sd_access_mutex, sd_transfer_mutex;
+// Mutex for medium access
+static xSemaphoreHandle medium_access_mutex;
+
+// Underlying block device
+static const blockdev_t *dev;
 
 // Mutex for thread waiting for a clean buffer to be available
 static xSemaphoreHandle waiting_for_clean_mutex;
@@ -68,29 +69,14 @@ static void vWriteTask(void *pvParameters);
 // Error recovery
 static uint16_t failed_attempt;
 
-// SD card error
-static sd_error_t transfer_error;
-
 #define min(a,b) ((a)<(b)?(a):(b))
 
-void transfer_handler(handler_arg_t arg)
-{
-    signed portBASE_TYPE pxHigherPriorityTaskWoken;
-
-    transfer_error = (sd_error_t)arg;
-
-    xSemaphoreGiveFromISR(sd_transfer_mutex, &pxHigherPriorityTaskWoken);
-
-    if (pxHigherPriorityTaskWoken != pdFALSE)
-    {
-        portYIELD();
-    }
-}
-
-fs_error_t fs_init()
+fs_error_t fs_init(const blockdev_t *device)
 {
     int i;
 
+    dev = device;
+
     // Initialize the minimum counting to the size of the pool,
     // set the counter to the min value at first so that the
     // first call on wait will be blocking (except if another
@@ -98,8 +84,7 @@ fs_error_t fs_init()
     dirty_sem = xSemaphoreCreateCounting(FS_POOL_SIZE, 0);
 
     // Initialize SD card access mutex
-    sd_access_mutex = xSemaphoreCreateMutex();
-    sd_transfer_mutex = xSemaphoreCreateCounting(1, 0);
+    medium_access_mutex = xSemaphoreCreateMutex();
 
     // Initialize the "waiting for clean buffer" mutex
     waiting_for_clean_mutex = xSemaphoreCreateCounting(1, 0);
@@ -118,13 +103,11 @@ fs_error_t fs_init()
         pool[i].use = 0;
     }
 
-    if (sd_init(sdio) != SD_NO_ERROR)
+    if (dev->init(dev->arg) != BLOCKDEV_OK)
     {
         return FS_MEDIUM_INIT_ERROR;
     }
 
-    sd_set_transfer_handler(sdio, transfer_handler);
-
     xTaskCreate(vWriteTask, (signed char *)"SDWrite", configMINIMAL_STACK_SIZE, NULL, 2, NULL);
 
     return FS_OK;
@@ -184,20 +167,20 @@ inline static void failed()
 
     if (failed_attempt > MAX_FAILED_ATTEMPT)
     {
-        log_warning("Too many failed attempts, trying to reinit SD card");
+        log_warning("Too many failed attempts, trying to reinit medium");
         failed_attempt = 0;
-        xSemaphoreTake(sd_access_mutex, portMAX_DELAY);
+        xSemaphoreTake(medium_access_mutex, portMAX_DELAY);
 
-        if (sd_init(sdio) != SD_NO_ERROR)
+        if (dev->init(dev->arg) != BLOCKDEV_OK)
         {
-            log_error("Cannot reinit SD card");
+            log_error("Cannot reinit medium");
 
             // Not recoverable error...
             HALT();
         }
 
-        xSemaphoreGive(sd_access_mutex);
-        log_info("SD card reinitialized");
+        xSemaphoreGive(medium_access_mutex);
+        log_info("Medium reinitialized");
     }
 }
 
@@ -206,73 +189,39 @@ inline static void passed()
     failed_attempt = 0;
 }
 
-inline static sd_error_t safe_read(uint32_t page, uint8_t *buf)
+inline static blockdev_error_t safe_read(uint32_t page, uint8_t *buf)
 {
-    sd_error_t ret;
+    blockdev_error_t ret;
 
     // Take medium access lock
-    xSemaphoreTake(sd_access_mutex, portMAX_DELAY);
+    xSemaphoreTake(medium_access_mutex, portMAX_DELAY);
 
-    if (sd_get_type(sdio) != SDHC)
-    {
-        ret = sd_read_single_block(sdio, page * 512ul, buf);
-    }
-    else
-    {
-        ret = sd_read_single_block(sdio, page, buf);
-    }
-
-    if (ret == SD_NO_ERROR)
-    {
-        // Wait for DMA transfer to be completed
-        xSemaphoreTake(sd_transfer_mutex, portMAX_DELAY);
-
-        // Check if no error occured during transfer
-        if (transfer_error != SD_NO_ERROR)
-        {
-            ret = FS_READ_FAILED;
-        }
-    }
+    // The block device returns once the page is in the buffer
+    ret = dev->read(dev->arg, page, buf);
 
     // Realease medium access lock
-    xSemaphoreGive(sd_access_mutex);
+    xSemaphoreGive(medium_access_mutex);
 
     return ret;
 }
 
-inline static sd_error_t safe_write(buffer_t *buffer)
+inline static blockdev_error_t safe_write(buffer_t *buffer)
 {
-    sd_error_t ret = SD_NO_ERROR;
+    blockdev_error_t ret;
 
-    xSemaphoreTake(sd_access_mutex, portMAX_DELAY);
+    xSemaphoreTake(medium_access_mutex, portMAX_DELAY);
 
-    if (sd_get_type(sdio) != SDHC)
-    {
-        ret = sd_write_single_block(sdio, buffer->page * 512ul, buffer->content);
-    }
-    else
-    {
-        ret = sd_write_single_block(sdio, buffer->page, buffer->content);
-    }
+    ret = dev->write(dev->arg, buffer->page, buffer->content);
 
-    if (ret == SD_NO_ERROR)
+    if (ret == BLOCKDEV_OK)
     {
-        // As we wrote the page on the micro SD card, the flash page is
+        // As we wrote the page on the medium, the flash page is
         // consistent with the buffer, so the page is not dirty anymore
         buffer->dirty = false;
         buffer->use = 1;
-
-        // Wait for DMA transfer to be completed
-        xSemaphoreTake(sd_transfer_mutex, portMAX_DELAY);
-
-        // Check if no error occured during transfer
-        if (transfer_error != SD_NO_ERROR)
-        {
-            ret = transfer_error;
-        }
     }
 
-    xSemaphoreGive(sd_access_mutex);
+    xSemaphoreGive(medium_access_mutex);
 
     return ret;
 }
@@ -282,7 +231,7 @@ uint16_t fs_write(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size)
     uint32_t i;
     uint16_t s = min(size, 512 - offset);
     buffer_t *b;
-    sd_error_t ret;
+    blockdev_error_t ret;
 
     while (true)
     {
@@ -365,7 +314,7 @@ uint16_t fs_write(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size)
                 for (i = 0; i < MAX_RETRY; i++)
                 {
                     // In this case, the page has to be loaded first
-                    if ((ret = safe_read(page, b->content)) == SD_NO_ERROR)
+                    if ((ret = safe_read(page, b->content)) == BLOCKDEV_OK)
                     {
                         passed();
                         break;
@@ -375,7 +324,7 @@ uint16_t fs_write(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size)
                     failed();
                 }
 
-                if (ret != SD_NO_ERROR)
+                if (ret != BLOCKDEV_OK)
                 {
                     // If there is an error, report it by telling the
                     // caller that no byte has been read
@@ -427,7 +376,7 @@ uint16_t fs_read(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size)
     uint32_t i;
     uint16_t s = min(size, 512 - offset);
     buffer_t *b;
-    sd_error_t ret;
+    blockdev_error_t ret;
 
     while (true)
     {
@@ -464,7 +413,7 @@ uint16_t fs_read(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size)
             // Read the page
             for (i = 0; i < MAX_RETRY; i++)
             {
-                if ((ret = safe_read(page, b->content)) == SD_NO_ERROR)
+                if ((ret = safe_read(page, b->content)) == BLOCKDEV_OK)
                 {
                     // If the page is successfully read, copy the data
                     cpy(b->content + offset, buf, s);
@@ -477,7 +426,7 @@ uint16_t fs_read(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size)
                 failed();
             }
 
-            if (ret != SD_NO_ERROR)
+            if (ret != BLOCKDEV_OK)
             {
                 // Else signal the error
                 s = 0;
@@ -512,7 +461,7 @@ void vWriteTask(void *pvParameters)
 {
     int i, j;
     uint8_t use_min;
-    sd_error_t ret;
+    blockdev_error_t ret;
 
     while (true)
     {
@@ -557,7 +506,7 @@ void vWriteTask(void *pvParameters)
         xSemaphoreGive(pool[j].vMutex);
 
         // We found the best buffer to write on the micro SD card
-        if ((ret = safe_write(&(pool[j]))) != SD_NO_ERROR)
+        if ((ret = safe_write(&(pool[j]))) != BLOCKDEV_OK)
         {
             // If write failed leave the buffer dirty and wait for another attempt
             xSemaphoreGive(dirty_sem);
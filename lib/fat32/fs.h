@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "blockdev.h"
 
 typedef struct
 {
@@ -46,7 +47,7 @@ typedef struct
     // Buffer status
     bool dirty;
 
-    // Page location on the SD card
+    // Page location on the medium
     uint32_t page;
 
     // Used only for read buffer
@@ -55,7 +56,7 @@ typedef struct
 
 typedef enum {FS_OK, FS_MEDIUM_INIT_ERROR, FS_READ_FAILED} fs_error_t;
 
-fs_error_t fs_init();
+fs_error_t fs_init(const blockdev_t *device);
 uint16_t fs_write(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size);
 uint16_t fs_read(uint32_t page, uint16_t offset, uint8_t *buf, uint16_t size);
 
@@ -30,8 +30,18 @@
 #include "event.h"
 #include "soft_timer.h"
 
+static int select_input(fiteco_lib_gwt_current_monitor_selection_t selection);
 static void current_sample_ready_isr(handler_arg_t arg);
 static void process_current_sample(handler_arg_t arg);
+static void raw_sample_ready_isr(handler_arg_t arg);
+static void raw_sample_read_isr(handler_arg_t arg, unsigned error);
+static void process_raw_samples(handler_arg_t arg);
+
+typedef struct
+{
+    uint32_t timestamp;
+    uint16_t values[4];
+} raw_sample_t;
 
 static struct
 {
@@ -39,6 +49,27 @@ static struct
 
     uint32_t isr_timestamp;
     fiteco_lib_gwt_current_monitor_handler_t handler;
+
+    /** Raw capture */
+    struct
+    {
+        uint8_t registers;
+        fiteco_lib_gwt_current_monitor_raw_handler_t handler;
+        handler_arg_t arg;
+
+        /**
+         * Ring of samples, head is only written from interrupt and tail from
+         * the event queue, both are free running.
+         */
+        raw_sample_t ring[FITECO_GWT_RAW_RING_LENGTH];
+        volatile uint8_t head, tail;
+
+        /** Sample read when the ring is full, then dropped */
+        raw_sample_t spare;
+
+        volatile uint8_t process_posted;
+        uint32_t dropped;
+    } raw;
 } gwt;
 
 void fiteco_lib_gwt_set_config(const fiteco_lib_gwt_config_t* config)
@@ -75,13 +106,59 @@ void fiteco_lib_gwt_current_monitor_select(
 {
     // Store handler
     gwt.handler = handler;
+    gwt.raw.handler = NULL;
+
+    if (!select_input(selection))
+    {
+        return;
+    }
 
+    // Enable interrupt
+    ina226_alert_enable(current_sample_ready_isr, arg);
+
+    // Initial read to start measures
+    ina226_read(NULL, NULL, NULL, NULL );
+}
+
+void fiteco_lib_gwt_current_monitor_select_raw(
+        fiteco_lib_gwt_current_monitor_selection_t selection,
+        uint8_t registers,
+        fiteco_lib_gwt_current_monitor_raw_handler_t handler,
+        handler_arg_t arg)
+{
+    // Store handler and empty the ring
+    gwt.handler = NULL;
+    gwt.raw.registers = registers;
+    gwt.raw.handler = handler;
+    gwt.raw.arg = arg;
+    gwt.raw.head = gwt.raw.tail = 0;
+    gwt.raw.dropped = 0;
+
+    if (!select_input(selection))
+    {
+        return;
+    }
+
+    // Enable interrupt
+    ina226_alert_enable(raw_sample_ready_isr, NULL);
+
+    // Initial read to start measures
+    ina226_read(NULL, NULL, NULL, NULL );
+}
+
+uint32_t fiteco_lib_gwt_current_monitor_raw_dropped()
+{
+    return gwt.raw.dropped;
+}
+
+static int select_input(fiteco_lib_gwt_current_monitor_selection_t selection)
+{
     switch (selection)
     {
         case FITECO_GWT_CURRENT_MONITOR__OFF:
             adg759_disable(gwt.config->current_mux);
             ina226_disable();
-            return;
+            return 0;
 
         case FITECO_GWT_CURRENT_MONITOR__OPEN_3V:
             adg759_enable(gwt.config->current_mux);
@@ -108,11 +185,7 @@ void fiteco_lib_gwt_current_monitor_select(
             break;
     }
 
-    // Enable interrupt
-    ina226_alert_enable(current_sample_ready_isr, arg);
-
-    // Initial read to start measures
-    ina226_read(NULL, NULL, NULL, NULL );
+    return 1;
 }
 
 static void current_sample_ready_isr(handler_arg_t arg)
@@ -134,6 +207,71 @@ static void process_current_sample(handler_arg_t arg)
     }
 }
 
+static void raw_sample_ready_isr(handler_arg_t arg)
+{
+    raw_sample_t *sample;
+
+    // Read into the spare sample if the ring is full, to clear the alert
+    if ((uint8_t)(gwt.raw.head - gwt.raw.tail) < FITECO_GWT_RAW_RING_LENGTH)
+    {
+        sample = &gwt.raw.ring[gwt.raw.head % FITECO_GWT_RAW_RING_LENGTH];
+    }
+    else
+    {
+        sample = &gwt.raw.spare;
+    }
+
+    uint32_t timestamp = soft_timer_time();
+
+    // The reads are submitted from here, the result comes in their handler
+    if (ina226_read_raw_async(gwt.raw.registers, sample->values,
+            raw_sample_read_isr, sample) != 0)
+    {
+        // Previous read still in progress, this sample is lost
+        gwt.raw.dropped++;
+        return;
+    }
+
+    // The I2C transfers last much longer than this
+    sample->timestamp = timestamp;
+}
+
+static void raw_sample_read_isr(handler_arg_t arg, unsigned error)
+{
+    if (error || arg == &gwt.raw.spare)
+    {
+        gwt.raw.dropped++;
+        return;
+    }
+
+    gwt.raw.head++;
+
+    if (!gwt.raw.process_posted)
+    {
+        gwt.raw.process_posted = 1;
+        event_post_from_isr(EVENT_QUEUE_APPLI, process_raw_samples, NULL);
+    }
+}
+
+static void process_raw_samples(handler_arg_t arg)
+{
+    // Clear first, so that samples added from now on post a new event
+    gwt.raw.process_posted = 0;
+
+    while (gwt.raw.tail != gwt.raw.head)
+    {
+        raw_sample_t *sample =
+                &gwt.raw.ring[gwt.raw.tail % FITECO_GWT_RAW_RING_LENGTH];
+
+        if (gwt.raw.handler)
+        {
+            gwt.raw.handler(gwt.raw.arg, sample->values, sample->timestamp);
+        }
+
+        gwt.raw.tail++;
+    }
+}
+
 void fiteco_lib_gwt_opennode_power_select(
         fiteco_lib_gwt_opennode_power_selection_t selection)
 {
@@ -0,0 +1,350 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2012 HiKoB.
+ */
+
+/*
+ * \file fiteco_lib_gwt_native.c
+ *
+ * Simulated current monitor for the native platform.
+ *
+ * A host thread raises the INA226 ALERT interrupt at the conversion rate of
+ * the configured sampling period and averaging, the samples follow an open
+ * node drawing a constant current plus periodic radio bursts. The samples
+ * are delivered in the same contexts as on the hardware.
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+
+#include "fiteco_lib_gwt.h"
+
+#include "ina226.h"
+#include "event.h"
+#include "soft_timer.h"
+#include "random.h"
+
+static void *alert_thread(void *arg);
+static void current_sample_ready_isr(void *arg);
+static void process_current_sample(handler_arg_t arg);
+static void process_raw_samples(handler_arg_t arg);
+
+typedef struct
+{
+    uint32_t timestamp;
+    uint16_t values[4];
+} raw_sample_t;
+
+static struct
+{
+    /** Conversion time of a sample, in ns */
+    uint64_t period_ns;
+    /** Simulated input */
+    float voltage, r_shunt, base_current, current_lsb;
+
+    /** ALERT thread control */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int thread_started;
+    volatile int running;
+
+    uint32_t isr_timestamp;
+    /** The sample is not read yet, the ALERT pin stays low */
+    volatile uint8_t alert_pending;
+    fiteco_lib_gwt_current_monitor_handler_t handler;
+    handler_arg_t arg;
+
+    /** Raw capture */
+    struct
+    {
+        uint8_t registers;
+        fiteco_lib_gwt_current_monitor_raw_handler_t handler;
+        handler_arg_t arg;
+
+        raw_sample_t ring[FITECO_GWT_RAW_RING_LENGTH];
+        volatile uint8_t head, tail;
+
+        volatile uint8_t process_posted;
+        uint32_t dropped;
+    } raw;
+} gwt =
+{
+    .period_ns = 1100000,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+void fiteco_lib_gwt_current_monitor_stop()
+{
+    gwt.running = 0;
+}
+
+void fiteco_lib_gwt_current_monitor_configure(ina226_sampling_period_t period,
+        ina226_averaging_factor_t average)
+{
+    static const uint16_t periods_us[] =
+    { 140, 204, 332, 588, 1100, 2116, 4156, 8244 };
+    static const uint16_t averages[] =
+    { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+    // Both the shunt and bus voltages are converted for each sample
+    gwt.period_ns = 2000ull * periods_us[period & 7] * averages[average & 7];
+}
+
+static int select_input(fiteco_lib_gwt_current_monitor_selection_t selection)
+{
+    switch (selection)
+    {
+        case FITECO_GWT_CURRENT_MONITOR__OPEN_3V:
+            gwt.voltage = 3.3f;
+            gwt.r_shunt = 1;
+            gwt.base_current = 0.012f;
+            gwt.current_lsb = 0.160f / (1 << 15);
+            break;
+
+        case FITECO_GWT_CURRENT_MONITOR__OPEN_5V:
+            gwt.voltage = 5.0f;
+            gwt.r_shunt = 0.082f;
+            gwt.base_current = 0.040f;
+            gwt.current_lsb = 0.8f / (1 << 15);
+            break;
+
+        case FITECO_GWT_CURRENT_MONITOR__BATTERY:
+            gwt.voltage = 3.9f;
+            gwt.r_shunt = 0.082f;
+            gwt.base_current = 0.012f;
+            gwt.current_lsb = 0.8f / (1 << 15);
+            break;
+
+        default:
+            gwt.running = 0;
+            return 0;
+    }
+
+    // Start the ALERT interrupts
+    pthread_mutex_lock(&gwt.mutex);
+    if (!gwt.thread_started)
+    {
+        pthread_t thread;
+        pthread_create(&thread, NULL, alert_thread, NULL);
+        gwt.thread_started = 1;
+    }
+    gwt.alert_pending = 0;
+    gwt.running = 1;
+    pthread_cond_signal(&gwt.cond);
+    pthread_mutex_unlock(&gwt.mutex);
+
+    return 1;
+}
+
+void fiteco_lib_gwt_current_monitor_select(
+        fiteco_lib_gwt_current_monitor_selection_t selection,
+        fiteco_lib_gwt_current_monitor_handler_t handler, handler_arg_t arg)
+{
+    gwt.handler = handler;
+    gwt.arg = arg;
+    gwt.raw.handler = NULL;
+
+    select_input(selection);
+}
+
+void fiteco_lib_gwt_current_monitor_select_raw(
+        fiteco_lib_gwt_current_monitor_selection_t selection,
+        uint8_t registers,
+        fiteco_lib_gwt_current_monitor_raw_handler_t handler,
+        handler_arg_t arg)
+{
+    gwt.handler = NULL;
+    gwt.raw.registers = registers;
+    gwt.raw.handler = handler;
+    gwt.raw.arg = arg;
+    gwt.raw.head = gwt.raw.tail = 0;
+    gwt.raw.dropped = 0;
+
+    select_input(selection);
+}
+
+uint32_t fiteco_lib_gwt_current_monitor_raw_dropped()
+{
+    return gwt.raw.dropped;
+}
+
+float ina226_get_current_lsb()
+{
+    return gwt.current_lsb;
+}
+
+/** Simulated current, with 2ms radio bursts every 10ms */
+static float sample_current(uint32_t t)
+{
+    float current = gwt.base_current;
+
+    if (t % soft_timer_ms_to_ticks(10) < soft_timer_ms_to_ticks(2))
+    {
+        current += 0.015f;
+    }
+
+    return current + (random_rand16() % 100) * 1e-5f;
+}
+
+static void raw_sample_ready_isr(uint32_t timestamp)
+{
+    if ((uint8_t)(gwt.raw.head - gwt.raw.tail) >= FITECO_GWT_RAW_RING_LENGTH)
+    {
+        gwt.raw.dropped++;
+        return;
+    }
+
+    raw_sample_t *sample = &gwt.raw.ring[gwt.raw.head % FITECO_GWT_RAW_RING_LENGTH];
+    float current = sample_current(timestamp);
+    uint16_t *value = sample->values;
+
+    sample->timestamp = timestamp;
+
+    // Registers in the order of the ina226_raw_register_t bits
+    if (gwt.raw.registers & INA226_RAW_SHUNT_VOLTAGE)
+    {
+        *value++ = current * gwt.r_shunt / INA226_SHUNT_VOLTAGE_LSB;
+    }
+    if (gwt.raw.registers & INA226_RAW_BUS_VOLTAGE)
+    {
+        *value++ = gwt.voltage / INA226_BUS_VOLTAGE_LSB;
+    }
+    if (gwt.raw.registers & INA226_RAW_POWER)
+    {
+        *value++ = current * gwt.voltage
+                   / (INA226_POWER_LSB_RATIO * gwt.current_lsb);
+    }
+    if (gwt.raw.registers & INA226_RAW_CURRENT)
+    {
+        *value++ = current / gwt.current_lsb;
+    }
+
+    gwt.raw.head++;
+
+    if (!gwt.raw.process_posted)
+    {
+        gwt.raw.process_posted = 1;
+        event_post_from_isr(EVENT_QUEUE_APPLI, process_raw_samples, NULL);
+    }
+}
+
+static void current_sample_ready_isr(void *arg)
+{
+    if (!gwt.running)
+    {
+        return;
+    }
+
+    if (gwt.raw.handler)
+    {
+        raw_sample_ready_isr(soft_timer_time());
+        return;
+    }
+
+    // No new edge until the previous sample is read, as on the real INA226
+    if (gwt.alert_pending)
+    {
+        return;
+    }
+
+    gwt.alert_pending = 1;
+    gwt.isr_timestamp = soft_timer_time();
+    event_post_from_isr(EVENT_QUEUE_APPLI, process_current_sample, gwt.arg);
+}
+
+static void process_current_sample(handler_arg_t arg)
+{
+    uint32_t t = gwt.isr_timestamp;
+    float i = sample_current(t);
+
+    gwt.alert_pending = 0;
+
+    if (gwt.handler)
+    {
+        gwt.handler(arg, gwt.voltage, i, gwt.voltage * i, i * gwt.r_shunt, t);
+    }
+}
+
+static void process_raw_samples(handler_arg_t arg)
+{
+    // Clear first, so that samples added from now on post a new event
+    gwt.raw.process_posted = 0;
+
+    while (gwt.raw.tail != gwt.raw.head)
+    {
+        raw_sample_t *sample =
+                &gwt.raw.ring[gwt.raw.tail % FITECO_GWT_RAW_RING_LENGTH];
+
+        if (gwt.raw.handler)
+        {
+            gwt.raw.handler(gwt.raw.arg, sample->values, sample->timestamp);
+        }
+
+        gwt.raw.tail++;
+    }
+}
+
+static void *alert_thread(void *arg)
+{
+    struct timespec now, next;
+    uint64_t next_ns = 0;
+
+    while (1)
+    {
+        pthread_mutex_lock(&gwt.mutex);
+        while (!gwt.running)
+        {
+            pthread_cond_wait(&gwt.cond, &gwt.mutex);
+            next_ns = 0;
+        }
+        pthread_mutex_unlock(&gwt.mutex);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+
+        // Start over after a stop, or when too late
+        if (next_ns == 0 || now_ns > next_ns + 16 * gwt.period_ns)
+        {
+            next_ns = now_ns;
+        }
+
+        next_ns += gwt.period_ns;
+        next.tv_sec = next_ns / 1000000000ull;
+        next.tv_nsec = next_ns % 1000000000ull;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        vPortNativeInterrupt(current_sample_ready_isr, NULL);
+    }
+
+    return NULL;
+}
+
+void fiteco_lib_gwt_opennode_power_select(
+        fiteco_lib_gwt_opennode_power_selection_t selection)
+{
+}
+
+void fiteco_lib_gwt_battery_charge_enable()
+{
+}
+
+void fiteco_lib_gwt_battery_charge_disable()
+{
+}
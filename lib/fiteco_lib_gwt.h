@@ -70,6 +70,53 @@ void fiteco_lib_gwt_current_monitor_select(
         fiteco_lib_gwt_current_monitor_selection_t selection,
         fiteco_lib_gwt_current_monitor_handler_t handler, handler_arg_t arg);
 
+#ifndef FITECO_GWT_RAW_RING_LENGTH
+/**
+ * Number of raw samples buffered between the ALERT interrupt and the handler,
+ * a power of 2 up to 128.
+ */
+#define FITECO_GWT_RAW_RING_LENGTH 32
+#endif
+
+/**
+ * Handler for raw current monitor sample.
+ *
+ * The values are the raw INA226 registers selected with
+ * \ref fiteco_lib_gwt_current_monitor_select_raw, in the order of the
+ * \ref ina226_raw_register_t bits.
+ */
+typedef void (*fiteco_lib_gwt_current_monitor_raw_handler_t)(
+        handler_arg_t arg, const uint16_t *values, uint32_t timestamp);
+
+/**
+ * Select the input for the Current Monitor circuit and start sampling raw
+ * registers.
+ *
+ * The registers are read by asynchronous I2C transfers started from the
+ * ALERT interrupt, and buffered in a ring. The handler is called from the
+ * application event queue for each buffered sample, without conversion: the
+ * values are to be multiplied by the LSB values of the INA226, see
+ * \ref ina226_get_current_lsb.
+ *
+ * \param selection the power input to measure
+ * \param registers the registers to read, a combination of
+ *      \ref ina226_raw_register_t
+ * \param handler the handler function to call on each new measure
+ * \param arg optional argument to provide to the handler
+ */
+void fiteco_lib_gwt_current_monitor_select_raw(
+        fiteco_lib_gwt_current_monitor_selection_t selection,
+        uint8_t registers,
+        fiteco_lib_gwt_current_monitor_raw_handler_t handler,
+        handler_arg_t arg);
+
+/**
+ * Get the number of raw samples lost since the last selection, because the
+ * ring was full, the previous read was not complete or an I2C error
+ * occurred.
+ */
+uint32_t fiteco_lib_gwt_current_monitor_raw_dropped();
+
 typedef enum
 {
     FITECO_GWT_OPENNODE_POWER__OFF = 0,
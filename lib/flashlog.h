@@ -0,0 +1,282 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/**
+ * \file flashlog.h
+ */
+
+#ifndef FLASHLOG_H_
+#define FLASHLOG_H_
+
+/**
+ * \addtogroup lib
+ * @{
+ */
+
+/**
+ * \defgroup flashlog Flash record log
+ *
+ * Append-only record log on a NOR flash.
+ *
+ * Records (up to \ref FLASHLOG_MAX_RECORD bytes) are packed in RAM pages
+ * which are programmed sequentially on the flash. The log region is used as
+ * a circular buffer of erase blocks: when the write head enters a block, the
+ * next block is erased in the background (erase-ahead) so that appending
+ * never waits for an erase cycle. If the head catches up with unread data,
+ * the oldest block is overwritten. As blocks are always reused in the same
+ * circular order, every block of the region gets the same number of erase
+ * cycles; the erase count is stored in every page header for monitoring.
+ *
+ * Each page carries a header with a 32-bit sequence number and a CRC. On
+ * \ref flashlog_mount, the head and tail are recovered from these headers,
+ * pages torn by a power loss are skipped. Reading a page marks it consumed
+ * in flash (by clearing a header byte), so drained data is not read again
+ * after a reset.
+ *
+ * Flash operations are never waited for in \ref flashlog_append: full pages
+ * are queued in RAM and programmed by \ref flashlog_process whenever the
+ * flash is idle. The application must call \ref flashlog_process regularly
+ * (e.g. from a soft timer). The library is not reentrant, all calls on a
+ * given log must be done from the same task.
+ *
+ * @{
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Size of a program page, in bytes */
+#define FLASHLOG_PAGE_SIZE      256
+/** Size of an erase block, in bytes */
+#define FLASHLOG_BLOCK_SIZE     4096
+/** Number of pages in an erase block */
+#define FLASHLOG_BLOCK_PAGES    (FLASHLOG_BLOCK_SIZE / FLASHLOG_PAGE_SIZE)
+/** Size of the header at the beginning of every page */
+#define FLASHLOG_HEADER_SIZE    12
+/** Maximum length of a record, one byte per record is used for its length */
+#define FLASHLOG_MAX_RECORD     (FLASHLOG_PAGE_SIZE - FLASHLOG_HEADER_SIZE - 1)
+
+#ifndef FLASHLOG_PAGE_BUFFERS
+/** Number of RAM pages absorbing the flash program and erase times */
+#define FLASHLOG_PAGE_BUFFERS   4
+#endif
+
+/**
+ * NOR flash device used by the log.
+ *
+ * Program and erase only start the operation, the completion is polled
+ * with busy. Read is only called when the device is not busy.
+ */
+typedef struct
+{
+    /** Read any number of bytes */
+    void (*read)(void *arg, uint32_t address, uint8_t *buf, uint16_t len);
+    /** Start programming a page, address is page aligned, buf may be reused on return */
+    void (*program_page)(void *arg, uint32_t address, const uint8_t *buf);
+    /** Start erasing a block, address is block aligned */
+    void (*erase_block)(void *arg, uint32_t address);
+    /** Check if a program or erase operation is in progress */
+    bool (*busy)(void *arg);
+
+    /** Implementation specific argument given to every callback */
+    void *arg;
+} flashlog_nor_t;
+
+typedef struct
+{
+    /** Number of records appended */
+    uint32_t records_written;
+    /** Number of records lost because all the RAM pages were full */
+    uint32_t records_dropped;
+    /** Number of unread pages overwritten because the log was full */
+    uint32_t pages_overwritten;
+    /** Number of pages skipped because of a bad CRC */
+    uint32_t pages_corrupted;
+    /** Number of blocks erased since mount */
+    uint32_t blocks_erased;
+    /** Highest erase count seen on a block since mount */
+    uint32_t max_erase_count;
+} flashlog_stats_t;
+
+typedef struct
+{
+    /** The NOR device */
+    const flashlog_nor_t *nor;
+    /** Start address of the log region, block aligned */
+    uint32_t start;
+    /** Number of blocks of the log region */
+    uint32_t num_blocks;
+
+    /** Index of the next page to program */
+    uint32_t head;
+    /** Index of the oldest unread page */
+    uint32_t tail;
+    /** Sequence number of the next page to program */
+    uint32_t next_seq;
+    /** Erase count of the block being written */
+    uint32_t head_erase_count;
+    /** Erase count of the block erased ahead */
+    uint32_t next_erase_count;
+    /** Block to erase before programming in it, or -1 */
+    int32_t erase_block;
+    /** Block which will be entered next has been erased */
+    bool next_erased;
+
+    /** RAM pages, filled by append and emptied by process */
+    uint8_t pages[FLASHLOG_PAGE_BUFFERS][FLASHLOG_PAGE_SIZE];
+    /** Index of the first queued page */
+    uint8_t queue_first;
+    /** Number of queued pages, including the one being filled */
+    uint8_t queue_count;
+    /** Write offset in the page being filled, 0 if none */
+    uint16_t fill_offset;
+
+    /** Page being read */
+    uint8_t read_page[FLASHLOG_PAGE_SIZE];
+    /** Index of the page being read */
+    uint32_t read_index;
+    /** Read offset in read_page, 0 if no page is loaded */
+    uint16_t read_offset;
+
+    flashlog_stats_t stats;
+} flashlog_t;
+
+/**
+ * Configure a log on a region of a NOR flash.
+ *
+ * \param log the log to configure
+ * \param nor the flash device
+ * \param start the start address of the region, aligned on \ref FLASHLOG_BLOCK_SIZE
+ * \param size the size of the region in bytes, at least 3 blocks
+ */
+void flashlog_config(flashlog_t *log, const flashlog_nor_t *nor,
+                     uint32_t start, uint32_t size);
+
+/**
+ * Recover the log state from the flash content.
+ *
+ * A blank or foreign region results in an empty log. This may take some time
+ * as the first page of every block is read, plus some pages of the head and
+ * tail blocks.
+ */
+void flashlog_mount(flashlog_t *log);
+
+/**
+ * Erase the whole log region, blocking.
+ */
+void flashlog_format(flashlog_t *log);
+
+/**
+ * Append a record to the log.
+ *
+ * This never waits for the flash. The record is lost (and counted in the
+ * statistics) if all the RAM pages are waiting to be programmed.
+ *
+ * \param data the record content
+ * \param len the record length, from 1 to \ref FLASHLOG_MAX_RECORD
+ * \return true if the record was stored
+ */
+bool flashlog_append(flashlog_t *log, const uint8_t *data, uint16_t len);
+
+/**
+ * Run the background flash operations.
+ *
+ * If the flash is idle, starts the next erase-ahead or page program.
+ *
+ * \return true if there is still work to do
+ */
+bool flashlog_process(flashlog_t *log);
+
+/**
+ * Queue the partially filled page for programming, without waiting.
+ */
+void flashlog_flush(flashlog_t *log);
+
+/**
+ * Queue the partially filled page and wait until everything is on flash.
+ */
+void flashlog_sync(flashlog_t *log);
+
+/**
+ * Read and consume the oldest record on flash.
+ *
+ * Only records which have been programmed are visible, call
+ * \ref flashlog_sync first to drain everything. Records are read one page
+ * at a time, a page is marked consumed on flash when the read following its
+ * last record is done, so a record may be read twice across a reset but is
+ * never lost. This waits for any flash operation in progress.
+ *
+ * \param buf the buffer to fill
+ * \param size the buffer size, longer records are truncated
+ * \return the record length, 0 if the log is empty
+ */
+uint16_t flashlog_read(flashlog_t *log, uint8_t *buf, uint16_t size);
+
+/**
+ * Get the number of unread pages on flash.
+ */
+uint32_t flashlog_pending_pages(const flashlog_t *log);
+
+/**
+ * Get the log statistics.
+ */
+static inline const flashlog_stats_t *flashlog_get_stats(const flashlog_t *log)
+{
+    return &log->stats;
+}
+
+/**
+ * Get the NOR device of the N25xxx flash of the platform.
+ */
+const flashlog_nor_t *flashlog_nor_n25xxx();
+
+/**
+ * RAM simulated NOR device.
+ *
+ * Programming can only clear bits, erasing sets a block to 0xFF, and the
+ * device stays busy for the typical N25Q program and erase times.
+ */
+typedef struct
+{
+    uint8_t *mem;
+    uint32_t size;
+
+    /** Clock in microseconds */
+    uint32_t (*clock_us)();
+    /** Time at which the current operation ends */
+    uint32_t busy_until;
+
+    /** Number of page programs and block erases */
+    uint32_t programs, erases;
+} flashlog_nor_sim_t;
+
+/** Typical N25Q page program time, in microseconds */
+#define FLASHLOG_SIM_PROGRAM_US    500
+/** Typical N25Q sub-sector erase time, in microseconds */
+#define FLASHLOG_SIM_ERASE_US      250000
+
+void flashlog_nor_sim_config(flashlog_nor_t *nor, flashlog_nor_sim_t *sim,
+                             uint8_t *mem, uint32_t size, uint32_t (*clock_us)());
+
+/**
+ * @}
+ * @}
+ */
+
+#endif /* FLASHLOG_H_ */
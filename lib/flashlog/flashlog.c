@@ -0,0 +1,587 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * flashlog.c
+ */
+
+#include <string.h>
+
+#include "flashlog.h"
+#include "debug.h"
+
+/*
+ * Page header layout, little endian:
+ *  0: sequence number (4 bytes), 0xFFFFFFFF on an erased page
+ *  4: erase count of the block (4 bytes)
+ *  8: number of payload bytes (1 byte)
+ *  9: consumed flag, 0xFF when unread, cleared once read (not in the CRC)
+ * 10: CRC16 of the header bytes 0 to 8 and of the payload (2 bytes)
+ *
+ * The payload is a list of records, each one being a length byte followed
+ * by the record content.
+ */
+#define HDR_SEQ         0
+#define HDR_ERASE_COUNT 4
+#define HDR_LENGTH      8
+#define HDR_CONSUMED    9
+#define HDR_CRC         10
+
+#define BLANK_SEQ       0xFFFFFFFF
+
+/* Page written over a read page to mark it consumed, programming 0xFF bytes
+ * leaves the flash content unchanged */
+static const uint8_t consumed_mark[FLASHLOG_PAGE_SIZE] =
+{
+    [0 ... FLASHLOG_PAGE_SIZE - 1] = 0xFF,
+    [HDR_CONSUMED] = 0x00
+};
+
+static inline uint32_t get32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static inline void put32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = val;
+    buf[1] = val >> 8;
+    buf[2] = val >> 16;
+    buf[3] = val >> 24;
+}
+
+static uint16_t crc16(uint16_t crc, const uint8_t *buf, uint16_t len)
+{
+    uint8_t i;
+
+    // CRC-16-CCITT, polynomial 0x1021
+    while (len--)
+    {
+        crc ^= (uint16_t)(*buf++) << 8;
+
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+static uint16_t page_crc(const uint8_t *page)
+{
+    uint16_t crc = crc16(0xFFFF, page, HDR_CONSUMED);
+    return crc16(crc, page + FLASHLOG_HEADER_SIZE, page[HDR_LENGTH]);
+}
+
+static bool page_valid(const uint8_t *page)
+{
+    uint16_t crc = page[HDR_CRC] | (page[HDR_CRC + 1] << 8);
+
+    if ((get32(page + HDR_SEQ) == BLANK_SEQ)
+            || (page[HDR_LENGTH] > FLASHLOG_PAGE_SIZE - FLASHLOG_HEADER_SIZE))
+    {
+        return false;
+    }
+
+    return page_crc(page) == crc;
+}
+
+static bool page_blank(const uint8_t *page)
+{
+    uint16_t i;
+
+    for (i = 0; i < FLASHLOG_PAGE_SIZE; i++)
+    {
+        if (page[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static inline uint32_t num_pages(const flashlog_t *log)
+{
+    return log->num_blocks * FLASHLOG_BLOCK_PAGES;
+}
+
+static inline uint32_t page_address(const flashlog_t *log, uint32_t page)
+{
+    return log->start + page * FLASHLOG_PAGE_SIZE;
+}
+
+static inline uint32_t next_page(const flashlog_t *log, uint32_t page)
+{
+    return (page + 1 == num_pages(log)) ? 0 : page + 1;
+}
+
+static inline uint32_t next_block(const flashlog_t *log, uint32_t block)
+{
+    return (block + 1 == log->num_blocks) ? 0 : block + 1;
+}
+
+static void wait_ready(flashlog_t *log)
+{
+    while (log->nor->busy(log->nor->arg))
+    {
+        ;
+    }
+}
+
+static void read_page(flashlog_t *log, uint32_t page, uint8_t *buf)
+{
+    log->nor->read(log->nor->arg, page_address(log, page), buf, FLASHLOG_PAGE_SIZE);
+}
+
+static uint32_t read_erase_count(flashlog_t *log, uint32_t block)
+{
+    uint8_t hdr[FLASHLOG_HEADER_SIZE];
+    uint32_t count;
+
+    log->nor->read(log->nor->arg, log->start + block * FLASHLOG_BLOCK_SIZE,
+                   hdr, FLASHLOG_HEADER_SIZE);
+
+    // Only the header is read, reject obviously wrong values
+    count = get32(hdr + HDR_ERASE_COUNT);
+
+    if ((get32(hdr + HDR_SEQ) == BLANK_SEQ) || (count > 0x00FFFFFF))
+    {
+        return 0;
+    }
+
+    return count;
+}
+
+/* Schedule the erase of a block, dropping its unread pages */
+static void schedule_erase(flashlog_t *log, uint32_t block)
+{
+    uint32_t first = block * FLASHLOG_BLOCK_PAGES;
+
+    // The head is never in the block following the erased one, so the new
+    // tail cannot pass it
+    if ((log->tail != log->head) && (log->tail / FLASHLOG_BLOCK_PAGES == block))
+    {
+        log->stats.pages_overwritten += first + FLASHLOG_BLOCK_PAGES - log->tail;
+        log->tail = next_block(log, block) * FLASHLOG_BLOCK_PAGES;
+    }
+
+    log->erase_block = block;
+    log->next_erased = false;
+}
+
+void flashlog_config(flashlog_t *log, const flashlog_nor_t *nor,
+                     uint32_t start, uint32_t size)
+{
+    memset(log, 0, sizeof(*log));
+
+    log->nor = nor;
+    log->start = start & ~(FLASHLOG_BLOCK_SIZE - 1);
+    log->num_blocks = size / FLASHLOG_BLOCK_SIZE;
+    log->erase_block = -1;
+}
+
+void flashlog_mount(flashlog_t *log)
+{
+    uint32_t block, page, seq;
+    uint32_t head_block = 0, head_seq = 0, tail_block = 0, tail_seq = BLANK_SEQ;
+    bool found = false;
+    uint8_t *buf = log->read_page;
+
+    log->queue_first = 0;
+    log->queue_count = 0;
+    log->fill_offset = 0;
+    log->read_offset = 0;
+    memset(&log->stats, 0, sizeof(log->stats));
+
+    wait_ready(log);
+
+    // Find the newest and oldest blocks from their first page
+    for (block = 0; block < log->num_blocks; block++)
+    {
+        read_page(log, block * FLASHLOG_BLOCK_PAGES, buf);
+
+        if (!page_valid(buf))
+        {
+            continue;
+        }
+
+        seq = get32(buf + HDR_SEQ);
+
+        if (!found || (seq > head_seq))
+        {
+            head_block = block;
+            head_seq = seq;
+            log->head_erase_count = get32(buf + HDR_ERASE_COUNT);
+        }
+
+        if (!found || (seq < tail_seq))
+        {
+            tail_block = block;
+            tail_seq = seq;
+        }
+
+        if (get32(buf + HDR_ERASE_COUNT) > log->stats.max_erase_count)
+        {
+            log->stats.max_erase_count = get32(buf + HDR_ERASE_COUNT);
+        }
+
+        found = true;
+    }
+
+    if (!found)
+    {
+        // Empty log, the first block must be erased before use
+        log->head = log->tail = 0;
+        log->next_seq = 0;
+        schedule_erase(log, 0);
+        log_info("Empty flash log");
+        return;
+    }
+
+    // In the newest block, the head follows the last non blank page
+    log->next_seq = head_seq + 1;
+    log->head = head_block * FLASHLOG_BLOCK_PAGES + 1;
+
+    for (page = FLASHLOG_BLOCK_PAGES - 1; page > 0; page--)
+    {
+        read_page(log, head_block * FLASHLOG_BLOCK_PAGES + page, buf);
+
+        if (!page_blank(buf))
+        {
+            log->head = head_block * FLASHLOG_BLOCK_PAGES + page + 1;
+
+            if (page_valid(buf))
+            {
+                log->next_seq = get32(buf + HDR_SEQ) + 1;
+            }
+            else
+            {
+                // Torn page, its sequence number is lost
+                log->next_seq = head_seq + page + 1;
+            }
+
+            break;
+        }
+    }
+
+    if (log->head == num_pages(log))
+    {
+        log->head = 0;
+    }
+
+    // If the newest block is full, the oldest one may be the next block whose
+    // erase was interrupted; it is dropped by the erase scheduled below
+    if ((log->head == tail_block * FLASHLOG_BLOCK_PAGES) && (tail_block != head_block))
+    {
+        tail_block = next_block(log, tail_block);
+    }
+
+    // Skip the fully consumed blocks, pages are consumed in order so checking
+    // the last page of a block is enough
+    block = tail_block;
+    log->tail = log->head;
+
+    while (block != head_block)
+    {
+        read_page(log, block * FLASHLOG_BLOCK_PAGES + FLASHLOG_BLOCK_PAGES - 1, buf);
+
+        if (buf[HDR_CONSUMED] != 0x00)
+        {
+            break;
+        }
+
+        block = next_block(log, block);
+    }
+
+    // Find the first unread page in this block
+    for (page = block * FLASHLOG_BLOCK_PAGES; page != log->head; page = next_page(log, page))
+    {
+        read_page(log, page, buf);
+
+        if (buf[HDR_CONSUMED] != 0x00)
+        {
+            log->tail = page;
+            break;
+        }
+    }
+
+    // Restore the erase-ahead invariant, the erase state of the next block is unknown
+    if (log->head % FLASHLOG_BLOCK_PAGES == 0)
+    {
+        block = log->head / FLASHLOG_BLOCK_PAGES;
+    }
+    else
+    {
+        block = next_block(log, log->head / FLASHLOG_BLOCK_PAGES);
+    }
+
+    schedule_erase(log, block);
+
+    log_info("Flash log mounted, head %u tail %u seq %u", log->head, log->tail,
+             log->next_seq);
+}
+
+void flashlog_format(flashlog_t *log)
+{
+    uint32_t block, count;
+
+    log->stats.max_erase_count = 0;
+
+    for (block = 0; block < log->num_blocks; block++)
+    {
+        wait_ready(log);
+        count = read_erase_count(log, block) + 1;
+
+        if (block == 0)
+        {
+            log->head_erase_count = count;
+        }
+
+        if (count > log->stats.max_erase_count)
+        {
+            log->stats.max_erase_count = count;
+        }
+
+        log->nor->erase_block(log->nor->arg, log->start + block * FLASHLOG_BLOCK_SIZE);
+        log->stats.blocks_erased++;
+    }
+
+    wait_ready(log);
+
+    log->head = log->tail = 0;
+    log->next_seq = 0;
+    log->next_erase_count = log->head_erase_count;
+    log->erase_block = -1;
+    log->next_erased = true;
+
+    log->queue_first = 0;
+    log->queue_count = 0;
+    log->fill_offset = 0;
+    log->read_offset = 0;
+}
+
+static uint8_t *fill_page(flashlog_t *log)
+{
+    return log->pages[(log->queue_first + log->queue_count - 1) % FLASHLOG_PAGE_BUFFERS];
+}
+
+void flashlog_flush(flashlog_t *log)
+{
+    if (log->fill_offset != 0)
+    {
+        fill_page(log)[HDR_LENGTH] = log->fill_offset - FLASHLOG_HEADER_SIZE;
+        log->fill_offset = 0;
+    }
+}
+
+bool flashlog_append(flashlog_t *log, const uint8_t *data, uint16_t len)
+{
+    uint8_t *page;
+
+    if ((len == 0) || (len > FLASHLOG_MAX_RECORD))
+    {
+        return false;
+    }
+
+    // Close the current page if the record does not fit
+    if ((log->fill_offset != 0) && (log->fill_offset + 1 + len > FLASHLOG_PAGE_SIZE))
+    {
+        flashlog_flush(log);
+    }
+
+    if (log->fill_offset == 0)
+    {
+        if (log->queue_count == FLASHLOG_PAGE_BUFFERS)
+        {
+            // Try to free a page before giving up
+            flashlog_process(log);
+
+            if (log->queue_count == FLASHLOG_PAGE_BUFFERS)
+            {
+                log->stats.records_dropped++;
+                return false;
+            }
+        }
+
+        log->queue_count++;
+        log->fill_offset = FLASHLOG_HEADER_SIZE;
+    }
+
+    page = fill_page(log);
+    page[log->fill_offset] = len;
+    memcpy(page + log->fill_offset + 1, data, len);
+    log->fill_offset += 1 + len;
+    log->stats.records_written++;
+
+    // Close the page as soon as no record can fit anymore
+    if (log->fill_offset + 2 > FLASHLOG_PAGE_SIZE)
+    {
+        flashlog_flush(log);
+    }
+
+    flashlog_process(log);
+
+    return true;
+}
+
+bool flashlog_process(flashlog_t *log)
+{
+    uint8_t ready = log->queue_count - (log->fill_offset != 0 ? 1 : 0);
+    uint32_t block;
+    uint16_t crc;
+    uint8_t *page;
+
+    if (log->nor->busy(log->nor->arg))
+    {
+        return true;
+    }
+
+    // Pending erase-ahead first
+    if (log->erase_block >= 0)
+    {
+        block = log->erase_block;
+
+        // Keep track of the erase count before wiping the block
+        log->next_erase_count = read_erase_count(log, block) + 1;
+        log->nor->erase_block(log->nor->arg, log->start + block * FLASHLOG_BLOCK_SIZE);
+
+        log->erase_block = -1;
+        log->next_erased = true;
+        log->stats.blocks_erased++;
+
+        if (log->next_erase_count > log->stats.max_erase_count)
+        {
+            log->stats.max_erase_count = log->next_erase_count;
+        }
+
+        return true;
+    }
+
+    if (ready == 0)
+    {
+        return false;
+    }
+
+    if (log->head % FLASHLOG_BLOCK_PAGES == 0)
+    {
+        if (!log->next_erased)
+        {
+            // Should not happen, the block is erased ahead
+            schedule_erase(log, log->head / FLASHLOG_BLOCK_PAGES);
+            return true;
+        }
+
+        // Entering an erased block
+        log->head_erase_count = log->next_erase_count;
+    }
+
+    // Complete the header and program the page
+    page = log->pages[log->queue_first];
+    put32(page + HDR_SEQ, log->next_seq);
+    put32(page + HDR_ERASE_COUNT, log->head_erase_count);
+    page[HDR_CONSUMED] = 0xFF;
+    crc = page_crc(page);
+    page[HDR_CRC] = crc;
+    page[HDR_CRC + 1] = crc >> 8;
+
+    log->nor->program_page(log->nor->arg, page_address(log, log->head), page);
+
+    log->queue_first = (log->queue_first + 1) % FLASHLOG_PAGE_BUFFERS;
+    log->queue_count--;
+    log->next_seq++;
+
+    // Erase the next block as soon as the head enters a block
+    if (log->head % FLASHLOG_BLOCK_PAGES == 0)
+    {
+        schedule_erase(log, next_block(log, log->head / FLASHLOG_BLOCK_PAGES));
+    }
+
+    log->head = next_page(log, log->head);
+
+    return true;
+}
+
+void flashlog_sync(flashlog_t *log)
+{
+    flashlog_flush(log);
+
+    while (flashlog_process(log))
+    {
+        ;
+    }
+}
+
+uint16_t flashlog_read(flashlog_t *log, uint8_t *buf, uint16_t size)
+{
+    uint8_t *page = log->read_page;
+    uint16_t len;
+
+    while (true)
+    {
+        if (log->read_offset == 0)
+        {
+            if (log->tail == log->head)
+            {
+                return 0;
+            }
+
+            wait_ready(log);
+            read_page(log, log->tail, page);
+            log->read_index = log->tail;
+
+            if (!page_valid(page))
+            {
+                log->stats.pages_corrupted++;
+                log->tail = next_page(log, log->tail);
+                continue;
+            }
+
+            log->read_offset = FLASHLOG_HEADER_SIZE;
+        }
+
+        if (log->read_offset >= FLASHLOG_HEADER_SIZE + page[HDR_LENGTH])
+        {
+            // All the records of the page were returned, mark it consumed
+            // unless it has been overwritten in the meantime
+            if (log->read_index == log->tail)
+            {
+                wait_ready(log);
+                log->nor->program_page(log->nor->arg, page_address(log, log->tail),
+                                       consumed_mark);
+                log->tail = next_page(log, log->tail);
+            }
+
+            log->read_offset = 0;
+            continue;
+        }
+
+        len = page[log->read_offset];
+        memcpy(buf, page + log->read_offset + 1, len < size ? len : size);
+        log->read_offset += 1 + len;
+
+        return len;
+    }
+}
+
+uint32_t flashlog_pending_pages(const flashlog_t *log)
+{
+    return (log->head + num_pages(log) - log->tail) % num_pages(log);
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * flashlog_n25xxx.c
+ *
+ * N25xxx NOR device for the flash log, log blocks are the flash sub-sectors.
+ */
+
+#include <stddef.h>
+
+#include "flashlog.h"
+#include "n25xxx.h"
+
+static void n25_read(void *arg, uint32_t address, uint8_t *buf, uint16_t len)
+{
+    n25xxx_read(address, buf, len);
+}
+
+static void n25_program_page(void *arg, uint32_t address, const uint8_t *buf)
+{
+    n25xxx_write_enable();
+    // The buffer is only sent over SPI
+    n25xxx_start_write_page(address, (uint8_t *)buf);
+}
+
+static void n25_erase_block(void *arg, uint32_t address)
+{
+    n25xxx_write_enable();
+    n25xxx_start_erase_subsector(address);
+}
+
+static bool n25_busy(void *arg)
+{
+    return n25xxx_is_busy();
+}
+
+static const flashlog_nor_t n25xxx_nor =
+{
+    .read = n25_read,
+    .program_page = n25_program_page,
+    .erase_block = n25_erase_block,
+    .busy = n25_busy,
+    .arg = NULL
+};
+
+const flashlog_nor_t *flashlog_nor_n25xxx()
+{
+    return &n25xxx_nor;
+}
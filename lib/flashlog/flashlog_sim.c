@@ -0,0 +1,106 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * flashlog_sim.c
+ *
+ * RAM simulated NOR flash, with NOR programming semantics and timings.
+ */
+
+#include <string.h>
+
+#include "flashlog.h"
+#include "debug.h"
+
+static bool sim_busy(void *arg)
+{
+    flashlog_nor_sim_t *sim = arg;
+
+    return (int32_t)(sim->clock_us() - sim->busy_until) < 0;
+}
+
+static void sim_read(void *arg, uint32_t address, uint8_t *buf, uint16_t len)
+{
+    flashlog_nor_sim_t *sim = arg;
+
+    if (sim_busy(sim))
+    {
+        log_error("NOR read while busy at %x", address);
+    }
+
+    memcpy(buf, sim->mem + address, len);
+}
+
+static void sim_program_page(void *arg, uint32_t address, const uint8_t *buf)
+{
+    flashlog_nor_sim_t *sim = arg;
+    uint8_t *page = sim->mem + (address & ~(FLASHLOG_PAGE_SIZE - 1));
+    uint16_t i;
+
+    if (sim_busy(sim))
+    {
+        log_error("NOR program while busy at %x", address);
+        return;
+    }
+
+    // Programming can only clear bits
+    for (i = 0; i < FLASHLOG_PAGE_SIZE; i++)
+    {
+        page[i] &= buf[i];
+    }
+
+    sim->busy_until = sim->clock_us() + FLASHLOG_SIM_PROGRAM_US;
+    sim->programs++;
+}
+
+static void sim_erase_block(void *arg, uint32_t address)
+{
+    flashlog_nor_sim_t *sim = arg;
+
+    if (sim_busy(sim))
+    {
+        log_error("NOR erase while busy at %x", address);
+        return;
+    }
+
+    memset(sim->mem + (address & ~(FLASHLOG_BLOCK_SIZE - 1)), 0xFF, FLASHLOG_BLOCK_SIZE);
+
+    sim->busy_until = sim->clock_us() + FLASHLOG_SIM_ERASE_US;
+    sim->erases++;
+}
+
+void flashlog_nor_sim_config(flashlog_nor_t *nor, flashlog_nor_sim_t *sim,
+                             uint8_t *mem, uint32_t size, uint32_t (*clock_us)())
+{
+    sim->mem = mem;
+    sim->size = size;
+    sim->clock_us = clock_us;
+    sim->busy_until = clock_us();
+    sim->programs = 0;
+    sim->erases = 0;
+
+    // A new chip is erased
+    memset(mem, 0xFF, size);
+
+    nor->read = sim_read;
+    nor->program_page = sim_program_page;
+    nor->erase_block = sim_erase_block;
+    nor->busy = sim_busy;
+    nor->arg = sim;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2013 HiKoB.
+ */
+
+/**
+ * \file log_deferred.h
+ *
+ * Deferred binary logging.
+ *
+ * When LOG_DEFERRED is set, the log_debug/info/warning/error macros of
+ * debug.h do not format their message: they store a record with the
+ * addresses of the format string and of the function name, the time and the
+ * raw 32bit arguments in a ring buffer. A low priority task sends the
+ * records on the print output, in frames mixed with the regular printf text,
+ * and the host formats them with the strings read from the ELF file
+ * (tools/logDecoder.py).
+ *
+ * The frames are copied at once in the PRINT_BUFFER output. Without it they
+ * are written with the interrupts enabled, and a printf from an interrupt
+ * may corrupt the record being sent.
+ *
+ * The arguments are sent as 32bit words: integers, characters and pointers
+ * to constant strings are supported, not floats nor 64bit values. The host
+ * shows a log with a floating point conversion (%f, %e, %g, %a) without its
+ * arguments, which are not 32bit words. Print such values as integers,
+ * e.g. in hundredths.
+ */
+
+#ifndef LOG_DEFERRED_H_
+#define LOG_DEFERRED_H_
+
+/**
+ * \addtogroup lib
+ * @{
+ */
+
+/**
+ * \defgroup log_deferred Deferred binary logging
+ *
+ * @{
+ */
+
+#include <stdint.h>
+
+#ifndef LOG_DEFERRED_SIZE
+/** Size of the record ring buffer, in 32bit words */
+#define LOG_DEFERRED_SIZE 256
+#endif
+
+#ifndef LOG_DEFERRED_PERIOD
+/** Period of the task sending the records, in ms */
+#define LOG_DEFERRED_PERIOD 10
+#endif
+
+/** Maximum number of arguments of a deferred log */
+#define LOG_DEFERRED_MAX_ARGS 8
+
+/** Start byte of a record frame in the print output (ASCII RS) */
+#define LOG_DEFERRED_FRAME_START 0x1E
+
+/** Count the arguments after the format string, up to 8 */
+#define LOG_DEFERRED_NARGS(...) \
+    LOG_DEFERRED_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_DEFERRED_NARGS_(fmt, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+/** Record a log of a level, the first argument is the format string */
+#define LOG_DEFERRED_RECORD(level, ...) \
+    log_deferred(((level) << 8) | LOG_DEFERRED_NARGS(__VA_ARGS__), \
+                 __func__, __VA_ARGS__)
+
+/**
+ * Start the task sending the records.
+ *
+ * This is called by \ref platform_run, before starting the scheduler.
+ */
+void log_deferred_init();
+
+/**
+ * Store a log record.
+ *
+ * This is called by the log macros, it may be called from any context.
+ * The record is dropped if the ring buffer is full, the host detects the
+ * gap from the record sequence numbers.
+ *
+ * \param info the log level in bits 8-15, the number of arguments in 0-7
+ * \param func the name of the calling function
+ * \param fmt the format string
+ * \param ... the arguments, as 32bit words, no doubles
+ */
+void log_deferred(uint32_t info, const char *func, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * Send one pending record on the print output.
+ *
+ * This is called by the task started by \ref log_deferred_init.
+ *
+ * \return 1 if more records are pending, 0 otherwise
+ */
+int32_t log_deferred_drain();
+
+/** Send all the pending records, before halting */
+void log_deferred_flush();
+
+/**
+ * @}
+ * @}
+ */
+
+#endif /* LOG_DEFERRED_H_ */
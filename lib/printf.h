@@ -58,6 +58,14 @@
  */
 int printf(const char *format, ...);
 
+/** Send the characters buffered for the standard output
+ * The platform may buffer the output of printf, and send it in background
+ * (see PRINT_BUFFER). This waits until the buffered characters are sent when
+ * the interrupts allow it, and makes the following ones sent synchronously.
+ * It is called before halting, so that the last messages are not lost.
+ */
+void printf_flush();
+
 /** Format and print data in a string
  * This function act as printf but instead of writing to the "standard output", writes the
  * output to a buffer regardless of its size.
@@ -0,0 +1,182 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2013 HiKoB.
+ */
+
+/*
+ * log_deferred.c
+ *
+ * A record is stored as 32bit words:
+ *      * sequence number [16 bits], level [8 bits], reserved [1 bit],
+ *        number of arguments [7 bits]
+ *      * time of the log, in soft timer ticks
+ *      * address of the format string
+ *      * address of the function name
+ *      * the arguments
+ *
+ * and sent as a frame of:
+ *      * LOG_DEFERRED_FRAME_START [1B]
+ *      * number of words [1B]
+ *      * the words, little endian [4B each]
+ */
+
+#include <stdarg.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "platform.h"
+#include "soft_timer.h"
+#include "debug.h"
+#include "log_deferred.h"
+
+extern void xputc(char c);
+
+enum
+{
+    RECORD_HEADER_WORDS = 4,
+    RECORD_MAX_WORDS = RECORD_HEADER_WORDS + LOG_DEFERRED_MAX_ARGS,
+
+    RECORD_NARGS_MASK = 0x7F,
+};
+
+static struct
+{
+    uint32_t words[LOG_DEFERRED_SIZE];
+
+    /** Free running write and read indexes */
+    uint32_t head, tail;
+
+    /** Sequence number of the next record, dropped ones included */
+    uint16_t sequence;
+} logd;
+
+static void drain_task(void *arg);
+
+void log_deferred_init()
+{
+    if (xTaskCreate(drain_task, (const signed char *) "logd",
+                    configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1,
+                    NULL) != pdPASS)
+    {
+        log_error("Failed to create the deferred log task");
+        HALT();
+    }
+}
+
+static void drain_task(void *arg)
+{
+    portTickType period = configTICK_RATE_HZ * LOG_DEFERRED_PERIOD / 1000;
+
+    while (1)
+    {
+        log_deferred_flush();
+
+        // At least a tick, the idle task must run in between
+        vTaskDelay(period ? period : 1);
+    }
+}
+
+void log_deferred(uint32_t info, const char *func, const char *fmt, ...)
+{
+    uint32_t nargs = info & 0xFF;
+    va_list ap;
+
+    if (nargs > LOG_DEFERRED_MAX_ARGS)
+    {
+        nargs = LOG_DEFERRED_MAX_ARGS;
+    }
+
+    uint32_t length = RECORD_HEADER_WORDS + nargs;
+    uint32_t time = soft_timer_time();
+
+    platform_enter_critical();
+    uint16_t sequence = logd.sequence++;
+
+    if (logd.head - logd.tail + length > LOG_DEFERRED_SIZE)
+    {
+        // Dropped, the host sees the sequence gap
+        platform_exit_critical();
+        return;
+    }
+
+    uint32_t head = logd.head;
+    logd.words[head++ % LOG_DEFERRED_SIZE] = ((uint32_t) sequence << 16)
+            | (info & 0xFF00) | nargs;
+    logd.words[head++ % LOG_DEFERRED_SIZE] = time;
+    logd.words[head++ % LOG_DEFERRED_SIZE] = (uint32_t) (uintptr_t) fmt;
+    logd.words[head++ % LOG_DEFERRED_SIZE] = (uint32_t) (uintptr_t) func;
+
+    va_start(ap, fmt);
+    while (nargs--)
+    {
+        logd.words[head++ % LOG_DEFERRED_SIZE] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    logd.head = head;
+    platform_exit_critical();
+}
+
+int32_t log_deferred_drain()
+{
+    uint32_t record[RECORD_MAX_WORDS];
+    uint32_t i, length;
+
+    // Copy the first record, to send it out of the critical section
+    platform_enter_critical();
+    if (logd.head == logd.tail)
+    {
+        platform_exit_critical();
+        return 0;
+    }
+
+    record[0] = logd.words[logd.tail % LOG_DEFERRED_SIZE];
+    length = RECORD_HEADER_WORDS + (record[0] & RECORD_NARGS_MASK);
+    for (i = 1; i < length; i++)
+    {
+        record[i] = logd.words[(logd.tail + i) % LOG_DEFERRED_SIZE];
+    }
+    logd.tail += length;
+    platform_exit_critical();
+
+#if defined(PRINT_BUFFER) && PRINT_BUFFER
+    // Buffered output: copy the frame at once, without printf text inside
+    platform_enter_critical();
+#endif
+    xputc(LOG_DEFERRED_FRAME_START);
+    xputc(length);
+    for (i = 0; i < length; i++)
+    {
+        xputc(record[i]);
+        xputc(record[i] >> 8);
+        xputc(record[i] >> 16);
+        xputc(record[i] >> 24);
+    }
+#if defined(PRINT_BUFFER) && PRINT_BUFFER
+    platform_exit_critical();
+#endif
+
+    return logd.head != logd.tail;
+}
+
+void log_deferred_flush()
+{
+    while (log_deferred_drain())
+    {
+    }
+}
@@ -179,6 +179,25 @@ static inline int32_t soft_timer_ticks_to_min(int32_t ticks)
  */
 uint32_t soft_timer_time();
 
+/**
+ * Get the current time, in 32kHz ticks as a 64bit value.
+ *
+ * This is the same time base as \ref soft_timer_time, which is its 32 lower
+ * bits, but it does not loop.
+ *
+ * \return the current time of the Software Timer, in timer ticks
+ */
+uint64_t soft_timer_time_64();
+
+/**
+ * Convert a past 32bit timestamp to a 64bit one.
+ *
+ * \param t a timestamp obtained with \ref soft_timer_time, less than 36.4
+ *      hours in the past
+ * \return the corresponding 64bit time
+ */
+uint64_t soft_timer_convert_time_64(uint32_t t);
+
 struct soft_timer_timeval
 {
     uint32_t tv_sec;
@@ -87,6 +87,35 @@ uint32_t soft_timer_time()
     return t + ((update || (t_b < t_a)) ? 0x10000 : 0) + t_b;
 }
 
+uint64_t soft_timer_time_64()
+{
+    // Same as soft_timer_time, without truncating the update count
+    uint16_t t_a, t_b;
+    uint64_t t;
+    uint32_t update = 0;
+
+    // Mask interrupts
+    vPortEnterCritical();
+
+    t = (uint64_t) softtim.update_count << 16;
+    t_a = timer_time(softtim.timer);
+    update = timer_get_update_flag(softtim.timer);
+    t_b = timer_time(softtim.timer);
+
+    // Unmask interrupts
+    vPortExitCritical();
+
+    return t + ((update || (t_b < t_a)) ? 0x10000 : 0) + t_b;
+}
+
+uint64_t soft_timer_convert_time_64(uint32_t t)
+{
+    uint64_t now = soft_timer_time_64();
+
+    // t is in the past, go back by the difference of the lower bits
+    return now - (uint32_t) ((uint32_t) now - t);
+}
+
 struct soft_timer_timeval soft_timer_time_extended()
 {
     struct soft_timer_timeval tv;
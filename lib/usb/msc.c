@@ -355,12 +355,32 @@ static msc_csw_status_t  msc_csw_status;              //  4
 /*
  * Data Buffers
  * 
- * when the buffer has been used (write + read) 
- * it must be released by setting len = 0 
+ * msc_buff is a circular array of buffers shared by the USB interrupt
+ * and the event task, so that the SCSI backend fills or drains one
+ * buffer while the endpoint streams another one:
+ *
+ *   - IN  (device to host): the event task fills the buffers with the
+ *     SCSI command answers, the IN endpoint interrupt sends them packet
+ *     by packet and releases them.
+ *   - OUT (host to device): the OUT endpoint interrupt fills the buffers
+ *     with the received packets, the event task gives them to the SCSI
+ *     command and releases them. The endpoint is NAKed while all the
+ *     buffers are full.
+ *
+ * The buffers are closed on the producer side (len is then valid) and
+ * released on the consumer side, msc_buff_used counts the closed ones.
  */
 
-/* data buffers, 512 is a SD-Card block size */
-#define MSC_BUFFER_SIZE  512
+/* data buffers, 512 is a SD-Card block size. IN buffers may hold
+ * several sectors for the backends that can fill them in one call,
+ * OUT buffers are always closed after a single sector. The default
+ * holds one sector, the platforms with enough RAM set MSC_BUFFER_SIZE
+ * to a multiple of MSC_SECTOR_SIZE in their include.cmake. */
+#define MSC_SECTOR_SIZE  512
+
+#ifndef MSC_BUFFER_SIZE
+#define MSC_BUFFER_SIZE  MSC_SECTOR_SIZE
+#endif
 
 typedef struct {
     uint8_t  data[MSC_BUFFER_SIZE];
@@ -368,16 +388,42 @@ typedef struct {
     uint16_t len;
 } msc_data_buff_t;
 
-/*
- * msc_buff is a circular array of buffers. 2 should do it.
- * At this point of dev&test we are strictly sequential and ordered.
- * Next release may have asyn double buffered I/O
- */
-#define MSC_BUFFER_COUNT   1
+#ifndef MSC_BUFFER_COUNT
+#define MSC_BUFFER_COUNT   3
+#endif
 
-static msc_data_buff_t msc_buff[MSC_BUFFER_COUNT] __attribute__((aligned(4)));;
+static msc_data_buff_t msc_buff[MSC_BUFFER_COUNT] __attribute__((aligned(4)));
 static int8_t          msc_buff_read;
 static int8_t          msc_buff_write;
+static volatile uint8_t msc_buff_used;
+
+/* an IN packet is being sent */
+static volatile bool   msc_in_busy;
+/* OUT endpoint NAKed, waiting for a free buffer */
+static volatile bool   msc_out_nak;
+
+/* ********************************************************************** */
+/* ********************************************************************** */
+/* ********************************************************************** */
+
+
+#define MSC_EV     ((void*)0)
+#define MSC_EV_IN  ((void*)1)
+#define MSC_EV_OUT ((void*)2)
+
+void usb_msc_ev_handler( handler_arg_t arg );
+
+event_status_t msc_ev_post(handler_arg_t arg)
+{
+    //DBG("+");
+    return event_post(EVENT_QUEUE_APPLI, usb_msc_ev_handler, arg);
+}
+
+event_status_t msc_ev_post_from_isr(handler_arg_t arg)
+{
+    //DBG("!");
+    return event_post_from_isr(EVENT_QUEUE_APPLI, usb_msc_ev_handler, arg);
+}
 
 /* ************************************************************ */
 /* **** Public Functions ************************************** */
@@ -395,6 +441,9 @@ void usb_msc_reset()
     }
     msc_buff_read       = 0;
     msc_buff_write      = 0;
+    msc_buff_used       = 0;
+    msc_in_busy         = false;
+    msc_out_nak         = false;
     msc_state           = MSC_STATE_NONE;
 }
 
@@ -425,16 +474,12 @@ static inline uint16_t min(uint16_t a, uint16_t b) { return a < b ? a : b; }
 
 /*
  * Buffer: mark the current read buffer as free and move to 
- * the next one
+ * the next one.
+ * Called from the IN interrupt, or from the event task within
+ * a critical section.
  */
 void usb_msc_close_read_buff()
 {
-    if (msc_buff[msc_buff_read].len != 0)
-    {
-	log_error("MSC Closing data on read buffer %d which has len = %d",msc_buff_read,msc_buff[msc_buff_read].len);
-	return;
-    }
-
     msc_buff[msc_buff_read].idx = 0;
     msc_buff[msc_buff_read].len = 0;
 
@@ -443,18 +488,21 @@ void usb_msc_close_read_buff()
     {
 	msc_buff_read = 0;
     }
+    msc_buff_used = msc_buff_used - 1;
 }
 
 /*
  * Buffer: commands can use a write buffer the way they need to.
  * Once a buffer is filled with information it must be closed so
  * that it can be used on the read side.
+ * Called from the OUT interrupt, or from the event task within
+ * a critical section.
  */
 void usb_msc_close_write_buff(uint16_t length)
 {
-    if (msc_buff[msc_buff_write].len != 0)
+    if (msc_buff_used == MSC_BUFFER_COUNT)
     {
-	log_error("MSC Registering data on write buffer %d which has len = %d",msc_buff_write,msc_buff[msc_buff_write].len);
+	log_error("MSC Registering data on write buffer %d while all buffers are used",msc_buff_write);
 	return;
     }
 
@@ -466,11 +514,14 @@ void usb_msc_close_write_buff(uint16_t length)
     {
 	msc_buff_write = 0;
     }
+    msc_buff_used = msc_buff_used + 1;
 }
 
 /*
- * USB IN: use the current read buffer as a data source for IN packets.
- * Returns true when the buffer is empty.
+ * USB IN: use the current read buffer as a data source for the next
+ * IN packet, the buffer is released as soon as its last packet has
+ * been copied to the endpoint.
+ * Returns false if there was nothing to send.
  */
 bool usb_msc_send_data_to_endpoint()
 {
@@ -478,9 +529,10 @@ bool usb_msc_send_data_to_endpoint()
     uint16_t  idx;
     uint8_t  *data;
 
-    if (msc_buff[msc_buff_read].len == 0)
+    if (msc_buff_used == 0)
     {
-	return true;
+	msc_in_busy = false;
+	return false;
     }
 
     len  = min( msc_buff[msc_buff_read].len, usb_get_max_packet_size( MSC_EP_IN ) );
@@ -489,38 +541,48 @@ bool usb_msc_send_data_to_endpoint()
 
     usb_send( MSC_EP_IN , true, NO_CHANGE, &data[idx], len);
     DBG("i");
+    msc_in_busy = true;
     msc_buff[msc_buff_read].len = msc_buff[msc_buff_read].len - len;
     msc_buff[msc_buff_read].idx = msc_buff[msc_buff_read].idx + len;
 
     if (msc_buff[msc_buff_read].len == 0)
     {
 	usb_msc_close_read_buff();
-	return true;
     }
-    return false;
+    return true;
 }
 
 /*
- * USB OUT: write from out endpoint to buffer.
- * returns true if buffer is full or if #read < #max which
- * means EOP. On EOP the write buffer is closed.
+ * USB IN: start sending from the event task if the endpoint is idle,
+ * it is then kept busy by the IN interrupt.
  */
-bool usb_msc_read_data_from_endpoint()
+static void usb_msc_start_data_in()
+{
+    platform_enter_critical();
+    if (!msc_in_busy)
+    {
+	usb_msc_send_data_to_endpoint();
+    }
+    platform_exit_critical();
+}
+
+/*
+ * USB OUT: write from out endpoint to the current write buffer, called
+ * from the OUT interrupt. The write buffer is closed when it is full or
+ * on a short packet (EOP) and the event task is notified. The endpoint
+ * is NAKed until the next packet can be stored.
+ */
+void usb_msc_read_data_from_endpoint()
 {
     uint16_t  rlen,plen,blen;
     uint16_t  idx;
     uint8_t  *data;
 
-    if (msc_buff[msc_buff_write].idx == MSC_BUFFER_SIZE)
-    {
-	return true;
-    }
-
-    idx  = msc_buff[ msc_buff_read ].idx;
-    data = msc_buff[ msc_buff_read ].data;
+    idx  = msc_buff[ msc_buff_write ].idx;
+    data = msc_buff[ msc_buff_write ].data;
     plen = usb_get_max_packet_size( MSC_EP_OUT );
     rlen = usb_recv_get_len( MSC_EP_OUT );
-    blen = MSC_BUFFER_SIZE - msc_buff[msc_buff_write].idx;
+    blen = MSC_SECTOR_SIZE - idx;
 
     if (rlen > blen)
     {
@@ -530,15 +592,38 @@ bool usb_msc_read_data_from_endpoint()
 
     usb_recv( MSC_EP_OUT, &data[idx], rlen);
     DBG("o");
-    msc_buff[msc_buff_write].idx = msc_buff[msc_buff_write].idx + rlen;
-    usb_recv_set_status( MSC_EP_OUT , STAT_RX_VALID);
+    msc_buff[msc_buff_write].idx = idx + rlen;
 
-    if ((msc_buff[msc_buff_write].idx ==  MSC_BUFFER_SIZE) || (rlen < plen))
+    if ((msc_buff[msc_buff_write].idx ==  MSC_SECTOR_SIZE) || (rlen < plen))
     {
 	usb_msc_close_write_buff( msc_buff[msc_buff_write].idx );
-	return true;
+	msc_ev_post_from_isr( MSC_EV_OUT );
+    }
+
+    if (msc_buff_used < MSC_BUFFER_COUNT)
+    {
+	usb_recv_set_status( MSC_EP_OUT , STAT_RX_VALID);
+    }
+    else
+    {
+	msc_out_nak = true;
+    }
+}
+
+/*
+ * USB OUT: release the current read buffer from the event task and
+ * resume the endpoint if it was waiting for it.
+ */
+static void usb_msc_release_data_out()
+{
+    platform_enter_critical();
+    usb_msc_close_read_buff();
+    if (msc_out_nak)
+    {
+	msc_out_nak = false;
+	usb_recv_set_status( MSC_EP_OUT , STAT_RX_VALID);
     }
-    return false;
+    platform_exit_critical();
 }
 
 /* ********************************************************************** */
@@ -554,6 +639,19 @@ void usb_msc_build_csw(uint8_t *b, uint32_t t, msc_csw_status_t s)
     csw->dCSWStatus      = s;
 }
 
+/*
+ * Queue the CSW behind the data still in the buffers
+ */
+static void usb_msc_send_status()
+{
+    msc_state = MSC_STATE_STATUS_sent;
+    usb_msc_build_csw( msc_buff[msc_buff_write].data, cbw.dCBWTag, msc_csw_status);
+    platform_enter_critical();
+    usb_msc_close_write_buff(sizeof(msc_csw_t));
+    platform_exit_critical();
+    usb_msc_start_data_in();
+}
+
 /* ********************************************************************** */
 /* ********************************************************************** */
 /* ********************************************************************** */
@@ -576,25 +674,6 @@ scsi_params_t usb_msc_build_scsi_params(uint8_t count, int8_t msc_buff_direction
 /* ********************************************************************** */
 /* ********************************************************************** */
 
-
-#define MSC_EV     ((void*)0)
-#define MSC_EV_IN  ((void*)1)
-#define MSC_EV_OUT ((void*)2)
-
-void usb_msc_ev_handler( handler_arg_t arg );
-
-event_status_t msc_ev_post(handler_arg_t arg)
-{
-    //DBG("+");
-    return event_post(EVENT_QUEUE_APPLI, usb_msc_ev_handler, arg);
-}
-
-event_status_t msc_ev_post_from_isr(handler_arg_t arg)
-{
-    //DBG("!");
-    return event_post_from_isr(EVENT_QUEUE_APPLI, usb_msc_ev_handler, arg);
-}
-
 int usb_msc_scsi_handler(bool firstcall)
 {
     int            handler_ret = 0;
@@ -630,7 +709,7 @@ int usb_msc_scsi_handler(bool firstcall)
 	    if (cbw.dCBWFlags & 0x80)
 	    {
                 /*
-		 * Data are flowing from Host to Device
+		 * Data are flowing from Device to Host
 		 */
 		msc_csw_status    = CSW_Command_Passed;
 		msc_state         = MSC_STATE_DATA_IN;
@@ -646,8 +725,6 @@ int usb_msc_scsi_handler(bool firstcall)
 		    {
 			/* The return is only a part of the full request, 
 			 * we'll have to come back */
-			// log_debug("MSC SCSI command made partially, returning %d bytes (%d)", 
-			// datalen, cbw.dCBWDataTransferLength - datalen);
 		    }
 		    else 
 		    {
@@ -656,25 +733,20 @@ int usb_msc_scsi_handler(bool firstcall)
 			cbw.dCBWDataTransferLength = datalen;
 		    }
 		}
-		else 
-		{
-		    /* ok : datalen == cbw.dCBWDataTransferLength */
-		    //log_debug("MSC SCSI command complete with the correct amount of data");
-		}
 
 		cbw.dCBWDataTransferLength = cbw.dCBWDataTransferLength - datalen;
-		if (cbw.dCBWDataTransferLength == 0)
+		if (datalen > 0)
 		{
-		    //log_info("Last packet");
+		    platform_enter_critical();
+		    usb_msc_close_write_buff(datalen);
+		    platform_exit_critical();
 		}
-		usb_msc_close_write_buff(datalen);
 		handler_ret = datalen;
 	    }
 	    else
 	    {
 		/*
-		 * Data are flowing from Device to Host
-		 * can we assert(msc_state == MSC_STATE_DATA_OUT) ?
+		 * Data are flowing from Host to Device
 		 */
 		if (msc_state != MSC_STATE_DATA_OUT) // == MSC_STATE_READY ??
 		{
@@ -688,27 +760,16 @@ int usb_msc_scsi_handler(bool firstcall)
 			log_error("datalen != msc_buff[msc_buff_read].len !!");
 			cbw.dCBWDataTransferLength = datalen;
 		    }
-		    msc_buff[msc_buff_read].len = 0;
-		    usb_msc_close_read_buff();
+		    usb_msc_release_data_out();
 		    cbw.dCBWDataTransferLength = cbw.dCBWDataTransferLength - datalen;
 		    if (cbw.dCBWDataTransferLength == 0)
 		    {
 			msc_csw_status    = CSW_Command_Passed;
-			msc_state         = MSC_STATE_STATUS;
-
-			msc_state         = MSC_STATE_STATUS_sent;
-			usb_msc_build_csw( msc_buff[msc_buff_write].data, cbw.dCBWTag, msc_csw_status);
-			usb_msc_close_write_buff(sizeof(msc_csw_t));
-			if (! usb_msc_send_data_to_endpoint())
-			{
-			    // log_error("this should not happen");
-			}
+			usb_msc_send_status();
 		    }
 		    else
 		    {
 			DBG("+");
-			msc_csw_status    = CSW_Command_Passed;
-			msc_state         = MSC_STATE_DATA_OUT;
 		    }
 		}
 	    }
@@ -716,13 +777,7 @@ int usb_msc_scsi_handler(bool firstcall)
 	else // Data are done, send Status
 	{
 	    msc_csw_status = CSW_Command_Passed;
-	    msc_state      = MSC_STATE_STATUS_sent;
-	    usb_msc_build_csw( msc_buff[msc_buff_write].data, cbw.dCBWTag, msc_csw_status);
-	    usb_msc_close_write_buff(sizeof(msc_csw_t));
-	    if (! usb_msc_send_data_to_endpoint())
-	    {
-		// log_error("this should not happen");
-	    }
+	    usb_msc_send_status();
 	}
 	break;
 	
@@ -749,72 +804,78 @@ int usb_msc_scsi_handler(bool firstcall)
 
 void usb_msc_ev_handler( handler_arg_t arg )
 {
-    int scsi_ret;
-
     switch (msc_state)
     {
     case MSC_STATE_NONE:
+	// idle, prepare the next sectors of a sequential read
+	scsi_read_ahead();
 	break;
 
     case MSC_STATE_READY:
 	// first SCSI Command call, fill data buffer with answer
-	scsi_ret = usb_msc_scsi_handler(true); 
-	if (scsi_ret)
+	usb_msc_scsi_handler(true); 
+	if (msc_state == MSC_STATE_DATA_IN)
 	{
-	    if (usb_msc_send_data_to_endpoint()) 
-	    {
-		// buffer sent in 1 packet, skip to STATUS
-		msc_state     = MSC_STATE_STATUS;
-	    }
+	    usb_msc_start_data_in();
+	    msc_ev_post( MSC_EV );
+	}
+	else if ((msc_state == MSC_STATE_DATA_OUT) && msc_buff_used)
+	{
+	    msc_ev_post( MSC_EV );
 	}
 	break;
 
     case MSC_STATE_DATA_IN:
-	if (usb_msc_send_data_to_endpoint()) 
+	if (cbw.dCBWDataTransferLength > 0) 
 	{
-	    if (cbw.dCBWDataTransferLength > 0) 
+	    /* SCSI command not complete, fill the next free buffer while
+	     * the previous ones are sent by the IN interrupt */
+	    if (msc_buff_used < MSC_BUFFER_COUNT)
 	    {
-		/* SCSI command not complete, precharge next buffer but do not
-		 * write to endpoint */
 		usb_msc_scsi_handler(false); 
+		usb_msc_start_data_in();
+		if ((msc_state == MSC_STATE_DATA_IN) && (cbw.dCBWDataTransferLength > 0)
+		    && (msc_buff_used < MSC_BUFFER_COUNT))
+		{
+		    msc_ev_post( MSC_EV );
+		}
 	    }
-	    else
-	    {
-		// all requested information transferred, going to Status
-		msc_state = MSC_STATE_STATUS;
-	    }
+	}
+	else if ((msc_buff_used == 0) && !msc_in_busy)
+	{
+	    // all requested information transferred, going to Status
+	    usb_msc_send_status();
 	}
 	break;
 
     case MSC_STATE_DATA_OUT:
-	if (usb_msc_read_data_from_endpoint())
+	if (msc_buff_used)
 	{
-	    scsi_ret = usb_msc_scsi_handler(false);
+	    // give the oldest received buffer to the SCSI command
+	    usb_msc_scsi_handler(false);
+	    if ((msc_state == MSC_STATE_DATA_OUT) && msc_buff_used)
+	    {
+		msc_ev_post( MSC_EV );
+	    }
 	}
 	break;
 
-    /* case MSC_STATE_STATUS_tosend: */
-    /* 	msc_state = MSC_STATE_STATUS; */
-    /* 	break; */
-
     case MSC_STATE_STATUS:
 	//DBG("S");
-	msc_state = MSC_STATE_STATUS_sent;
-	usb_msc_build_csw( msc_buff[msc_buff_write].data, cbw.dCBWTag, msc_csw_status);
-	usb_msc_close_write_buff(sizeof(msc_csw_t));
-	if (usb_msc_send_data_to_endpoint())
+	if (msc_in_busy || msc_buff_used)
 	{
-	    //DBG("s\n");
-	}
-	else
-	{
-	    log_error(" STATUS cannot be sent ??");
+	    // wait for the data already queued to be sent
+	    break;
 	}
-	//DBG("\n");
+	usb_msc_send_status();
 	break;
 
     case MSC_STATE_STATUS_sent:
-	msc_state = MSC_STATE_NONE;
+	if (!msc_in_busy && !msc_buff_used)
+	{
+	    msc_state = MSC_STATE_NONE;
+	    msc_ev_post( MSC_EV );
+	}
 	break;
     }
 }
@@ -828,13 +889,21 @@ void usb_msc_ev_handler( handler_arg_t arg )
 
 static void usb_msc_data_in(uint8_t endp, bool rx, bool tx)
 {
+    uint8_t used;
+
     if (!tx && rx)
     {
         log_error("MSC data in (to host) callback called with: rx = %d and tx = %d", rx, tx);
 	return;
     }
 
-    msc_ev_post_from_isr( MSC_EV_IN );
+    /* send the next packet right away, the event task only needs to
+     * be woken up when a buffer is released or nothing is left */
+    used = msc_buff_used;
+    if (!usb_msc_send_data_to_endpoint() || (msc_buff_used != used))
+    {
+	msc_ev_post_from_isr( MSC_EV_IN );
+    }
 }
 
 
@@ -898,7 +967,7 @@ static void usb_msc_data_out(uint8_t endp, bool rx, bool tx)
 	
     case MSC_STATE_READY:
     case MSC_STATE_DATA_OUT:
-	msc_ev_post_from_isr( MSC_EV_OUT );
+	usb_msc_read_data_from_endpoint();
 	break;
 
     case MSC_STATE_DATA_IN:
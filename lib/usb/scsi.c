@@ -105,6 +105,15 @@ typedef enum {
  * SCSI Global variables and definitions
  * ************************************************** */
 
+/* READ10 read-ahead, the sector following the last READ10 */
+static struct {
+    uint8_t  lun;
+    uint32_t lba;
+    bool     pending;  // lba follows a READ10 run, not read yet
+    bool     valid;    // data holds sector lba
+    uint8_t  data[BLOCKSIZE] __attribute__((aligned(4)));
+} scsi_ahead;
+
 #define SCSI_SENSE_REPLY_FIXED_SIZE    17
 #define SCSI_SENSE_REPLY_SIZE           8
 #define SCSI_SENSE_CACHING_REPLY_SIZE  19
@@ -243,6 +252,12 @@ scsi_cmdret_t scsi_process_command(scsi_params_t scsi_params)
 {
     int i;
 
+    /* the read-ahead sector is only kept for a READ10 following another one */
+    if ((scsi_params.cont == 0) && (scsi_params.cmd[0] != SCSI_READ10))
+    {
+	scsi_ahead.valid = false;
+    }
+
     for(i=0; i < sizeof(scsi_cdb_list)/sizeof(scsi_cdb_desc_t); i++)
     {
 	if (scsi_params.cmd[0] == scsi_cdb_list[i].cdb_op)
@@ -534,14 +549,92 @@ static scsi_cmdret_t scsi_cmd_read_capacity10(scsi_params_t scsi_params)
 
 static scsi_cmdret_t scsi_cmd_read10(scsi_params_t scsi_params)
 {
-    if (scsi_lun[scsi_params.lun].read10)
+    scsi_cdb10_t  *cdb10   = (scsi_cdb10_t *)scsi_params.cmd;
+    uint32_t       lba     = msbtohost32(cdb10->lba);
+    uint16_t       nblocks = msbtohost16(cdb10->length);
+    scsi_cmdret_t  ret;
+
+    if (scsi_lun[scsi_params.lun].read10 == NULL)
     {
-	return scsi_lun[scsi_params.lun].read10(scsi_params);
+	*scsi_params.datalen  = 0;
+	*scsi_params.status   = SCSI_CHECK_CONDITION;
+	return SCSI_CMD_DONE;
     }
 
-    *scsi_params.datalen  = 0;
-    *scsi_params.status   = SCSI_CHECK_CONDITION;
-    return SCSI_CMD_DONE;
+    if (scsi_ahead.valid && (scsi_ahead.lun == scsi_params.lun) && (scsi_ahead.lba == lba)
+	&& (nblocks > 0) && (scsi_params.datamax >= BLOCKSIZE))
+    {
+	/* sequential run, the first sector is already there */
+	memcpy(scsi_params.data, scsi_ahead.data, BLOCKSIZE);
+	scsi_ahead.valid      = false;
+	*scsi_params.datalen  = BLOCKSIZE;
+	*scsi_params.status   = SCSI_GOOD;
+	if (nblocks == 1)
+	{
+	    ret = SCSI_CMD_DONE;
+	}
+	else
+	{
+	    cdb10->lba        = msbtohost32( lba     + 1 );
+	    cdb10->length     = msbtohost16( nblocks - 1 );
+	    ret = SCSI_CMD_PARTIAL;
+	}
+    }
+    else
+    {
+	scsi_ahead.valid = false;
+	ret = scsi_lun[scsi_params.lun].read10(scsi_params);
+    }
+
+    /* end of the run, the next sector may be read ahead */
+    scsi_ahead.pending = (ret == SCSI_CMD_DONE) && (*scsi_params.status == SCSI_GOOD);
+    if (scsi_ahead.pending)
+    {
+	scsi_ahead.lun = scsi_params.lun;
+	scsi_ahead.lba = lba + *scsi_params.datalen / BLOCKSIZE;
+    }
+    return ret;
+}
+
+void scsi_read_ahead()
+{
+    scsi_cdb10_t   cdb10;
+    scsi_status_t  status;
+    uint32_t       datalen = 0;
+    uint32_t       bcount  = 0;
+    uint16_t       bsize;
+    scsi_params_t  scsi_params = {
+	.cont    = 1,
+	.lun     = scsi_ahead.lun,
+	.cmd     = (uint8_t *)&cdb10,
+	.data    = scsi_ahead.data,
+	.datamax = BLOCKSIZE,
+	.datalen = &datalen,
+	.status  = &status,
+    };
+
+    if (!scsi_ahead.pending)
+    {
+	return;
+    }
+    scsi_ahead.pending = false;
+
+    if (scsi_lun[scsi_ahead.lun].read_capacity)
+    {
+	scsi_lun[scsi_ahead.lun].read_capacity(scsi_ahead.lun, &bcount, &bsize);
+    }
+    if (scsi_ahead.lba >= bcount)
+    {
+	return;
+    }
+
+    memset(&cdb10, 0, sizeof(cdb10));
+    cdb10.operation_code = SCSI_READ10;
+    cdb10.lba            = msbtohost32(scsi_ahead.lba);
+    cdb10.length         = msbtohost16(1);
+
+    scsi_lun[scsi_ahead.lun].read10(scsi_params);
+    scsi_ahead.valid = (status == SCSI_GOOD) && (datalen == BLOCKSIZE);
 }
 
 /* ********************************************************************** */
@@ -550,6 +643,10 @@ static scsi_cmdret_t scsi_cmd_read10(scsi_params_t scsi_params)
 
 static scsi_cmdret_t scsi_cmd_write10(scsi_params_t scsi_params)
 {
+    /* the read-ahead sector may be overwritten */
+    scsi_ahead.valid   = false;
+    scsi_ahead.pending = false;
+
     if (scsi_lun[scsi_params.lun].write10)
     {
 	return scsi_lun[scsi_params.lun].write10(scsi_params);
@@ -150,6 +150,14 @@ scsi_cmdret_t scsi_process_command(scsi_params_t scsi_params);
  */
 
 void scsi_init();
+
+/**
+ * SCSI READ10 read-ahead
+ * Reads the sector following the last READ10 command, the next
+ * READ10 is served from it if it continues the sequential run.
+ * To be called when the transport is idle.
+ **/
+void scsi_read_ahead();
 void scsi_dump_blk(uint32_t lba, uint8_t *d, uint16_t len);
 
 #endif
@@ -147,6 +147,104 @@ static inline void write32(uint8_t *buf, uint32_t val)
 #define PARTITION_LABEL        'H','i','K','o','B',' ',' ',' ',' ',' ',' '
 #define FILESYSTEM_TYPE        'F','A','T','1','6',' ',' ',' '
 
+#define CLUSTERBYTES           (CLUSTERSIZE * SECTORSIZE)
+#define FAT_ENTRIES_PER_SECTOR (SECTORSIZE / 2)
+
+/* only the first RootDirectory sector is built, after the volume label */
+#define MMAPFS_MAX_FILES       (SECTORSIZE / DIRECTORY_ENTRYSIZE - 1)
+
+#ifndef MMAPFS_CACHE_SECTORS
+#define MMAPFS_CACHE_SECTORS   2
+#endif
+
+/*
+ * Layout of the files, computed from the mmapfs_t description and
+ * the info callbacks. It is checked on each request and rebuilt, with
+ * the cached metadata sectors dropped, only when a file's presence or
+ * size has changed.
+ */
+typedef struct {
+    int      present;
+    uint32_t size;
+    uint32_t cstart;      // first cluster
+    uint32_t cend;        // last cluster for the max size
+    uint32_t c2end;       // last cluster for the actual size
+} mmapfs_layout_t;
+
+static const mmapfs_t *layout_mmapfs;
+static uint16_t        layout_size;
+static mmapfs_layout_t layout[MMAPFS_MAX_FILES];
+
+/* generated FAT and RootDirectory sectors */
+typedef struct {
+    bool     valid;
+    uint32_t lba;
+    uint8_t  data[SECTORSIZE];
+} mmapfs_cached_sector_t;
+
+static mmapfs_cached_sector_t cache[MMAPFS_CACHE_SECTORS] __attribute__((aligned(4)));
+static uint8_t                cache_next;
+
+static void update_layout(const mmapfs_t *mmapfs)
+{
+    int      i;
+    int      present;
+    uint32_t size;
+    uint32_t cstart  = DATA_FIRST_FAT_CLUSTER;
+    bool     changed = (mmapfs != layout_mmapfs);
+    uint16_t nfiles  = mmapfs->size;
+
+    if (nfiles > MMAPFS_MAX_FILES)
+    {
+	log_error("mmapfs only %d files can be exported", MMAPFS_MAX_FILES);
+	nfiles = MMAPFS_MAX_FILES;
+    }
+
+    for(i=0; i < nfiles; i++)
+    {
+	if (mmapfs->files[i].info)
+	{
+	    mmapfs->files[i].info( mmapfs->files[i].arg, &present, &size);
+	}
+	else
+	{
+	    present = 1;
+	    size    = mmapfs->files[i].maxsize;
+	}
+
+	if (size > mmapfs->files[i].maxsize)
+	{
+	    size = mmapfs->files[i].maxsize;
+	}
+
+	if (changed || (layout[i].present != present) || (layout[i].size != size))
+	{
+	    changed = true;
+	}
+
+	layout[i].present = present;
+	layout[i].size    = size;
+	layout[i].cstart  = cstart;
+	layout[i].cend    = cstart + (mmapfs->files[i].maxsize + CLUSTERBYTES - 1) / CLUSTERBYTES - 1;
+	layout[i].c2end   = cstart + (size + CLUSTERBYTES - 1) / CLUSTERBYTES - 1;
+
+	cstart = layout[i].cend + 1;
+    }
+
+    if (changed || (nfiles != layout_size))
+    {
+	DBG("mmapfs layout changed\n");
+	layout_mmapfs = mmapfs;
+	layout_size   = nfiles;
+	for(i=0; i < MMAPFS_CACHE_SECTORS; i++)
+	{
+	    cache[i].valid = false;
+	}
+    }
+}
+
+static inline uint32_t min(uint32_t a, uint32_t b) { return a < b ? a : b; }
+
 /* ********************************************************************** */
 /*                                                                        */
 /* ********************************************************************** */
@@ -193,7 +291,7 @@ static const uint8_t BootSector[] =
     // 0xEB 0x3C 0x90
 };
 
-static void build_bootsector(const mmapfs_t *mmapfs, uint16_t lba, uint8_t *sector)
+static void build_bootsector(const mmapfs_t *mmapfs, uint32_t lba, uint8_t *sector)
 {
     memset( sector,          0, SECTORSIZE);
     DBG("b");
@@ -256,101 +354,46 @@ static void build_bootsector(const mmapfs_t *mmapfs, uint16_t lba, uint8_t *sect
  *
  */
 
-static void build_fat(const mmapfs_t *mmapfs, uint16_t lba, uint8_t *sector)
+static void build_fat(const mmapfs_t *mmapfs, uint32_t lba, uint8_t *sector)
 {
-    int i,c;
-    int fat_sect    = 0;                          // current FAT sector
-    int fat_off     = DATA_FIRST_FAT_CLUSTER * 2; // current FAT offset (byte) > 6
-    uint16_t cstart = DATA_FIRST_FAT_CLUSTER;     // current cluster start for file
-    uint16_t cend   = cstart - 1;                 // max cluster end for file
-    uint16_t csize;                               // max file size in cluster
-    uint16_t c2size,c2end;                        // actual cluster size and end.
+    int      i,e;
+    uint32_t c;
     uint16_t mk;
 
-    int      present;
-    uint32_t size;
-
-    memset(sector, 0, LUN_SECTORSIZE);
-    for(i=0; i < SECTORSIZE; i+=2)
-    {
-	write16( &sector[i], FAT_BADCLUSTER);
-    }
-
     DBG("f");
-    /* FAT16 start */
-    if (lba == 0)
+    for(e=0; e < FAT_ENTRIES_PER_SECTOR; e++)
     {
-	sector[0] = MEDIA_TYPE;
-	sector[1] = 0xFF;
-	sector[2] = FAT_ENDOFCLUSTER & 0xff;
-	sector[3] = FAT_ENDOFCLUSTER >> 8;
-	//sector[4] = 0; 
-	//sector[5] = 0;
-    }
+	c  = lba * FAT_ENTRIES_PER_SECTOR + e;
+	mk = FAT_BADCLUSTER;
 
-    for( i = 0 ; i < mmapfs->size ; i++)
-    {
-	if (mmapfs->files[i].info)
-	{
-	    mmapfs->files[i].info( mmapfs->files[i].arg, &present, &size);
-	}
-	else
+	for(i=0; i < layout_size; i++)
 	{
-	    present = 1;
-	    size    = mmapfs->files[i].maxsize;
-	}
-
-	// max size and end
-	csize   = mmapfs->files[i].maxsize / (CLUSTERSIZE * SECTORSIZE);
-	csize  += (csize * (CLUSTERSIZE * SECTORSIZE)) < mmapfs->files[i].maxsize;
-	cend   += csize;
-	
-	// actual size and end
-	c2size  =  size / (CLUSTERSIZE * SECTORSIZE);
-	c2size += (size * (CLUSTERSIZE * SECTORSIZE)) < size;
-	c2end   = cstart + c2size - 1;
-
-
-	DBG("FAT %8s.%3s size %5d, cluster %3d.%3d.%3d, max %3d.%3d.%3d",
-		  mmapfs->files[i].name,mmapfs->files[i].ext,mmapfs->files[i].maxsize,
-		  cstart,csize,cend,cstart,c2size,c2end);
-
-	for( c = cstart ; c <= cend ; c++ )
-	{
-	    if (fat_sect == lba)
+	    if ((c >= layout[i].cstart) && (c <= layout[i].cend))
 	    {
-		if (c < c2end)
+		if (c < layout[i].c2end)
 		{
-		    mk = c;
+		    mk = c + 1;
 		}
-		else if (c == c2end)
+		else if (c == layout[i].c2end)
 		{
 		    mk = FAT_ENDOFCLUSTER;
 		}
-		else
-		{
-		    mk = FAT_BADCLUSTER;
-		}
-
-		sector[fat_off    ] =  mk       & 0xff;
-		sector[fat_off + 1] = (mk >> 8) & 0xff;
-	    }
-
-	    fat_off += 2;
-
-	    if (fat_off >= (SECTORSIZE/2))
-	    {
-		fat_sect ++;
-		fat_off  = 0;
+		break;
 	    }
 	}
-        // prepare next round
-	cstart = cend + 1;
+
+	write16( &sector[2 * e], mk);
     }
 
-    if (lba == 0) // we juste finished the requested sector
+    /* FAT16 start */
+    if (lba == 0)
     {
-	log_info("mmapfs read FAT sector %d",c);
+	sector[0] = MEDIA_TYPE;
+	sector[1] = 0xFF;
+	sector[2] = FAT_ENDOFCLUSTER & 0xff;
+	sector[3] = FAT_ENDOFCLUSTER >> 8;
+
+	log_info("mmapfs read FAT sector %d",lba);
 	DUMP_READ(lba, sector, SECTORSIZE);
     }
 }
@@ -379,19 +422,12 @@ typedef enum {
 } rootdir_mode_t;
 
 
-static void build_rootdirectory(rootdir_mode_t mode, const mmapfs_t *mmapfs, uint16_t lba, uint8_t *sector)
+static void build_rootdirectory(rootdir_mode_t mode, const mmapfs_t *mmapfs, uint32_t lba, uint8_t *sector)
 {
     int i;
-    int offset;
+    int offset = DIRECTORY_ENTRYSIZE;
     uint16_t date;
 
-    uint16_t cstart = DATA_FIRST_FAT_CLUSTER;     // current cluster start for file
-    uint16_t cend   = cstart - 1;                 // current cluster end for file
-    uint16_t csize;
-
-    int      present;
-    uint32_t size;
-
     DBG("r");
     if (mode == MMAPFS_BUILD)
     {
@@ -405,8 +441,6 @@ static void build_rootdirectory(rootdir_mode_t mode, const mmapfs_t *mmapfs, uin
 	    write16( &sector[0x10], FAT_DATE_DEFAULT); // create date
 	    write16( &sector[0x12], FAT_DATE_DEFAULT); // last access
 	    write16( &sector[0x18], FAT_DATE_DEFAULT); // last modified
-	    
-	    offset = DIRECTORY_ENTRYSIZE;
 	}
     }
 
@@ -416,34 +450,20 @@ static void build_rootdirectory(rootdir_mode_t mode, const mmapfs_t *mmapfs, uin
 	return ;
     }
 
-    for(i=0; i< mmapfs->size; i++)
+    for(i=0; i< layout_size; i++)
     {
 	date = FAT_DATE_DEFAULT;
 
-	if (mmapfs->files[i].info)
-	{
-	    mmapfs->files[i].info( mmapfs->files[i].arg, &present, &size);
-	}
-	else
-	{
-	    present = 1;
-	    size    = mmapfs->files[i].maxsize;
-	}
-
-	csize  = mmapfs->files[i].maxsize / (CLUSTERSIZE * SECTORSIZE);
-	csize += (csize * (CLUSTERSIZE * SECTORSIZE)) < mmapfs->files[i].maxsize;
-	cend  += csize;
-
-	DBG("RootDirectory %s.%s size %d start %d end %d (%d clusters)",
+	DBG("RootDirectory %s.%s size %d start %d end %d",
 		  mmapfs->files[i].name,mmapfs->files[i].ext,mmapfs->files[i].maxsize,
-		  cstart,cend,csize);
+		  layout[i].cstart,layout[i].cend);
 
 	switch (mode) 
 	{
 	case MMAPFS_BUILD: 
 	    // name and extension
 	    memcpy(& sector[ offset     ], mmapfs->files[i].name, 8);
-	    if (present == 0)
+	    if (layout[i].present == 0)
 	    {
 		sector[offset] = FAT_FILE_DELETED;
 	    }
@@ -453,12 +473,12 @@ static void build_rootdirectory(rootdir_mode_t mode, const mmapfs_t *mmapfs, uin
 	    write16( &sector[offset + 0x12], date);
 	    write16( &sector[offset + 0x18], date);
 	    // start cluster
-	    write16( &sector[offset + 0x1A], cstart);
+	    write16( &sector[offset + 0x1A], layout[i].cstart);
 	    // size
-	    write32( &sector[offset + 0x1C], size);
+	    write32( &sector[offset + 0x1C], layout[i].size);
 	    break;
 	case MMAPFS_CHECK:
-	    if ((present) && (sector[offset] == FAT_FILE_DELETED))
+	    if ((layout[i].present) && (sector[offset] == FAT_FILE_DELETED))
 	    {
 		if (mmapfs->files[i].unlink)
 		{
@@ -468,18 +488,14 @@ static void build_rootdirectory(rootdir_mode_t mode, const mmapfs_t *mmapfs, uin
 	    break;
 	}
 
-	cstart = cend + 1;
 	offset = offset + DIRECTORY_ENTRYSIZE;
     }
 
-    if (lba == 0)
+    if (mode == MMAPFS_BUILD)
     {
-	if (mode == MMAPFS_BUILD)
-	{
-	    log_info("mmapfs read RootDirectory sector %d",lba);
-	}
-	DUMP_READ(lba, sector, SECTORSIZE);
+	log_info("mmapfs read RootDirectory sector %d",lba);
     }
+    DUMP_READ(lba, sector, SECTORSIZE);
 }
 
 /*
@@ -494,25 +510,15 @@ typedef enum {
     MMAPFS_WRITE,
 } data_mode_t;
 
-static void build_data(data_mode_t mode, const mmapfs_t *mmapfs, uint16_t lba, uint8_t *sector)
+static void build_data(data_mode_t mode, const mmapfs_t *mmapfs, uint32_t lba, uint8_t *sector)
 {
     int i;
-    uint16_t cstart = DATA_FIRST_FAT_CLUSTER;     // current cluster start for file
-    uint16_t cend   = DATA_FIRST_FAT_CLUSTER - 1; // current cluster end for file
-    uint16_t csize;
     uint32_t sstart,send;
 
-    // log_info("mmapfs data sector %d",lba);
-    // memset(sector,0,SECTORSIZE);
-
-    for(i=0; i < mmapfs->size; i++)
+    for(i=0; i < layout_size; i++)
     {
-	csize  = mmapfs->files[i].maxsize / (CLUSTERSIZE * SECTORSIZE);
-	csize += (csize * (CLUSTERSIZE * SECTORSIZE)) < mmapfs->files[i].maxsize;
-	cend  += csize;
-
-	sstart  = fat_cluster_to_sector( cstart );
-	send    = fat_cluster_to_sector( cend   ) + CLUSTERSIZE - 1;
+	sstart  = fat_cluster_to_sector( layout[i].cstart );
+	send    = fat_cluster_to_sector( layout[i].cend   ) + CLUSTERSIZE - 1;
 
 	// the requested sector is in the file
 	if ((lba >= sstart) && (lba <= send))
@@ -520,27 +526,74 @@ static void build_data(data_mode_t mode, const mmapfs_t *mmapfs, uint16_t lba, u
 	    switch (mode)
 	    {
 	    case MMAPFS_READ:
-		DBG("mmapfs read %s.%s size %d start %d end %d (%d clusters) :: lba %d cluster %d",
-			  mmapfs->files[i].name,mmapfs->files[i].ext,mmapfs->files[i].maxsize,
-			  cstart, cend, csize, lba, lba / CLUSTERSIZE);
+		DBG("mmapfs read %s.%s :: lba %d cluster %d",
+			  mmapfs->files[i].name,mmapfs->files[i].ext, lba, lba / CLUSTERSIZE);
 		mmapfs->files[i].read( mmapfs->files[i].arg, lba - sstart, sector);
 		break;
 	    case MMAPFS_WRITE:
-		DBG("mmapfs write %s.%s size %d start %d end %d (%d clusters) :: lba %d cluster %d",
-			  mmapfs->files[i].name,mmapfs->files[i].ext,mmapfs->files[i].maxsize,
-			  cstart, cend, csize, lba, lba / CLUSTERSIZE);
+		DBG("mmapfs write %s.%s :: lba %d cluster %d",
+			  mmapfs->files[i].name,mmapfs->files[i].ext, lba, lba / CLUSTERSIZE);
 		mmapfs->files[i].write( mmapfs->files[i].arg, lba - sstart, sector);
 		break;
 	    }
 	    return;
 	}
-	cstart = cend + 1;
     }
     
     memset(sector,0,SECTORSIZE);
     //log_error("mmapfs file not found lba %d cluster %d",lba,lba / CLUSTERSIZE);
 }
 
+/*
+ * Metadata sectors (FAT and RootDirectory) are served from the cache,
+ * data sectors are read from the files.
+ */
+static void read_sector(const mmapfs_t *mmapfs, uint32_t lba, uint8_t *sector)
+{
+    int i;
+    mmapfs_cached_sector_t *slot;
+
+    // Boot and reserved sectors
+    if (lba < FAT_FAT1_FIRST)
+    {
+	build_bootsector(mmapfs,lba,sector);
+	return;
+    }
+
+    // Data
+    if (lba > DIRECTORY_LAST)
+    {
+	build_data(MMAPFS_READ, mmapfs,lba,sector);
+	return;
+    }
+
+    for(i=0; i < MMAPFS_CACHE_SECTORS; i++)
+    {
+	if (cache[i].valid && (cache[i].lba == lba))
+	{
+	    memcpy(sector, cache[i].data, SECTORSIZE);
+	    return;
+	}
+    }
+
+    // FAT 1
+    if (lba <= FAT_FAT1_LAST)
+    {
+	build_fat(mmapfs,lba - FAT_FAT1_FIRST,sector);
+    } 
+    // RootDirectory
+    else
+    {
+	build_rootdirectory(MMAPFS_BUILD, mmapfs,lba - DIRECTORY_FIRST,sector);
+    }
+
+    slot = &cache[cache_next];
+    cache_next = (cache_next + 1) % MMAPFS_CACHE_SECTORS;
+    memcpy(slot->data, sector, SECTORSIZE);
+    slot->lba   = lba;
+    slot->valid = true;
+}
+
 
 /* ********************************************************************** */
 /* READ CAPACITY(10), MMC5 page 435                                       */
@@ -569,6 +622,7 @@ scsi_cmdret_t scsi_mmapfs_read10(scsi_params_t scsi_params)
     //uint8_t       FUA      = (cdb10->cdb_info >> 3) & 0x1;
     uint32_t        lba      = msbtohost32(cdb10->lba);
     uint32_t        nblocks  = msbtohost16(cdb10->length);
+    uint32_t        count, i;
     
     scsi_cmdret_t   ret;
 
@@ -588,50 +642,35 @@ scsi_cmdret_t scsi_mmapfs_read10(scsi_params_t scsi_params)
 
     DBG("R%d",lba);
 
-    // Boot and reserved sectors
-    if ((lba >= 0) && (lba < FAT_FAT1_FIRST))
-    {
-	build_bootsector(mmapfs,lba,scsi_params.data);
-    } 
-    // FAT 1
-    else if ((lba >= FAT_FAT1_FIRST) && (lba <= FAT_FAT1_LAST))
-    {
-	build_fat(mmapfs,lba - FAT_FAT1_FIRST,scsi_params.data);
-    } 
-    // RootDirectory
-    else if ((lba >= DIRECTORY_FIRST) && (lba <= DIRECTORY_LAST))
-    {
-	build_rootdirectory(MMAPFS_BUILD, mmapfs,lba - DIRECTORY_FIRST,scsi_params.data);
-    }
-    // Data
-    else
+    update_layout(mmapfs);
+
+    // Serve as many contiguous sectors as the buffer can hold
+    count = min(nblocks, scsi_params.datamax / LUN_SECTORSIZE);
+    for(i=0; i < count; i++)
     {
-	build_data(MMAPFS_READ, mmapfs,lba,scsi_params.data);
+	read_sector(mmapfs, lba + i, scsi_params.data + i * LUN_SECTORSIZE);
     }
 
     DBG(" ");
 
-
-    *scsi_params.datalen = scsi_params.datamax;
-
-    switch (nblocks)
+    if (nblocks == 0)
     {
-    case 0:
 	*scsi_params.status     = SCSI_CHECK_CONDITION;
 	ret            = SCSI_CMD_ERROR;
-	break;
-    case 1:
-	*scsi_params.datalen    = LUN_SECTORSIZE;
+    }
+    else if (nblocks == count)
+    {
+	*scsi_params.datalen    = count * LUN_SECTORSIZE;
 	*scsi_params.status     = SCSI_GOOD;
 	ret            = SCSI_CMD_DONE;
-	break;
-    default:
-	cdb10->lba     = msbtohost32( lba     + 1 );
-	cdb10->length  = msbtohost16( nblocks - 1 );
-	*scsi_params.datalen    = LUN_SECTORSIZE;
+    }
+    else
+    {
+	cdb10->lba     = msbtohost32( lba     + count );
+	cdb10->length  = msbtohost16( nblocks - count );
+	*scsi_params.datalen    = count * LUN_SECTORSIZE;
 	*scsi_params.status     = SCSI_GOOD;
 	ret            = SCSI_CMD_PARTIAL;
-	break;
     }
     return ret;
 }
@@ -680,8 +719,10 @@ scsi_cmdret_t scsi_mmapfs_write10( scsi_params_t scsi_params)
     }
     else
     {
+	update_layout(mmapfs);
+
 	// Boot and reserved sectors
-	if ((lba >= 0) && (lba < FAT_FAT1_FIRST))
+	if (lba < FAT_FAT1_FIRST)
 	{
 	    log_error("mmapfs write to Boot sector %d",lba );
 	    DUMP_WRITE(lba, scsi_params.data, SECTORSIZE);
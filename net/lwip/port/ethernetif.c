@@ -50,14 +50,92 @@
 
 #include "netif/etharp.h"
 
+#include "platform.h"
 #include "ethmac.h"
 
 /* Define those to better describe your network interface. */
 #define IFNAME0 'e'
 #define IFNAME1 'n'
 
+/*
+ * Zero-copy: the received frames are passed to the stack in the DMA buffers
+ * (custom pbufs, whose buffer goes back to the descriptors when freed), and
+ * the pbufs to send are read in place by the DMA (a descriptor per pbuf).
+ */
+#ifndef ETHERNETIF_ZEROCOPY
+#define ETHERNETIF_ZEROCOPY (ETH_PAD_SIZE == 0)
+#endif
+
+#if ETHERNETIF_ZEROCOPY
+
+#if ETH_PAD_SIZE || !LWIP_SUPPORT_CUSTOM_PBUF
+#error "Zero-copy requires ETH_PAD_SIZE == 0 and the custom pbufs"
+#endif
+
+/** Spare receive buffers, swapped with the descriptor ones at reception */
+#ifndef ETHERNETIF_RX_BUFFERS
+#define ETHERNETIF_RX_BUFFERS 4
+#endif
+
+/** Maximum number of pbufs of a frame sent in place, copied otherwise */
+#define ETHERNETIF_TX_SEGMENTS 4
+
+/** A received frame lent to the stack */
+struct rx_pbuf
+{
+    struct pbuf_custom pc;
+
+    /** The received frame if lent, a spare buffer if free */
+    uint8_t *buffer;
+
+    struct rx_pbuf *next;
+};
+
+static struct rx_pbuf rx_pbufs[ETHERNETIF_RX_BUFFERS];
+static struct rx_pbuf *rx_free;
+
+static uint8_t rx_buffers[ETHERNETIF_RX_BUFFERS][ETHMAC_BUFFER_SIZE]
+        __attribute__((aligned(4)));
+
+static void rx_pbuf_free(struct pbuf *p);
+static void tx_reclaim(void *arg);
+
+/** Set while a reclaim is requested and not started */
+static volatile uint8_t tx_scheduled;
+
+#endif
+
+/*
+ * Interrupt moderation: a receive interrupt every ETHERNETIF_RX_COALESCE_FRAMES
+ * frames, or ETHERNETIF_RX_COALESCE_US after a frame. A transmit interrupt
+ * every ETHERNETIF_TX_COALESCE_FRAMES frames, to free the sent pbufs in zero
+ * copy mode; none otherwise, the copied frames need no reclaim.
+ */
+#ifndef ETHERNETIF_RX_COALESCE_FRAMES
+#define ETHERNETIF_RX_COALESCE_FRAMES 2
+#endif
+#ifndef ETHERNETIF_RX_COALESCE_US
+#define ETHERNETIF_RX_COALESCE_US 100
+#endif
+#ifndef ETHERNETIF_TX_COALESCE_FRAMES
+#if ETHERNETIF_ZEROCOPY
+#define ETHERNETIF_TX_COALESCE_FRAMES 1
+#else
+#define ETHERNETIF_TX_COALESCE_FRAMES 0
+#endif
+#endif
+
+/** Maximum number of frames processed per message of the tcpip thread */
+#ifndef ETHERNETIF_RX_BATCH
+#define ETHERNETIF_RX_BATCH 16
+#endif
+
 /* Forward declarations. */
-static void ethernetif_input(struct netif *netif);
+static void ethernetif_input(struct netif *netif, struct pbuf *p);
+static void rx_request(struct netif *netif);
+
+/** Set while a batch is requested and not started */
+static volatile uint8_t rx_scheduled;
 
 /**
  * In this function, the hardware should be initialized.
@@ -78,7 +156,19 @@ static void low_level_init(struct netif *netif)
     /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
     netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
 
-    /* Do whatever else is needed to initialize interface. */
+#if ETHERNETIF_ZEROCOPY
+    unsigned i;
+
+    /* All the spare receive buffers are free */
+    rx_free = NULL;
+    for (i = 0; i < ETHERNETIF_RX_BUFFERS; i++)
+    {
+        rx_pbufs[i].pc.custom_free_function = rx_pbuf_free;
+        rx_pbufs[i].buffer = rx_buffers[i];
+        rx_pbufs[i].next = rx_free;
+        rx_free = &rx_pbufs[i];
+    }
+#endif
 }
 
 /**
@@ -97,6 +187,87 @@ static void low_level_init(struct netif *netif)
  *       dropped because of memory failure (except for the TCP timers).
  */
 
+#if ETHERNETIF_ZEROCOPY
+
+static err_t low_level_output(struct netif *netif, struct pbuf *p)
+{
+    ethmac_tx_buffer_t buffers[ETHERNETIF_TX_SEGMENTS];
+    struct pbuf *q, *frame;
+    uint32_t count = 0;
+
+    // Release the frames sent since the previous call
+    tx_reclaim(NULL);
+
+    for (q = p; q != NULL; q = q->next)
+    {
+        if (q->len)
+        {
+            count++;
+        }
+    }
+
+    if (count <= ETHERNETIF_TX_SEGMENTS && count <= ethmac_tx_get_free())
+    {
+        // Sent in place, keep the chain until the DMA is done, the TCP
+        // output does not rewrite a segment while it is referenced here
+        frame = p;
+        pbuf_ref(frame);
+    }
+    else
+    {
+        // Too many parts for the free descriptors, merge them in one
+        frame = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+        if (frame == NULL)
+        {
+            LINK_STATS_INC(link.memerr);
+            LINK_STATS_INC(link.drop);
+            return ERR_MEM;
+        }
+
+        pbuf_copy(frame, p);
+    }
+
+    count = 0;
+    for (q = frame; q != NULL; q = q->next)
+    {
+        if (q->len)
+        {
+            buffers[count].data = q->payload;
+            buffers[count].length = q->len;
+            count++;
+        }
+    }
+
+    if (!ethmac_tx_send_buffers(buffers, count, frame))
+    {
+        log_error("Failed to get a TX descriptor");
+        pbuf_free(frame);
+        return ERR_TIMEOUT;
+    }
+
+    LINK_STATS_INC(link.xmit);
+
+    return ERR_OK;
+}
+
+/**
+ * Free the pbufs sent by the DMA, in the tcpip thread.
+ */
+static void tx_reclaim(void *arg)
+{
+    struct pbuf *frame;
+
+    /* the interrupts from now on request another reclaim */
+    tx_scheduled = 0;
+
+    while ((frame = ethmac_tx_reclaim()) != NULL)
+    {
+        pbuf_free(frame);
+    }
+}
+
+#else
+
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
     ethmac_tx_t tx;
@@ -135,6 +306,8 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
     return ERR_OK;
 }
 
+#endif
+
 /**
  * Should allocate a pbuf and transfer the bytes of the incoming
  * packet from the interface into the pbuf.
@@ -161,6 +334,33 @@ low_level_input(struct netif *netif)
      variable. */
     len = ethmac_rx_get_len(&rx);
 
+#if ETHERNETIF_ZEROCOPY
+    struct rx_pbuf *rp;
+
+    platform_enter_critical();
+    rp = rx_free;
+    if (rp)
+    {
+        rx_free = rp->next;
+    }
+    platform_exit_critical();
+
+    if (rp)
+    {
+        /* Lend the frame buffer, the descriptor takes the spare one */
+        uint8_t *buffer = ethmac_rx_get_buffer(&rx);
+        ethmac_rx_release_buffer(&rx, rp->buffer);
+        rp->buffer = buffer;
+
+        LINK_STATS_INC(link.recv);
+
+        return pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rp->pc, buffer,
+                ETHMAC_BUFFER_SIZE);
+    }
+
+    /* All the spare buffers are held by the stack, copy the frame */
+#endif
+
 #if ETH_PAD_SIZE
     len += ETH_PAD_SIZE; /* allow room for Ethernet padding */
 #endif
@@ -208,25 +408,68 @@ low_level_input(struct netif *netif)
     return p;
 }
 
+#if ETHERNETIF_ZEROCOPY
+/**
+ * Free function of the received frames, the buffer becomes a spare one.
+ */
+static void rx_pbuf_free(struct pbuf *p)
+{
+    struct rx_pbuf *rp = (struct rx_pbuf *) p;
+
+    platform_enter_critical();
+    rp->next = rx_free;
+    rx_free = rp;
+    platform_exit_critical();
+}
+#endif
+
+/**
+ * This function is called in the tcpip thread when packets are ready to be
+ * read from the interface. It uses the function low_level_input() for each
+ * of the received packets, up to ETHERNETIF_RX_BATCH, and passes them to
+ * ethernetif_input().
+ *
+ * @param arg the lwip network interface structure for this ethernetif
+ */
+static void ethernetif_rx_batch(void *arg)
+{
+    struct netif *netif = arg;
+    struct pbuf *p;
+    unsigned count;
+
+    /* the interrupts from now on request another batch */
+    rx_scheduled = 0;
+
+    for (count = 0; count < ETHERNETIF_RX_BATCH && ethmac_rx_pending(); count++)
+    {
+        /* move received packet into a new pbuf */
+        p = low_level_input(netif);
+
+        /* no packet could be read, silently ignore this */
+        if (p != NULL)
+        {
+            ethernetif_input(netif, p);
+        }
+    }
+
+    /* let the other messages in before the remaining packets */
+    if (ethmac_rx_pending())
+    {
+        rx_request(netif);
+    }
+}
+
 /**
- * This function should be called when a packet is ready to be read
- * from the interface. It uses the function low_level_input() that
- * should handle the actual reception of bytes from the network
- * interface. Then the type of the received packet is determined and
- * the appropriate input function is called.
+ * The type of the received packet is determined and the appropriate input
+ * function is called, in the tcpip thread.
  *
  * @param netif the lwip network interface structure for this ethernetif
+ * @param p the received packet
  */
-static void ethernetif_input(struct netif *netif)
+static void ethernetif_input(struct netif *netif, struct pbuf *p)
 {
     struct eth_hdr *ethhdr;
-    struct pbuf *p;
 
-    /* move received packet into a new pbuf */
-    p = low_level_input(netif);
-    /* no packet could be read, silently ignore this */
-    if (p == NULL)
-        return;
     /* points to packet payload, which starts with an Ethernet header */
     ethhdr = p->payload;
 
@@ -240,8 +483,8 @@ static void ethernetif_input(struct netif *netif)
             case ETHTYPE_PPPOEDISC:
             case ETHTYPE_PPPOE:
 #endif /* PPPOE_SUPPORT */
-            /* full packet send to tcpip_thread to process */
-            if (netif->input(p, netif) != ERR_OK)
+            /* full packet processed, already in the tcpip thread */
+            if (ethernet_input(p, netif) != ERR_OK)
             {
                 LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: IP input error\n"));
                 pbuf_free(p);
@@ -353,6 +596,8 @@ void hkb_lwip_init(struct lwip_config *config)
     // Start the MAC
     ethmac_enable();
     ethmac_start(ethif.hwaddr);
+    ethmac_set_coalescing(ETHERNETIF_RX_COALESCE_FRAMES,
+            ETHERNETIF_RX_COALESCE_US, ETHERNETIF_TX_COALESCE_FRAMES);
 
     // Add the interface
     netif_add(&ethif, &ip, &netmask, &gateway, NULL, ethernetif_init,
@@ -395,13 +640,84 @@ void check_status(handler_arg_t arg)
         tcpip_callback_with_block((tcpip_callback_fn) netif_set_link_down,
                 &ethif, 0);
     }
+
+#if ETHERNETIF_ZEROCOPY
+    // Free the sent pbufs left by a failed reclaim request
+    tcpip_callback_with_block(tx_reclaim, NULL, 0);
+#endif
+
+    // Process the packets left if a batch could not be requested
+    if (ethmac_rx_pending())
+    {
+        rx_request(&ethif);
+    }
+}
+
+static void rx_post(handler_arg_t arg)
+{
+    // One message for all the packets received until it is processed
+    if (tcpip_callback_with_block(ethernetif_rx_batch, arg, 0) != ERR_OK)
+    {
+        // Mailbox full, retried on the next interrupt or link check
+        rx_scheduled = 0;
+    }
+}
+
+static void rx_request(struct netif *netif)
+{
+    uint32_t post;
+
+    platform_enter_critical();
+    post = !rx_scheduled;
+    rx_scheduled = 1;
+    platform_exit_critical();
+
+    if (post)
+    {
+        rx_post(netif);
+    }
 }
 
 void ethmac_frame_received_isr()
 {
-    event_post_from_isr(EVENT_QUEUE_APPLI, (handler_t) ethernetif_input,
-            &ethif);
+    // The batch requested and not started yet will take this packet too
+    if (!rx_scheduled)
+    {
+        rx_scheduled = 1;
+
+        if (event_post_from_isr(EVENT_QUEUE_APPLI, rx_post, &ethif)
+                != EVENT_OK)
+        {
+            // Event queue full, retried on the next interrupt or link check
+            rx_scheduled = 0;
+        }
+    }
 }
+#if ETHERNETIF_ZEROCOPY
+static void tx_post(handler_arg_t arg)
+{
+    // One message for all the frames sent until it is processed
+    if (tcpip_callback_with_block(tx_reclaim, arg, 0) != ERR_OK)
+    {
+        // Mailbox full, retried on the next interrupt or link check
+        tx_scheduled = 0;
+    }
+}
+#endif
+
 void ethmac_frame_sent_isr()
 {
+#if ETHERNETIF_ZEROCOPY
+    // The reclaim requested and not started yet will free this frame too
+    if (!tx_scheduled)
+    {
+        tx_scheduled = 1;
+
+        if (event_post_from_isr(EVENT_QUEUE_APPLI, tx_post, NULL) != EVENT_OK)
+        {
+            // Event queue full, retried on the next interrupt or link check
+            tx_scheduled = 0;
+        }
+    }
+#endif
 }
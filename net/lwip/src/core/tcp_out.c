@@ -1049,6 +1049,16 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   struct netif *netif;
   u32_t *opts;
 
+  if (seg->p->ref != 1) {
+    /* The netif driver still references the previous transmission of this
+       segment (zero copy TX): its headers must not be rewritten in place.
+       It is sent again on the next retransmission timeout. */
+    if (pcb->rtime == -1) {
+      pcb->rtime = 0;
+    }
+    return;
+  }
+
   /** @bug Exclude retransmitted segments from this count. */
   snmp_inc_tcpoutsegs();
 
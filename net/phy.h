@@ -317,6 +317,24 @@ phy_status_t phy_cca(phy_t phy, int32_t *cca);
  */
 phy_status_t phy_ed(phy_t phy, int32_t *ed);
 
+/**
+ * Perform Energy Detection measurements on several channels.
+ *
+ * This method enters RX once, and measures the energy on each requested
+ * channel back to back, only waiting for the synthesizer to settle between
+ * two channels. The previously selected channel is restored.
+ *
+ * \note The PHY must be in SLEEP or IDLE state to perform a ED measurement.
+ *
+ * \param phy the PHY
+ * \param channels a bitmap of the channels to measure, bit n for channel n
+ * \param ed an array to store the ED results in dBm, one per requested
+ *          channel in increasing channel order
+ * \return the status of the operation, \ref PHY_SUCCESS on success,
+ * or \ref PHY_ERR_INVALID_STATE if the radio was an invalid state
+ */
+phy_status_t phy_ed_sweep(phy_t phy, uint32_t channels, int8_t *ed);
+
 /**
  * Set the PHY in RX state, at a given time.
  *
@@ -0,0 +1,388 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * phy_native.c
+ *
+ * The end of TX, the end of the received frames and the RX timeouts are
+ * soft timer alarms handled in the network event queue, where the handlers
+ * of the PHY are called, as with the real radio.
+ */
+
+#include "phy_native.h"
+#include "random.h"
+#include "event.h"
+
+#define LOG_LEVEL LOG_LEVEL_WARNING
+#include "debug.h"
+
+/** Air time of a byte at 250kbps */
+#define PHY_NATIVE_BYTE_US 32
+/** Synchronization header and length bytes, before the frame */
+#define PHY_NATIVE_HEADER_BYTES 6
+
+static void timer_handler(handler_arg_t arg);
+static void schedule_rx(phy_native_t *_phy, uint32_t start);
+
+void phy_native_init(phy_native_t *phy, uint32_t rx_period,
+        uint32_t rx_channels)
+{
+    phy->rx_period = rx_period;
+    phy->rx_channels = rx_channels;
+    phy->rx_seq = 0;
+
+    soft_timer_set_handler(&phy->timer, timer_handler, phy);
+    soft_timer_set_event_priority(&phy->timer, EVENT_QUEUE_NETWORK);
+
+    // The soft timer is not initialized yet, do not stop the timer
+    phy->state = PHY_NATIVE_STATE_SLEEP;
+    phy->channel = PHY_2400_MIN_CHANNEL;
+    phy->power = PHY_POWER_0dBm;
+}
+
+static uint32_t air_time(uint8_t length)
+{
+    return soft_timer_us_to_ticks(
+            (PHY_NATIVE_HEADER_BYTES + length) * PHY_NATIVE_BYTE_US);
+}
+
+static void set_alarm(phy_native_t *_phy, uint32_t t)
+{
+    _phy->alarm = t;
+    soft_timer_start_at(&_phy->timer, t);
+}
+
+void phy_reset(phy_t phy)
+{
+    phy_native_t *_phy = phy;
+
+    phy_sleep(phy);
+    _phy->channel = PHY_2400_MIN_CHANNEL;
+    _phy->power = PHY_POWER_0dBm;
+}
+
+void phy_idle(phy_t phy)
+{
+    phy_native_t *_phy = phy;
+
+    soft_timer_stop(&_phy->timer);
+    _phy->state = PHY_NATIVE_STATE_IDLE;
+}
+
+void phy_sleep(phy_t phy)
+{
+    phy_native_t *_phy = phy;
+
+    soft_timer_stop(&_phy->timer);
+    _phy->state = PHY_NATIVE_STATE_SLEEP;
+}
+
+static int is_ready(phy_native_t *_phy)
+{
+    return _phy->state == PHY_NATIVE_STATE_IDLE
+           || _phy->state == PHY_NATIVE_STATE_SLEEP;
+}
+
+phy_status_t phy_set_channel(phy_t phy, uint8_t channel)
+{
+    phy_native_t *_phy = phy;
+
+    if (!is_ready(_phy))
+    {
+        return PHY_ERR_INVALID_STATE;
+    }
+
+    if (channel < PHY_2400_MIN_CHANNEL)
+    {
+        channel = PHY_2400_MIN_CHANNEL;
+    }
+    else if (channel > PHY_2400_MAX_CHANNEL)
+    {
+        channel = PHY_2400_MAX_CHANNEL;
+    }
+
+    _phy->channel = channel;
+    return PHY_SUCCESS;
+}
+
+phy_status_t phy_set_power(phy_t phy, phy_power_t power)
+{
+    phy_native_t *_phy = phy;
+
+    if (!is_ready(_phy))
+    {
+        return PHY_ERR_INVALID_STATE;
+    }
+
+    _phy->power = power;
+    return PHY_SUCCESS;
+}
+
+/** Noise floor, with the frames of the simulated traffic now and then */
+static int8_t energy(phy_native_t *_phy, uint8_t channel)
+{
+    int8_t ed = -91 + random_rand16() % 4;
+
+    if (_phy->rx_period && (_phy->rx_channels & (1 << channel))
+            && (random_rand16() % 4) == 0)
+    {
+        ed = -70 + random_rand16() % 20;
+    }
+
+    return ed;
+}
+
+phy_status_t phy_cca(phy_t phy, int32_t *cca)
+{
+    phy_native_t *_phy = phy;
+
+    if (!is_ready(_phy))
+    {
+        return PHY_ERR_INVALID_STATE;
+    }
+
+    *cca = energy(_phy, _phy->channel) < -77;
+    return PHY_SUCCESS;
+}
+
+phy_status_t phy_ed(phy_t phy, int32_t *ed)
+{
+    phy_native_t *_phy = phy;
+
+    if (!is_ready(_phy))
+    {
+        return PHY_ERR_INVALID_STATE;
+    }
+
+    *ed = energy(_phy, _phy->channel);
+    return PHY_SUCCESS;
+}
+
+phy_status_t phy_ed_sweep(phy_t phy, uint32_t channels, int8_t *ed)
+{
+    phy_native_t *_phy = phy;
+    uint8_t channel;
+
+    if (!is_ready(_phy))
+    {
+        return PHY_ERR_INVALID_STATE;
+    }
+
+    for (channel = PHY_2400_MIN_CHANNEL; channel <= PHY_2400_MAX_CHANNEL;
+            channel++)
+    {
+        if (channels & (1 << channel))
+        {
+            *ed++ = energy(_phy, channel);
+        }
+    }
+
+    return PHY_SUCCESS;
+}
+
+phy_status_t phy_rx(phy_t phy, uint32_t rx_time, uint32_t timeout_time,
+                    phy_packet_t *pkt, phy_handler_t handler)
+{
+    phy_native_t *_phy = phy;
+    uint32_t now = soft_timer_time();
+
+    if (!is_ready(_phy))
+    {
+        return PHY_ERR_INVALID_STATE;
+    }
+
+    if (rx_time && (int32_t) (rx_time - now) <= 1)
+    {
+        return PHY_ERR_TOO_LATE;
+    }
+
+    _phy->pkt = pkt;
+    _phy->handler = handler;
+    _phy->rx_timeout = timeout_time;
+    _phy->state = PHY_NATIVE_STATE_RX;
+
+    schedule_rx(_phy, rx_time ? rx_time : now);
+    return PHY_SUCCESS;
+}
+
+static void schedule_rx(phy_native_t *_phy, uint32_t start)
+{
+    uint32_t end = 0;
+
+    if (_phy->rx_period && (_phy->rx_channels & (1 << _phy->channel)))
+    {
+        // Frames every half to one and a half period
+        end = start + _phy->rx_period / 2 + random_rand32() % _phy->rx_period;
+    }
+
+    if (_phy->rx_timeout
+            && (end == 0 || soft_timer_a_is_before_b(_phy->rx_timeout, end)))
+    {
+        end = _phy->rx_timeout;
+    }
+    else
+    {
+        _phy->rx_timeout = 0;
+    }
+
+    if (end)
+    {
+        set_alarm(_phy, end);
+    }
+}
+
+static void receive(phy_native_t *_phy, uint32_t now)
+{
+    phy_packet_t *pkt = _phy->pkt;
+    uint8_t i, length = 12 + _phy->rx_seq % 64;
+
+    // A broadcast data frame, with short addresses and the PAN compressed
+    phy_prepare_packet(pkt);
+    pkt->data[0] = 0x41;
+    pkt->data[1] = 0x88;
+    pkt->data[2] = _phy->rx_seq++;
+    pkt->data[3] = 0x34;
+    pkt->data[4] = 0x12;
+    pkt->data[5] = 0xFF;
+    pkt->data[6] = 0xFF;
+    pkt->data[7] = _phy->channel;
+    pkt->data[8] = 0x00;
+
+    for (i = 9; i < length; i++)
+    {
+        pkt->data[i] = i;
+    }
+
+    pkt->length = length;
+    pkt->rssi = -80 + random_rand16() % 40;
+    pkt->lqi = 255 - random_rand16() % 16;
+    pkt->eop_time = now;
+    pkt->timestamp = now - air_time(length)
+                     + soft_timer_us_to_ticks(5 * PHY_NATIVE_BYTE_US);
+}
+
+static void timer_handler(handler_arg_t arg)
+{
+    phy_native_t *_phy = arg;
+    uint32_t now = soft_timer_time();
+
+    // Ignore an alarm stopped after it was posted
+    if ((int32_t) (now - _phy->alarm) < 0)
+    {
+        return;
+    }
+
+    switch (_phy->state)
+    {
+        case PHY_NATIVE_STATE_TX:
+            _phy->state = PHY_NATIVE_STATE_IDLE;
+            _phy->handler(PHY_SUCCESS);
+            break;
+
+        case PHY_NATIVE_STATE_RX:
+            _phy->state = PHY_NATIVE_STATE_IDLE;
+
+            if (_phy->rx_timeout)
+            {
+                _phy->handler(PHY_RX_TIMEOUT_ERROR);
+            }
+            else
+            {
+                receive(_phy, now);
+                _phy->handler(PHY_SUCCESS);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+phy_status_t phy_tx(phy_t phy, uint32_t tx_time, phy_packet_t *pkt,
+                    phy_handler_t handler)
+{
+    phy_native_t *_phy = phy;
+    uint32_t now = soft_timer_time();
+
+    if (!is_ready(_phy))
+    {
+        return PHY_ERR_INVALID_STATE;
+    }
+
+    if (pkt->length > PHY_MAX_TX_LENGTH)
+    {
+        return PHY_ERR_INVALID_LENGTH;
+    }
+
+    if (tx_time && (int32_t) (tx_time - now) <= 1)
+    {
+        return PHY_ERR_TOO_LATE;
+    }
+
+    uint32_t start = tx_time ? tx_time : now;
+
+    _phy->pkt = pkt;
+    _phy->handler = handler;
+    _phy->state = PHY_NATIVE_STATE_TX;
+
+    pkt->timestamp = start + soft_timer_us_to_ticks(5 * PHY_NATIVE_BYTE_US);
+    pkt->eop_time = start + air_time(pkt->length);
+
+    log_debug("TX %u bytes on channel %u", pkt->length, _phy->channel);
+    set_alarm(_phy, pkt->eop_time);
+    return PHY_SUCCESS;
+}
+
+phy_power_t phy_convert_power(float power)
+{
+    // Same steps as the RF231, rounded to the closest
+    static const float steps[] =
+    {
+        0.0f, 0.7f, 1.0f, 1.3f, 1.8f, 2.0f, 2.3f, 2.8f, 3.0f, 4.0f, 5.0f
+    };
+    uint32_t i;
+
+    if (power < -0.5f)
+    {
+        int32_t db = power - 0.5f;
+        return (db < -30) ? PHY_POWER_m30dBm : PHY_POWER_0dBm + db;
+    }
+
+    for (i = 1; i < sizeof(steps) / sizeof(steps[0]); i++)
+    {
+        if (power < (steps[i - 1] + steps[i]) / 2)
+        {
+            break;
+        }
+    }
+
+    return PHY_POWER_0dBm + i - 1;
+}
+
+phy_status_t phy_jam(phy_t phy, uint8_t channel, phy_power_t power)
+{
+    phy_native_t *_phy = phy;
+
+    phy_idle(phy);
+    phy_set_channel(phy, channel);
+    phy_set_power(phy, power);
+    _phy->state = PHY_NATIVE_STATE_JAMMING;
+
+    return PHY_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+/*
+ * phy_native.h
+ *
+ * Simulated 2.4GHz PHY for the native platform.
+ *
+ * Transmissions last the air time of the frame at 250kbps, received frames
+ * are generated at random intervals on the configured channels, and energy
+ * measurements return noise, higher on the channels with traffic.
+ */
+
+#ifndef PHY_NATIVE_H_
+#define PHY_NATIVE_H_
+
+#include "phy.h"
+#include "soft_timer.h"
+
+typedef enum
+{
+    PHY_NATIVE_STATE_SLEEP = 0,
+    PHY_NATIVE_STATE_IDLE = 1,
+    PHY_NATIVE_STATE_RX = 2,
+    PHY_NATIVE_STATE_TX = 3,
+    PHY_NATIVE_STATE_JAMMING = 4,
+} phy_native_state_t;
+
+typedef struct
+{
+    // Running State
+    volatile phy_native_state_t state;
+
+    uint8_t channel;
+    phy_power_t power;
+
+    // Pointers to the packet used in TX or RX, and the handler
+    phy_packet_t *pkt;
+    phy_handler_t handler;
+
+    // End of TX, end of the next received frame, or RX timeout
+    soft_timer_t timer;
+    uint32_t alarm;
+    uint32_t rx_timeout;
+
+    // Simulated traffic
+    uint32_t rx_period;
+    uint32_t rx_channels;
+    uint8_t rx_seq;
+} phy_native_t;
+
+/**
+ * Initialize the simulated PHY.
+ *
+ * \param phy the PHY to init
+ * \param rx_period the mean interval between two received frames, in soft
+ *      timer ticks, 0 for no traffic
+ * \param rx_channels the bitmap of the channels with traffic
+ */
+void phy_native_init(phy_native_t *phy, uint32_t rx_period,
+        uint32_t rx_channels);
+
+#endif /* PHY_NATIVE_H_ */
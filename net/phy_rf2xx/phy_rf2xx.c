@@ -388,6 +388,135 @@ phy_status_t phy_ed(phy_t phy, int32_t *ed)
     return phy_ed_cca_measure(phy, ed, 1);
 }
 
+static phy_status_t wait_irq_status(phy_rf2xx_t *_phy, uint8_t mask)
+{
+    uint32_t t_end = soft_timer_time() + RF_MAX_WAIT;
+
+    while ((rf2xx_reg_read(_phy->radio, RF2XX_REG__IRQ_STATUS) & mask) == 0)
+    {
+        // Check for block
+        if (!soft_timer_a_is_before_b(soft_timer_time(), t_end))
+        {
+            return PHY_ERR_INTERNAL;
+        }
+    }
+
+    return PHY_SUCCESS;
+}
+
+phy_status_t phy_ed_sweep(phy_t phy, uint32_t channels, int8_t *ed)
+{
+    take();
+
+    // Cast to RF2XX PHY
+    phy_rf2xx_t *_phy = phy;
+    phy_status_t ret = PHY_SUCCESS;
+
+    // Check state
+    switch (_phy->state)
+    {
+        case PHY_STATE_SLEEP:
+            // Wakeup
+            rf2xx_wakeup(_phy->radio);
+            break;
+        case PHY_STATE_IDLE:
+            // Nothing to do
+            break;
+        default:
+            // Invalid state!
+            log_error("Invalid state %u", _phy->state);
+
+            give();
+            return PHY_ERR_INVALID_STATE;
+    }
+
+    // Only 2.4GHz channels can be swept
+    if (rf2xx_get_type(_phy->radio) != RF2XX_TYPE_2_4GHz)
+    {
+        channels = 0;
+    }
+
+    // Save the current channel
+    uint8_t cc_cca = rf2xx_reg_read(_phy->radio, RF2XX_REG__PHY_CC_CCA);
+
+    // Disable interrupt, flags are polled
+    rf2xx_irq_disable(_phy->radio);
+    rf2xx_reg_write(_phy->radio, RF2XX_REG__IRQ_MASK,
+            RF2XX_IRQ_STATUS_MASK__PLL_LOCK
+                    | RF2XX_IRQ_STATUS_MASK__CCA_ED_DONE);
+
+    // Start RX once for all the channels
+    rf2xx_set_state(_phy->radio, RF2XX_TRX_STATE__RX_ON);
+
+    uint8_t reg;
+    uint32_t t_end = soft_timer_time() + RF_MAX_WAIT;
+
+    do
+    {
+        reg = rf2xx_get_status(_phy->radio);
+
+        // Check for block
+        if (!soft_timer_a_is_before_b(soft_timer_time(), t_end))
+        {
+            log_error("RF delay expired #0");
+            ret = PHY_ERR_INTERNAL;
+            channels = 0;
+            break;
+        }
+    } while ((reg & RF2XX_TRX_STATUS__RX_ON) == 0);
+
+    uint8_t channel;
+    for (channel = PHY_2400_MIN_CHANNEL; channel <= PHY_2400_MAX_CHANNEL;
+            channel++)
+    {
+        if ((channels & (1 << channel)) == 0)
+        {
+            continue;
+        }
+
+        // Clear the flags, then change channel and wait for the PLL to lock
+        (void) rf2xx_reg_read(_phy->radio, RF2XX_REG__IRQ_STATUS);
+        rf2xx_reg_write(_phy->radio, RF2XX_REG__PHY_CC_CCA,
+                RF2XX_PHY_CC_CCA_DEFAULT__CCA_MODE | channel);
+
+        if (wait_irq_status(_phy, RF2XX_IRQ_STATUS_MASK__PLL_LOCK)
+                != PHY_SUCCESS)
+        {
+            log_error("RF PLL lock expired on channel %u", channel);
+            ret = PHY_ERR_INTERNAL;
+            break;
+        }
+
+        // Request a ED measurement and wait until it is performed
+        rf2xx_reg_write(_phy->radio, RF2XX_REG__PHY_ED_LEVEL, 0xAA);
+
+        if (wait_irq_status(_phy, RF2XX_IRQ_STATUS_MASK__CCA_ED_DONE)
+                != PHY_SUCCESS)
+        {
+            log_error("RF ED expired on channel %u", channel);
+            ret = PHY_ERR_INTERNAL;
+            break;
+        }
+
+        *ed++ = -91 + rf2xx_reg_read(_phy->radio, RF2XX_REG__PHY_ED_LEVEL);
+    }
+
+    // Stop RX and restore the channel
+    rf2xx_set_state(_phy->radio, RF2XX_TRX_STATE__FORCE_TRX_OFF);
+    rf2xx_reg_write(_phy->radio, RF2XX_REG__PHY_CC_CCA, cc_cca);
+
+    // Go back to sleep if needed
+    if (_phy->state == PHY_STATE_SLEEP)
+    {
+        // Sleep
+        rf2xx_sleep(_phy->radio);
+    }
+
+    give();
+
+    return ret;
+}
+
 phy_status_t phy_cca(phy_t phy, int32_t *cca)
 {
     return phy_ed_cca_measure(phy, cca, 0);
@@ -572,7 +701,8 @@ phy_status_t phy_tx(phy_t phy, uint32_t tx_time, phy_packet_t *pkt,
     rf2xx_set_state(_phy->radio, RF2XX_TRX_STATE__PLL_ON);
 
     uint32_t launch_now = 0;
-    int16_t spare_time = 0;
+    // Ticks left before the TX, up to a full period of the 16bit timer
+    int32_t spare_time = 0;
 
     // Backup state and store new State
     uint32_t last_state = _phy->state;
@@ -90,6 +90,16 @@ extern "C" {
  */
 typedef void * xTaskHandle;
 
+/*
+ * Possible return values for eTaskConfirmSleepModeStatus().
+ */
+typedef enum
+{
+	eAbortSleep = 0,		/* A task has been made ready or a context switch pended since portSUPPRESS_TICKS_AND_SLEEP() was called - abort entering a sleep mode. */
+	eStandardSleep,			/* Enter a sleep mode that will not last any longer than the expected idle time. */
+	eNoTasksWaitingTimeout	/* No tasks are waiting for a timeout so it is safe to enter a sleep mode that can only be exited by an external interrupt. */
+} eSleepModeStatus;
+
 /*
  * Used internally only.
  */
@@ -1292,6 +1302,25 @@ void vTaskPriorityInherit( xTaskHandle * const pxMutexHolder ) PRIVILEGED_FUNCTI
  */
 void vTaskPriorityDisinherit( xTaskHandle * const pxMutexHolder ) PRIVILEGED_FUNCTION;
 
+/*
+ * Only available when configUSE_TICKLESS_IDLE is set to 1.
+ * Called from the portSUPPRESS_TICKS_AND_SLEEP() implementation, with the
+ * scheduler suspended, to correct the tick count value after the tick
+ * interrupt was stopped for a number of tick periods.  The tick count must
+ * not reach the time at which the next task unblocks, that tick is left to
+ * the tick interrupt.
+ */
+void vTaskStepTick( portTickType xTicksToJump ) PRIVILEGED_FUNCTION;
+
+/*
+ * Only available when configUSE_TICKLESS_IDLE is set to 1.
+ * Called from the portSUPPRESS_TICKS_AND_SLEEP() implementation, with the
+ * interrupts masked, to check that entering the sleep mode is still
+ * appropriate: a task may have been readied by an interrupt since the
+ * expected idle time was computed.
+ */
+eSleepModeStatus eTaskConfirmSleepModeStatus( void ) PRIVILEGED_FUNCTION;
+
 /*
  * Generic version of the task creation function which is in turn called by the
  * xTaskCreate() and xTaskCreateRestricted() macros.
@@ -8,112 +8,197 @@
  */
 
 /*-----------------------------------------------------------
- * Implementation of functions defined in portable.h for the ARM CM3 port.
+ * Implementation of functions defined in portable.h for the native port.
+ *
+ * Each task runs in its own POSIX thread, but only one thread owns the
+ * simulated CPU at a time: the thread of the current TCB, or a thread
+ * running an interrupt handler with vPortNativeInterrupt(). Interrupts are
+ * taken when the running task enables them, i.e. when leaving the outermost
+ * critical section, on yield, and while the idle task waits for interrupts.
+ * A task looping without any kernel call therefore delays the interrupts,
+ * which is enough for the event driven applications of the platform.
  *----------------------------------------------------------*/
 
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
 /* Scheduler includes. */
 #include "FreeRTOS.h"
 #include "task.h"
-#include "platform.h"
-
-/* For backward compatibility, ensure configKERNEL_INTERRUPT_PRIORITY is
-defined.  The value should also ensure backward compatibility.
-FreeRTOS.org versions prior to V4.4.0 did not include this definition. */
-#ifndef configKERNEL_INTERRUPT_PRIORITY
-	#define configKERNEL_INTERRUPT_PRIORITY 255
-#endif
-
-/* Constants required to manipulate the NVIC. */
-#define portNVIC_SYSTICK_CTRL		( ( volatile unsigned long *) 0xe000e010 )
-#define portNVIC_SYSTICK_LOAD		( ( volatile unsigned long *) 0xe000e014 )
-#define portNVIC_INT_CTRL			( ( volatile unsigned long *) 0xe000ed04 )
-#define portNVIC_SYSPRI2			( ( volatile unsigned long *) 0xe000ed20 )
-#define portNVIC_SYSTICK_CLK		0x00000004
-#define portNVIC_SYSTICK_INT		0x00000002
-#define portNVIC_SYSTICK_ENABLE		0x00000001
-#define portNVIC_PENDSVSET			0x10000000
-#define portNVIC_PENDSV_PRI			( ( ( unsigned long ) configKERNEL_INTERRUPT_PRIORITY ) << 16 )
-#define portNVIC_SYSTICK_PRI		( ( ( unsigned long ) configKERNEL_INTERRUPT_PRIORITY ) << 24 )
-
-/* Constants required to set up the initial stack. */
-#define portINITIAL_XPSR			( 0x01000000 )
-
-/* The priority used by the kernel is assigned to a variable to make access
-from inline assembler easier. */
-const unsigned long ulKernelPriority = configKERNEL_INTERRUPT_PRIORITY;
+
+/* Thread running a task */
+typedef struct
+{
+	pthread_t thread;
+	pdTASK_CODE pxCode;
+	void *pvParameters;
+} xNativeThread;
+
+/* The TCB of the running task, its first field is the top of stack, where the
+xNativeThread pointer is stored. */
+extern void * volatile pxCurrentTCB;
+#define prvScheduledThread() \
+	( *( xNativeThread ** ) ( *( volatile portSTACK_TYPE ** ) pxCurrentTCB ) )
+
+/* Ownership of the simulated CPU, protected by xCpuMutex. */
+static pthread_mutex_t xCpuMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xCpuCond = PTHREAD_COND_INITIALIZER;
+/* Owner markers for the code before the scheduler starts, and the ISRs. */
+static char cBootOwner, cInterruptOwner;
+static void *pvCpuOwner = &cBootOwner;
+/* Number of interrupt threads waiting for the CPU, and of ISRs served. */
+static unsigned long ulInterruptRequests = 0;
+static unsigned long ulInterruptsServed = 0;
+
+/* A context switch was requested while it could not be done. */
+static volatile portBASE_TYPE xYieldPending = pdFALSE;
 
 /* Each task maintains its own interrupt status in the critical nesting
-variable. */
+variable. As tasks are only switched out when leaving the critical sections,
+a single variable is enough. */
 static unsigned portBASE_TYPE uxCriticalNesting = 0xaaaaaaaa;
 
-/*
- * Setup the timer to generate the tick interrupts.
- */
-static void prvSetupTimerInterrupt( void );
+/* The task of the calling thread, NULL for interrupt and main threads. */
+static __thread xNativeThread *pxThisThread = NULL;
 
 /*
- * Exception handlers.
+ * The thread generating the tick interrupts.
  */
-void pendsv_handler( void ) __attribute__ (( naked ));
-void xPortTickHandler( void* );
-void svc_handler( void ) __attribute__ (( naked ));
+static void *prvTickThread( void *pvArg );
+static void prvTickInterrupt( void *pvArg );
 
-/*
- * Start first task is a separate function so it can be tested in isolation.
- */
-void vPortStartFirstTask( void ) __attribute__ (( naked ));
+/*-----------------------------------------------------------*/
 
+/* Release the CPU, xCpuMutex must be held */
+static void prvReleaseCpu( void )
+{
+	pvCpuOwner = NULL;
+	pthread_cond_broadcast( &xCpuCond );
+}
 /*-----------------------------------------------------------*/
 
-/*
- * See header file for description.
- */
-portSTACK_TYPE *pxPortInitialiseStack( portSTACK_TYPE *pxTopOfStack, pdTASK_CODE pxCode, void *pvParameters )
+/* Wait until the task is scheduled and the CPU is free of interrupts,
+xCpuMutex must be held */
+static void prvAcquireCpu( xNativeThread *pxThread )
 {
-	/* Simulate the stack frame as it would be created by a context switch
-	interrupt. */
-	pxTopOfStack--; /* Offset added to account for the way the MCU uses the stack on entry/exit of interrupts. */
-	*pxTopOfStack = portINITIAL_XPSR;	/* xPSR */
-	pxTopOfStack--;
-	*pxTopOfStack = ( portSTACK_TYPE ) pxCode;	/* PC */
-	pxTopOfStack--;
-	*pxTopOfStack = 0;	/* LR */
-	pxTopOfStack -= 5;	/* R12, R3, R2 and R1. */
-	*pxTopOfStack = ( portSTACK_TYPE ) pvParameters;	/* R0 */
-	pxTopOfStack -= 8;	/* R11, R10, R9, R8, R7, R6, R5 and R4. */
+	while( ( pvCpuOwner != NULL ) || ( ulInterruptRequests != 0 )
+			|| ( prvScheduledThread() != pxThread ) )
+	{
+		pthread_cond_wait( &xCpuCond, &xCpuMutex );
+	}
 
-	return pxTopOfStack;
+	pvCpuOwner = pxThread;
 }
 /*-----------------------------------------------------------*/
 
-void svc_handler( void )
+/* Select the next task and hand the CPU over if it changed */
+static void prvSwitchContext( void )
 {
+	while( xYieldPending != pdFALSE )
+	{
+		xYieldPending = pdFALSE;
+		vTaskSwitchContext();
+
+		if( prvScheduledThread() != pxThisThread )
+		{
+			pthread_mutex_lock( &xCpuMutex );
+			prvReleaseCpu();
+			prvAcquireCpu( pxThisThread );
+			pthread_mutex_unlock( &xCpuMutex );
+		}
+	}
 }
 /*-----------------------------------------------------------*/
 
-void vPortStartFirstTask( void )
+/* Let the waiting interrupts run, then switch context if requested */
+static void prvServiceInterrupts( void )
 {
+	if( ( pxThisThread == NULL ) || ( uxCriticalNesting != 0 ) )
+	{
+		return;
+	}
+
+	pthread_mutex_lock( &xCpuMutex );
+	if( ulInterruptRequests != 0 )
+	{
+		prvReleaseCpu();
+		prvAcquireCpu( pxThisThread );
+	}
+	pthread_mutex_unlock( &xCpuMutex );
+
+	prvSwitchContext();
+}
+/*-----------------------------------------------------------*/
+
+static void *prvTaskThread( void *pvArg )
+{
+	xNativeThread *pxThread = pvArg;
+
+	pxThisThread = pxThread;
+
+	/* Wait until the task is scheduled for the first time. */
+	pthread_mutex_lock( &xCpuMutex );
+	prvAcquireCpu( pxThread );
+	pthread_mutex_unlock( &xCpuMutex );
+
+	pxThread->pxCode( pxThread->pvParameters );
+
+	/* Tasks must not return. */
+	return NULL;
 }
 /*-----------------------------------------------------------*/
 
 /*
  * See header file for description.
  */
-portBASE_TYPE xPortStartScheduler( void )
+portSTACK_TYPE *pxPortInitialiseStack( portSTACK_TYPE *pxTopOfStack, pdTASK_CODE pxCode, void *pvParameters )
 {
-	/* Make PendSV, CallSV and SysTick the same priroity as the kernel. */
-	*(portNVIC_SYSPRI2) |= portNVIC_PENDSV_PRI;
-	*(portNVIC_SYSPRI2) |= portNVIC_SYSTICK_PRI;
+	xNativeThread *pxThread = malloc( sizeof( xNativeThread ) );
+	pthread_attr_t xAttr;
+
+	configASSERT( pxThread );
+	pxThread->pxCode = pxCode;
+	pxThread->pvParameters = pvParameters;
+
+	/* The thread blocks until the task is scheduled, the task stack is only
+	used to find the thread back from the TCB. A deleted task leaves its
+	thread blocked forever. */
+	pthread_attr_init( &xAttr );
+	pthread_attr_setdetachstate( &xAttr, PTHREAD_CREATE_DETACHED );
+	pthread_create( &pxThread->thread, &xAttr, prvTaskThread, pxThread );
+	pthread_attr_destroy( &xAttr );
 
-	/* Start the timer that generates the tick ISR.  Interrupts are disabled
-	here already. */
-	prvSetupTimerInterrupt();
+	pxTopOfStack--;
+	*pxTopOfStack = ( portSTACK_TYPE ) pxThread;
+
+	return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+portBASE_TYPE xPortStartScheduler( void )
+{
+	pthread_t xTick;
 
 	/* Initialise the critical nesting count ready for the first task. */
 	uxCriticalNesting = 0;
 
-	/* Start the first task. */
-	vPortStartFirstTask();
+	/* Start the thread that generates the tick ISR. */
+	pthread_create( &xTick, NULL, prvTickThread, NULL );
+
+	/* Start the first task, and let the main thread wait. */
+	pthread_mutex_lock( &xCpuMutex );
+	prvReleaseCpu();
+	pthread_mutex_unlock( &xCpuMutex );
+
+	for( ;; )
+	{
+		pause();
+	}
 
 	/* Should not get here! */
 	return 0;
@@ -122,15 +207,21 @@ portBASE_TYPE xPortStartScheduler( void )
 
 void vPortEndScheduler( void )
 {
-	/* It is unlikely that the CM3 port will require this function as there
-	is nothing to return to.  */
+	exit( 0 );
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+	xYieldPending = pdTRUE;
+	prvServiceInterrupts();
 }
 /*-----------------------------------------------------------*/
 
 void vPortYieldFromISR( void )
 {
-	/* Set a PendSV to request a context switch. */
-	*(portNVIC_INT_CTRL) = portNVIC_PENDSVSET;
+	/* The switch happens when the interrupted task gets the CPU back. */
+	xYieldPending = pdTRUE;
 }
 /*-----------------------------------------------------------*/
 
@@ -147,45 +238,94 @@ void vPortExitCritical( void )
 	if( uxCriticalNesting == 0 )
 	{
 		portENABLE_INTERRUPTS();
+		prvServiceInterrupts();
 	}
 }
 /*-----------------------------------------------------------*/
 
-void pendsv_handler( void )
+void vPortNativeInterrupt( void ( *pvHandler )( void * ), void *pvArg )
 {
-	/* This is a naked function. */
+	pthread_mutex_lock( &xCpuMutex );
+	ulInterruptRequests++;
+	while( pvCpuOwner != NULL )
+	{
+		pthread_cond_wait( &xCpuCond, &xCpuMutex );
+	}
+	ulInterruptRequests--;
+	pvCpuOwner = &cInterruptOwner;
+	pthread_mutex_unlock( &xCpuMutex );
+
+	pvHandler( pvArg );
+
+	pthread_mutex_lock( &xCpuMutex );
+	ulInterruptsServed++;
+	prvReleaseCpu();
+	pthread_mutex_unlock( &xCpuMutex );
 }
 /*-----------------------------------------------------------*/
 
-void xPortTickHandler( void* arg )
+void vPortNativeWaitForInterrupt( void )
 {
-unsigned long ulDummy;
-
-	(void) arg;
+	unsigned long ulServed;
 
-	/* If using preemption, also force a context switch. */
-	#if configUSE_PREEMPTION == 1
-		*(portNVIC_INT_CTRL) = portNVIC_PENDSVSET;
-	#endif
+	if( pxThisThread == NULL )
+	{
+		return;
+	}
 
-	ulDummy = portSET_INTERRUPT_MASK_FROM_ISR();
+	pthread_mutex_lock( &xCpuMutex );
+	if( ( ulInterruptRequests == 0 ) && ( xYieldPending == pdFALSE ) )
 	{
-		vTaskIncrementTick();
+		ulServed = ulInterruptsServed;
+		prvReleaseCpu();
+
+		while( ulInterruptsServed == ulServed )
+		{
+			pthread_cond_wait( &xCpuCond, &xCpuMutex );
+		}
+
+		prvAcquireCpu( pxThisThread );
 	}
-	portCLEAR_INTERRUPT_MASK_FROM_ISR( ulDummy );
+	pthread_mutex_unlock( &xCpuMutex );
+
+	prvServiceInterrupts();
 }
 /*-----------------------------------------------------------*/
 
-#include "nvic.h"
-
-/*
- * Setup the systick timer to generate the tick interrupts at the required
- * frequency.
- */
-void prvSetupTimerInterrupt( void )
+static void prvTickInterrupt( void *pvArg )
 {
-	// Call the platform specific method to generate the FreeRTOS tick
-	// platform_start_freertos_tick(configTICK_RATE_HZ, xPortTickHandler, 0);
+	( void ) pvArg;
+
+	vTaskIncrementTick();
+
+	/* If using preemption, also force a context switch. */
+	#if configUSE_PREEMPTION == 1
+		xYieldPending = pdTRUE;
+	#endif
 }
 /*-----------------------------------------------------------*/
 
+static void *prvTickThread( void *pvArg )
+{
+	struct timespec xNext;
+
+	( void ) pvArg;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNext );
+
+	for( ;; )
+	{
+		xNext.tv_nsec += 1000000000L / configTICK_RATE_HZ;
+		if( xNext.tv_nsec >= 1000000000L )
+		{
+			xNext.tv_nsec -= 1000000000L;
+			xNext.tv_sec++;
+		}
+
+		clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &xNext, NULL );
+		vPortNativeInterrupt( prvTickInterrupt, NULL );
+	}
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
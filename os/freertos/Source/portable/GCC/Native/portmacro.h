@@ -51,9 +51,10 @@ extern "C" {
 
 
 /* Scheduler utilities. */
+extern void vPortYield( void );
 extern void vPortYieldFromISR( void );
 
-#define portYIELD()					vPortYieldFromISR()
+#define portYIELD()					vPortYield()
 
 #define portEND_SWITCHING_ISR( xSwitchRequired ) if( xSwitchRequired ) vPortYieldFromISR()
 /*-----------------------------------------------------------*/
@@ -91,6 +92,20 @@ extern void vPortExitCritical( void );
 #define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
 
 #define portNOP()
+/*-----------------------------------------------------------*/
+
+/* Native interrupts. */
+
+/*
+ * Run an interrupt handler from a host thread (timer, I/O...), once the
+ * running task has enabled the interrupts. Blocks until the handler is done.
+ */
+extern void vPortNativeInterrupt( void ( *pvHandler )( void * ), void *pvArg );
+
+/*
+ * Release the CPU until an interrupt has been served, the native WFI.
+ */
+extern void vPortNativeWaitForInterrupt( void );
 
 #ifdef __cplusplus
 }
@@ -132,6 +132,48 @@ void ina226_alert_disable();
  */
 void ina226_read(float *voltage, float *current, float *power, float* shunt_voltage);
 
+/** Registers that may be read by \ref ina226_read_raw_async */
+typedef enum
+{
+    INA226_RAW_SHUNT_VOLTAGE = 0x01,
+    INA226_RAW_BUS_VOLTAGE = 0x02,
+    INA226_RAW_POWER = 0x04,
+    INA226_RAW_CURRENT = 0x08,
+} ina226_raw_register_t;
+
+/** Value of the LSB of the raw bus voltage register, in V */
+#define INA226_BUS_VOLTAGE_LSB      1.25e-3f
+/** Value of the LSB of the raw shunt voltage register, in V */
+#define INA226_SHUNT_VOLTAGE_LSB    2.5e-6f
+/** Ratio between the LSB of the raw power register and the current LSB */
+#define INA226_POWER_LSB_RATIO      25
+
+/**
+ * Get the value of the LSB of the raw current register, in A.
+ * This depends on the last calibration.
+ */
+float ina226_get_current_lsb();
+
+/**
+ * Read raw sampled values without blocking.
+ *
+ * The reads of the selected registers are queued at once on the I2C bus,
+ * followed by the read clearing the conversion ready flag. No conversion
+ * is done, the raw values are to be multiplied by their LSB value. This may
+ * be called from interrupt context.
+ *
+ * \param registers the registers to read, a combination of
+ *      \ref ina226_raw_register_t
+ * \param values a buffer to store the register values, in the order of the
+ *      \ref ina226_raw_register_t bits
+ * \param handler the handler called from interrupt context on completion,
+ *      with a non zero result on I2C error
+ * \param arg an argument to the handler
+ * \return 0 if the read started, 1 if a read is already in progress
+ */
+unsigned ina226_read_raw_async(uint8_t registers, uint16_t *values,
+        result_handler_t handler, handler_arg_t arg);
+
 /**
  * Check if a new set of sample is available.
  *
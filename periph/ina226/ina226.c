@@ -31,6 +31,11 @@
 
 static uint16_t read_reg(uint8_t addr);
 static void write_reg(uint8_t addr, uint16_t value);
+static void raw_read_done(handler_arg_t arg, unsigned error);
+static void raw_read_end(handler_arg_t arg, unsigned error);
+
+/** Number of reads of a raw sample: the 4 registers then the mask/enable */
+#define RAW_READS 5
 
 static struct
 {
@@ -39,6 +44,22 @@ static struct
     exti_line_t alert_line;
 
     float current_lsb;
+
+    /** Asynchronous raw read, one I2C transaction per register */
+    struct
+    {
+        volatile uint8_t busy;
+        uint8_t count;
+        volatile uint8_t error;
+        uint16_t *values;
+
+        uint8_t regs[RAW_READS];
+        uint8_t bufs[RAW_READS][2];
+        i2c_transaction_t transactions[RAW_READS];
+
+        result_handler_t handler;
+        handler_arg_t arg;
+    } raw;
 } ina;
 
 void ina226_init(i2c_t i2c, uint8_t address, exti_line_t alert_line)
@@ -164,6 +185,88 @@ void ina226_read(float *voltage, float *current, float *power, float* shunt_volt
     }
 }
 
+float ina226_get_current_lsb()
+{
+    return ina.current_lsb;
+}
+
+unsigned ina226_read_raw_async(uint8_t registers, uint16_t *values,
+        result_handler_t handler, handler_arg_t arg)
+{
+    uint8_t reg, i;
+
+    if (ina.raw.busy)
+    {
+        return 1;
+    }
+
+    ina.raw.busy = 1;
+    ina.raw.error = 0;
+    ina.raw.values = values;
+    ina.raw.handler = handler;
+    ina.raw.arg = arg;
+
+    // The selected registers, bit n selects register n + 1, then the
+    // mask/enable register to clear the conversion ready flag
+    ina.raw.count = 0;
+    for (reg = INA226_REG_SHUNT_VOLTAGE; reg <= INA226_REG_CURRENT; reg++)
+    {
+        if (registers & (1 << (reg - 1)))
+        {
+            ina.raw.regs[ina.raw.count++] = reg;
+        }
+    }
+    ina.raw.regs[ina.raw.count++] = INA226_REG_MASK_ENABLE;
+
+    // Queued at once, the I2C driver chains them
+    for (i = 0; i < ina.raw.count; i++)
+    {
+        i2c_transaction_t *transaction = &ina.raw.transactions[i];
+
+        transaction->addr = ina.i2c_address;
+        transaction->priority = I2C_PRIORITY_NORMAL;
+        transaction->tx_buffer = &ina.raw.regs[i];
+        transaction->tx_length = 1;
+        transaction->rx_buffer = ina.raw.bufs[i];
+        transaction->rx_length = 2;
+        transaction->handler = (i == ina.raw.count - 1) ? raw_read_end
+                : raw_read_done;
+        transaction->arg = NULL;
+        transaction->pending = 0;
+
+        i2c_submit(ina.i2c, transaction);
+    }
+
+    return 0;
+}
+
+static void raw_read_done(handler_arg_t arg, unsigned error)
+{
+    if (error)
+    {
+        ina.raw.error = 1;
+    }
+}
+
+static void raw_read_end(handler_arg_t arg, unsigned error)
+{
+    uint8_t i;
+
+    // All the values but the mask/enable one
+    for (i = 0; i < ina.raw.count - 1; i++)
+    {
+        ina.raw.values[i] = (ina.raw.bufs[i][0] << 8) + ina.raw.bufs[i][1];
+    }
+
+    error |= ina.raw.error;
+    ina.raw.busy = 0;
+
+    if (ina.raw.handler)
+    {
+        ina.raw.handler(ina.raw.arg, error);
+    }
+}
+
 static uint16_t read_reg(uint8_t addr)
 {
     uint8_t buf[2];
@@ -36,6 +36,9 @@
 #define N25XXX_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "handler.h"
 
 /** Read the flash chip ID
  * Reads the flash chip ID which contains the manufacturer ID, the device ID and an unique ID
@@ -90,6 +93,28 @@ void n25xxx_write_page(uint32_t address, uint8_t *buf);
  */
 void n25xxx_erase_subsector(uint32_t address);
 
+/** Start writing a complete flash page
+ * Same as \ref n25xxx_write_page but returns as soon as the data is transferred, without
+ * waiting for the end of the program cycle. \ref n25xxx_is_busy must return false before
+ * any other write or erase operation is started.
+ * \param address The address of the page where to write the content of the buffer
+ * \param buf[in] The buffer to write to the flash page. This buffer MUST be 256-byte long
+ */
+void n25xxx_start_write_page(uint32_t address, uint8_t *buf);
+
+/** Start erasing a sub-sector of the flash
+ * Same as \ref n25xxx_erase_subsector but returns as soon as the instruction is sent, without
+ * waiting for the end of the erase cycle. \ref n25xxx_is_busy must return false before
+ * any other write or erase operation is started.
+ * \param address The address of the sub-sector to erase
+ */
+void n25xxx_start_erase_subsector(uint32_t address);
+
+/** Check if a program or erase cycle is in progress
+ * \return true while the flash is busy writing or erasing
+ */
+bool n25xxx_is_busy();
+
 /** Erase a sector of the flash
  * This functions erases a given sector of the flash, a sector is composed of 16 sub-sectors (i.e 256 page or 65536 bytes)
  * \note The write must be enabled before calling this function (\see \ref n25xxx_write_enable). If writting is
@@ -106,6 +131,68 @@ void n25xxx_erase_sector(uint32_t address);
  */
 void n25xxx_bulk_erase();
 
+/*
+ * The asynchronous requests below run as SPI transactions (\ref spi_submit) at
+ * low priority, and may share the bus with other devices using transactions. The
+ * synchronous functions above access the bus directly, they must not be used while
+ * asynchronous requests are pending.
+ */
+
+/** Number of asynchronous requests that may be queued */
+#ifndef N25XXX_ASYNC_QUEUE_LENGTH
+#define N25XXX_ASYNC_QUEUE_LENGTH 4
+#endif
+
+/** Queue an asynchronous read
+ * The instruction and address are sent when the request reaches the head of the queue,
+ * the data is then received in the same SPI transaction.
+ * \note The handler is called from the event task (\ref EVENT_QUEUE_APPLI) with a null
+ * result, buf must remain valid until then.
+ * \param address The address where to start reading
+ * \param buf The buffer where the read content will be stored
+ * \param len The number of bytes to read
+ * \param handler The function called when the data is in buf, may be NULL
+ * \param arg The argument given to the handler
+ * \return true if the request is queued, false if the queue is full
+ */
+bool n25xxx_read_async(uint32_t address, uint8_t *buf, uint16_t len,
+                       result_handler_t handler, handler_arg_t arg);
+
+/** Queue an asynchronous page write
+ * The write is enabled, then the page is sent by DMA and the end of the program cycle
+ * is polled with a soft timer. The next queued request starts as soon as the cycle is
+ * over, before the handler is called, so queuing the next page while the previous one
+ * is programmed keeps the flash busy all the time.
+ * \note The handler is called from the event task (\ref EVENT_QUEUE_APPLI) with a null
+ * result once the page is programmed, buf must remain valid until then.
+ * \param address The address of the page, the last 8 bits must be 0
+ * \param buf The 256-byte buffer to write to the flash page
+ * \param handler The function called when the page is programmed, may be NULL
+ * \param arg The argument given to the handler
+ * \return true if the request is queued, false if the queue is full
+ */
+bool n25xxx_write_page_async(uint32_t address, uint8_t *buf,
+                             result_handler_t handler, handler_arg_t arg);
+
+/** Queue an asynchronous sub-sector erase
+ * The write is enabled, then the erase is started and its end polled with a soft timer.
+ * \note The handler is called from the event task (\ref EVENT_QUEUE_APPLI) with a null
+ * result once the sub-sector is erased.
+ * \param address The address of the sub-sector, the last 12 bits must be 0
+ * \param handler The function called when the sub-sector is erased, may be NULL
+ * \param arg The argument given to the handler
+ * \return true if the request is queued, false if the queue is full
+ */
+bool n25xxx_erase_subsector_async(uint32_t address,
+                                  result_handler_t handler, handler_arg_t arg);
+
+/** Get the number of asynchronous requests not completed yet
+ * \warning The blocking functions MUST NOT be called while asynchronous requests
+ * are pending.
+ * \return the number of queued requests, including the one in progress
+ */
+uint8_t n25xxx_async_pending();
+
 /** @} */
 
 /** @} */
@@ -23,8 +23,13 @@
  * \author Christophe Braillon <christophe.braillon.at.hikob.com>
  */
 
+#include <stdbool.h>
+
+#include "platform.h"
 #include "gpio.h"
 #include "spi.h"
+#include "event.h"
+#include "soft_timer.h"
 #include "n25xxx.h"
 #include "n25xxx_.h"
 #include "n25xxx_regs.h"
@@ -47,8 +52,60 @@ static struct
     // HOLDn pin
     gpio_t holdn_gpio;
     gpio_pin_t holdn_pin;
+
+    // The device, for the SPI transactions of the asynchronous requests
+    spi_device_t device;
 } flash;
 
+/** Asynchronous operations */
+typedef enum
+{
+    ASYNC_READ,
+    ASYNC_PROGRAM,
+    ASYNC_ERASE,
+} async_op_t;
+
+/** An asynchronous request */
+typedef struct
+{
+    async_op_t op;
+    uint32_t address;
+    uint8_t *buf;
+    uint16_t len;
+
+    result_handler_t handler;
+    handler_arg_t arg;
+} async_request_t;
+
+/** Status polling periods while a program or erase cycle is in progress */
+#define PROGRAM_POLL_US 100
+#define ERASE_POLL_MS   5
+
+static struct
+{
+    // Circular queue of requests, the first one is in progress
+    async_request_t queue[N25XXX_ASYNC_QUEUE_LENGTH];
+    uint8_t first, count;
+
+    // Instruction and address bytes of the request in progress
+    uint8_t ins[4];
+
+    // SPI transactions: write enable, request transfer, status read
+    spi_transaction_t wren, xfer, rdsr;
+    uint8_t status;
+
+    // Timer polling the WIP bit
+    soft_timer_t poll_timer;
+} async;
+
+static const uint8_t wren_ins = N25XXX_INS__WREN;
+static const uint8_t rdsr_ins = N25XXX_INS__RDSR;
+
+static void async_start();
+static void async_poll(handler_arg_t arg);
+static void async_transfer_done(handler_arg_t arg);
+static void async_status_done(handler_arg_t arg);
+
 /* Handy functions */
 inline static void csn_set()
 {
@@ -94,6 +151,13 @@ void n25xxx_config(spi_t spi,
     flash.holdn_gpio = holdn_gpio;
     flash.holdn_pin = holdn_pin;
 
+    // The flash yields the bus to the latency critical devices
+    flash.device.spi = spi;
+    flash.device.cs_gpio = csn_gpio;
+    flash.device.cs_pin = csn_pin;
+    flash.device.baudrate = 0;
+    flash.device.priority = SPI_PRIORITY_LOW;
+
     wn_set();
     holdn_set();
 }
@@ -114,6 +178,27 @@ void n25xxx_init()
     csn_set();
     wn_set();
     holdn_set();
+
+    // Prepare the asynchronous requests
+    async.first = 0;
+    async.count = 0;
+    soft_timer_set_handler(&async.poll_timer, async_poll, NULL);
+
+    async.wren.device = &flash.device;
+    async.wren.cmd = &wren_ins;
+    async.wren.cmd_length = 1;
+
+    async.xfer.device = &flash.device;
+    async.xfer.cmd = async.ins;
+    async.xfer.cmd_length = 4;
+    async.xfer.handler = async_transfer_done;
+
+    async.rdsr.device = &flash.device;
+    async.rdsr.cmd = &rdsr_ins;
+    async.rdsr.cmd_length = 1;
+    async.rdsr.rx_buffer = &async.status;
+    async.rdsr.length = 1;
+    async.rdsr.handler = async_status_done;
 }
 
 void n25xxx_read_id(uint8_t *id, uint16_t len)
@@ -206,7 +291,22 @@ void n25xxx_write_disable()
     }
 }
 
-void n25xxx_write_page(uint32_t address, uint8_t *buf)
+bool n25xxx_is_busy()
+{
+    // The WIP bit is set while a program or erase cycle is in progress
+    return n25xxx_read_status() & 0x1;
+}
+
+static void n25xxx_wait_ready()
+{
+    // Wait for the WIP bit to be cleared
+    while (n25xxx_is_busy())
+    {
+        ;
+    }
+}
+
+void n25xxx_start_write_page(uint32_t address, uint8_t *buf)
 {
     uint8_t ad[3] = {address >> 16, address >> 8, 0};
 
@@ -224,15 +324,15 @@ void n25xxx_write_page(uint32_t address, uint8_t *buf)
 
     // End the SPI transfer
     csn_set();
+}
 
-    // Wait for the WIP bit to be cleared
-    while (n25xxx_read_status() & 0x1)
-    {
-        ;
-    }
+void n25xxx_write_page(uint32_t address, uint8_t *buf)
+{
+    n25xxx_start_write_page(address, buf);
+    n25xxx_wait_ready();
 }
 
-void n25xxx_erase_subsector(uint32_t address)
+void n25xxx_start_erase_subsector(uint32_t address)
 {
     uint8_t ad[3] = {address >> 16, address >> 8, 0};
 
@@ -247,12 +347,12 @@ void n25xxx_erase_subsector(uint32_t address)
 
     // End the SPI transfer
     csn_set();
+}
 
-    // Wait for the WIP bit to be cleared
-    while (n25xxx_read_status() & 0x1)
-    {
-        ;
-    }
+void n25xxx_erase_subsector(uint32_t address)
+{
+    n25xxx_start_erase_subsector(address);
+    n25xxx_wait_ready();
 }
 
 void n25xxx_erase_sector(uint32_t address)
@@ -295,3 +395,163 @@ void n25xxx_bulk_erase()
         ;
     }
 }
+
+static bool async_push(async_op_t op, uint32_t address, uint8_t *buf,
+                       uint16_t len, result_handler_t handler, handler_arg_t arg)
+{
+    async_request_t *req;
+    bool idle;
+
+    platform_enter_critical();
+
+    if (async.count == N25XXX_ASYNC_QUEUE_LENGTH)
+    {
+        platform_exit_critical();
+        return false;
+    }
+
+    req = &async.queue[(async.first + async.count) % N25XXX_ASYNC_QUEUE_LENGTH];
+    req->op = op;
+    req->address = address;
+    req->buf = buf;
+    req->len = len;
+    req->handler = handler;
+    req->arg = arg;
+
+    idle = (async.count++ == 0);
+
+    platform_exit_critical();
+
+    // Start it now if the queue was idle
+    if (idle)
+    {
+        async_start();
+    }
+
+    return true;
+}
+
+static void async_done(unsigned result)
+{
+    async_request_t req = async.queue[async.first];
+    bool more;
+
+    platform_enter_critical();
+    async.first = (async.first + 1) % N25XXX_ASYNC_QUEUE_LENGTH;
+    more = (--async.count != 0);
+    platform_exit_critical();
+
+    // Start the next request first, so that the bus does not wait for the handler
+    if (more)
+    {
+        async_start();
+    }
+
+    if (req.handler)
+    {
+        req.handler(req.arg, result);
+    }
+}
+
+static void async_poll(handler_arg_t arg)
+{
+    async_request_t *req = &async.queue[async.first];
+
+    // Reads are over with the transfer
+    if (req->op == ASYNC_READ)
+    {
+        async_done(0);
+        return;
+    }
+
+    // Writes when the WIP bit is cleared, read the status
+    spi_submit(&async.rdsr);
+}
+
+static void async_status(handler_arg_t arg)
+{
+    async_request_t *req = &async.queue[async.first];
+
+    if (!(async.status & 0x1))
+    {
+        async_done(0);
+        return;
+    }
+
+    // Check again later, without blocking the event task
+    soft_timer_start(&async.poll_timer, req->op == ASYNC_ERASE ?
+                     soft_timer_ms_to_ticks(ERASE_POLL_MS) :
+                     soft_timer_us_to_ticks(PROGRAM_POLL_US), 0);
+}
+
+static void async_transfer_done(handler_arg_t arg)
+{
+    // Called from the SPI interrupt, complete the request in the event task
+    event_post_from_isr(EVENT_QUEUE_APPLI, async_poll, NULL);
+}
+
+static void async_status_done(handler_arg_t arg)
+{
+    event_post_from_isr(EVENT_QUEUE_APPLI, async_status, NULL);
+}
+
+static void async_start()
+{
+    async_request_t *req = &async.queue[async.first];
+
+    async.ins[1] = req->address >> 16;
+    async.ins[2] = req->address >> 8;
+    async.ins[3] = req->address;
+
+    switch (req->op)
+    {
+        case ASYNC_READ:
+            async.ins[0] = N25XXX_INS__READ;
+            break;
+
+        case ASYNC_PROGRAM:
+            async.ins[0] = N25XXX_INS__PP;
+            async.ins[3] = 0;
+            break;
+
+        case ASYNC_ERASE:
+            async.ins[0] = N25XXX_INS__SSE;
+            async.ins[3] = 0;
+            break;
+    }
+
+    // Queue the write enable, the transactions of the flash run in order
+    if (req->op != ASYNC_READ)
+    {
+        spi_submit(&async.wren);
+    }
+
+    // Then the instruction, the address and the data
+    async.xfer.tx_buffer = req->op == ASYNC_PROGRAM ? req->buf : NULL;
+    async.xfer.rx_buffer = req->op == ASYNC_READ ? req->buf : NULL;
+    async.xfer.length = req->len;
+    spi_submit(&async.xfer);
+}
+
+bool n25xxx_read_async(uint32_t address, uint8_t *buf, uint16_t len,
+                       result_handler_t handler, handler_arg_t arg)
+{
+    return async_push(ASYNC_READ, address, buf, len, handler, arg);
+}
+
+bool n25xxx_write_page_async(uint32_t address, uint8_t *buf,
+                             result_handler_t handler, handler_arg_t arg)
+{
+    return async_push(ASYNC_PROGRAM, address, buf, 256, handler, arg);
+}
+
+bool n25xxx_erase_subsector_async(uint32_t address,
+                                  result_handler_t handler, handler_arg_t arg)
+{
+    return async_push(ASYNC_ERASE, address, NULL, 0, handler, arg);
+}
+
+uint8_t n25xxx_async_pending()
+{
+    return async.count;
+}
@@ -487,7 +487,8 @@ void max6x_set_rdy_handler(handler_t handler, handler_arg_t arg)
 
 uint32_t max6x_data_count(uint16_t *count, result_handler_t handler, handler_arg_t arg)
 {
-    uint8_t reg = 0xFD;
+    // Static, an asynchronous transfer may start after the return
+    static const uint8_t reg = 0xFD;
 
     if (handler)
     {
@@ -41,6 +41,8 @@ set(PLATFORM_HAS_PHY 1)
 set(PLATFORM_HAS_SYSTICK 1)
 set(PLATFORM_HAS_SOFTTIM 1)
 set(PLATFORM_HAS_USB 1)
+# USB mass storage IN buffers of 4 sectors, for the multi-sector reads
+set(MY_C_FLAGS "${MY_C_FLAGS} -DMSC_BUFFER_SIZE=2048")
 set(PLATFORM_HAS_TSCH 1)
 set(PLATFORM_HAS_CSMA 1)
 set(PLATFORM_HAS_TDMA 1)
@@ -74,6 +74,15 @@ void platform_drivers_setup()
     gpio_set_uart_tx(GPIO_A, GPIO_PIN_9);
     gpio_set_uart_rx(GPIO_A, GPIO_PIN_10);
 
+    // Start the TIM4 at 1MHz, its channel 4 triggers the ADC scans
+    timer_enable(TIM_4);
+    timer_select_internal_clock(TIM_4, (rcc_sysclk_get_clock_frequency(
+                                           RCC_SYSCLK_CLOCK_PCLK1_TIM) / 1000000) - 1);
+
+    // Configure DMA1 Channel 1 (ADC1)
+    dma_enable(DMA_1_CH1);
+    adc_set_dma(ADC_1, DMA_1_CH1);
+
     // Configure DMA1 Channel 4 (SPI2 RX) and DMA1 Channel 5 (SPI2 TX)
     dma_enable(DMA_1_CH4);
     dma_enable(DMA_1_CH5);
@@ -151,6 +160,11 @@ void i2c2_er_isr()
     i2c_handle_er_interrupt(I2C_2);
 }
 
+void dma1_channel1_isr()
+{
+    dma_handle_interrupt(DMA_1_CH1);
+}
+
 void dma1_channel4_isr()
 {
     dma_handle_interrupt(DMA_1_CH4);
@@ -164,6 +164,7 @@ static _adg759_t adg759 =
         .select_gpio_A1 = GPIO_A, .select_pin_A1 = GPIO_PIN_7
 };
 adg759_t pga308_mux = &adg759;
+openlab_timer_t pga308_timer = TIM_4;
 
 void amp_setup()
 {
@@ -39,7 +39,7 @@
  *----------------------------------------------------------*/
 
 #define configUSE_PREEMPTION            1
-#define configUSE_IDLE_HOOK             0
+#define configUSE_IDLE_HOOK             1
 #define configUSE_TICK_HOOK             0
 #define configCPU_CLOCK_HZ              ((unsigned portLONG)72000000) // Clock setup from main.c in the demo application.
 #define configTICK_RATE_HZ              ((portTickType)1000)
@@ -60,6 +60,14 @@
 #define configUSE_MALLOC_FAILED_HOOK    0
 #define configUSE_APPLICATION_TASK_TAG  0
 
+/* Tickless idle, the tick is stopped while sleeping (see platform.h). */
+#define configUSE_TICKLESS_IDLE         1
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP   1
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) \
+    platform_suppress_ticks_and_sleep(xExpectedIdleTime)
+#include <stdint.h>
+void platform_suppress_ticks_and_sleep(uint32_t expected_ticks);
+
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES           0
 #define configMAX_CO_ROUTINE_PRIORITIES (2)
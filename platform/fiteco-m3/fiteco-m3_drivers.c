@@ -82,9 +82,14 @@ void platform_drivers_setup()
     spi_set_dma(SPI_2, DMA_1_CH4, DMA_1_CH5);
     spi_enable(SPI_2, 4000000, SPI_CLOCK_MODE_IDLE_LOW_RISING);
 
-    // Configure the I2C 1
+    // Configure DMA1 Channel 6 (I2C1 TX) and DMA1 Channel 7 (I2C1 RX)
+    dma_enable(DMA_1_CH6);
+    dma_enable(DMA_1_CH7);
+
+    // Configure the I2C 1 with DMA
     gpio_set_i2c_scl(GPIO_B, GPIO_PIN_6);
     gpio_set_i2c_sda(GPIO_B, GPIO_PIN_7);
+    i2c_set_dma(I2C_1, DMA_1_CH7, DMA_1_CH6);
     i2c_enable(I2C_1, I2C_CLOCK_MODE_FAST);
 
     // Force inclusion of EXTI
@@ -105,6 +110,14 @@ void platform_start_freertos_tick(uint16_t frequency, handler_t handler,
     // For now, until the RTC works, start the systick.
     nvic_enable_systick(frequency, handler, arg);
 }
+uint32_t platform_stretch_freertos_tick(uint32_t ticks)
+{
+    return nvic_stretch_systick(ticks);
+}
+uint32_t platform_restore_freertos_tick()
+{
+    return nvic_restore_systick();
+}
 
 /* ISR handlers */
 void tim2_isr()
@@ -175,3 +188,13 @@ void dma1_channel5_isr()
 {
     dma_handle_interrupt(DMA_1_CH5);
 }
+
+void dma1_channel6_isr()
+{
+    dma_handle_interrupt(DMA_1_CH6);
+}
+
+void dma1_channel7_isr()
+{
+    dma_handle_interrupt(DMA_1_CH7);
+}
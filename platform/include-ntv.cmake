@@ -6,9 +6,9 @@ set(FREERTOS_PORT "Native")
 set(FREERTOS_MEMMANG heap_3)
 
 # GCC target specific flags
-set(MY_C_FLAGS   "${MY_C_FLAGS} -DGCC_NATIVE")
+set(MY_C_FLAGS   "${MY_C_FLAGS} -DGCC_NATIVE -pthread")
 
 # LD target specific flags
-set(MY_LD_FLAGS  "${MY_LD_FLAGS} ")
+set(MY_LD_FLAGS  "${MY_LD_FLAGS} -pthread")
 
 
@@ -7,5 +7,7 @@ set(PLATFORM_VERSION 0x01)
 set(PLATFORM_RAM_KB 1000000)
 
 # Set the flags to select the application that may be compiled
+set(PLATFORM_HAS_DISK_IMAGE 1)
+set(PLATFORM_HAS_SIMULATED_INA226 1)
 
 include(${PROJECT_SOURCE_DIR}/platform/include-ntv.cmake)
@@ -25,6 +25,7 @@
  */
 
 #include "platform.h"
+#include "native.h"
 #include "unique_id.h"
 #include "random.h"
 #include "printf.h"
@@ -48,6 +49,9 @@ void platform_init(void)
     // Setup the libraries
     platform_lib_setup();
 
+    // Setup the networking
+    platform_net_setup();
+
     // Feed the random number generator
     random_init(uid->uid32[2]);
 }
@@ -58,12 +62,57 @@ void platform_init(void)
 
 void platform_run()
 {
+#if defined(LOG_DEFERRED) && LOG_DEFERRED
+    // Send the log records from a low priority task
+    log_deferred_init();
+#endif // LOG_DEFERRED
+
     /* Start the scheduler. */
     vTaskStartScheduler();
 }
 void platform_prevent_low_power() {}
 void platform_release_low_power() {}
 
+static struct
+{
+    platform_idle_handler_t handler;
+    handler_arg_t arg;
+} platform_idle_data =
+{ NULL, NULL };
+
+void platform_set_idle_handler(platform_idle_handler_t handler,
+                               handler_arg_t arg)
+{
+    platform_idle_data.handler = handler;
+    platform_idle_data.arg = arg;
+}
+
+void vApplicationIdleHook(xTaskHandle *pxTask, signed portCHAR *pcTaskName)
+{
+    // Call handler if any
+    if (platform_idle_data.handler)
+    {
+        if (platform_idle_data.handler(platform_idle_data.arg))
+        {
+            // Do not halt the CPU
+            return;
+        }
+    }
+
+    // Wait for an interrupt
+    vPortNativeWaitForInterrupt();
+}
+
+void platform_enter_critical()
+{
+    vPortEnterCritical();
+}
+
+void platform_exit_critical()
+{
+    vPortExitCritical();
+}
+
 
 
 /* ------------------------------------------------------------ */
@@ -71,15 +120,22 @@ void platform_release_low_power() {}
 /* ------------------------------------------------------------ */
 
 /* We cannot #include <stdio.h> due to local printf.h definitions
- * Since we only need the putchar() prototype, here it is ...
+ * Since we only need the putchar() and fflush() prototypes, here they are ...
  */
 int putchar(int c);
+int fflush(void *stream);
 
 void xputc(char c)
 {
     putchar(c);
 }
 
+void printf_flush()
+{
+    // The standard output is buffered by the host
+    fflush(NULL);
+}
+
 /* ------------------------------------------------------------ */
 /*                                                              */
 /* ------------------------------------------------------------ */
@@ -30,11 +30,15 @@
 #include "timer.h"
 
 /* Drivers */
-extern timer_t tim3, tim6;
+extern openlab_timer_t TIM_1, TIM_8;
+extern openlab_timer_t TIM_2, TIM_3, TIM_4;
+extern openlab_timer_t TIM_6, TIM_7;
+extern openlab_timer_t TIM_9, TIM_10, TIM_11;
 
 void platform_drivers_setup();
 void platform_leds_setup();
 void platform_periph_setup();
 void platform_lib_setup();
+void platform_net_setup();
 
 #endif /* _NATIVE_H_ */
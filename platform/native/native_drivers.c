@@ -25,20 +25,35 @@
  */
 
 #include "platform.h"
+#include "native.h"
 #include "unique_id.h"
 #include "timer_.h"
+#include "uart_.h"
 
 /* Timers instantiations */
-static _openlab_timer_t _tim1, _tim8;
-static _openlab_timer_t _tim2, _tim3, _tim4;
-static _openlab_timer_t _tim6, _tim7;
-static _openlab_timer_t _tim9, _tim10, _tim11;
+TIMER_INIT(_tim1);
+TIMER_INIT(_tim8);
+TIMER_INIT(_tim2);
+TIMER_INIT(_tim3);
+TIMER_INIT(_tim4);
+TIMER_INIT(_tim6);
+TIMER_INIT(_tim7);
+TIMER_INIT(_tim9);
+TIMER_INIT(_tim10);
+TIMER_INIT(_tim11);
 
 /* Timers declarations */
-openlab_timer_t TIM_1 = TIM_1, TIM_8  = TIM_8;
-openlab_timer_t TIM_2 = TIM_2, TIM_3  = TIM_3,   TIM_4 = TIM_4;
-openlab_timer_t TIM_6 = TIM_6, TIM_7  = TIM_7;
-openlab_timer_t TIM_9 = TIM_9, TIM_10 = TIM_10, TIM_11 = TIM_11;
+openlab_timer_t TIM_1 = &_tim1, TIM_8  = &_tim8;
+openlab_timer_t TIM_2 = &_tim2, TIM_3  = &_tim3,  TIM_4 = &_tim4;
+openlab_timer_t TIM_6 = &_tim6, TIM_7  = &_tim7;
+openlab_timer_t TIM_9 = &_tim9, TIM_10 = &_tim10, TIM_11 = &_tim11;
+
+/* UARTs, the external one on a pseudo-terminal */
+UART_INIT(_uart_print, UART_NATIVE_STDIO, NULL);
+UART_INIT(_uart_external, UART_NATIVE_PTY, "NATIVE_UART_EXTERNAL");
+
+uart_t uart_print = &_uart_print;
+uart_t uart_external = &_uart_external;
 
 /* unique ID */
 uid_t native_uuid;
@@ -60,6 +75,11 @@ void native_uuid_init()
 void platform_drivers_setup()
 {
     native_uuid_init();
+
+    // Enable the timer for the soft timer, at 32kHz
+    timer_enable(TIM_3);
+    timer_select_external_clock(TIM_3, 0);
+    timer_start(TIM_3, 0xFFFF, NULL, NULL);
 }
 
 /* ------------------------------------------------------------ */
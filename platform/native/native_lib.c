@@ -25,9 +25,19 @@
  */
 
 #include "platform.h"
+#include "native.h"
+
+#include "softtimer/soft_timer_.h"
+#include "event.h"
 
 void platform_lib_setup()
 {
+    // Setup the software timer
+    soft_timer_config(TIM_3, TIMER_CHANNEL_1);
+    timer_start(TIM_3, 0xFFFF, soft_timer_update, NULL);
+
+    // Setup the event system
+    event_init();
 }
 
 
@@ -0,0 +1,50 @@
+/*
+ * This file is part of HiKoB Openlab.
+ *
+ * HiKoB Openlab is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, version 3.
+ *
+ * HiKoB Openlab is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with HiKoB Openlab. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2011-2013 HiKoB.
+ */
+
+
+/*
+ * native_net.c
+ *
+ * The simulated radio receives a frame every NATIVE_PHY_RX_PERIOD_MS
+ * milliseconds on average (20 by default, 0 for none) on the channels of
+ * the NATIVE_PHY_RX_CHANNELS bitmap (all by default).
+ */
+
+#include <stdlib.h>
+
+#include "platform.h"
+#include "native.h"
+
+#include "phy_native/phy_native.h"
+
+static phy_native_t phy_sim;
+phy_t platform_phy = &phy_sim;
+
+static uint32_t env_value(const char *name, uint32_t value)
+{
+    const char *str = getenv(name);
+    return str ? strtoul(str, NULL, 0) : value;
+}
+
+void platform_net_setup()
+{
+    phy_native_init(&phy_sim,
+            soft_timer_ms_to_ticks(env_value("NATIVE_PHY_RX_PERIOD_MS", 20)),
+            env_value("NATIVE_PHY_RX_CHANNELS", PHY_MAP_CHANNEL_2400_ALL));
+}
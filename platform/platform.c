@@ -37,6 +37,11 @@ __attribute__((weak)) void platform_run()
 {
     log_printf("FreeRTOS Heap Free: %u\n", xPortGetFreeHeapSize());
 
+#if defined(LOG_DEFERRED) && LOG_DEFERRED
+    // Send the log records from a low priority task
+    log_deferred_init();
+#endif // LOG_DEFERRED
+
     /* Start the scheduler. */
     vTaskStartScheduler();
 }
@@ -64,9 +69,18 @@ __attribute__((weak)) void platform_set_idle_handler(
     platform_idle_data.arg = arg;
 }
 
+#if configUSE_TICKLESS_IDLE
+/** Set by the idle hook when the CPU should not be halted */
+static uint32_t idle_awake;
+#endif // configUSE_TICKLESS_IDLE
+
 __attribute__((weak)) void vApplicationIdleHook(xTaskHandle *pxTask,
         signed portCHAR *pcTaskName)
 {
+#if configUSE_TICKLESS_IDLE
+    idle_awake = 1;
+#endif // configUSE_TICKLESS_IDLE
+
     // Call handler if any
     if (platform_idle_data.handler)
     {
@@ -77,14 +91,208 @@ __attribute__((weak)) void vApplicationIdleHook(xTaskHandle *pxTask,
         }
     }
 
+#if configUSE_TICKLESS_IDLE
+    // The idle task sleeps next, in platform_suppress_ticks_and_sleep
+    idle_awake = 0;
+#else
     // Enter SLEEP mode
     asm volatile("wfi");
+#endif // configUSE_TICKLESS_IDLE
 }
+
+#if configUSE_TICKLESS_IDLE
+/*
+ * Tickless idle: the tick interrupt is delayed until the next task unblocks
+ * (the next vTaskDelay or queue timeout). The soft timer alarms, as all the
+ * other interrupts, end the sleep earlier: the event task they post to is
+ * readied and the tick count is corrected with the periods actually slept.
+ *
+ * The sleep is the SLEEP mode, with the clocks running, as required while
+ * platform_prevent_low_power is in effect.
+ */
+void platform_suppress_ticks_and_sleep(uint32_t expected_ticks)
+{
+    if (idle_awake)
+    {
+        return;
+    }
+
+    // Mask interrupts, they still end the WFI
+    asm volatile("cpsid i");
+
+    // A task may have been readied since the expected time was computed
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep)
+    {
+        asm volatile("cpsie i");
+        return;
+    }
+
+    if (expected_ticks > 1)
+    {
+        platform_stretch_freertos_tick(expected_ticks);
+    }
+
+    // Enter SLEEP mode
+    asm volatile("wfi");
+
+    if (expected_ticks > 1)
+    {
+        // The pending tick interrupt, if any, counts its own period
+        vTaskStepTick(platform_restore_freertos_tick());
+    }
+
+    // Unmask interrupts
+    asm volatile("cpsie i");
+}
+#endif // configUSE_TICKLESS_IDLE
+#if defined(PRINT_BUFFER) && PRINT_BUFFER
+/*
+ * Buffered output: printf writes in a ring buffer, drained in background by
+ * asynchronous transfers on the print UART (with DMA if the UART has a TX
+ * channel). When the buffer is full, the characters are dropped and a '~'
+ * marks the gap, or with PRINT_BUFFER_BLOCK the caller waits when the
+ * interrupts allow it.
+ */
+#ifndef PRINT_BUFFER_BLOCK
+#define PRINT_BUFFER_BLOCK 0
+#endif
+
+static struct
+{
+    char buffer[PRINT_BUFFER];
+
+    /** Free running write and read indexes */
+    volatile uint32_t head, tail;
+
+    /** Length of the transfer in progress, 0 if none */
+    volatile uint32_t sending;
+
+    /** Set when characters were dropped, to mark the gap */
+    uint32_t dropped;
+
+    /** Set once flushed, to write synchronously */
+    uint32_t sync;
+} print;
+
+static void print_start();
+
+/** Check that the TX interrupts may run, i.e. waiting is possible */
+static int print_can_wait()
+{
+    uint32_t primask, basepri, ipsr;
+
+    asm volatile("mrs %0, primask" : "=r"(primask));
+    asm volatile("mrs %0, basepri" : "=r"(basepri));
+    asm volatile("mrs %0, ipsr" : "=r"(ipsr));
+
+    return (primask == 0) && (basepri == 0) && ((ipsr & 0x1FF) == 0);
+}
+
+static void print_done(handler_arg_t arg)
+{
+    print.tail += print.sending;
+    print.sending = 0;
+
+    if (print.head != print.tail)
+    {
+        print_start();
+    }
+}
+
+/** Start sending the contiguous part of the buffer, in critical section */
+static void print_start()
+{
+    uint32_t index = print.tail % PRINT_BUFFER;
+    uint32_t length = print.head - print.tail;
+
+    if (length > PRINT_BUFFER - index)
+    {
+        length = PRINT_BUFFER - index;
+    }
+
+    print.sending = length;
+    uart_transfer_async(uart_print, (const uint8_t *) print.buffer + index,
+            length, print_done, NULL);
+}
+
+__attribute__((weak)) void xputc(char c)
+{
+    if (print.sync)
+    {
+        uart_transfer(uart_print, (const uint8_t *) &c, 1);
+        return;
+    }
+
+    // Wait for room if allowed, the transfers run in interrupts
+    while (PRINT_BUFFER_BLOCK && (print.head - print.tail >= PRINT_BUFFER)
+            && print_can_wait())
+    {
+    }
+
+    platform_enter_critical();
+
+    // Room for the gap mark and the character
+    if (print.head - print.tail + (print.dropped ? 2 : 1) > PRINT_BUFFER)
+    {
+        print.dropped = 1;
+        platform_exit_critical();
+        return;
+    }
+
+    if (print.dropped)
+    {
+        print.buffer[print.head++ % PRINT_BUFFER] = '~';
+        print.dropped = 0;
+    }
+    print.buffer[print.head++ % PRINT_BUFFER] = c;
+
+    if (print.sending == 0)
+    {
+        print_start();
+    }
+
+    platform_exit_critical();
+}
+
+__attribute__((weak)) void printf_flush()
+{
+    // The pending characters are sent if the interrupts can run
+    if (print_can_wait())
+    {
+        while (print.sending)
+        {
+        }
+    }
+
+    // Else complete the transfer in progress, and write the rest synchronously
+    platform_enter_critical();
+    if (print.sending)
+    {
+        uart_transfer_async_finish(uart_print);
+    }
+    print.tail += print.sending;
+    print.sending = 0;
+    print.sync = 1;
+
+    while (print.head != print.tail)
+    {
+        uart_transfer(uart_print,
+                (const uint8_t *) print.buffer + print.tail++ % PRINT_BUFFER,
+                1);
+    }
+    platform_exit_critical();
+}
+#else // PRINT_BUFFER
 __attribute__((weak)) void xputc(char c)
 {
     uart_transfer(uart_print, (const uint8_t *) &c, 1);
 }
 
+__attribute__((weak)) void printf_flush()
+{
+}
+#endif // PRINT_BUFFER
+
 __attribute__((weak)) void vApplicationStackOverflowHook(xTaskHandle *pxTask,
         signed portCHAR *pcTaskName)
 {
@@ -127,6 +127,27 @@ void button_set_handler(handler_t handler, handler_arg_t handler_arg);
 void platform_start_freertos_tick(uint16_t frequency, handler_t handler,
                                   handler_arg_t arg);
 
+/**
+ * Delay the next FreeRTOS tick, for the tickless idle.
+ *
+ * This is required on the platforms setting configUSE_TICKLESS_IDLE, whose
+ * FreeRTOSConfig.h maps portSUPPRESS_TICKS_AND_SLEEP to
+ * platform_suppress_ticks_and_sleep. It is called by the idle task with the
+ * interrupts masked.
+ *
+ * \param ticks the number of tick periods until the next tick
+ * \return the number of tick periods actually delayed
+ */
+uint32_t platform_stretch_freertos_tick(uint32_t ticks);
+
+/**
+ * Restore the periodic FreeRTOS tick after a tickless idle period.
+ *
+ * \return the number of tick periods ended while delayed, not counting the
+ *  one with a pending tick interrupt
+ */
+uint32_t platform_restore_freertos_tick();
+
 /**
  * Handler prototype for IDLE listener.
  *
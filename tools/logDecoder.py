@@ -0,0 +1,215 @@
+#!/usr/bin/env python
+
+"""Decoder of the deferred logs of the firmware
+
+The firmware built with LOG_DEFERRED=1 sends binary log records mixed with
+the regular printf output. The format strings and function names are not
+sent, they are read from the ELF file of the firmware:
+
+    logDecoder.py build/bin/app.elf -p /dev/ttyUSB1
+    logDecoder.py build/bin/app.elf < capture.bin
+"""
+
+from __future__ import print_function
+
+import re
+import sys
+import struct
+import argparse
+
+FRAME_START = 0x1E
+LEVELS = {0: "debug", 1: "info", 2: "warning", 3: "error"}
+HEADER_WORDS = 4
+
+
+class Elf(object):
+    """Minimal ELF reader, giving the strings at a target address"""
+
+    def __init__(self, path):
+        with open(path, "rb") as elf:
+            self.data = elf.read()
+
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError("%s is not an ELF file" % path)
+
+        is64 = ord(self.data[4:5]) == 2
+        endian = "<" if ord(self.data[5:6]) == 1 else ">"
+
+        if is64:
+            shoff, = struct.unpack_from(endian + "Q", self.data, 0x28)
+            shentsize, shnum = struct.unpack_from(endian + "HH", self.data,
+                                                  0x3A)
+            section = endian + "IIQQQQ"
+        else:
+            shoff, = struct.unpack_from(endian + "I", self.data, 0x20)
+            shentsize, shnum = struct.unpack_from(endian + "HH", self.data,
+                                                  0x2E)
+            section = endian + "IIIIII"
+
+        # Sections with content loaded in memory (SHF_ALLOC, not NOBITS)
+        self.sections = []
+        for i in range(shnum):
+            _name, stype, flags, addr, offset, size = struct.unpack_from(
+                section, self.data, shoff + i * shentsize)
+            if flags & 0x2 and stype != 8 and size:
+                self.sections.append((addr, offset, size))
+
+    def string(self, addr):
+        for start, offset, size in self.sections:
+            if start <= addr < start + size:
+                begin = offset + addr - start
+                end = self.data.find(b"\0", begin, offset + size)
+                if end < 0:
+                    end = offset + size
+                return self.data[begin:end].decode("ascii", "replace")
+        return None
+
+
+CONVERSION = re.compile(r"%([-+ 0#]*)(\d*)(?:\.(\d+))?(l{0,2}|h{0,2}|z)"
+                        r"([diuxXcsp%])")
+FLOAT_CONVERSION = re.compile(r"%%|%[-+ 0#]*\d*(?:\.\d+)?(?:l{0,2}|h{0,2}|z|L)"
+                              r"([feEgGaA])")
+
+
+def has_float(fmt):
+    """Check if a format has a floating point conversion"""
+    return any(match.group(1) for match in FLOAT_CONVERSION.finditer(fmt))
+
+
+def render(elf, fmt, args):
+    """Format a printf subset with 32bit arguments"""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, _length, conv = match.groups()
+        if conv == "%":
+            return "%"
+        if not args:
+            return match.group(0)
+
+        value = args.pop(0)
+        if conv == "s":
+            text = elf.string(value)
+            if text is None:
+                text = "<0x%08x>" % value
+            spec = "%" + flags + width + ("." + precision if precision else "")
+            return (spec + "s") % text
+        if conv == "d" or conv == "i":
+            if value & 0x80000000:
+                value -= 1 << 32
+            conv = "d"
+        elif conv == "p":
+            flags, conv = "#", "x"
+        elif conv == "c":
+            value = chr(value & 0xFF)
+        return ("%" + flags + width + conv) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+class Decoder(object):
+    def __init__(self, elf, frequency, out):
+        self.elf = elf
+        self.frequency = frequency
+        self.out = out
+        self.buf = bytearray()
+        self.sequence = None
+        self.lost = 0
+
+    def feed(self, data):
+        self.buf += bytearray(data)
+
+        while self.buf:
+            start = self.buf.find(bytearray([FRAME_START]))
+            if start < 0:
+                self.text(self.buf)
+                del self.buf[:]
+                break
+
+            self.text(self.buf[:start])
+            del self.buf[:start]
+
+            if len(self.buf) < 2:
+                break
+            length = self.buf[1]
+            if len(self.buf) < 2 + 4 * length:
+                break
+
+            words = struct.unpack("<%uI" % length,
+                                  bytes(self.buf[2:2 + 4 * length]))
+            del self.buf[:2 + 4 * length]
+            self.record(words)
+
+    def text(self, data):
+        if data:
+            self.out.write(bytes(data).decode("ascii", "replace"))
+            self.out.flush()
+
+    def record(self, words):
+        if len(words) < HEADER_WORDS:
+            return
+
+        info, time, fmt, func = words[:HEADER_WORDS]
+        sequence, level, nargs = info >> 16, (info >> 8) & 0xFF, info & 0x7F
+
+        if self.sequence is not None and sequence != self.sequence:
+            missed = (sequence - self.sequence) & 0xFFFF
+            self.lost += missed
+            self.out.write("*** %u log records lost\n" % missed)
+        self.sequence = (sequence + 1) & 0xFFFF
+
+        fmt_str = self.elf.string(fmt)
+        if fmt_str is None:
+            fmt_str = "<unknown format 0x%08x>" % fmt
+        func_str = self.elf.string(func) or "0x%08x" % func
+        # The doubles are not 32bit words, the arguments are not readable
+        if has_float(fmt_str):
+            fmt_str = fmt_str.rstrip("\n") + " <floating point arguments dropped>"
+            nargs = 0
+
+        self.out.write("[%10.6f] %s: %s: %s\n"
+                       % (float(time) / self.frequency,
+                          LEVELS.get(level, str(level)), func_str,
+                          render(self.elf, fmt_str,
+                                 words[HEADER_WORDS:HEADER_WORDS + nargs])
+                          .rstrip("\n")))
+        self.out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="ELF file of the running firmware")
+    parser.add_argument("-p", "--port", default=None,
+                        help="serial port, standard input if not set")
+    parser.add_argument("-b", "--baudrate", type=int, default=500000)
+    parser.add_argument("-f", "--frequency", type=int, default=32768,
+                        help="soft timer frequency, in Hz")
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf), args.frequency, sys.stdout)
+
+    if args.port:
+        import serial
+        stream = serial.Serial(args.port, args.baudrate, timeout=0.5)
+    else:
+        stream = getattr(sys.stdin, "buffer", sys.stdin)
+
+    try:
+        while True:
+            if args.port:
+                data = stream.read(max(1, stream.in_waiting))
+            else:
+                data = stream.read1(256) if hasattr(stream, "read1") \
+                    else stream.read(256)
+                if not data:
+                    break
+            decoder.feed(data)
+    except KeyboardInterrupt:
+        pass
+
+    if decoder.lost:
+        print("# %u log records lost" % decoder.lost, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()